@@ -36,6 +36,20 @@
 #include "Pkcs5.h"
 #include "Crypto.h"
 
+#if !defined (TC_WINDOWS_BOOT) && !defined (DEVICE_DRIVER) && !defined (_UEFI) && !defined (WOLFCRYPT_BACKEND) && (CRYPTOPP_BOOL_X64 || CRYPTOPP_BOOL_X86 || CRYPTOPP_BOOL_X32)
+/* PBKDF2 output blocks are independent HMAC chains: compute them in parallel SIMD lanes */
+#define TC_SHA2_MB
+#include "Sha2Mb.h"
+#endif
+
+#ifndef TC_WINDOWS_BOOT
+/* A running derivation polls its abort flag (if any) once per this many iterations */
+#define PKCS5_ABORT_CHECK_INTERVAL	1024
+#define PKCS5_ABORT_CHECK(c, pAbort)	(((c) & (PKCS5_ABORT_CHECK_INTERVAL - 1)) == 0 && (pAbort) && *(pAbort))
+#else
+#define PKCS5_ABORT_CHECK(c, pAbort)	0
+#endif
+
 #if !defined(TC_WINDOWS_BOOT) || defined(TC_WINDOWS_BOOT_SHA2)
 
 typedef struct hmac_sha256_ctx_struct
@@ -145,7 +159,7 @@ void hmac_sha256
 }
 #endif
 
-static void derive_u_sha256 (const unsigned char *salt, int salt_len, uint32 iterations, int b, hmac_sha256_ctx* hmac)
+static void derive_u_sha256 (const unsigned char *salt, int salt_len, uint32 iterations, int b, hmac_sha256_ctx* hmac, long volatile *pAbortKeyDerivation)
 {
 	unsigned char* k = hmac->k;
 	unsigned char* u = hmac->u;
@@ -192,16 +206,93 @@ static void derive_u_sha256 (const unsigned char *salt, int salt_len, uint32 ite
 			u[i] ^= k[i];
 		}
 		c--;
+
+		if (PKCS5_ABORT_CHECK (c, pAbortKeyDerivation))
+			break;
 	}
 }
 
+#ifdef TC_SHA2_MB
+typedef void (*sha256_mb_pbkdf2_fn) (const uint_32t inner[8], const uint_32t outer[8], uint_32t u[8 * SHA256_MB_LANES], uint_32t t[8 * SHA256_MB_LANES], uint_32t iterations);
+
+static sha256_mb_pbkdf2_fn get_sha256_mb_pbkdf2 ()
+{
+	if (HasSAVX512F() && HasSAVX512VL() && sha2_mb_has_avx512 ())
+		return sha256_mb_pbkdf2_avx512;
+	if (HasSAVX() && HasSAVX2() && sha2_mb_has_avx2 ())
+		return sha256_mb_pbkdf2_avx2;
+	return NULL;
+}
+
+/* Computes blocks b to b + count - 1 (count <= SHA256_MB_LANES) and writes the first len bytes of their concatenation to dk */
+static void derive_u_sha256_mb (sha256_mb_pbkdf2_fn pbkdf2, const unsigned char *salt, int salt_len, uint32 iterations, int b, int count, hmac_sha256_ctx* hmac, unsigned char *dk, int len, long volatile *pAbortKeyDerivation)
+{
+	CRYPTOPP_ALIGN_DATA(32) uint_32t u[8 * SHA256_MB_LANES];
+	CRYPTOPP_ALIGN_DATA(32) uint_32t t[8 * SHA256_MB_LANES];
+	unsigned char* k = hmac->k;
+	uint32 be, c, chunk;
+	int lane, i;
 
-void derive_key_sha256 (const unsigned char *pwd, int pwd_len, const unsigned char *salt, int salt_len, uint32 iterations, unsigned char *dk, int dklen)
+	memset (u, 0, sizeof (u));
+
+	/* iteration 1 of every chain */
+	for (lane = 0; lane < count; lane++)
+	{
+		memcpy (k, salt, salt_len);
+		be = bswap_32 ((uint32) (b + lane));
+		memcpy (&k[salt_len], &be, 4);
+
+		hmac_sha256_internal (k, salt_len + 4, hmac);
+
+		for (i = 0; i < 8; i++)
+		{
+			memcpy (&be, &k[i * 4], 4);
+			u[i * SHA256_MB_LANES + lane] = bswap_32 (be);
+		}
+	}
+
+	memcpy (t, u, sizeof (t));
+
+	/* remaining iterations, in chunks so that an abort request is noticed */
+	for (c = iterations > 1 ? iterations - 1 : 0; c > 0; c -= chunk)
+	{
+		chunk = c < PKCS5_ABORT_CHECK_INTERVAL ? c : PKCS5_ABORT_CHECK_INTERVAL;
+		pbkdf2 (hmac->inner_digest_ctx.hash, hmac->outer_digest_ctx.hash, u, t, chunk);
+
+		if (pAbortKeyDerivation && *pAbortKeyDerivation)
+			break;
+	}
+
+	for (lane = 0; lane < count; lane++)
+	{
+		for (i = 0; i < 8; i++)
+		{
+			be = bswap_32 (t[i * SHA256_MB_LANES + lane]);
+			memcpy (&k[i * 4], &be, 4);
+		}
+
+		memcpy (dk, k, len < SHA256_DIGESTSIZE ? len : SHA256_DIGESTSIZE);
+		dk += SHA256_DIGESTSIZE;
+		len -= SHA256_DIGESTSIZE;
+	}
+
+	burn (u, sizeof (u));
+	burn (t, sizeof (t));
+	burn (&be, sizeof (be));
+}
+#endif
+
+
+void derive_key_sha256 (const unsigned char *pwd, int pwd_len, const unsigned char *salt, int salt_len, uint32 iterations, unsigned char *dk, int dklen, long volatile *pAbortKeyDerivation)
 {	
 	hmac_sha256_ctx hmac;
 	sha256_ctx* ctx;
 	unsigned char* buf = hmac.k;
 	int b, l, r;
+#ifdef TC_SHA2_MB
+	sha256_mb_pbkdf2_fn mb_pbkdf2 = get_sha256_mb_pbkdf2 ();
+	int n;
+#endif
 #ifndef TC_WINDOWS_BOOT
 	unsigned char key[SHA256_DIGESTSIZE];
 #if defined (DEVICE_DRIVER) && !defined(_M_ARM64)
@@ -261,17 +352,32 @@ void derive_key_sha256 (const unsigned char *pwd, int pwd_len, const unsigned ch
 
 	sha256_hash (buf, SHA256_BLOCKSIZE, ctx);
 
-	/* first l - 1 blocks */
-	for (b = 1; b < l; b++)
+#ifdef TC_SHA2_MB
+	if (mb_pbkdf2 && l > 1)
 	{
-		derive_u_sha256 (salt, salt_len, iterations, b, &hmac);
-		memcpy (dk, hmac.u, SHA256_DIGESTSIZE);
-		dk += SHA256_DIGESTSIZE;
+		/* all blocks, SHA256_MB_LANES at a time */
+		for (b = 1; b <= l; b += n)
+		{
+			n = (l - b + 1 < SHA256_MB_LANES) ? (l - b + 1) : SHA256_MB_LANES;
+			derive_u_sha256_mb (mb_pbkdf2, salt, salt_len, iterations, b, n, &hmac, dk, (b + n > l) ? (n - 1) * SHA256_DIGESTSIZE + r : n * SHA256_DIGESTSIZE, pAbortKeyDerivation);
+			dk += n * SHA256_DIGESTSIZE;
+		}
 	}
+	else
+#endif
+	{
+		/* first l - 1 blocks */
+		for (b = 1; b < l; b++)
+		{
+			derive_u_sha256 (salt, salt_len, iterations, b, &hmac, pAbortKeyDerivation);
+			memcpy (dk, hmac.u, SHA256_DIGESTSIZE);
+			dk += SHA256_DIGESTSIZE;
+		}
 
-	/* last block */
-	derive_u_sha256 (salt, salt_len, iterations, b, &hmac);
-	memcpy (dk, hmac.u, r);
+		/* last block */
+		derive_u_sha256 (salt, salt_len, iterations, b, &hmac, pAbortKeyDerivation);
+		memcpy (dk, hmac.u, r);
+	}
 
 #if defined (DEVICE_DRIVER) && !defined(_M_ARM64)
 	if (NT_SUCCESS (saveStatus))
@@ -395,7 +501,7 @@ void hmac_sha512
 	burn (key, sizeof(key));
 }
 
-static void derive_u_sha512 (const unsigned char *salt, int salt_len, uint32 iterations, int b, hmac_sha512_ctx* hmac)
+static void derive_u_sha512 (const unsigned char *salt, int salt_len, uint32 iterations, int b, hmac_sha512_ctx* hmac, long volatile *pAbortKeyDerivation)
 {
 	unsigned char* k = hmac->k;
 	unsigned char* u = hmac->u;
@@ -418,16 +524,94 @@ static void derive_u_sha512 (const unsigned char *salt, int salt_len, uint32 ite
 		{
 			u[i] ^= k[i];
 		}
+
+		if (PKCS5_ABORT_CHECK (c, pAbortKeyDerivation))
+			break;
 	}
 }
 
+#ifdef TC_SHA2_MB
+typedef void (*sha512_mb_pbkdf2_fn) (const uint_64t inner[8], const uint_64t outer[8], uint_64t u[8 * SHA512_MB_LANES], uint_64t t[8 * SHA512_MB_LANES], uint_32t iterations);
 
-void derive_key_sha512 (const unsigned char *pwd, int pwd_len, const unsigned char *salt, int salt_len, uint32 iterations, unsigned char *dk, int dklen)
+static sha512_mb_pbkdf2_fn get_sha512_mb_pbkdf2 ()
+{
+	if (HasSAVX512F() && HasSAVX512VL() && sha2_mb_has_avx512 ())
+		return sha512_mb_pbkdf2_avx512;
+	if (HasSAVX() && HasSAVX2() && sha2_mb_has_avx2 ())
+		return sha512_mb_pbkdf2_avx2;
+	return NULL;
+}
+
+/* Computes blocks b to b + count - 1 (count <= SHA512_MB_LANES) and writes the first len bytes of their concatenation to dk */
+static void derive_u_sha512_mb (sha512_mb_pbkdf2_fn pbkdf2, const unsigned char *salt, int salt_len, uint32 iterations, int b, int count, hmac_sha512_ctx* hmac, unsigned char *dk, int len, long volatile *pAbortKeyDerivation)
+{
+	CRYPTOPP_ALIGN_DATA(32) uint_64t u[8 * SHA512_MB_LANES];
+	CRYPTOPP_ALIGN_DATA(32) uint_64t t[8 * SHA512_MB_LANES];
+	unsigned char* k = hmac->k;
+	uint64 be;
+	uint32 be32, c, chunk;
+	int lane, i;
+
+	memset (u, 0, sizeof (u));
+
+	/* iteration 1 of every chain */
+	for (lane = 0; lane < count; lane++)
+	{
+		memcpy (k, salt, salt_len);
+		be32 = bswap_32 ((uint32) (b + lane));
+		memcpy (&k[salt_len], &be32, 4);
+
+		hmac_sha512_internal (k, salt_len + 4, hmac);
+
+		for (i = 0; i < 8; i++)
+		{
+			memcpy (&be, &k[i * 8], 8);
+			u[i * SHA512_MB_LANES + lane] = bswap_64 (be);
+		}
+	}
+
+	memcpy (t, u, sizeof (t));
+
+	/* remaining iterations, in chunks so that an abort request is noticed */
+	for (c = iterations > 1 ? iterations - 1 : 0; c > 0; c -= chunk)
+	{
+		chunk = c < PKCS5_ABORT_CHECK_INTERVAL ? c : PKCS5_ABORT_CHECK_INTERVAL;
+		pbkdf2 (hmac->inner_digest_ctx.hash, hmac->outer_digest_ctx.hash, u, t, chunk);
+
+		if (pAbortKeyDerivation && *pAbortKeyDerivation)
+			break;
+	}
+
+	for (lane = 0; lane < count; lane++)
+	{
+		for (i = 0; i < 8; i++)
+		{
+			be = bswap_64 (t[i * SHA512_MB_LANES + lane]);
+			memcpy (&k[i * 8], &be, 8);
+		}
+
+		memcpy (dk, k, len < SHA512_DIGESTSIZE ? len : SHA512_DIGESTSIZE);
+		dk += SHA512_DIGESTSIZE;
+		len -= SHA512_DIGESTSIZE;
+	}
+
+	burn (u, sizeof (u));
+	burn (t, sizeof (t));
+	burn (&be, sizeof (be));
+}
+#endif
+
+
+void derive_key_sha512 (const unsigned char *pwd, int pwd_len, const unsigned char *salt, int salt_len, uint32 iterations, unsigned char *dk, int dklen, long volatile *pAbortKeyDerivation)
 {
 	hmac_sha512_ctx hmac;
 	sha512_ctx* ctx;
 	unsigned char* buf = hmac.k;
 	int b, l, r;
+#ifdef TC_SHA2_MB
+	sha512_mb_pbkdf2_fn mb_pbkdf2 = get_sha512_mb_pbkdf2 ();
+	int n;
+#endif
 	unsigned char key[SHA512_DIGESTSIZE];
 #if defined (DEVICE_DRIVER) && !defined(_M_ARM64)
 	NTSTATUS saveStatus = STATUS_INVALID_PARAMETER;
@@ -486,17 +670,32 @@ void derive_key_sha512 (const unsigned char *pwd, int pwd_len, const unsigned ch
 
 	sha512_hash (buf, SHA512_BLOCKSIZE, ctx);
 
-	/* first l - 1 blocks */
-	for (b = 1; b < l; b++)
+#ifdef TC_SHA2_MB
+	if (mb_pbkdf2 && l > 1)
 	{
-		derive_u_sha512 (salt, salt_len, iterations, b, &hmac);
-		memcpy (dk, hmac.u, SHA512_DIGESTSIZE);
-		dk += SHA512_DIGESTSIZE;
+		/* all blocks, SHA512_MB_LANES at a time */
+		for (b = 1; b <= l; b += n)
+		{
+			n = (l - b + 1 < SHA512_MB_LANES) ? (l - b + 1) : SHA512_MB_LANES;
+			derive_u_sha512_mb (mb_pbkdf2, salt, salt_len, iterations, b, n, &hmac, dk, (b + n > l) ? (n - 1) * SHA512_DIGESTSIZE + r : n * SHA512_DIGESTSIZE, pAbortKeyDerivation);
+			dk += n * SHA512_DIGESTSIZE;
+		}
 	}
+	else
+#endif
+	{
+		/* first l - 1 blocks */
+		for (b = 1; b < l; b++)
+		{
+			derive_u_sha512 (salt, salt_len, iterations, b, &hmac, pAbortKeyDerivation);
+			memcpy (dk, hmac.u, SHA512_DIGESTSIZE);
+			dk += SHA512_DIGESTSIZE;
+		}
 
-	/* last block */
-	derive_u_sha512 (salt, salt_len, iterations, b, &hmac);
-	memcpy (dk, hmac.u, r);
+		/* last block */
+		derive_u_sha512 (salt, salt_len, iterations, b, &hmac, pAbortKeyDerivation);
+		memcpy (dk, hmac.u, r);
+	}
 
 #if defined (DEVICE_DRIVER) && !defined(_M_ARM64)
 	if (NT_SUCCESS (saveStatus))
@@ -619,7 +818,7 @@ void hmac_blake2s
 }
 #endif
 
-static void derive_u_blake2s (const unsigned char *salt, int salt_len, uint32 iterations, int b, hmac_blake2s_ctx* hmac)
+static void derive_u_blake2s (const unsigned char *salt, int salt_len, uint32 iterations, int b, hmac_blake2s_ctx* hmac, long volatile *pAbortKeyDerivation)
 {
 	unsigned char* k = hmac->k;
 	unsigned char* u = hmac->u;
@@ -666,11 +865,14 @@ static void derive_u_blake2s (const unsigned char *salt, int salt_len, uint32 it
 			u[i] ^= k[i];
 		}
 		c--;
+
+		if (PKCS5_ABORT_CHECK (c, pAbortKeyDerivation))
+			break;
 	}
 }
 
 
-void derive_key_blake2s (const unsigned char *pwd, int pwd_len, const unsigned char *salt, int salt_len, uint32 iterations, unsigned char *dk, int dklen)
+void derive_key_blake2s (const unsigned char *pwd, int pwd_len, const unsigned char *salt, int salt_len, uint32 iterations, unsigned char *dk, int dklen, long volatile *pAbortKeyDerivation)
 {	
 	hmac_blake2s_ctx hmac;
 	blake2s_state* ctx;
@@ -738,13 +940,13 @@ void derive_key_blake2s (const unsigned char *pwd, int pwd_len, const unsigned c
 	/* first l - 1 blocks */
 	for (b = 1; b < l; b++)
 	{
-		derive_u_blake2s (salt, salt_len, iterations, b, &hmac);
+		derive_u_blake2s (salt, salt_len, iterations, b, &hmac, pAbortKeyDerivation);
 		memcpy (dk, hmac.u, BLAKE2S_DIGESTSIZE);
 		dk += BLAKE2S_DIGESTSIZE;
 	}
 
 	/* last block */
-	derive_u_blake2s (salt, salt_len, iterations, b, &hmac);
+	derive_u_blake2s (salt, salt_len, iterations, b, &hmac, pAbortKeyDerivation);
 	memcpy (dk, hmac.u, r);
 
 #if defined (DEVICE_DRIVER) && !defined(_M_ARM64)
@@ -856,7 +1058,7 @@ void hmac_whirlpool
 	burn(&hmac, sizeof(hmac));
 }
 
-static void derive_u_whirlpool (const unsigned char *salt, int salt_len, uint32 iterations, int b, hmac_whirlpool_ctx* hmac)
+static void derive_u_whirlpool (const unsigned char *salt, int salt_len, uint32 iterations, int b, hmac_whirlpool_ctx* hmac, long volatile *pAbortKeyDerivation)
 {
 	unsigned char* u = hmac->u;
 	unsigned char* k = hmac->k;
@@ -879,10 +1081,13 @@ static void derive_u_whirlpool (const unsigned char *salt, int salt_len, uint32
 		{
 			u[i] ^= k[i];
 		}
+
+		if (PKCS5_ABORT_CHECK (c, pAbortKeyDerivation))
+			break;
 	}
 }
 
-void derive_key_whirlpool (const unsigned char *pwd, int pwd_len, const unsigned char *salt, int salt_len, uint32 iterations, unsigned char *dk, int dklen)
+void derive_key_whirlpool (const unsigned char *pwd, int pwd_len, const unsigned char *salt, int salt_len, uint32 iterations, unsigned char *dk, int dklen, long volatile *pAbortKeyDerivation)
 {
 	hmac_whirlpool_ctx hmac;
 	WHIRLPOOL_CTX* ctx;
@@ -942,13 +1147,13 @@ void derive_key_whirlpool (const unsigned char *pwd, int pwd_len, const unsigned
 	/* first l - 1 blocks */
 	for (b = 1; b < l; b++)
 	{
-		derive_u_whirlpool (salt, salt_len, iterations, b, &hmac);
+		derive_u_whirlpool (salt, salt_len, iterations, b, &hmac, pAbortKeyDerivation);
 		memcpy (dk, hmac.u, WHIRLPOOL_DIGESTSIZE);
 		dk += WHIRLPOOL_DIGESTSIZE;
 	}
 
 	/* last block */
-	derive_u_whirlpool (salt, salt_len, iterations, b, &hmac);
+	derive_u_whirlpool (salt, salt_len, iterations, b, &hmac, pAbortKeyDerivation);
 	memcpy (dk, hmac.u, r);
 
 	/* Prevent possible leaks. */
@@ -1050,7 +1255,7 @@ void hmac_streebog
 	burn(&hmac, sizeof(hmac));
 }
 
-static void derive_u_streebog (const unsigned char *salt, int salt_len, uint32 iterations, int b, hmac_streebog_ctx* hmac)
+static void derive_u_streebog (const unsigned char *salt, int salt_len, uint32 iterations, int b, hmac_streebog_ctx* hmac, long volatile *pAbortKeyDerivation)
 {
 	unsigned char* u = hmac->u;
 	unsigned char* k = hmac->k;
@@ -1073,10 +1278,13 @@ static void derive_u_streebog (const unsigned char *salt, int salt_len, uint32 i
 		{
 			u[i] ^= k[i];
 		}
+
+		if (PKCS5_ABORT_CHECK (c, pAbortKeyDerivation))
+			break;
 	}
 }
 
-void derive_key_streebog (const unsigned char *pwd, int pwd_len, const unsigned char *salt, int salt_len, uint32 iterations, unsigned char *dk, int dklen)
+void derive_key_streebog (const unsigned char *pwd, int pwd_len, const unsigned char *salt, int salt_len, uint32 iterations, unsigned char *dk, int dklen, long volatile *pAbortKeyDerivation)
 {
 	hmac_streebog_ctx hmac;
 	STREEBOG_CTX* ctx;
@@ -1136,13 +1344,13 @@ void derive_key_streebog (const unsigned char *pwd, int pwd_len, const unsigned
 	/* first l - 1 blocks */
 	for (b = 1; b < l; b++)
 	{
-		derive_u_streebog (salt, salt_len, iterations, b, &hmac);
+		derive_u_streebog (salt, salt_len, iterations, b, &hmac, pAbortKeyDerivation);
 		memcpy (dk, hmac.u, STREEBOG_DIGESTSIZE);
 		dk += STREEBOG_DIGESTSIZE;
 	}
 
 	/* last block */
-	derive_u_streebog (salt, salt_len, iterations, b, &hmac);
+	derive_u_streebog (salt, salt_len, iterations, b, &hmac, pAbortKeyDerivation);
 	memcpy (dk, hmac.u, r);
 
 	/* Prevent possible leaks. */
@@ -54,6 +54,14 @@ namespace VeraCrypt
 		TC_CLONE (SlotNumber);
 		TC_CLONE (UseBackupHeaders);
 		TC_CLONE (SecurityTokenSchemeSpec);
+		TC_CLONE (ReadAheadSize);
+		TC_CLONE (SectorCacheSize);
+		TC_CLONE (AsyncIoQueueDepth);
+		TC_CLONE (DirectIo);
+		TC_CLONE (WriteBufferSize);
+		TC_CLONE (Discard);
+		TC_CLONE (Nbd);
+		TC_CLONE (PinEncryptionThreads);
 	}
 
 	void MountOptions::Deserialize (shared_ptr <Stream> stream)
@@ -127,6 +135,14 @@ namespace VeraCrypt
 
 		sr.Deserialize ("Pim", Pim);
 		sr.Deserialize ("ProtectionPim", ProtectionPim);
+		sr.Deserialize ("ReadAheadSize", ReadAheadSize);
+		sr.Deserialize ("SectorCacheSize", SectorCacheSize);
+		sr.Deserialize ("AsyncIoQueueDepth", AsyncIoQueueDepth);
+		sr.Deserialize ("DirectIo", DirectIo);
+		sr.Deserialize ("WriteBufferSize", WriteBufferSize);
+		sr.Deserialize ("Discard", Discard);
+		sr.Deserialize ("Nbd", Nbd);
+		sr.Deserialize ("PinEncryptionThreads", PinEncryptionThreads);
 	}
 
 	void MountOptions::Serialize (shared_ptr <Stream> stream) const
@@ -181,6 +197,14 @@ namespace VeraCrypt
 
 		sr.Serialize ("Pim", Pim);
 		sr.Serialize ("ProtectionPim", ProtectionPim);
+		sr.Serialize ("ReadAheadSize", ReadAheadSize);
+		sr.Serialize ("SectorCacheSize", SectorCacheSize);
+		sr.Serialize ("AsyncIoQueueDepth", AsyncIoQueueDepth);
+		sr.Serialize ("DirectIo", DirectIo);
+		sr.Serialize ("WriteBufferSize", WriteBufferSize);
+		sr.Serialize ("Discard", Discard);
+		sr.Serialize ("Nbd", Nbd);
+		sr.Serialize ("PinEncryptionThreads", PinEncryptionThreads);
 	}
 
 	TC_SERIALIZER_FACTORY_ADD_CLASS (MountOptions);
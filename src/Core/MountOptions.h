@@ -26,6 +26,7 @@ namespace VeraCrypt
 		MountOptions ()
 			:
 			CachePassword (false),
+			DirectIo (false),
 			NoFilesystem (false),
 			NoHardwareCrypto (false),
 			NoKernelCrypto (false),
@@ -39,7 +40,14 @@ namespace VeraCrypt
 			SharedAccessAllowed (false),
 			SlotNumber (0),
 			UseBackupHeaders (false),
-			SecurityTokenSchemeSpec(wstring())
+			SecurityTokenSchemeSpec(wstring()),
+			ReadAheadSize (0),
+			SectorCacheSize (0),
+			AsyncIoQueueDepth (0),
+			WriteBufferSize (0),
+			Discard (false),
+			Nbd (false),
+			PinEncryptionThreads (false)
 		{
 		}
 
@@ -51,6 +59,7 @@ namespace VeraCrypt
 		TC_SERIALIZABLE (MountOptions);
 
 		bool CachePassword;
+		bool DirectIo;
 		wstring FilesystemOptions;
 		wstring FilesystemType;
 		shared_ptr <KeyfileList> Keyfiles;
@@ -76,6 +85,13 @@ namespace VeraCrypt
 		bool UseBackupHeaders;
 		wstring SecurityTokenSchemeSpec;
 		bool EMVSupportEnabled;
+		uint64 ReadAheadSize;
+		uint64 SectorCacheSize;
+		uint32 AsyncIoQueueDepth;
+		uint64 WriteBufferSize;
+		bool Discard;
+		bool Nbd;
+		bool PinEncryptionThreads;
 
 	protected:
 		void CopyFrom (const MountOptions &other);
@@ -705,7 +705,7 @@ namespace VeraCrypt
 
 		try
 		{
-			FuseService::Mount (volume, options.SlotNumber, fuseMountPoint);
+			FuseService::Mount (volume, options, fuseMountPoint);
 		}
 		catch (...)
 		{
@@ -802,7 +802,20 @@ namespace VeraCrypt
 
 	void CoreUnix::MountAuxVolumeImage (const DirectoryPath &auxMountPoint, const MountOptions &options) const
 	{
-		DevicePath loopDev = AttachFileToLoopDevice (string (auxMountPoint) + FuseService::GetVolumeImagePath(), options.Protection == VolumeProtection::ReadOnly);
+		DevicePath loopDev;
+
+		if (options.Nbd)
+		{
+			// A loop device is used if NBD is not available or the NBD device cannot be connected
+			try
+			{
+				loopDev = AttachNbdDevice (FuseService::GetNbdSocketPath (auxMountPoint), options.Protection == VolumeProtection::ReadOnly);
+			}
+			catch (Exception&) { }
+		}
+
+		if (loopDev.IsEmpty())
+			loopDev = AttachFileToLoopDevice (string (auxMountPoint) + FuseService::GetVolumeImagePath(), options.Protection == VolumeProtection::ReadOnly);
 
 		try
 		{
@@ -104,8 +104,63 @@ namespace VeraCrypt
 		throw LoopDeviceSetupFailed (SRC_POS, wstring (filePath));
 	}
 
+	DevicePath CoreLinux::AttachNbdDevice (const string &socketPath, bool readOnly) const
+	{
+		// Load NBD kernel module
+		list <string> modprobeArgs;
+		modprobeArgs.push_back ("nbd");
+
+		try
+		{
+			Process::Execute ("modprobe", modprobeArgs);
+		}
+		catch (...) { }
+
+		// NBD is not available without the kernel module
+		if (!FilesystemPath ("/dev/nbd0").IsBlockDevice())
+			throw NotApplicable (SRC_POS);
+
+		for (int devIndex = 0; devIndex < 256; devIndex++)
+		{
+			string nbdDev = "/dev/nbd" + StringConverter::ToSingle (devIndex);
+			if (!FilesystemPath (nbdDev).IsBlockDevice())
+				break;
+
+			// Devices which are in use are connected to a client process
+			if (FilesystemPath ("/sys/block/nbd" + StringConverter::ToSingle (devIndex) + "/pid").IsFile())
+				continue;
+
+			list <string> args;
+			args.push_back ("-unix");
+			args.push_back (socketPath);
+			args.push_back (nbdDev);
+
+			// Requests are distributed over several connections, which are served in parallel
+			args.push_back ("-connections");
+			args.push_back ("4");
+
+			if (readOnly)
+				args.push_back ("-readonly");
+
+			try
+			{
+				Process::Execute ("nbd-client", args);
+				return nbdDev;
+			}
+			catch (ExecutedProcessFailed&) { }
+		}
+
+		throw LoopDeviceSetupFailed (SRC_POS, StringConverter::ToWide (socketPath));
+	}
+
 	void CoreLinux::DetachLoopDevice (const DevicePath &devicePath) const
 	{
+		if (string (devicePath).find ("/dev/nbd") == 0)
+		{
+			DetachNbdDevice (devicePath);
+			return;
+		}
+
 		list <string> args;
 		args.push_back ("-d");
 		args.push_back (devicePath);
@@ -126,6 +181,28 @@ namespace VeraCrypt
 		}
 	}
 
+	void CoreLinux::DetachNbdDevice (const DevicePath &devicePath) const
+	{
+		list <string> args;
+		args.push_back ("-d");
+		args.push_back (devicePath);
+
+		for (int t = 0; true; t++)
+		{
+			try
+			{
+				Process::Execute ("nbd-client", args);
+				break;
+			}
+			catch (ExecutedProcessFailed&)
+			{
+				if (t > 5)
+					throw;
+				Thread::Sleep (200);
+			}
+		}
+	}
+
 	void CoreLinux::DismountNativeVolume (shared_ptr <VolumeInfo> mountedVolume) const
 	{
 		string devPath = mountedVolume->VirtualDevice;
@@ -318,6 +395,7 @@ namespace VeraCrypt
 			|| (typeid (*volume->GetEncryptionAlgorithm()) == typeid (KuznyechikSerpentCamellia));
 
 		if (options.NoKernelCrypto
+			|| options.Nbd
 			|| !xts
 			|| algoNotSupported
 			|| volume->IsEncryptionNotCompleted ()
@@ -0,0 +1,40 @@
+/*
+ * Copyright (c) 2013-2025 IDRIX
+ * Governed by the Apache License 2.0 the full text of which is contained
+ * in the file License.txt included in VeraCrypt binary and source
+ * code distribution packages.
+ */
+
+/* Wide AES-256-XTS kernels built on VAES and VPCLMULQDQ: every AES instruction processes
+ * 2 (AVX2) or 4 (AVX-512) blocks and the XTS tweak sequence is computed in vector registers.
+ */
+
+#ifndef TC_HEADER_Crypto_Aes_Hw_Vaes
+#define TC_HEADER_Crypto_Aes_Hw_Vaes
+
+#include "Common/Tcdefs.h"
+
+#if defined(__cplusplus)
+extern "C"
+{
+#endif
+
+/* ks:          round keys of the primary key (encryption schedule for encrypt, decryption schedule for decrypt)
+ * tweakKs:     encryption round keys of the secondary key
+ * data:        blockCount 16-byte blocks, processed in place
+ * dataUnitNo:  number of the data unit containing the first block
+ * startBlock:  index of the first block within its data unit
+ */
+void aes_vaes_xts_encrypt_avx2 (const uint8 *ks, const uint8 *tweakKs, uint8 *data, uint64 blockCount, uint64 dataUnitNo, unsigned int startBlock);
+void aes_vaes_xts_decrypt_avx2 (const uint8 *ks, const uint8 *tweakKs, uint8 *data, uint64 blockCount, uint64 dataUnitNo, unsigned int startBlock);
+int aes_vaes_has_avx2 ();
+
+void aes_vaes_xts_encrypt_avx512 (const uint8 *ks, const uint8 *tweakKs, uint8 *data, uint64 blockCount, uint64 dataUnitNo, unsigned int startBlock);
+void aes_vaes_xts_decrypt_avx512 (const uint8 *ks, const uint8 *tweakKs, uint8 *data, uint64 blockCount, uint64 dataUnitNo, unsigned int startBlock);
+int aes_vaes_has_avx512 ();
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif // TC_HEADER_Crypto_Aes_Hw_Vaes
@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2013-2025 IDRIX
+ * Governed by the Apache License 2.0 the full text of which is contained
+ * in the file License.txt included in VeraCrypt binary and source
+ * code distribution packages.
+ */
+
+/* AVX2 flavour of the VAES XTS kernels: two blocks per 256-bit register. */
+
+#include "Aes_hw_vaes.h"
+#include "Crypto/config.h"
+#include "Crypto/cpu.h"
+
+#if CRYPTOPP_BOOL_VAES_INTRINSICS_AVAILABLE
+
+#include <immintrin.h>
+
+#define VX_SUFFIX avx2
+#define VX_BLOCKS 2
+#define VX_VEC __m256i
+
+#define VX_LOADU(p)				_mm256_loadu_si256 ((const __m256i *) (p))
+#define VX_STOREU(p,v)			_mm256_storeu_si256 ((__m256i *) (p), v)
+#define VX_XOR(a,b)				_mm256_xor_si256 (a, b)
+#define VX_BROADCAST(x)			_mm256_broadcastsi128_si256 (x)
+#define VX_AESENC(v,k)			_mm256_aesenc_epi128 (v, k)
+#define VX_AESENCLAST(v,k)		_mm256_aesenclast_epi128 (v, k)
+#define VX_AESDEC(v,k)			_mm256_aesdec_epi128 (v, k)
+#define VX_AESDECLAST(v,k)		_mm256_aesdeclast_epi128 (v, k)
+#define VX_SLLI64(v,n)			_mm256_slli_epi64 (v, n)
+#define VX_SRLI64(v,n)			_mm256_srli_epi64 (v, n)
+#define VX_LO_TO_HI(v)			_mm256_slli_si256 (v, 8)
+#define VX_CLMUL_HI_LO(a,b)		_mm256_clmulepi64_epi128 (a, b, 0x01)
+
+#include "Aes_hw_vaes_kernel.h"
+
+int aes_vaes_has_avx2 ()
+{
+	return 1;
+}
+
+#else
+
+void aes_vaes_xts_encrypt_avx2 (const uint8 *ks, const uint8 *tweakKs, uint8 *data, uint64 blockCount, uint64 dataUnitNo, unsigned int startBlock)
+{
+}
+
+void aes_vaes_xts_decrypt_avx2 (const uint8 *ks, const uint8 *tweakKs, uint8 *data, uint64 blockCount, uint64 dataUnitNo, unsigned int startBlock)
+{
+}
+
+int aes_vaes_has_avx2 ()
+{
+	return 0;
+}
+
+#endif
@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2013-2025 IDRIX
+ * Governed by the Apache License 2.0 the full text of which is contained
+ * in the file License.txt included in VeraCrypt binary and source
+ * code distribution packages.
+ */
+
+/* AVX-512 flavour of the VAES XTS kernels: four blocks per 512-bit register. */
+
+#include "Aes_hw_vaes.h"
+#include "Crypto/config.h"
+#include "Crypto/cpu.h"
+
+#if CRYPTOPP_BOOL_VAES512_INTRINSICS_AVAILABLE
+
+#include <immintrin.h>
+
+#define VX_SUFFIX avx512
+#define VX_BLOCKS 4
+#define VX_VEC __m512i
+
+#define VX_LOADU(p)				_mm512_loadu_si512 ((const void *) (p))
+#define VX_STOREU(p,v)			_mm512_storeu_si512 ((void *) (p), v)
+#define VX_XOR(a,b)				_mm512_xor_si512 (a, b)
+#define VX_BROADCAST(x)			_mm512_broadcast_i32x4 (x)
+#define VX_AESENC(v,k)			_mm512_aesenc_epi128 (v, k)
+#define VX_AESENCLAST(v,k)		_mm512_aesenclast_epi128 (v, k)
+#define VX_AESDEC(v,k)			_mm512_aesdec_epi128 (v, k)
+#define VX_AESDECLAST(v,k)		_mm512_aesdeclast_epi128 (v, k)
+#define VX_SLLI64(v,n)			_mm512_slli_epi64 (v, n)
+#define VX_SRLI64(v,n)			_mm512_srli_epi64 (v, n)
+#define VX_LO_TO_HI(v)			_mm512_maskz_shuffle_epi32 (0xCCCC, v, _MM_PERM_BADC)
+#define VX_CLMUL_HI_LO(a,b)		_mm512_clmulepi64_epi128 (a, b, 0x01)
+
+#include "Aes_hw_vaes_kernel.h"
+
+int aes_vaes_has_avx512 ()
+{
+	return 1;
+}
+
+#else
+
+void aes_vaes_xts_encrypt_avx512 (const uint8 *ks, const uint8 *tweakKs, uint8 *data, uint64 blockCount, uint64 dataUnitNo, unsigned int startBlock)
+{
+}
+
+void aes_vaes_xts_decrypt_avx512 (const uint8 *ks, const uint8 *tweakKs, uint8 *data, uint64 blockCount, uint64 dataUnitNo, unsigned int startBlock)
+{
+}
+
+int aes_vaes_has_avx512 ()
+{
+	return 0;
+}
+
+#endif
@@ -0,0 +1,173 @@
+/*
+ * Copyright (c) 2013-2025 IDRIX
+ * Governed by the Apache License 2.0 the full text of which is contained
+ * in the file License.txt included in VeraCrypt binary and source
+ * code distribution packages.
+ */
+
+/* Shared body of the VAES AES-256-XTS kernels (see Aes_hw_vaes.h).
+ * The including file defines VX_SUFFIX, VX_BLOCKS (blocks per vector), VX_VEC and the primitives:
+ *   VX_LOADU(p), VX_STOREU(p,v)          unaligned vector load/store
+ *   VX_XOR(a,b)                          a ^ b
+ *   VX_BROADCAST(x)                      128-bit value copied to every lane
+ *   VX_AESENC/VX_AESENCLAST(v,k)         AES round on every lane (VX_AESDEC/VX_AESDECLAST likewise)
+ *   VX_SLLI64(v,n), VX_SRLI64(v,n)       shift every 64-bit element
+ *   VX_LO_TO_HI(v)                       low 64 bits of every lane moved to the high half, low half zeroed
+ *   VX_CLMUL_HI_LO(a,b)                  carry-less product of the high half of a and the low half of b, per lane
+ */
+
+#ifndef AES_HW_VAES_KERNEL_H
+#define AES_HW_VAES_KERNEL_H
+
+#define VX_FN_(name, suffix) name##_##suffix
+#define VX_FN__(name, suffix) VX_FN_(name, suffix)
+#define VX_FN(name) VX_FN__(name, VX_SUFFIX)
+
+#define VX_ROUNDS 14
+
+/* BLOCKS_PER_XTS_DATA_UNIT (Common/Crypto.h is not usable from here) */
+#define VX_BLOCKS_PER_DATA_UNIT (512 / 16)
+
+/* Four vectors in flight hide the latency of the AES units */
+#define VX_INTERLEAVE 4
+
+/* Multiplies the tweak by x (a left shift by one bit reduced modulo x^128 + x^7 + x^2 + x + 1) */
+VC_INLINE __m128i VX_FN(xts_mul_x) (__m128i t)
+{
+	const __m128i poly = _mm_set_epi32 (0, 1, 0, 0x87);
+	__m128i carry = _mm_and_si128 (_mm_shuffle_epi32 (_mm_srai_epi32 (t, 31), 0x13), poly);
+	return _mm_xor_si128 (_mm_add_epi64 (t, t), carry);
+}
+
+/* Multiplies the tweak of every lane by x^n (n < 57), folding the bits shifted out of the
+ * lane back in with a carry-less multiplication by the reduction polynomial */
+VC_INLINE VX_VEC VX_FN(xts_mul_xn) (VX_VEC t, VX_VEC poly, int n)
+{
+	VX_VEC carry = VX_SRLI64 (t, 64 - n);
+	return VX_XOR (VX_XOR (VX_SLLI64 (t, n), VX_LO_TO_HI (carry)), VX_CLMUL_HI_LO (carry, poly));
+}
+
+/* One AES-256 block with AES-NI, for the secondary key and the tail of a partial data unit */
+VC_INLINE __m128i VX_FN(aes_xmm) (__m128i b, const uint8 *ks, int decrypt)
+{
+	int r;
+	b = _mm_xor_si128 (b, _mm_loadu_si128 ((const __m128i *) ks));
+	for (r = 1; r < VX_ROUNDS; r++)
+	{
+		__m128i k = _mm_loadu_si128 ((const __m128i *) (ks + 16 * r));
+		b = decrypt ? _mm_aesdec_si128 (b, k) : _mm_aesenc_si128 (b, k);
+	}
+	return decrypt ? _mm_aesdeclast_si128 (b, _mm_loadu_si128 ((const __m128i *) (ks + 16 * VX_ROUNDS)))
+		: _mm_aesenclast_si128 (b, _mm_loadu_si128 ((const __m128i *) (ks + 16 * VX_ROUNDS)));
+}
+
+#define VX_ROUND(v,k)		(decrypt ? VX_AESDEC (v, k) : VX_AESENC (v, k))
+#define VX_ROUND_LAST(v,k)	(decrypt ? VX_AESDECLAST (v, k) : VX_AESENCLAST (v, k))
+
+/* decrypt is a compile-time constant in both callers, so each of them gets its own branch-free copy */
+VC_INLINE void VX_FN(aes_vaes_xts) (const uint8 *ks, const uint8 *tweakKs, uint8 *data, uint64 blockCount, uint64 dataUnitNo, unsigned int startBlock, int decrypt)
+{
+	VX_VEC rk[VX_ROUNDS + 1];
+	CRYPTOPP_ALIGN_DATA(16) __m128i tweaks[VX_BLOCKS];
+	const VX_VEC poly = VX_BROADCAST (_mm_set_epi32 (0, 0, 0, 0x87));
+	int i, r;
+
+	for (i = 0; i <= VX_ROUNDS; i++)
+		rk[i] = VX_BROADCAST (_mm_loadu_si128 ((const __m128i *) (ks + 16 * i)));
+
+	while (blockCount > 0)
+	{
+		uint64 count = VX_BLOCKS_PER_DATA_UNIT - startBlock;
+		VX_VEC t0;
+		__m128i t;
+
+		if (count > blockCount)
+			count = blockCount;
+		blockCount -= count;
+
+		/* The first whitening value of a data unit is its number encrypted with the secondary key */
+		t = VX_FN(aes_xmm) (_mm_set_epi64x (0, (long long) dataUnitNo), tweakKs, 0);
+		for (i = 0; i < (int) startBlock; i++)
+			t = VX_FN(xts_mul_x) (t);
+
+		for (i = 0; i < VX_BLOCKS; i++)
+		{
+			tweaks[i] = t;
+			t = VX_FN(xts_mul_x) (t);
+		}
+		t0 = VX_LOADU (tweaks);
+
+		while (count >= VX_INTERLEAVE * VX_BLOCKS)
+		{
+			VX_VEC t1 = VX_FN(xts_mul_xn) (t0, poly, VX_BLOCKS);
+			VX_VEC t2 = VX_FN(xts_mul_xn) (t1, poly, VX_BLOCKS);
+			VX_VEC t3 = VX_FN(xts_mul_xn) (t2, poly, VX_BLOCKS);
+			VX_VEC b0 = VX_XOR (VX_XOR (VX_LOADU (data), t0), rk[0]);
+			VX_VEC b1 = VX_XOR (VX_XOR (VX_LOADU (data + 16 * VX_BLOCKS), t1), rk[0]);
+			VX_VEC b2 = VX_XOR (VX_XOR (VX_LOADU (data + 32 * VX_BLOCKS), t2), rk[0]);
+			VX_VEC b3 = VX_XOR (VX_XOR (VX_LOADU (data + 48 * VX_BLOCKS), t3), rk[0]);
+
+			for (r = 1; r < VX_ROUNDS; r++)
+			{
+				b0 = VX_ROUND (b0, rk[r]);
+				b1 = VX_ROUND (b1, rk[r]);
+				b2 = VX_ROUND (b2, rk[r]);
+				b3 = VX_ROUND (b3, rk[r]);
+			}
+
+			VX_STOREU (data, VX_XOR (VX_ROUND_LAST (b0, rk[VX_ROUNDS]), t0));
+			VX_STOREU (data + 16 * VX_BLOCKS, VX_XOR (VX_ROUND_LAST (b1, rk[VX_ROUNDS]), t1));
+			VX_STOREU (data + 32 * VX_BLOCKS, VX_XOR (VX_ROUND_LAST (b2, rk[VX_ROUNDS]), t2));
+			VX_STOREU (data + 48 * VX_BLOCKS, VX_XOR (VX_ROUND_LAST (b3, rk[VX_ROUNDS]), t3));
+
+			t0 = VX_FN(xts_mul_xn) (t3, poly, VX_BLOCKS);
+			data += 16 * VX_INTERLEAVE * VX_BLOCKS;
+			count -= VX_INTERLEAVE * VX_BLOCKS;
+		}
+
+		while (count >= VX_BLOCKS)
+		{
+			VX_VEC b0 = VX_XOR (VX_XOR (VX_LOADU (data), t0), rk[0]);
+
+			for (r = 1; r < VX_ROUNDS; r++)
+				b0 = VX_ROUND (b0, rk[r]);
+
+			VX_STOREU (data, VX_XOR (VX_ROUND_LAST (b0, rk[VX_ROUNDS]), t0));
+
+			t0 = VX_FN(xts_mul_xn) (t0, poly, VX_BLOCKS);
+			data += 16 * VX_BLOCKS;
+			count -= VX_BLOCKS;
+		}
+
+		/* Remaining blocks of a partial data unit */
+		VX_STOREU (tweaks, t0);
+		for (i = 0; i < (int) count; i++)
+		{
+			__m128i b = _mm_xor_si128 (_mm_loadu_si128 ((const __m128i *) data), tweaks[i]);
+			b = VX_FN(aes_xmm) (b, ks, decrypt);
+			_mm_storeu_si128 ((__m128i *) data, _mm_xor_si128 (b, tweaks[i]));
+			data += 16;
+		}
+
+		dataUnitNo++;
+		startBlock = 0;
+	}
+
+	burn (rk, sizeof (rk));
+	burn (tweaks, sizeof (tweaks));
+}
+
+#undef VX_ROUND
+#undef VX_ROUND_LAST
+
+void VX_FN(aes_vaes_xts_encrypt) (const uint8 *ks, const uint8 *tweakKs, uint8 *data, uint64 blockCount, uint64 dataUnitNo, unsigned int startBlock)
+{
+	VX_FN(aes_vaes_xts) (ks, tweakKs, data, blockCount, dataUnitNo, startBlock, 0);
+}
+
+void VX_FN(aes_vaes_xts_decrypt) (const uint8 *ks, const uint8 *tweakKs, uint8 *data, uint64 blockCount, uint64 dataUnitNo, unsigned int startBlock)
+{
+	VX_FN(aes_vaes_xts) (ks, tweakKs, data, blockCount, dataUnitNo, startBlock, 1);
+}
+
+#endif
@@ -17,6 +17,16 @@ void camellia_set_key(const unsigned __int8 userKey[], unsigned __int8 *ks);
 void camellia_encrypt(const unsigned __int8 *inBlock, unsigned __int8 *outBlock, unsigned __int8 *ks);
 void camellia_decrypt(const unsigned __int8 *inBlock,  unsigned __int8 *outBlock, unsigned __int8 *ks);
 
+/* 32-way byte-sliced kernels (Camellia_AVX2.c, Camellia_VAES.c): process all complete groups of
+ * 32 blocks and leave the remaining blocks untouched. ks is the schedule of the x64 assembly. */
+void camellia_encrypt_blocks_avx2(const unsigned __int8 *ks, const uint8* in_blk, uint8* out_blk, size_t blockCount);
+void camellia_decrypt_blocks_avx2(const unsigned __int8 *ks, const uint8* in_blk, uint8* out_blk, size_t blockCount);
+int camellia_has_avx2();
+
+void camellia_encrypt_blocks_vaes(const unsigned __int8 *ks, const uint8* in_blk, uint8* out_blk, size_t blockCount);
+void camellia_decrypt_blocks_vaes(const unsigned __int8 *ks, const uint8* in_blk, uint8* out_blk, size_t blockCount);
+int camellia_has_vaes();
+
 #if CRYPTOPP_BOOL_X64 && !defined(CRYPTOPP_DISABLE_ASM)
 void camellia_encrypt_blocks(unsigned __int8 *ks, const uint8* in_blk, uint8* out_blk, uint32 blockCount);
 void camellia_decrypt_blocks(unsigned __int8 *ks, const uint8* in_blk, uint8* out_blk, uint32 blockCount);
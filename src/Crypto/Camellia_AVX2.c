@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2013-2025 IDRIX
+ * Governed by the Apache License 2.0 the full text of which is contained
+ * in the file License.txt included in VeraCrypt binary and source
+ * code distribution packages.
+ */
+
+/* AVX2 flavour of the 32-way Camellia kernels: the S-boxes use AES-NI on each 128-bit half. */
+
+#include "Camellia.h"
+#include "Crypto/config.h"
+#include "Crypto/cpu.h"
+#include "Crypto/misc.h"
+
+#if CRYPTOPP_BOOL_AVX2_INTRINSICS_AVAILABLE && CRYPTOPP_BOOL_AESNI_INTRINSICS_AVAILABLE
+
+#include <immintrin.h>
+
+#define CM_SUFFIX avx2
+
+VC_INLINE __m256i camellia_aesenclast_avx2 (__m256i v)
+{
+	const __m128i zero = _mm_setzero_si128 ();
+	__m128i lo = _mm_aesenclast_si128 (_mm256_castsi256_si128 (v), zero);
+	__m128i hi = _mm_aesenclast_si128 (_mm256_extracti128_si256 (v, 1), zero);
+	return _mm256_inserti128_si256 (_mm256_castsi128_si256 (lo), hi, 1);
+}
+
+#define CM_AESENCLAST(v)	camellia_aesenclast_avx2 (v)
+
+#include "Camellia_avx2_kernel.h"
+
+int camellia_has_avx2 ()
+{
+	return 1;
+}
+
+#else
+
+void camellia_encrypt_blocks_avx2 (const unsigned __int8 *ks, const uint8 *in_blk, uint8 *out_blk, size_t blockCount)
+{
+}
+
+void camellia_decrypt_blocks_avx2 (const unsigned __int8 *ks, const uint8 *in_blk, uint8 *out_blk, size_t blockCount)
+{
+}
+
+int camellia_has_avx2 ()
+{
+	return 0;
+}
+
+#endif
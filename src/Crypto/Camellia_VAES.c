@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2013-2025 IDRIX
+ * Governed by the Apache License 2.0 the full text of which is contained
+ * in the file License.txt included in VeraCrypt binary and source
+ * code distribution packages.
+ */
+
+/* VAES flavour of the 32-way Camellia kernels: one AESENCLAST covers both 128-bit lanes. */
+
+#include "Camellia.h"
+#include "Crypto/config.h"
+#include "Crypto/cpu.h"
+#include "Crypto/misc.h"
+
+#if CRYPTOPP_BOOL_VAES_INTRINSICS_AVAILABLE
+
+#include <immintrin.h>
+
+#define CM_SUFFIX vaes
+
+#define CM_AESENCLAST(v)	_mm256_aesenclast_epi128 (v, _mm256_setzero_si256 ())
+
+#include "Camellia_avx2_kernel.h"
+
+int camellia_has_vaes ()
+{
+	return 1;
+}
+
+#else
+
+void camellia_encrypt_blocks_vaes (const unsigned __int8 *ks, const uint8 *in_blk, uint8 *out_blk, size_t blockCount)
+{
+}
+
+void camellia_decrypt_blocks_vaes (const unsigned __int8 *ks, const uint8 *in_blk, uint8 *out_blk, size_t blockCount)
+{
+}
+
+int camellia_has_vaes ()
+{
+	return 0;
+}
+
+#endif
@@ -0,0 +1,306 @@
+/*
+ * Copyright (c) 2013-2025 IDRIX
+ * Governed by the Apache License 2.0 the full text of which is contained
+ * in the file License.txt included in VeraCrypt binary and source
+ * code distribution packages.
+ */
+
+/* Shared body of the 32-way byte-sliced Camellia kernels (see Camellia.h), built on the method of
+ * Camellia_aesni_x64.S: register j holds byte j of 32 blocks (16 in each 128-bit lane) and the
+ * S-boxes are computed with AESENCLAST surrounded by affine nibble-table filters.
+ * The including file defines CM_SUFFIX and CM_AESENCLAST(v), AESENCLAST with a zero round key
+ * applied to both 128-bit lanes of v.
+ *
+ * The key schedule is the one produced by camellia_set_key for the x64 assembly: 34 subkeys of
+ * two 32-bit words (L, R) with the whitening keys absorbed into the neighbouring subkeys.
+ */
+
+#ifndef CAMELLIA_AVX2_KERNEL_H
+#define CAMELLIA_AVX2_KERNEL_H
+
+#define CM_FN_(name, suffix) name##_##suffix
+#define CM_FN__(name, suffix) CM_FN_(name, suffix)
+#define CM_FN(name) CM_FN__(name, CM_SUFFIX)
+
+#define CM_BLOCKS 32
+
+#define CM_KL(ks,i) (((const uint32 *) (ks))[2 * (i)])
+#define CM_KR(ks,i) (((const uint32 *) (ks))[2 * (i) + 1])
+
+typedef struct
+{
+	__m256i mask0f;
+	__m256i inv_shift_row;
+	__m256i pre_lo_s1, pre_hi_s1;
+	__m256i pre_lo_s4, pre_hi_s4;
+	__m256i post_lo_s1, post_hi_s1;
+	__m256i post_lo_s2, post_hi_s2;
+	__m256i post_lo_s3, post_hi_s3;
+} CM_FN(camellia_consts);
+
+#define CM_TABLE(b0,b1,b2,b3,b4,b5,b6,b7,b8,b9,b10,b11,b12,b13,b14,b15) \
+	_mm256_broadcastsi128_si256 (_mm_setr_epi8 ((char) b0, (char) b1, (char) b2, (char) b3, (char) b4, (char) b5, (char) b6, (char) b7, \
+		(char) b8, (char) b9, (char) b10, (char) b11, (char) b12, (char) b13, (char) b14, (char) b15))
+
+/* Filter tables of Camellia_aesni_x64.S: pre_* map a Camellia S-box input to the AES field, post_* map
+ * the AES S-box output back (s2 and s3 are rotations of s1, s4 is s1 of the input rotated by one bit) */
+VC_INLINE void CM_FN(camellia_init_consts) (CM_FN(camellia_consts) *c)
+{
+	c->mask0f = _mm256_set1_epi8 (0x0f);
+	c->inv_shift_row = CM_TABLE (0x00, 0x0d, 0x0a, 0x07, 0x04, 0x01, 0x0e, 0x0b, 0x08, 0x05, 0x02, 0x0f, 0x0c, 0x09, 0x06, 0x03);
+	c->pre_lo_s1 = CM_TABLE (0x45, 0xe8, 0x40, 0xed, 0x2e, 0x83, 0x2b, 0x86, 0x4b, 0xe6, 0x4e, 0xe3, 0x20, 0x8d, 0x25, 0x88);
+	c->pre_hi_s1 = CM_TABLE (0x00, 0x51, 0xf1, 0xa0, 0x8a, 0xdb, 0x7b, 0x2a, 0x09, 0x58, 0xf8, 0xa9, 0x83, 0xd2, 0x72, 0x23);
+	c->pre_lo_s4 = CM_TABLE (0x45, 0x40, 0x2e, 0x2b, 0x4b, 0x4e, 0x20, 0x25, 0x14, 0x11, 0x7f, 0x7a, 0x1a, 0x1f, 0x71, 0x74);
+	c->pre_hi_s4 = CM_TABLE (0x00, 0xf1, 0x8a, 0x7b, 0x09, 0xf8, 0x83, 0x72, 0xad, 0x5c, 0x27, 0xd6, 0xa4, 0x55, 0x2e, 0xdf);
+	c->post_lo_s1 = CM_TABLE (0x3c, 0xcc, 0xcf, 0x3f, 0x32, 0xc2, 0xc1, 0x31, 0xdc, 0x2c, 0x2f, 0xdf, 0xd2, 0x22, 0x21, 0xd1);
+	c->post_hi_s1 = CM_TABLE (0x00, 0xf9, 0x86, 0x7f, 0xd7, 0x2e, 0x51, 0xa8, 0xa4, 0x5d, 0x22, 0xdb, 0x73, 0x8a, 0xf5, 0x0c);
+	c->post_lo_s2 = CM_TABLE (0x78, 0x99, 0x9f, 0x7e, 0x64, 0x85, 0x83, 0x62, 0xb9, 0x58, 0x5e, 0xbf, 0xa5, 0x44, 0x42, 0xa3);
+	c->post_hi_s2 = CM_TABLE (0x00, 0xf3, 0x0d, 0xfe, 0xaf, 0x5c, 0xa2, 0x51, 0x49, 0xba, 0x44, 0xb7, 0xe6, 0x15, 0xeb, 0x18);
+	c->post_lo_s3 = CM_TABLE (0x1e, 0x66, 0xe7, 0x9f, 0x19, 0x61, 0xe0, 0x98, 0x6e, 0x16, 0x97, 0xef, 0x69, 0x11, 0x90, 0xe8);
+	c->post_hi_s3 = CM_TABLE (0x00, 0xfc, 0x43, 0xbf, 0xeb, 0x17, 0xa8, 0x54, 0x52, 0xae, 0x11, 0xed, 0xb9, 0x45, 0xfa, 0x06);
+}
+
+/* lo[x & 0xf] ^ hi[x >> 4] for every byte */
+VC_INLINE __m256i CM_FN(camellia_filter) (__m256i x, __m256i lo, __m256i hi, __m256i mask0f)
+{
+	return _mm256_xor_si256 (_mm256_shuffle_epi8 (lo, _mm256_and_si256 (x, mask0f)),
+		_mm256_shuffle_epi8 (hi, _mm256_and_si256 (_mm256_srli_epi32 (x, 4), mask0f)));
+}
+
+/* The inverse ShiftRows cancels the one done by AESENCLAST, leaving SubBytes alone */
+VC_INLINE __m256i CM_FN(camellia_sbox) (__m256i x, __m256i preLo, __m256i preHi, __m256i postLo, __m256i postHi, const CM_FN(camellia_consts) *c)
+{
+	x = CM_FN(camellia_filter) (_mm256_shuffle_epi8 (x, c->inv_shift_row), preLo, preHi, c->mask0f);
+	return CM_FN(camellia_filter) (CM_AESENCLAST (x), postLo, postHi, c->mask0f);
+}
+
+#define CM_KEY_BYTE(k,i) _mm256_set1_epi8 ((char) ((k) >> (24 - 8 * (i))))
+
+/* y ^= F(x) with the round key (kl, kr) added at the end of F, as arranged by camellia_set_key */
+VC_INLINE void CM_FN(camellia_round) (const __m256i *x, __m256i *y, uint32 kl, uint32 kr, const CM_FN(camellia_consts) *c)
+{
+	__m256i t0 = CM_FN(camellia_sbox) (x[0], c->pre_lo_s1, c->pre_hi_s1, c->post_lo_s1, c->post_hi_s1, c);
+	__m256i t1 = CM_FN(camellia_sbox) (x[1], c->pre_lo_s1, c->pre_hi_s1, c->post_lo_s2, c->post_hi_s2, c);
+	__m256i t2 = CM_FN(camellia_sbox) (x[2], c->pre_lo_s1, c->pre_hi_s1, c->post_lo_s3, c->post_hi_s3, c);
+	__m256i t3 = CM_FN(camellia_sbox) (x[3], c->pre_lo_s4, c->pre_hi_s4, c->post_lo_s1, c->post_hi_s1, c);
+	__m256i t4 = CM_FN(camellia_sbox) (x[4], c->pre_lo_s1, c->pre_hi_s1, c->post_lo_s2, c->post_hi_s2, c);
+	__m256i t5 = CM_FN(camellia_sbox) (x[5], c->pre_lo_s1, c->pre_hi_s1, c->post_lo_s3, c->post_hi_s3, c);
+	__m256i t6 = CM_FN(camellia_sbox) (x[6], c->pre_lo_s4, c->pre_hi_s4, c->post_lo_s1, c->post_hi_s1, c);
+	__m256i t7 = CM_FN(camellia_sbox) (x[7], c->pre_lo_s1, c->pre_hi_s1, c->post_lo_s1, c->post_hi_s1, c);
+
+	/* P-function: afterwards t4..t7 hold output bytes 0..3 and t0..t3 bytes 4..7 */
+	t0 = _mm256_xor_si256 (t0, t5);
+	t1 = _mm256_xor_si256 (t1, t6);
+	t2 = _mm256_xor_si256 (t2, t7);
+	t3 = _mm256_xor_si256 (t3, t4);
+	t4 = _mm256_xor_si256 (t4, t2);
+	t5 = _mm256_xor_si256 (t5, t3);
+	t6 = _mm256_xor_si256 (t6, t0);
+	t7 = _mm256_xor_si256 (t7, t1);
+	t0 = _mm256_xor_si256 (t0, t7);
+	t1 = _mm256_xor_si256 (t1, t4);
+	t2 = _mm256_xor_si256 (t2, t5);
+	t3 = _mm256_xor_si256 (t3, t6);
+	t4 = _mm256_xor_si256 (t4, t3);
+	t5 = _mm256_xor_si256 (t5, t0);
+	t6 = _mm256_xor_si256 (t6, t1);
+	t7 = _mm256_xor_si256 (t7, t2);
+
+	y[0] = _mm256_xor_si256 (y[0], _mm256_xor_si256 (t4, CM_KEY_BYTE (kl, 0)));
+	y[1] = _mm256_xor_si256 (y[1], _mm256_xor_si256 (t5, CM_KEY_BYTE (kl, 1)));
+	y[2] = _mm256_xor_si256 (y[2], _mm256_xor_si256 (t6, CM_KEY_BYTE (kl, 2)));
+	y[3] = _mm256_xor_si256 (y[3], _mm256_xor_si256 (t7, CM_KEY_BYTE (kl, 3)));
+	y[4] = _mm256_xor_si256 (y[4], _mm256_xor_si256 (t0, CM_KEY_BYTE (kr, 0)));
+	y[5] = _mm256_xor_si256 (y[5], _mm256_xor_si256 (t1, CM_KEY_BYTE (kr, 1)));
+	y[6] = _mm256_xor_si256 (y[6], _mm256_xor_si256 (t2, CM_KEY_BYTE (kr, 2)));
+	y[7] = _mm256_xor_si256 (y[7], _mm256_xor_si256 (t3, CM_KEY_BYTE (kr, 3)));
+}
+
+/* x ^= rotl32 (a & k, 1) for the 32-bit words whose bytes (most significant first) are a[0..3] */
+VC_INLINE void CM_FN(camellia_xor_rol1_and) (__m256i *x, const __m256i *a, uint32 k)
+{
+	const __m256i one = _mm256_set1_epi8 (1);
+	__m256i t[4];
+	int i;
+
+	for (i = 0; i < 4; i++)
+		t[i] = _mm256_and_si256 (a[i], CM_KEY_BYTE (k, i));
+
+	for (i = 0; i < 4; i++)
+	{
+		__m256i carry = _mm256_and_si256 (_mm256_srli_epi16 (t[(i + 1) & 3], 7), one);
+		x[i] = _mm256_xor_si256 (x[i], _mm256_or_si256 (_mm256_add_epi8 (t[i], t[i]), carry));
+	}
+}
+
+/* x ^= a | k */
+VC_INLINE void CM_FN(camellia_xor_or) (__m256i *x, const __m256i *a, uint32 k)
+{
+	int i;
+	for (i = 0; i < 4; i++)
+		x[i] = _mm256_xor_si256 (x[i], _mm256_or_si256 (a[i], CM_KEY_BYTE (k, i)));
+}
+
+/* FL on the left half with subkey kl, FL^-1 on the right half with subkey kr */
+VC_INLINE void CM_FN(camellia_fls) (__m256i *x, const unsigned __int8 *ks, int kl, int kr)
+{
+	CM_FN(camellia_xor_rol1_and) (x + 4, x, CM_KL (ks, kl));
+	CM_FN(camellia_xor_or) (x, x + 4, CM_KR (ks, kl));
+	CM_FN(camellia_xor_or) (x + 8, x + 12, CM_KR (ks, kr));
+	CM_FN(camellia_xor_rol1_and) (x + 12, x + 8, CM_KL (ks, kr));
+}
+
+/* The unpack network transposes a 16x16 byte matrix held in the 128-bit lanes of r,
+ * except that row j of the result ends up in r[bit-reversed j] */
+VC_INLINE void CM_FN(camellia_transpose) (__m256i *r)
+{
+	__m256i u[16];
+	int i;
+
+	for (i = 0; i < 8; i++)
+	{
+		u[i] = _mm256_unpacklo_epi8 (r[2 * i], r[2 * i + 1]);
+		u[i + 8] = _mm256_unpackhi_epi8 (r[2 * i], r[2 * i + 1]);
+	}
+	for (i = 0; i < 8; i++)
+	{
+		r[i] = _mm256_unpacklo_epi16 (u[2 * i], u[2 * i + 1]);
+		r[i + 8] = _mm256_unpackhi_epi16 (u[2 * i], u[2 * i + 1]);
+	}
+	for (i = 0; i < 8; i++)
+	{
+		u[i] = _mm256_unpacklo_epi32 (r[2 * i], r[2 * i + 1]);
+		u[i + 8] = _mm256_unpackhi_epi32 (r[2 * i], r[2 * i + 1]);
+	}
+	for (i = 0; i < 8; i++)
+	{
+		r[i] = _mm256_unpacklo_epi64 (u[2 * i], u[2 * i + 1]);
+		r[i + 8] = _mm256_unpackhi_epi64 (u[2 * i], u[2 * i + 1]);
+	}
+}
+
+static const int CM_FN(camellia_bitrev4)[16] = { 0, 8, 4, 12, 2, 10, 6, 14, 1, 9, 5, 13, 3, 11, 7, 15 };
+
+/* Block i goes to the low lane of row i and block 16 + i to its high lane; x[j] receives byte j of every block */
+VC_INLINE void CM_FN(camellia_load) (__m256i *x, const uint8 *in)
+{
+	__m256i r[16];
+	int i;
+
+	for (i = 0; i < 16; i++)
+		r[i] = _mm256_inserti128_si256 (_mm256_castsi128_si256 (_mm_loadu_si128 ((const __m128i *) (in + 16 * i))),
+			_mm_loadu_si128 ((const __m128i *) (in + 16 * (16 + i))), 1);
+
+	CM_FN(camellia_transpose) (r);
+
+	for (i = 0; i < 16; i++)
+		x[i] = r[CM_FN(camellia_bitrev4)[i]];
+}
+
+/* Output block is (right half, left half) */
+VC_INLINE void CM_FN(camellia_store) (uint8 *out, const __m256i *x)
+{
+	__m256i r[16];
+	int i;
+
+	for (i = 0; i < 16; i++)
+		r[i] = x[(i + 8) & 15];
+
+	CM_FN(camellia_transpose) (r);
+
+	for (i = 0; i < 16; i++)
+	{
+		__m256i b = r[CM_FN(camellia_bitrev4)[i]];
+		_mm_storeu_si128 ((__m128i *) (out + 16 * i), _mm256_castsi256_si128 (b));
+		_mm_storeu_si128 ((__m128i *) (out + 16 * (16 + i)), _mm256_extracti128_si256 (b, 1));
+	}
+}
+
+VC_INLINE void CM_FN(camellia_xor_key) (__m256i *x, uint32 kl, uint32 kr)
+{
+	int i;
+	for (i = 0; i < 4; i++)
+	{
+		x[i] = _mm256_xor_si256 (x[i], CM_KEY_BYTE (kl, i));
+		x[i + 4] = _mm256_xor_si256 (x[i + 4], CM_KEY_BYTE (kr, i));
+	}
+}
+
+void CM_FN(camellia_encrypt_blocks) (const unsigned __int8 *ks, const uint8 *in_blk, uint8 *out_blk, size_t blockCount)
+{
+	CM_FN(camellia_consts) c;
+	__m256i x[16];
+	int r, i;
+
+	CM_FN(camellia_init_consts) (&c);
+
+	for (; blockCount >= CM_BLOCKS; blockCount -= CM_BLOCKS)
+	{
+		CM_FN(camellia_load) (x, in_blk);
+
+		CM_FN(camellia_xor_key) (x, CM_KL (ks, 0), CM_KR (ks, 0));
+
+		for (r = 0; r < 32; r += 8)
+		{
+			if (r > 0)
+				CM_FN(camellia_fls) (x, ks, r, r + 1);
+
+			for (i = 2; i < 8; i += 2)
+			{
+				CM_FN(camellia_round) (x, x + 8, CM_KL (ks, r + i), CM_KR (ks, r + i), &c);
+				CM_FN(camellia_round) (x + 8, x, CM_KL (ks, r + i + 1), CM_KR (ks, r + i + 1), &c);
+			}
+		}
+
+		CM_FN(camellia_xor_key) (x + 8, CM_KL (ks, 32), CM_KR (ks, 32));
+
+		CM_FN(camellia_store) (out_blk, x);
+
+		in_blk += 16 * CM_BLOCKS;
+		out_blk += 16 * CM_BLOCKS;
+	}
+
+	burn (x, sizeof (x));
+}
+
+void CM_FN(camellia_decrypt_blocks) (const unsigned __int8 *ks, const uint8 *in_blk, uint8 *out_blk, size_t blockCount)
+{
+	CM_FN(camellia_consts) c;
+	__m256i x[16];
+	int r, i;
+
+	CM_FN(camellia_init_consts) (&c);
+
+	for (; blockCount >= CM_BLOCKS; blockCount -= CM_BLOCKS)
+	{
+		CM_FN(camellia_load) (x, in_blk);
+
+		CM_FN(camellia_xor_key) (x, CM_KL (ks, 32), CM_KR (ks, 32));
+
+		for (r = 24; r >= 0; r -= 8)
+		{
+			for (i = 7; i > 2; i -= 2)
+			{
+				CM_FN(camellia_round) (x, x + 8, CM_KL (ks, r + i), CM_KR (ks, r + i), &c);
+				CM_FN(camellia_round) (x + 8, x, CM_KL (ks, r + i - 1), CM_KR (ks, r + i - 1), &c);
+			}
+
+			if (r > 0)
+				CM_FN(camellia_fls) (x, ks, r + 1, r);
+		}
+
+		CM_FN(camellia_xor_key) (x + 8, CM_KL (ks, 0), CM_KR (ks, 0));
+
+		CM_FN(camellia_store) (out_blk, x);
+
+		in_blk += 16 * CM_BLOCKS;
+		out_blk += 16 * CM_BLOCKS;
+	}
+
+	burn (x, sizeof (x));
+}
+
+#undef CM_KEY_BYTE
+#undef CM_TABLE
+
+#endif
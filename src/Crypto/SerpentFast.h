@@ -22,6 +22,17 @@ void serpent_decrypt_blocks(const unsigned __int8* in, unsigned __int8* out, siz
 #define serpent_encrypt(inBlock,outBlock,ks)	serpent_encrypt_blocks(inBlock,outBlock,1,ks)
 #define serpent_decrypt(inBlock,outBlock,ks)	serpent_decrypt_blocks(inBlock,outBlock,1,ks)
 
+/* Wide bitsliced kernels (SerpentFast_AVX2.cpp, SerpentFast_AVX512.cpp): process all complete groups of
+ * 8 (AVX2) or 16 (AVX-512) blocks and leave the remaining blocks untouched.
+ * round_key points to the round keys within the key schedule ((unsigned __int32 *) ks + 8). */
+void serpent_simd_encrypt_blocks_avx2 (const unsigned __int8 *in, unsigned __int8 *out, size_t blocks, const unsigned __int32 *round_key);
+void serpent_simd_decrypt_blocks_avx2 (const unsigned __int8 *in, unsigned __int8 *out, size_t blocks, const unsigned __int32 *round_key);
+int serpent_simd_has_avx2 ();
+
+void serpent_simd_encrypt_blocks_avx512 (const unsigned __int8 *in, unsigned __int8 *out, size_t blocks, const unsigned __int32 *round_key);
+void serpent_simd_decrypt_blocks_avx512 (const unsigned __int8 *in, unsigned __int8 *out, size_t blocks, const unsigned __int32 *round_key);
+int serpent_simd_has_avx512 ();
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2013-2025 IDRIX
+ * Governed by the Apache License 2.0 the full text of which is contained
+ * in the file License.txt included in VeraCrypt binary and source
+ * code distribution packages.
+ */
+
+/* AVX2 flavour of the bitsliced Serpent kernels: 8 blocks per call, four in each 128-bit lane. */
+
+#include "SerpentFast.h"
+#include "Crypto/config.h"
+#include "Crypto/cpu.h"
+#include "Crypto/misc.h"
+
+#if CRYPTOPP_BOOL_AVX2_INTRINSICS_AVAILABLE
+
+#include <immintrin.h>
+
+class SIMD_8x32
+{
+public:
+
+	SIMD_8x32 () { m_reg = _mm256_setzero_si256 (); }
+
+	explicit SIMD_8x32 (unsigned __int32 B) { m_reg = _mm256_set1_epi32 ((int) B); }
+
+	static SIMD_8x32 load_le (const void *in) { return SIMD_8x32 (_mm256_loadu_si256 ((const __m256i *) in)); }
+
+	void store_le (unsigned __int8 out[]) const { _mm256_storeu_si256 ((__m256i *) out, m_reg); }
+
+	void rotate_left (int rot) { m_reg = _mm256_or_si256 (_mm256_slli_epi32 (m_reg, rot), _mm256_srli_epi32 (m_reg, 32 - rot)); }
+
+	void rotate_right (int rot) { rotate_left (32 - rot); }
+
+	void operator^= (const SIMD_8x32 &other) { m_reg = _mm256_xor_si256 (m_reg, other.m_reg); }
+
+	SIMD_8x32 operator^ (const SIMD_8x32 &other) const { return SIMD_8x32 (_mm256_xor_si256 (m_reg, other.m_reg)); }
+
+	void operator|= (const SIMD_8x32 &other) { m_reg = _mm256_or_si256 (m_reg, other.m_reg); }
+
+	void operator&= (const SIMD_8x32 &other) { m_reg = _mm256_and_si256 (m_reg, other.m_reg); }
+
+	SIMD_8x32 operator<< (int shift) const { return SIMD_8x32 (_mm256_slli_epi32 (m_reg, shift)); }
+
+	SIMD_8x32 operator>> (int shift) const { return SIMD_8x32 (_mm256_srli_epi32 (m_reg, shift)); }
+
+	SIMD_8x32 operator~ () const { return SIMD_8x32 (_mm256_xor_si256 (m_reg, _mm256_set1_epi32 (-1))); }
+
+	static void transpose (SIMD_8x32 &B0, SIMD_8x32 &B1, SIMD_8x32 &B2, SIMD_8x32 &B3)
+	{
+		__m256i T0 = _mm256_unpacklo_epi32 (B0.m_reg, B1.m_reg);
+		__m256i T1 = _mm256_unpacklo_epi32 (B2.m_reg, B3.m_reg);
+		__m256i T2 = _mm256_unpackhi_epi32 (B0.m_reg, B1.m_reg);
+		__m256i T3 = _mm256_unpackhi_epi32 (B2.m_reg, B3.m_reg);
+		B0.m_reg = _mm256_unpacklo_epi64 (T0, T1);
+		B1.m_reg = _mm256_unpackhi_epi64 (T0, T1);
+		B2.m_reg = _mm256_unpacklo_epi64 (T2, T3);
+		B3.m_reg = _mm256_unpackhi_epi64 (T2, T3);
+	}
+
+private:
+
+	explicit SIMD_8x32 (__m256i in) { m_reg = in; }
+
+	__m256i m_reg;
+};
+
+#define SF_SUFFIX avx2
+#define SF_BLOCKS 8
+#define SF_SIMD SIMD_8x32
+
+#include "SerpentFast_simd_kernel.h"
+
+extern "C" int serpent_simd_has_avx2 ()
+{
+	return 1;
+}
+
+#else
+
+extern "C" void serpent_simd_encrypt_blocks_avx2 (const unsigned __int8 *in, unsigned __int8 *out, size_t blocks, const unsigned __int32 *round_key)
+{
+}
+
+extern "C" void serpent_simd_decrypt_blocks_avx2 (const unsigned __int8 *in, unsigned __int8 *out, size_t blocks, const unsigned __int32 *round_key)
+{
+}
+
+extern "C" int serpent_simd_has_avx2 ()
+{
+	return 0;
+}
+
+#endif
@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2013-2025 IDRIX
+ * Governed by the Apache License 2.0 the full text of which is contained
+ * in the file License.txt included in VeraCrypt binary and source
+ * code distribution packages.
+ */
+
+/* AVX-512 flavour of the bitsliced Serpent kernels: 16 blocks per call, four in each 128-bit lane,
+ * with native rotates. */
+
+#include "SerpentFast.h"
+#include "Crypto/config.h"
+#include "Crypto/cpu.h"
+#include "Crypto/misc.h"
+
+#if CRYPTOPP_BOOL_AVX512_INTRINSICS_AVAILABLE
+
+#include <immintrin.h>
+
+/* Element-wise operations below use the zero-masking intrinsics with all elements selected: GCC 12 implements
+ * the plain forms with an uninitialized merge source, which -Wmaybe-uninitialized reports at every use. With a
+ * full mask the compiler emits the same unmasked instructions. */
+#define SIMD_16x32_ALL ((__mmask16) 0xFFFF)
+#define SIMD_16x32_ALL64 ((__mmask8) 0xFF)
+
+class SIMD_16x32
+{
+public:
+
+	SIMD_16x32 () { m_reg = _mm512_setzero_si512 (); }
+
+	explicit SIMD_16x32 (unsigned __int32 B) { m_reg = _mm512_set1_epi32 ((int) B); }
+
+	static SIMD_16x32 load_le (const void *in) { return SIMD_16x32 (_mm512_loadu_si512 ((const __m512i *) in)); }
+
+	void store_le (unsigned __int8 out[]) const { _mm512_storeu_si512 ((__m512i *) out, m_reg); }
+
+	void rotate_left (int rot) { m_reg = _mm512_maskz_rolv_epi32 (SIMD_16x32_ALL, m_reg, _mm512_set1_epi32 (rot)); }
+
+	void rotate_right (int rot) { rotate_left (32 - rot); }
+
+	void operator^= (const SIMD_16x32 &other) { m_reg = _mm512_xor_si512 (m_reg, other.m_reg); }
+
+	SIMD_16x32 operator^ (const SIMD_16x32 &other) const { return SIMD_16x32 (_mm512_xor_si512 (m_reg, other.m_reg)); }
+
+	void operator|= (const SIMD_16x32 &other) { m_reg = _mm512_or_si512 (m_reg, other.m_reg); }
+
+	void operator&= (const SIMD_16x32 &other) { m_reg = _mm512_and_si512 (m_reg, other.m_reg); }
+
+	SIMD_16x32 operator<< (int shift) const { return SIMD_16x32 (_mm512_maskz_slli_epi32 (SIMD_16x32_ALL, m_reg, shift)); }
+
+	SIMD_16x32 operator>> (int shift) const { return SIMD_16x32 (_mm512_maskz_srli_epi32 (SIMD_16x32_ALL, m_reg, shift)); }
+
+	SIMD_16x32 operator~ () const { return SIMD_16x32 (_mm512_ternarylogic_epi32 (m_reg, m_reg, m_reg, 0x55)); }
+
+	static void transpose (SIMD_16x32 &B0, SIMD_16x32 &B1, SIMD_16x32 &B2, SIMD_16x32 &B3)
+	{
+		__m512i T0 = _mm512_maskz_unpacklo_epi32 (SIMD_16x32_ALL, B0.m_reg, B1.m_reg);
+		__m512i T1 = _mm512_maskz_unpacklo_epi32 (SIMD_16x32_ALL, B2.m_reg, B3.m_reg);
+		__m512i T2 = _mm512_maskz_unpackhi_epi32 (SIMD_16x32_ALL, B0.m_reg, B1.m_reg);
+		__m512i T3 = _mm512_maskz_unpackhi_epi32 (SIMD_16x32_ALL, B2.m_reg, B3.m_reg);
+		B0.m_reg = _mm512_maskz_unpacklo_epi64 (SIMD_16x32_ALL64, T0, T1);
+		B1.m_reg = _mm512_maskz_unpackhi_epi64 (SIMD_16x32_ALL64, T0, T1);
+		B2.m_reg = _mm512_maskz_unpacklo_epi64 (SIMD_16x32_ALL64, T2, T3);
+		B3.m_reg = _mm512_maskz_unpackhi_epi64 (SIMD_16x32_ALL64, T2, T3);
+	}
+
+private:
+
+	explicit SIMD_16x32 (__m512i in) { m_reg = in; }
+
+	__m512i m_reg;
+};
+
+#define SF_SUFFIX avx512
+#define SF_BLOCKS 16
+#define SF_SIMD SIMD_16x32
+
+#include "SerpentFast_simd_kernel.h"
+
+#undef SIMD_16x32_ALL
+#undef SIMD_16x32_ALL64
+
+extern "C" int serpent_simd_has_avx512 ()
+{
+	return 1;
+}
+
+#else
+
+extern "C" void serpent_simd_encrypt_blocks_avx512 (const unsigned __int8 *in, unsigned __int8 *out, size_t blocks, const unsigned __int32 *round_key)
+{
+}
+
+extern "C" void serpent_simd_decrypt_blocks_avx512 (const unsigned __int8 *in, unsigned __int8 *out, size_t blocks, const unsigned __int32 *round_key)
+{
+}
+
+extern "C" int serpent_simd_has_avx512 ()
+{
+	return 0;
+}
+
+#endif
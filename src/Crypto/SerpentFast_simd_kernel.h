@@ -0,0 +1,159 @@
+/*
+ * Copyright (c) 2013-2025 IDRIX
+ * Governed by the Apache License 2.0 the full text of which is contained
+ * in the file License.txt included in VeraCrypt binary and source
+ * code distribution packages.
+ */
+
+/* Shared body of the wide bitsliced Serpent kernels (see SerpentFast.h), following the
+ * 4-way SSE2 code of SerpentFast_simd.cpp. The including file defines SF_SUFFIX and SF_BLOCKS
+ * (blocks per call, four per 128-bit lane) and a class SF_SIMD offering what SIMD_4x32 offers:
+ *   load_le(p), store_le(p)              unaligned load/store of one vector
+ *   SF_SIMD(x)                           32-bit value copied to every element
+ *   ^ ^= &= |= ~ << >>                   bitwise operations and shifts of every 32-bit element
+ *   rotate_left(n), rotate_right(n)      rotation of every 32-bit element
+ *   transpose(B0, B1, B2, B3)            4x4 transposition of 32-bit words within every 128-bit lane
+ *
+ * Vector i holds blocks i * (SF_BLOCKS / 4) to (i + 1) * (SF_BLOCKS / 4) - 1, so that after the
+ * lane-wise transposition each lane carries four distinct blocks and no cross-lane shuffle is needed.
+ */
+
+#ifndef SERPENTFAST_SIMD_KERNEL_H
+#define SERPENTFAST_SIMD_KERNEL_H
+
+#include "SerpentFast_sbox.h"
+
+#define SF_FN_(name, suffix) name##_##suffix
+#define SF_FN__(name, suffix) SF_FN_(name, suffix)
+#define SF_FN(name) SF_FN__(name, SF_SUFFIX)
+
+/* Bytes per vector */
+#define SF_STRIDE (SF_BLOCKS * 4)
+
+#define key_xor(round, B0, B1, B2, B3) \
+	do { \
+		B0 ^= SF_SIMD (round_key[4*(round)  ]); \
+		B1 ^= SF_SIMD (round_key[4*(round)+1]); \
+		B2 ^= SF_SIMD (round_key[4*(round)+2]); \
+		B3 ^= SF_SIMD (round_key[4*(round)+3]); \
+	} while (0);
+
+/*
+* Serpent's linear transformations
+*/
+#define transform(B0, B1, B2, B3) \
+	do { \
+		B0.rotate_left (13); \
+		B2.rotate_left (3); \
+		B1 ^= B0 ^ B2; \
+		B3 ^= B2 ^ (B0 << 3); \
+		B1.rotate_left (1); \
+		B3.rotate_left (7); \
+		B0 ^= B1 ^ B3; \
+		B2 ^= B3 ^ (B1 << 7); \
+		B0.rotate_left (5); \
+		B2.rotate_left (22); \
+	} while (0);
+
+#define i_transform(B0, B1, B2, B3) \
+	do { \
+		B2.rotate_right (22); \
+		B0.rotate_right (5); \
+		B2 ^= B3 ^ (B1 << 7); \
+		B0 ^= B1 ^ B3; \
+		B3.rotate_right (7); \
+		B1.rotate_right (1); \
+		B3 ^= B2 ^ (B0 << 3); \
+		B1 ^= B0 ^ B2; \
+		B2.rotate_right (3); \
+		B0.rotate_right (13); \
+	} while (0);
+
+extern "C" void SF_FN(serpent_simd_encrypt_blocks) (const unsigned __int8 *in, unsigned __int8 *out, size_t blocks, const unsigned __int32 *round_key)
+{
+	for (; blocks >= SF_BLOCKS; blocks -= SF_BLOCKS)
+	{
+		SF_SIMD B0 = SF_SIMD::load_le (in);
+		SF_SIMD B1 = SF_SIMD::load_le (in + SF_STRIDE);
+		SF_SIMD B2 = SF_SIMD::load_le (in + 2 * SF_STRIDE);
+		SF_SIMD B3 = SF_SIMD::load_le (in + 3 * SF_STRIDE);
+		int r;
+
+		SF_SIMD::transpose (B0, B1, B2, B3);
+
+		/* The eight S-boxes are applied in turn, four times; the very last round ends with a key addition instead of the linear transformation */
+		for (r = 0; r < 32; r += 8)
+		{
+			key_xor(r    ,B0,B1,B2,B3); SBoxE1(SF_SIMD,B0,B1,B2,B3); transform(B0,B1,B2,B3);
+			key_xor(r + 1,B0,B1,B2,B3); SBoxE2(SF_SIMD,B0,B1,B2,B3); transform(B0,B1,B2,B3);
+			key_xor(r + 2,B0,B1,B2,B3); SBoxE3(SF_SIMD,B0,B1,B2,B3); transform(B0,B1,B2,B3);
+			key_xor(r + 3,B0,B1,B2,B3); SBoxE4(SF_SIMD,B0,B1,B2,B3); transform(B0,B1,B2,B3);
+			key_xor(r + 4,B0,B1,B2,B3); SBoxE5(SF_SIMD,B0,B1,B2,B3); transform(B0,B1,B2,B3);
+			key_xor(r + 5,B0,B1,B2,B3); SBoxE6(SF_SIMD,B0,B1,B2,B3); transform(B0,B1,B2,B3);
+			key_xor(r + 6,B0,B1,B2,B3); SBoxE7(SF_SIMD,B0,B1,B2,B3); transform(B0,B1,B2,B3);
+			key_xor(r + 7,B0,B1,B2,B3); SBoxE8(SF_SIMD,B0,B1,B2,B3);
+
+			if (r < 24)
+				transform(B0,B1,B2,B3)
+			else
+				key_xor(32,B0,B1,B2,B3)
+		}
+
+		SF_SIMD::transpose (B0, B1, B2, B3);
+
+		B0.store_le (out);
+		B1.store_le (out + SF_STRIDE);
+		B2.store_le (out + 2 * SF_STRIDE);
+		B3.store_le (out + 3 * SF_STRIDE);
+
+		in += 16 * SF_BLOCKS;
+		out += 16 * SF_BLOCKS;
+	}
+}
+
+extern "C" void SF_FN(serpent_simd_decrypt_blocks) (const unsigned __int8 *in, unsigned __int8 *out, size_t blocks, const unsigned __int32 *round_key)
+{
+	for (; blocks >= SF_BLOCKS; blocks -= SF_BLOCKS)
+	{
+		SF_SIMD B0 = SF_SIMD::load_le (in);
+		SF_SIMD B1 = SF_SIMD::load_le (in + SF_STRIDE);
+		SF_SIMD B2 = SF_SIMD::load_le (in + 2 * SF_STRIDE);
+		SF_SIMD B3 = SF_SIMD::load_le (in + 3 * SF_STRIDE);
+		int r;
+
+		SF_SIMD::transpose (B0, B1, B2, B3);
+
+		key_xor(32,B0,B1,B2,B3);
+
+		for (r = 24; r >= 0; r -= 8)
+		{
+			if (r < 24)
+				i_transform(B0,B1,B2,B3)
+
+			SBoxD8(SF_SIMD,B0,B1,B2,B3); key_xor(r + 7,B0,B1,B2,B3);
+			i_transform(B0,B1,B2,B3); SBoxD7(SF_SIMD,B0,B1,B2,B3); key_xor(r + 6,B0,B1,B2,B3);
+			i_transform(B0,B1,B2,B3); SBoxD6(SF_SIMD,B0,B1,B2,B3); key_xor(r + 5,B0,B1,B2,B3);
+			i_transform(B0,B1,B2,B3); SBoxD5(SF_SIMD,B0,B1,B2,B3); key_xor(r + 4,B0,B1,B2,B3);
+			i_transform(B0,B1,B2,B3); SBoxD4(SF_SIMD,B0,B1,B2,B3); key_xor(r + 3,B0,B1,B2,B3);
+			i_transform(B0,B1,B2,B3); SBoxD3(SF_SIMD,B0,B1,B2,B3); key_xor(r + 2,B0,B1,B2,B3);
+			i_transform(B0,B1,B2,B3); SBoxD2(SF_SIMD,B0,B1,B2,B3); key_xor(r + 1,B0,B1,B2,B3);
+			i_transform(B0,B1,B2,B3); SBoxD1(SF_SIMD,B0,B1,B2,B3); key_xor(r    ,B0,B1,B2,B3);
+		}
+
+		SF_SIMD::transpose (B0, B1, B2, B3);
+
+		B0.store_le (out);
+		B1.store_le (out + SF_STRIDE);
+		B2.store_le (out + 2 * SF_STRIDE);
+		B3.store_le (out + 3 * SF_STRIDE);
+
+		in += 16 * SF_BLOCKS;
+		out += 16 * SF_BLOCKS;
+	}
+}
+
+#undef key_xor
+#undef transform
+#undef i_transform
+
+#endif
@@ -0,0 +1,43 @@
+/*
+ * Copyright (c) 2013-2025 IDRIX
+ * Governed by the Apache License 2.0 the full text of which is contained
+ * in the file License.txt included in VeraCrypt binary and source
+ * code distribution packages.
+ */
+
+/* Multi-buffer SHA-2 kernels used by PBKDF2: every SIMD lane runs one of the
+ * independent HMAC chains that produce the output blocks of a derived key.
+ */
+
+#ifndef _SHA2MB_H
+#define _SHA2MB_H
+
+#include "Common/Tcdefs.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#define SHA256_MB_LANES 8
+#define SHA512_MB_LANES 4
+
+/* State arrays are stored word-major: word w of lane l is at index (w * LANES + l).
+ *
+ * inner/outer: HMAC midstates after the key block (identical for all lanes, 8 words each)
+ * u:           on input the first PBKDF2 iteration of every lane, on output the last one
+ * t:           accumulated XOR of all iterations (in/out)
+ * iterations:  number of additional iterations to compute
+ */
+void sha256_mb_pbkdf2_avx2 (const uint_32t inner[8], const uint_32t outer[8], uint_32t u[8 * SHA256_MB_LANES], uint_32t t[8 * SHA256_MB_LANES], uint_32t iterations);
+void sha512_mb_pbkdf2_avx2 (const uint_64t inner[8], const uint_64t outer[8], uint_64t u[8 * SHA512_MB_LANES], uint_64t t[8 * SHA512_MB_LANES], uint_32t iterations);
+int sha2_mb_has_avx2 ();
+
+void sha256_mb_pbkdf2_avx512 (const uint_32t inner[8], const uint_32t outer[8], uint_32t u[8 * SHA256_MB_LANES], uint_32t t[8 * SHA256_MB_LANES], uint_32t iterations);
+void sha512_mb_pbkdf2_avx512 (const uint_64t inner[8], const uint_64t outer[8], uint_64t u[8 * SHA512_MB_LANES], uint_64t t[8 * SHA512_MB_LANES], uint_32t iterations);
+int sha2_mb_has_avx512 ();
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
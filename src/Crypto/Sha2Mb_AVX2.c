@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2013-2025 IDRIX
+ * Governed by the Apache License 2.0 the full text of which is contained
+ * in the file License.txt included in VeraCrypt binary and source
+ * code distribution packages.
+ */
+
+#include "Sha2Mb.h"
+#include "Crypto/config.h"
+#include "Crypto/cpu.h"
+#include "Crypto/misc.h"
+
+#if CRYPTOPP_BOOL_AVX2_INTRINSICS_AVAILABLE
+
+#include <immintrin.h>
+
+#define MB_SUFFIX avx2
+
+#define MB_ROR32(x,n)	_mm256_or_si256 (_mm256_srli_epi32 (x, n), _mm256_slli_epi32 (x, 32 - (n)))
+#define MB_ROR64(x,n)	_mm256_or_si256 (_mm256_srli_epi64 (x, n), _mm256_slli_epi64 (x, 64 - (n)))
+#define MB_XOR3(a,b,c)	_mm256_xor_si256 (_mm256_xor_si256 (a, b), c)
+#define MB_CH(e,f,g)	_mm256_xor_si256 (_mm256_and_si256 (e, f), _mm256_andnot_si256 (e, g))
+#define MB_MAJ(a,b,c)	_mm256_or_si256 (_mm256_and_si256 (a, b), _mm256_and_si256 (c, _mm256_or_si256 (a, b)))
+
+#include "Sha2Mb_kernel.h"
+
+int sha2_mb_has_avx2 ()
+{
+	return 1;
+}
+
+#else
+
+void sha256_mb_pbkdf2_avx2 (const uint_32t inner[8], const uint_32t outer[8], uint_32t u[8 * SHA256_MB_LANES], uint_32t t[8 * SHA256_MB_LANES], uint_32t iterations)
+{
+}
+
+void sha512_mb_pbkdf2_avx2 (const uint_64t inner[8], const uint_64t outer[8], uint_64t u[8 * SHA512_MB_LANES], uint_64t t[8 * SHA512_MB_LANES], uint_32t iterations)
+{
+}
+
+int sha2_mb_has_avx2 ()
+{
+	return 0;
+}
+
+#endif
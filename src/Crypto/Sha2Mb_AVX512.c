@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2013-2025 IDRIX
+ * Governed by the Apache License 2.0 the full text of which is contained
+ * in the file License.txt included in VeraCrypt binary and source
+ * code distribution packages.
+ */
+
+/* AVX-512VL flavour of the multi-buffer kernels: same 256-bit lanes as the AVX2
+ * version, but with native rotates and VPTERNLOG for the three-input functions. */
+
+#include "Sha2Mb.h"
+#include "Crypto/config.h"
+#include "Crypto/cpu.h"
+#include "Crypto/misc.h"
+
+#if CRYPTOPP_BOOL_AVX512_INTRINSICS_AVAILABLE
+
+#include <immintrin.h>
+
+#define MB_SUFFIX avx512
+
+#define MB_ROR32(x,n)	_mm256_ror_epi32 (x, n)
+#define MB_ROR64(x,n)	_mm256_ror_epi64 (x, n)
+#define MB_XOR3(a,b,c)	_mm256_ternarylogic_epi32 (a, b, c, 0x96)
+#define MB_CH(e,f,g)	_mm256_ternarylogic_epi32 (e, f, g, 0xCA)
+#define MB_MAJ(a,b,c)	_mm256_ternarylogic_epi32 (a, b, c, 0xE8)
+
+#include "Sha2Mb_kernel.h"
+
+int sha2_mb_has_avx512 ()
+{
+	return 1;
+}
+
+#else
+
+void sha256_mb_pbkdf2_avx512 (const uint_32t inner[8], const uint_32t outer[8], uint_32t u[8 * SHA256_MB_LANES], uint_32t t[8 * SHA256_MB_LANES], uint_32t iterations)
+{
+}
+
+void sha512_mb_pbkdf2_avx512 (const uint_64t inner[8], const uint_64t outer[8], uint_64t u[8 * SHA512_MB_LANES], uint_64t t[8 * SHA512_MB_LANES], uint_32t iterations)
+{
+}
+
+int sha2_mb_has_avx512 ()
+{
+	return 0;
+}
+
+#endif
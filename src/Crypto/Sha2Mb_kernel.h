@@ -0,0 +1,260 @@
+/*
+ * Copyright (c) 2013-2025 IDRIX
+ * Governed by the Apache License 2.0 the full text of which is contained
+ * in the file License.txt included in VeraCrypt binary and source
+ * code distribution packages.
+ */
+
+/* Shared body of the multi-buffer SHA-2 PBKDF2 kernels (see Sha2Mb.h).
+ * The including file defines MB_SUFFIX and the instruction-set specific primitives:
+ *   MB_ROR32(x,n), MB_ROR64(x,n)  rotate every 32/64-bit lane right by n bits
+ *   MB_XOR3(a,b,c)                a ^ b ^ c
+ *   MB_CH(e,f,g)                  (e & f) ^ (~e & g)
+ *   MB_MAJ(a,b,c)                 (a & b) ^ (a & c) ^ (b & c)
+ */
+
+#ifndef SHA2MB_KERNEL_H
+#define SHA2MB_KERNEL_H
+
+#define MB_FN_(name, suffix) name##_##suffix
+#define MB_FN__(name, suffix) MB_FN_(name, suffix)
+#define MB_FN(name) MB_FN__(name, MB_SUFFIX)
+
+static const uint_32t SHA256_MB_K[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static const uint_64t SHA512_MB_K[80] = {
+	LL(0x428a2f98d728ae22), LL(0x7137449123ef65cd), LL(0xb5c0fbcfec4d3b2f), LL(0xe9b5dba58189dbbc),
+	LL(0x3956c25bf348b538), LL(0x59f111f1b605d019), LL(0x923f82a4af194f9b), LL(0xab1c5ed5da6d8118),
+	LL(0xd807aa98a3030242), LL(0x12835b0145706fbe), LL(0x243185be4ee4b28c), LL(0x550c7dc3d5ffb4e2),
+	LL(0x72be5d74f27b896f), LL(0x80deb1fe3b1696b1), LL(0x9bdc06a725c71235), LL(0xc19bf174cf692694),
+	LL(0xe49b69c19ef14ad2), LL(0xefbe4786384f25e3), LL(0x0fc19dc68b8cd5b5), LL(0x240ca1cc77ac9c65),
+	LL(0x2de92c6f592b0275), LL(0x4a7484aa6ea6e483), LL(0x5cb0a9dcbd41fbd4), LL(0x76f988da831153b5),
+	LL(0x983e5152ee66dfab), LL(0xa831c66d2db43210), LL(0xb00327c898fb213f), LL(0xbf597fc7beef0ee4),
+	LL(0xc6e00bf33da88fc2), LL(0xd5a79147930aa725), LL(0x06ca6351e003826f), LL(0x142929670a0e6e70),
+	LL(0x27b70a8546d22ffc), LL(0x2e1b21385c26c926), LL(0x4d2c6dfc5ac42aed), LL(0x53380d139d95b3df),
+	LL(0x650a73548baf63de), LL(0x766a0abb3c77b2a8), LL(0x81c2c92e47edaee6), LL(0x92722c851482353b),
+	LL(0xa2bfe8a14cf10364), LL(0xa81a664bbc423001), LL(0xc24b8b70d0f89791), LL(0xc76c51a30654be30),
+	LL(0xd192e819d6ef5218), LL(0xd69906245565a910), LL(0xf40e35855771202a), LL(0x106aa07032bbd1b8),
+	LL(0x19a4c116b8d2d0c8), LL(0x1e376c085141ab53), LL(0x2748774cdf8eeb99), LL(0x34b0bcb5e19b48a8),
+	LL(0x391c0cb3c5c95a63), LL(0x4ed8aa4ae3418acb), LL(0x5b9cca4f7763e373), LL(0x682e6ff3d6b2b8a3),
+	LL(0x748f82ee5defb2fc), LL(0x78a5636f43172f60), LL(0x84c87814a1f0ab72), LL(0x8cc702081a6439ec),
+	LL(0x90befffa23631e28), LL(0xa4506cebde82bde9), LL(0xbef9a3f7b2c67915), LL(0xc67178f2e372532b),
+	LL(0xca273eceea26619c), LL(0xd186b8c721c0c207), LL(0xeada7dd6cde0eb1e), LL(0xf57d4f7fee6ed178),
+	LL(0x06f067aa72176fba), LL(0x0a637dc5a2c898a6), LL(0x113f9804bef90dae), LL(0x1b710b35131c471b),
+	LL(0x28db77f523047d84), LL(0x32caab7b40c72493), LL(0x3c9ebe0a15c9bebc), LL(0x431d67c49c100d4c),
+	LL(0x4cc5d4becb3e42b6), LL(0x597f299cfc657e2a), LL(0x5fcb6fab3ad6faec), LL(0x6c44198c4a475817)
+};
+
+/* SHA-256: 8 lanes of 32-bit words */
+
+#define S256_SUM0(x)	MB_XOR3 (MB_ROR32 (x, 2), MB_ROR32 (x, 13), MB_ROR32 (x, 22))
+#define S256_SUM1(x)	MB_XOR3 (MB_ROR32 (x, 6), MB_ROR32 (x, 11), MB_ROR32 (x, 25))
+#define S256_SIG0(x)	MB_XOR3 (MB_ROR32 (x, 7), MB_ROR32 (x, 18), _mm256_srli_epi32 (x, 3))
+#define S256_SIG1(x)	MB_XOR3 (MB_ROR32 (x, 17), MB_ROR32 (x, 19), _mm256_srli_epi32 (x, 10))
+
+#define S256_ROUND(a,b,c,d,e,f,g,h,i) \
+	{ \
+		__m256i t1, t2; \
+		if ((i) >= 16) \
+			w[(i) & 15] = _mm256_add_epi32 (_mm256_add_epi32 (S256_SIG1 (w[((i) - 2) & 15]), w[((i) - 7) & 15]), \
+				_mm256_add_epi32 (S256_SIG0 (w[((i) - 15) & 15]), w[(i) & 15])); \
+		t1 = _mm256_add_epi32 (_mm256_add_epi32 (h, S256_SUM1 (e)), \
+			_mm256_add_epi32 (_mm256_add_epi32 (MB_CH (e, f, g), _mm256_set1_epi32 ((int) SHA256_MB_K[i])), w[(i) & 15])); \
+		t2 = _mm256_add_epi32 (S256_SUM0 (a), MB_MAJ (a, b, c)); \
+		d = _mm256_add_epi32 (d, t1); \
+		h = _mm256_add_epi32 (t1, t2); \
+	}
+
+static void MB_FN(sha256_mb_compress) (__m256i s[8], __m256i w[16])
+{
+	__m256i a = s[0], b = s[1], c = s[2], d = s[3], e = s[4], f = s[5], g = s[6], h = s[7];
+	int i;
+
+	for (i = 0; i < 64; i += 8)
+	{
+		S256_ROUND (a, b, c, d, e, f, g, h, i + 0);
+		S256_ROUND (h, a, b, c, d, e, f, g, i + 1);
+		S256_ROUND (g, h, a, b, c, d, e, f, i + 2);
+		S256_ROUND (f, g, h, a, b, c, d, e, i + 3);
+		S256_ROUND (e, f, g, h, a, b, c, d, i + 4);
+		S256_ROUND (d, e, f, g, h, a, b, c, i + 5);
+		S256_ROUND (c, d, e, f, g, h, a, b, i + 6);
+		S256_ROUND (b, c, d, e, f, g, h, a, i + 7);
+	}
+
+	s[0] = _mm256_add_epi32 (s[0], a);
+	s[1] = _mm256_add_epi32 (s[1], b);
+	s[2] = _mm256_add_epi32 (s[2], c);
+	s[3] = _mm256_add_epi32 (s[3], d);
+	s[4] = _mm256_add_epi32 (s[4], e);
+	s[5] = _mm256_add_epi32 (s[5], f);
+	s[6] = _mm256_add_epi32 (s[6], g);
+	s[7] = _mm256_add_epi32 (s[7], h);
+}
+
+/* Hashes the 32-byte digest in s (one lane each) with the given midstate.
+ * The message is always a single block: digest, 0x80 padding and a bit length
+ * that accounts for the 64-byte HMAC key block already absorbed in the midstate. */
+static void MB_FN(sha256_mb_hash_digest) (__m256i s[8], const __m256i mid[8], __m256i w[16])
+{
+	int i;
+
+	for (i = 0; i < 8; i++)
+	{
+		w[i] = s[i];
+		s[i] = mid[i];
+	}
+
+	w[8] = _mm256_set1_epi32 ((int) 0x80000000);
+	for (i = 9; i < 15; i++)
+		w[i] = _mm256_setzero_si256 ();
+	w[15] = _mm256_set1_epi32 ((64 + 32) * 8);
+
+	MB_FN(sha256_mb_compress) (s, w);
+}
+
+void MB_FN(sha256_mb_pbkdf2) (const uint_32t inner[8], const uint_32t outer[8], uint_32t u[8 * SHA256_MB_LANES], uint_32t t[8 * SHA256_MB_LANES], uint_32t iterations)
+{
+	__m256i in[8], out[8], s[8], acc[8], w[16];
+	int i;
+
+	for (i = 0; i < 8; i++)
+	{
+		in[i] = _mm256_set1_epi32 ((int) inner[i]);
+		out[i] = _mm256_set1_epi32 ((int) outer[i]);
+		s[i] = _mm256_loadu_si256 ((const __m256i *) (u + i * SHA256_MB_LANES));
+		acc[i] = _mm256_loadu_si256 ((const __m256i *) (t + i * SHA256_MB_LANES));
+	}
+
+	while (iterations--)
+	{
+		MB_FN(sha256_mb_hash_digest) (s, in, w);
+		MB_FN(sha256_mb_hash_digest) (s, out, w);
+
+		for (i = 0; i < 8; i++)
+			acc[i] = _mm256_xor_si256 (acc[i], s[i]);
+	}
+
+	for (i = 0; i < 8; i++)
+	{
+		_mm256_storeu_si256 ((__m256i *) (u + i * SHA256_MB_LANES), s[i]);
+		_mm256_storeu_si256 ((__m256i *) (t + i * SHA256_MB_LANES), acc[i]);
+	}
+
+	burn (in, sizeof (in));
+	burn (out, sizeof (out));
+	burn (s, sizeof (s));
+	burn (acc, sizeof (acc));
+	burn (w, sizeof (w));
+}
+
+/* SHA-512: 4 lanes of 64-bit words */
+
+#define S512_SUM0(x)	MB_XOR3 (MB_ROR64 (x, 28), MB_ROR64 (x, 34), MB_ROR64 (x, 39))
+#define S512_SUM1(x)	MB_XOR3 (MB_ROR64 (x, 14), MB_ROR64 (x, 18), MB_ROR64 (x, 41))
+#define S512_SIG0(x)	MB_XOR3 (MB_ROR64 (x, 1), MB_ROR64 (x, 8), _mm256_srli_epi64 (x, 7))
+#define S512_SIG1(x)	MB_XOR3 (MB_ROR64 (x, 19), MB_ROR64 (x, 61), _mm256_srli_epi64 (x, 6))
+
+#define S512_ROUND(a,b,c,d,e,f,g,h,i) \
+	{ \
+		__m256i t1, t2; \
+		if ((i) >= 16) \
+			w[(i) & 15] = _mm256_add_epi64 (_mm256_add_epi64 (S512_SIG1 (w[((i) - 2) & 15]), w[((i) - 7) & 15]), \
+				_mm256_add_epi64 (S512_SIG0 (w[((i) - 15) & 15]), w[(i) & 15])); \
+		t1 = _mm256_add_epi64 (_mm256_add_epi64 (h, S512_SUM1 (e)), \
+			_mm256_add_epi64 (_mm256_add_epi64 (MB_CH (e, f, g), _mm256_set1_epi64x ((long long) SHA512_MB_K[i])), w[(i) & 15])); \
+		t2 = _mm256_add_epi64 (S512_SUM0 (a), MB_MAJ (a, b, c)); \
+		d = _mm256_add_epi64 (d, t1); \
+		h = _mm256_add_epi64 (t1, t2); \
+	}
+
+static void MB_FN(sha512_mb_compress) (__m256i s[8], __m256i w[16])
+{
+	__m256i a = s[0], b = s[1], c = s[2], d = s[3], e = s[4], f = s[5], g = s[6], h = s[7];
+	int i;
+
+	for (i = 0; i < 80; i += 8)
+	{
+		S512_ROUND (a, b, c, d, e, f, g, h, i + 0);
+		S512_ROUND (h, a, b, c, d, e, f, g, i + 1);
+		S512_ROUND (g, h, a, b, c, d, e, f, i + 2);
+		S512_ROUND (f, g, h, a, b, c, d, e, i + 3);
+		S512_ROUND (e, f, g, h, a, b, c, d, i + 4);
+		S512_ROUND (d, e, f, g, h, a, b, c, i + 5);
+		S512_ROUND (c, d, e, f, g, h, a, b, i + 6);
+		S512_ROUND (b, c, d, e, f, g, h, a, i + 7);
+	}
+
+	s[0] = _mm256_add_epi64 (s[0], a);
+	s[1] = _mm256_add_epi64 (s[1], b);
+	s[2] = _mm256_add_epi64 (s[2], c);
+	s[3] = _mm256_add_epi64 (s[3], d);
+	s[4] = _mm256_add_epi64 (s[4], e);
+	s[5] = _mm256_add_epi64 (s[5], f);
+	s[6] = _mm256_add_epi64 (s[6], g);
+	s[7] = _mm256_add_epi64 (s[7], h);
+}
+
+static void MB_FN(sha512_mb_hash_digest) (__m256i s[8], const __m256i mid[8], __m256i w[16])
+{
+	int i;
+
+	for (i = 0; i < 8; i++)
+	{
+		w[i] = s[i];
+		s[i] = mid[i];
+	}
+
+	w[8] = _mm256_set1_epi64x ((long long) LL(0x8000000000000000));
+	for (i = 9; i < 15; i++)
+		w[i] = _mm256_setzero_si256 ();
+	w[15] = _mm256_set1_epi64x ((128 + 64) * 8);
+
+	MB_FN(sha512_mb_compress) (s, w);
+}
+
+void MB_FN(sha512_mb_pbkdf2) (const uint_64t inner[8], const uint_64t outer[8], uint_64t u[8 * SHA512_MB_LANES], uint_64t t[8 * SHA512_MB_LANES], uint_32t iterations)
+{
+	__m256i in[8], out[8], s[8], acc[8], w[16];
+	int i;
+
+	for (i = 0; i < 8; i++)
+	{
+		in[i] = _mm256_set1_epi64x ((long long) inner[i]);
+		out[i] = _mm256_set1_epi64x ((long long) outer[i]);
+		s[i] = _mm256_loadu_si256 ((const __m256i *) (u + i * SHA512_MB_LANES));
+		acc[i] = _mm256_loadu_si256 ((const __m256i *) (t + i * SHA512_MB_LANES));
+	}
+
+	while (iterations--)
+	{
+		MB_FN(sha512_mb_hash_digest) (s, in, w);
+		MB_FN(sha512_mb_hash_digest) (s, out, w);
+
+		for (i = 0; i < 8; i++)
+			acc[i] = _mm256_xor_si256 (acc[i], s[i]);
+	}
+
+	for (i = 0; i < 8; i++)
+	{
+		_mm256_storeu_si256 ((__m256i *) (u + i * SHA512_MB_LANES), s[i]);
+		_mm256_storeu_si256 ((__m256i *) (t + i * SHA512_MB_LANES), acc[i]);
+	}
+
+	burn (in, sizeof (in));
+	burn (out, sizeof (out));
+	burn (s, sizeof (s));
+	burn (acc, sizeof (acc));
+	burn (w, sizeof (w));
+}
+
+#endif
@@ -59,6 +59,11 @@ void twofish_encrypt_blocks(TwofishInstance *instance, const uint8* in_blk, uint
 void twofish_decrypt_blocks(TwofishInstance *instance, const uint8* in_blk, uint8* out_blk, uint32 blockCount);
 #define twofish_encrypt(instance,in_blk,out_blk)   twofish_encrypt_blocks(instance, (const uint8*) in_blk, (uint8*) out_blk, 1)
 #define twofish_decrypt(instance,in_blk,out_blk)   twofish_decrypt_blocks(instance, (const uint8*) in_blk, (uint8*) out_blk, 1)
+
+/* 16-way AVX2 kernels (Twofish_AVX2.c): process all complete groups of 16 blocks */
+void twofish_encrypt_blocks_avx2(const TwofishInstance *instance, const uint8* in_blk, uint8* out_blk, size_t blockCount);
+void twofish_decrypt_blocks_avx2(const TwofishInstance *instance, const uint8* in_blk, uint8* out_blk, size_t blockCount);
+int twofish_has_avx2();
 #else
 void twofish_encrypt(TwofishInstance *instance, const u4byte in_blk[4], u4byte out_blk[4]);
 void twofish_decrypt(TwofishInstance *instance, const u4byte in_blk[4], u4byte out_blk[4]);
@@ -0,0 +1,191 @@
+/*
+ * Copyright (c) 2013-2025 IDRIX
+ * Governed by the Apache License 2.0 the full text of which is contained
+ * in the file License.txt included in VeraCrypt binary and source
+ * code distribution packages.
+ */
+
+/* AVX2 Twofish kernels for the key schedule of the x64 assembly: every 32-bit element of a register
+ * belongs to a different block and the key-dependent S-box tables are read with VPGATHERDD.
+ * Two groups of 8 blocks are interleaved so that the gathers of one group overlap the arithmetic
+ * of the other.
+ */
+
+#include "Twofish.h"
+#include "Crypto/config.h"
+#include "Crypto/cpu.h"
+#include "Crypto/misc.h"
+
+#if CRYPTOPP_BOOL_AVX2_INTRINSICS_AVAILABLE && CRYPTOPP_BOOL_X64 && !defined(CRYPTOPP_DISABLE_ASM)
+
+#include <immintrin.h>
+
+#define TF_BLOCKS 16
+
+#define TF_ROTL(x,n) _mm256_or_si256 (_mm256_slli_epi32 (x, n), _mm256_srli_epi32 (x, 32 - (n)))
+#define TF_ROTR(x,n) TF_ROTL (x, 32 - (n))
+
+/* Byte n of every 32-bit element */
+VC_INLINE __m256i twofish_byte_avx2 (__m256i x, int n)
+{
+	return n == 3 ? _mm256_srli_epi32 (x, 24) : _mm256_and_si256 (_mm256_srli_epi32 (x, 8 * n), _mm256_set1_epi32 (0xff));
+}
+
+#define TF_LOOKUP(t, x, n) _mm256_i32gather_epi32 ((const int *) ks->mk_tab[t], twofish_byte_avx2 (x, n), 4)
+
+/* g0 (first = 0) and g1 (first = 3, the input rotated by 8 bits): mk_tab[t] is indexed by byte (first + t) & 3 */
+VC_INLINE __m256i twofish_g_avx2 (const TwofishInstance *ks, __m256i x, int first)
+{
+	return _mm256_xor_si256 (
+		_mm256_xor_si256 (TF_LOOKUP (0, x, first), TF_LOOKUP (1, x, (first + 1) & 3)),
+		_mm256_xor_si256 (TF_LOOKUP (2, x, (first + 2) & 3), TF_LOOKUP (3, x, (first + 3) & 3)));
+}
+
+/* The two round function outputs (f0, f1) of the words a (g0) and b (g1) of one group */
+#define TF_F(a, b, r, f0, f1) \
+	f0 = twofish_g_avx2 (ks, a, 0); \
+	f1 = twofish_g_avx2 (ks, b, 3); \
+	f0 = _mm256_add_epi32 (f0, f1); \
+	f1 = _mm256_add_epi32 (f1, _mm256_add_epi32 (f0, _mm256_set1_epi32 ((int) rk[2 * (r) + 9]))); \
+	f0 = _mm256_add_epi32 (f0, _mm256_set1_epi32 ((int) rk[2 * (r) + 8]));
+
+/* Encryption round r: (a, b) feed the round function, (c, d) are updated */
+#define TF_ENC_ROUND(a, b, c, d, r) \
+	do { \
+		__m256i f0, f1; \
+		TF_F (a, b, r, f0, f1) \
+		c = TF_ROTR (_mm256_xor_si256 (c, f0), 1); \
+		d = _mm256_xor_si256 (TF_ROTL (d, 1), f1); \
+	} while (0)
+
+#define TF_DEC_ROUND(a, b, c, d, r) \
+	do { \
+		__m256i f0, f1; \
+		TF_F (a, b, r, f0, f1) \
+		c = _mm256_xor_si256 (TF_ROTL (c, 1), f0); \
+		d = TF_ROTR (_mm256_xor_si256 (d, f1), 1); \
+	} while (0)
+
+/* 4x4 transposition of 32-bit words in every 128-bit lane: register i holds blocks 2i and 2i + 1 on input
+ * and word i of blocks 0, 2, 4, 6 (low lane) and 1, 3, 5, 7 (high lane) on output, and conversely */
+VC_INLINE void twofish_transpose_avx2 (__m256i *x)
+{
+	__m256i t0 = _mm256_unpacklo_epi32 (x[0], x[1]);
+	__m256i t1 = _mm256_unpacklo_epi32 (x[2], x[3]);
+	__m256i t2 = _mm256_unpackhi_epi32 (x[0], x[1]);
+	__m256i t3 = _mm256_unpackhi_epi32 (x[2], x[3]);
+	x[0] = _mm256_unpacklo_epi64 (t0, t1);
+	x[1] = _mm256_unpackhi_epi64 (t0, t1);
+	x[2] = _mm256_unpacklo_epi64 (t2, t3);
+	x[3] = _mm256_unpackhi_epi64 (t2, t3);
+}
+
+VC_INLINE void twofish_load_avx2 (__m256i *x, const uint8 *in, const u4byte *whitening)
+{
+	int i;
+	for (i = 0; i < 4; i++)
+		x[i] = _mm256_loadu_si256 ((const __m256i *) (in + 32 * i));
+
+	twofish_transpose_avx2 (x);
+
+	for (i = 0; i < 4; i++)
+		x[i] = _mm256_xor_si256 (x[i], _mm256_set1_epi32 ((int) whitening[i]));
+}
+
+/* The output block is (x2, x3, x0, x1) */
+VC_INLINE void twofish_store_avx2 (uint8 *out, __m256i *x, const u4byte *whitening)
+{
+	__m256i y[4];
+	int i;
+
+	for (i = 0; i < 4; i++)
+		y[i] = _mm256_xor_si256 (x[(i + 2) & 3], _mm256_set1_epi32 ((int) whitening[i]));
+
+	twofish_transpose_avx2 (y);
+
+	for (i = 0; i < 4; i++)
+		_mm256_storeu_si256 ((__m256i *) (out + 32 * i), y[i]);
+}
+
+void twofish_encrypt_blocks_avx2 (const TwofishInstance *ks, const uint8 *in_blk, uint8 *out_blk, size_t blockCount)
+{
+	/* w[0..7] are the whitening keys and k[] follows them: rk[8 + i] is k[i] */
+	const u4byte *rk = ks->w;
+	__m256i x[4], y[4];
+	int r;
+
+	for (; blockCount >= TF_BLOCKS; blockCount -= TF_BLOCKS)
+	{
+		twofish_load_avx2 (x, in_blk, rk);
+		twofish_load_avx2 (y, in_blk + 8 * 16, rk);
+
+		for (r = 0; r < 16; r += 2)
+		{
+			TF_ENC_ROUND (x[0], x[1], x[2], x[3], r);
+			TF_ENC_ROUND (y[0], y[1], y[2], y[3], r);
+			TF_ENC_ROUND (x[2], x[3], x[0], x[1], r + 1);
+			TF_ENC_ROUND (y[2], y[3], y[0], y[1], r + 1);
+		}
+
+		twofish_store_avx2 (out_blk, x, rk + 4);
+		twofish_store_avx2 (out_blk + 8 * 16, y, rk + 4);
+
+		in_blk += 16 * TF_BLOCKS;
+		out_blk += 16 * TF_BLOCKS;
+	}
+
+	burn (x, sizeof (x));
+	burn (y, sizeof (y));
+}
+
+void twofish_decrypt_blocks_avx2 (const TwofishInstance *ks, const uint8 *in_blk, uint8 *out_blk, size_t blockCount)
+{
+	const u4byte *rk = ks->w;
+	__m256i x[4], y[4];
+	int r;
+
+	for (; blockCount >= TF_BLOCKS; blockCount -= TF_BLOCKS)
+	{
+		twofish_load_avx2 (x, in_blk, rk + 4);
+		twofish_load_avx2 (y, in_blk + 8 * 16, rk + 4);
+
+		for (r = 15; r > 0; r -= 2)
+		{
+			TF_DEC_ROUND (x[0], x[1], x[2], x[3], r);
+			TF_DEC_ROUND (y[0], y[1], y[2], y[3], r);
+			TF_DEC_ROUND (x[2], x[3], x[0], x[1], r - 1);
+			TF_DEC_ROUND (y[2], y[3], y[0], y[1], r - 1);
+		}
+
+		twofish_store_avx2 (out_blk, x, rk);
+		twofish_store_avx2 (out_blk + 8 * 16, y, rk);
+
+		in_blk += 16 * TF_BLOCKS;
+		out_blk += 16 * TF_BLOCKS;
+	}
+
+	burn (x, sizeof (x));
+	burn (y, sizeof (y));
+}
+
+int twofish_has_avx2 ()
+{
+	return 1;
+}
+
+#else
+
+void twofish_encrypt_blocks_avx2 (const TwofishInstance *ks, const uint8 *in_blk, uint8 *out_blk, size_t blockCount)
+{
+}
+
+void twofish_decrypt_blocks_avx2 (const TwofishInstance *ks, const uint8 *in_blk, uint8 *out_blk, size_t blockCount)
+{
+}
+
+int twofish_has_avx2 ()
+{
+	return 0;
+}
+
+#endif
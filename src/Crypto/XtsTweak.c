@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2013-2025 IDRIX
+ * Governed by the Apache License 2.0 the full text of which is contained
+ * in the file License.txt included in VeraCrypt binary and source
+ * code distribution packages.
+ */
+
+#include "XtsTweak.h"
+#include "Common/Endian.h"
+#include "Crypto/config.h"
+#include "Crypto/cpu.h"
+
+#if CRYPTOPP_BOOL_SSE2_INTRINSICS_AVAILABLE
+
+/* Multiplies the tweak by x: a left shift by one bit reduced modulo x^128 + x^7 + x^2 + x + 1 */
+VC_INLINE __m128i xts_mul_x (__m128i t)
+{
+	const __m128i poly = _mm_set_epi32 (0, 1, 0, 0x87);
+	__m128i carry = _mm_and_si128 (_mm_shuffle_epi32 (_mm_srai_epi32 (t, 31), 0x13), poly);
+	return _mm_xor_si128 (_mm_add_epi64 (t, t), carry);
+}
+
+/* Multiplies the tweak by x^4. The four bits shifted out of the top are reduced
+ * with shifts, as c * (x^7 + x^2 + x + 1) never exceeds 64 bits. */
+VC_INLINE __m128i xts_mul_x4 (__m128i t)
+{
+	__m128i carry = _mm_srli_epi64 (t, 60);
+	__m128i top = _mm_srli_si128 (carry, 8);
+	__m128i r = _mm_xor_si128 (_mm_slli_epi64 (t, 4), _mm_slli_si128 (carry, 8));
+
+	r = _mm_xor_si128 (r, _mm_xor_si128 (top, _mm_slli_epi64 (top, 1)));
+	return _mm_xor_si128 (r, _mm_xor_si128 (_mm_slli_epi64 (top, 2), _mm_slli_epi64 (top, 7)));
+}
+
+static void xts_tweak_table_sse2 (uint8 *tweaks, const uint8 *firstTweak, unsigned int startBlock, unsigned int count)
+{
+	__m128i t0 = _mm_loadu_si128 ((const __m128i *) firstTweak), t1, t2, t3;
+	__m128i *out = (__m128i *) tweaks;
+
+	for (; startBlock >= 4; startBlock -= 4)
+		t0 = xts_mul_x4 (t0);
+	for (; startBlock > 0; startBlock--)
+		t0 = xts_mul_x (t0);
+
+	/* Four independent chains advanced by x^4 */
+	t1 = xts_mul_x (t0);
+	t2 = xts_mul_x (t1);
+	t3 = xts_mul_x (t2);
+
+	for (; count >= 4; count -= 4)
+	{
+		_mm_storeu_si128 (out++, t0);
+		_mm_storeu_si128 (out++, t1);
+		_mm_storeu_si128 (out++, t2);
+		_mm_storeu_si128 (out++, t3);
+
+		t0 = xts_mul_x4 (t0);
+		t1 = xts_mul_x4 (t1);
+		t2 = xts_mul_x4 (t2);
+		t3 = xts_mul_x4 (t3);
+	}
+
+	if (count > 0)
+		_mm_storeu_si128 (out++, t0);
+	if (count > 1)
+		_mm_storeu_si128 (out++, t1);
+	if (count > 2)
+		_mm_storeu_si128 (out++, t2);
+}
+
+void xts_tweak_table (uint8 *tweaks, const uint8 *firstTweak, unsigned int startBlock, unsigned int count)
+{
+	if (HasSAVX2() && xts_tweak_has_avx2())
+		xts_tweak_table_avx2 (tweaks, firstTweak, startBlock, count);
+	else
+		xts_tweak_table_sse2 (tweaks, firstTweak, startBlock, count);
+}
+
+#else
+
+void xts_tweak_table (uint8 *tweaks, const uint8 *firstTweak, unsigned int startBlock, unsigned int count)
+{
+	uint64 lo = LE64 (((const uint64 *) firstTweak)[0]);
+	uint64 hi = LE64 (((const uint64 *) firstTweak)[1]);
+	uint64 *out = (uint64 *) tweaks;
+	unsigned int block;
+
+	for (block = 0; block < startBlock + count; block++)
+	{
+		uint64 carry = (hi & 0x8000000000000000ULL) ? 135 : 0;
+
+		if (block >= startBlock)
+		{
+			*out++ = LE64 (lo);
+			*out++ = LE64 (hi);
+		}
+
+		hi = (hi << 1) | (lo >> 63);
+		lo = (lo << 1) ^ carry;
+	}
+}
+
+#endif
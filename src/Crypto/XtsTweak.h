@@ -0,0 +1,33 @@
+/*
+ * Copyright (c) 2013-2025 IDRIX
+ * Governed by the Apache License 2.0 the full text of which is contained
+ * in the file License.txt included in VeraCrypt binary and source
+ * code distribution packages.
+ */
+
+/* Generation of the XTS whitening values (tweaks) of a data unit: the encrypted data unit
+ * number multiplied by successive powers of x in GF(2^128).
+ */
+
+#ifndef TC_HEADER_Crypto_XtsTweak
+#define TC_HEADER_Crypto_XtsTweak
+
+#include "Common/Tcdefs.h"
+
+#if defined(__cplusplus)
+extern "C"
+{
+#endif
+
+/* Writes count 16-byte whitening values to tweaks: firstTweak multiplied by x^startBlock,
+ * x^(startBlock + 1), ... x^(startBlock + count - 1). */
+void xts_tweak_table (uint8 *tweaks, const uint8 *firstTweak, unsigned int startBlock, unsigned int count);
+
+void xts_tweak_table_avx2 (uint8 *tweaks, const uint8 *firstTweak, unsigned int startBlock, unsigned int count);
+int xts_tweak_has_avx2 ();
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif // TC_HEADER_Crypto_XtsTweak
@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2013-2025 IDRIX
+ * Governed by the Apache License 2.0 the full text of which is contained
+ * in the file License.txt included in VeraCrypt binary and source
+ * code distribution packages.
+ */
+
+/* AVX2 flavour of the XTS tweak generator: two whitening values per 256-bit register. */
+
+#include "XtsTweak.h"
+#include "Crypto/config.h"
+#include "Crypto/cpu.h"
+
+#if CRYPTOPP_BOOL_AVX2_INTRINSICS_AVAILABLE
+
+#include <immintrin.h>
+
+VC_INLINE __m128i xts_mul_x (__m128i t)
+{
+	const __m128i poly = _mm_set_epi32 (0, 1, 0, 0x87);
+	__m128i carry = _mm_and_si128 (_mm_shuffle_epi32 (_mm_srai_epi32 (t, 31), 0x13), poly);
+	return _mm_xor_si128 (_mm_add_epi64 (t, t), carry);
+}
+
+/* Multiplies the tweak in each 128-bit lane by x^4 (see xts_mul_x4 in XtsTweak.c) */
+VC_INLINE __m256i xts_mul_x4_avx2 (__m256i t)
+{
+	__m256i carry = _mm256_srli_epi64 (t, 60);
+	__m256i top = _mm256_srli_si256 (carry, 8);
+	__m256i r = _mm256_xor_si256 (_mm256_slli_epi64 (t, 4), _mm256_slli_si256 (carry, 8));
+
+	r = _mm256_xor_si256 (r, _mm256_xor_si256 (top, _mm256_slli_epi64 (top, 1)));
+	return _mm256_xor_si256 (r, _mm256_xor_si256 (_mm256_slli_epi64 (top, 2), _mm256_slli_epi64 (top, 7)));
+}
+
+void xts_tweak_table_avx2 (uint8 *tweaks, const uint8 *firstTweak, unsigned int startBlock, unsigned int count)
+{
+	__m128i t = _mm_loadu_si128 ((const __m128i *) firstTweak), t1, t2, t3;
+	__m256i t01, t23;
+	__m256i *out = (__m256i *) tweaks;
+
+	for (; startBlock > 0; startBlock--)
+		t = xts_mul_x (t);
+
+	t1 = xts_mul_x (t);
+	t2 = xts_mul_x (t1);
+	t3 = xts_mul_x (t2);
+
+	/* Two independent chains of two lanes each, advanced by x^4 */
+	t01 = _mm256_inserti128_si256 (_mm256_castsi128_si256 (t), t1, 1);
+	t23 = _mm256_inserti128_si256 (_mm256_castsi128_si256 (t2), t3, 1);
+
+	for (; count >= 4; count -= 4)
+	{
+		_mm256_storeu_si256 (out++, t01);
+		_mm256_storeu_si256 (out++, t23);
+
+		t01 = xts_mul_x4_avx2 (t01);
+		t23 = xts_mul_x4_avx2 (t23);
+	}
+
+	if (count >= 2)
+	{
+		_mm256_storeu_si256 (out++, t01);
+		t01 = t23;
+		count -= 2;
+	}
+
+	if (count > 0)
+		_mm_storeu_si128 ((__m128i *) out, _mm256_castsi256_si128 (t01));
+}
+
+int xts_tweak_has_avx2 ()
+{
+	return 1;
+}
+
+#else
+
+void xts_tweak_table_avx2 (uint8 *tweaks, const uint8 *firstTweak, unsigned int startBlock, unsigned int count)
+{
+}
+
+int xts_tweak_has_avx2 ()
+{
+	return 0;
+}
+
+#endif
@@ -157,6 +157,36 @@
     #define CRYPTOPP_BOOL_SSE41_INTRINSICS_AVAILABLE 0
 #endif
 
+#if CRYPTOPP_BOOL_SSE41_INTRINSICS_AVAILABLE && !defined(CRYPTOPP_DISABLE_AVX2) && (defined(__AVX2__) || (_MSC_VER >= 1800))
+    #define CRYPTOPP_BOOL_AVX2_INTRINSICS_AVAILABLE 1
+#else
+    #define CRYPTOPP_BOOL_AVX2_INTRINSICS_AVAILABLE 0
+#endif
+
+#if CRYPTOPP_BOOL_AVX2_INTRINSICS_AVAILABLE && !defined(CRYPTOPP_DISABLE_AVX512) && ((defined(__AVX512F__) && defined(__AVX512VL__)) || (_MSC_VER >= 1910))
+    #define CRYPTOPP_BOOL_AVX512_INTRINSICS_AVAILABLE 1
+#else
+    #define CRYPTOPP_BOOL_AVX512_INTRINSICS_AVAILABLE 0
+#endif
+
+#if CRYPTOPP_BOOL_AVX2_INTRINSICS_AVAILABLE && CRYPTOPP_BOOL_AESNI_INTRINSICS_AVAILABLE && !defined(CRYPTOPP_DISABLE_VAES) && ((defined(__VAES__) && defined(__VPCLMULQDQ__)) || (_MSC_VER >= 1920))
+    #define CRYPTOPP_BOOL_VAES_INTRINSICS_AVAILABLE 1
+#else
+    #define CRYPTOPP_BOOL_VAES_INTRINSICS_AVAILABLE 0
+#endif
+
+#if CRYPTOPP_BOOL_VAES_INTRINSICS_AVAILABLE && CRYPTOPP_BOOL_AVX512_INTRINSICS_AVAILABLE
+    #define CRYPTOPP_BOOL_VAES512_INTRINSICS_AVAILABLE 1
+#else
+    #define CRYPTOPP_BOOL_VAES512_INTRINSICS_AVAILABLE 0
+#endif
+
+#if CRYPTOPP_BOOL_AVX512_INTRINSICS_AVAILABLE && !defined(CRYPTOPP_DISABLE_GFNI) && ((defined(__GFNI__) && defined(__AVX512BW__) && defined(__AVX512VBMI__)) || (_MSC_VER >= 1920))
+    #define CRYPTOPP_BOOL_GFNI_INTRINSICS_AVAILABLE 1
+#else
+    #define CRYPTOPP_BOOL_GFNI_INTRINSICS_AVAILABLE 0
+#endif
+
 // how to allocate 16-byte aligned memory (for SSE2)
 #if defined(_MSC_VER)
 	#define CRYPTOPP_MM_MALLOC_AVAILABLE
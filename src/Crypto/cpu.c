@@ -199,6 +199,9 @@ static uint64 xgetbv()
 volatile int g_x86DetectionDone = 0;
 volatile int g_hasISSE = 0, g_hasSSE2 = 0, g_hasSSSE3 = 0, g_hasMMX = 0, g_hasAESNI = 0, g_hasCLMUL = 0, g_isP4 = 0;
 volatile int g_hasAVX = 0, g_hasAVX2 = 0, g_hasBMI2 = 0, g_hasSSE42 = 0, g_hasSSE41 = 0, g_isIntel = 0, g_isAMD = 0;
+volatile int g_hasAVX512F = 0, g_hasAVX512VL = 0, g_hasAVX512BW = 0;
+volatile int g_hasVAES = 0, g_hasVPCLMULQDQ = 0;
+volatile int g_hasGFNI = 0, g_hasAVX512VBMI = 0;
 volatile int g_hasRDRAND = 0, g_hasRDSEED = 0;
 volatile int g_hasSHA256 = 0;
 volatile uint32 g_cacheLineSize = CRYPTOPP_L1_CACHE_LINE_SIZE;
@@ -341,6 +344,22 @@ void DetectX86Features()
 	{
       uint64 xcrFeatureMask = xgetbv();
       g_hasAVX = (xcrFeatureMask & 0x6) == 0x6;
+      if (g_hasAVX && (cpuid[0] >= 7) && CpuId(7, cpuid2))
+      {
+         /* VEX/EVEX encoded AES and carry-less multiplication on YMM/ZMM registers */
+         g_hasVAES = (cpuid2[2] & (1 << 9)) != 0;
+         g_hasVPCLMULQDQ = (cpuid2[2] & (1 << 10)) != 0;
+         g_hasGFNI = (cpuid2[2] & (1 << 8)) != 0;
+
+         /* AVX-512 additionally needs the OS to save opmask and upper ZMM state (XCR0 bits 5-7) */
+         if ((xcrFeatureMask & 0xE0) == 0xE0)
+         {
+            g_hasAVX512F = (cpuid2[1] & (1 << 16)) != 0;
+            g_hasAVX512BW = g_hasAVX512F && ((cpuid2[1] & (1 << 30)) != 0);
+            g_hasAVX512VL = g_hasAVX512F && ((cpuid2[1] & (1u << 31)) != 0);
+            g_hasAVX512VBMI = g_hasAVX512F && ((cpuid2[2] & (1 << 1)) != 0);
+         }
+      }
 	}
 	g_hasAVX2 = g_hasAVX && (cpuid1[1] & (1 << 5));
 	g_hasBMI2 = g_hasSSE2 && (cpuid1[1] & (1 << 8));
@@ -351,6 +370,8 @@ void DetectX86Features()
 	g_hasAESNI = g_hasSSE2 && (cpuid1[2] & (1<<25));
 #endif
 	g_hasCLMUL = g_hasSSE2 && (cpuid1[2] & (1<<1));
+	g_hasVAES = g_hasVAES && g_hasAESNI;
+	g_hasVPCLMULQDQ = g_hasVPCLMULQDQ && g_hasCLMUL;
 	g_hasSHA256 = CheckSHA256Support();
 
 #if !defined (_UEFI) && ((defined(__AES__) && defined(__PCLMUL__)) || defined(__INTEL_COMPILER) || CRYPTOPP_BOOL_AESNI_INTRINSICS_AVAILABLE)
@@ -459,6 +480,13 @@ void DisableCPUExtendedFeatures ()
 	g_hasAVX = 0;
 	g_hasAVX2 = 0;
 	g_hasBMI2 = 0;
+	g_hasAVX512F = 0;
+	g_hasAVX512VL = 0;
+	g_hasAVX512BW = 0;
+	g_hasVAES = 0;
+	g_hasVPCLMULQDQ = 0;
+	g_hasGFNI = 0;
+	g_hasAVX512VBMI = 0;
 	g_hasSSE42 = 0;
 	g_hasSSE41 = 0;
 	g_hasSSSE3 = 0;
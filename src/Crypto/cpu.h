@@ -232,6 +232,7 @@ extern "C" {
 #define CRYPTOPP_CPUID_AVAILABLE
 #if !defined(CRYPTOPP_DISABLE_AESNI) && !defined(WOLFCRYPT_BACKEND)
 #define TC_AES_HW_CPU
+#define TC_AES_HW_VAES
 #endif
 
 // these should not be used directly
@@ -242,6 +243,13 @@ extern volatile int g_hasMMX;
 extern volatile int g_hasAVX;
 extern volatile int g_hasAVX2;
 extern volatile int g_hasBMI2;
+extern volatile int g_hasAVX512F;
+extern volatile int g_hasAVX512VL;
+extern volatile int g_hasAVX512BW;
+extern volatile int g_hasVAES;
+extern volatile int g_hasVPCLMULQDQ;
+extern volatile int g_hasGFNI;
+extern volatile int g_hasAVX512VBMI;
 extern volatile int g_hasSSE42;
 extern volatile int g_hasSSE41;
 extern volatile int g_hasSSSE3;
@@ -273,6 +281,13 @@ void DisableCPUExtendedFeatures ();
 #define HasSAVX() g_hasAVX
 #define HasSAVX2() g_hasAVX2
 #define HasSBMI2() g_hasBMI2
+#define HasSAVX512F() g_hasAVX512F
+#define HasSAVX512VL() g_hasAVX512VL
+#define HasSAVX512BW() g_hasAVX512BW
+#define HasVAES() g_hasVAES
+#define HasVPCLMULQDQ() g_hasVPCLMULQDQ
+#define HasGFNI() g_hasGFNI
+#define HasSAVX512VBMI() g_hasAVX512VBMI
 #define HasSSSE3() g_hasSSSE3
 #define HasAESNI() g_hasAESNI
 #define HasCLMUL() g_hasCLMUL
@@ -319,6 +334,13 @@ void DetectArmFeatures();
 #define HasSAVX() 0
 #define HasSAVX2() 0
 #define HasSBMI2() 0
+#define HasSAVX512F() 0
+#define HasSAVX512VL() 0
+#define HasSAVX512BW() 0
+#define HasVAES() 0
+#define HasVPCLMULQDQ() 0
+#define HasGFNI() 0
+#define HasSAVX512VBMI() 0
 #define HasSSSE3() 0
 #define HasAESNI() 0
 #define HasCLMUL() 0
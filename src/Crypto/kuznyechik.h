@@ -28,6 +28,11 @@ void kuznyechik_decrypt_block(uint8* out, const uint8* in, kuznyechik_kds* kds);
 void kuznyechik_decrypt_blocks(uint8* out, const uint8* in, size_t blocks, kuznyechik_kds* kds);
 void kuznyechik_set_key(const uint8* key, kuznyechik_kds *kds);
 
+/* AVX-512 GFNI kernels (kuznyechik_gfni.c): process all complete groups of 16 blocks */
+void kuznyechik_encrypt_blocks_gfni(uint8* out, const uint8* in, size_t blocks, const kuznyechik_kds* kds);
+void kuznyechik_decrypt_blocks_gfni(uint8* out, const uint8* in, size_t blocks, const kuznyechik_kds* kds);
+int kuznyechik_has_gfni();
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,559 @@
+/*
+ Derived from source code of TrueCrypt 7.1a, which is
+ Copyright (c) 2008-2012 TrueCrypt Developers Association and which is governed
+ by the TrueCrypt License 3.0.
+
+ Modifications and additions to the original source code (contained in this file)
+ and all other portions of this file are Copyright (c) 2013-2025 IDRIX
+ and are governed by the Apache License 2.0 the full text of which is
+ contained in the file License.txt included in VeraCrypt binary and source
+ code distribution packages.
+*/
+
+#define FUSE_USE_VERSION  32
+
+#include <errno.h>
+#include <fcntl.h>
+#include <fuse_lowlevel.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "FuseService.h"
+#include "Platform/Finally.h"
+#include "Platform/SecureBufferPool.h"
+#include "Platform/SystemLog.h"
+
+namespace VeraCrypt
+{
+	// The volume service exposes a fixed set of files, whose inode numbers are therefore constant
+	enum
+	{
+		FuseRootInode = FUSE_ROOT_ID,
+		FuseVolumeImageInode,
+		FuseControlInode
+	};
+
+	// Requests are sized for large sequential transfers of the loop device
+	static const unsigned int FuseMaxRequestSize = 1024 * 1024;
+	static const unsigned int FuseMaxBackgroundRequests = 64;
+	static const unsigned int FuseMaxIdleThreads = 16;
+
+	// Attributes of the volume image do not change while it is mounted. The size of the control file does.
+	static const double FuseVolumeImageAttrTimeout = 3600.0;
+
+	static int fuse_ll_error_code ()
+	{
+		// Low-level replies take positive error numbers
+		return -FuseService::ExceptionToErrorCode();
+	}
+
+	static bool fuse_ll_check_access_rights (fuse_req_t req)
+	{
+		return FuseService::CheckAccessRights (fuse_req_ctx (req)->uid);
+	}
+
+	static bool fuse_ll_get_attr (fuse_ino_t ino, struct stat *statData)
+	{
+		Memory::Zero (statData, sizeof (*statData));
+
+		statData->st_ino = ino;
+		statData->st_uid = FuseService::GetUserId();
+		statData->st_gid = FuseService::GetGroupId();
+		statData->st_atime = time (NULL);
+		statData->st_ctime = time (NULL);
+		statData->st_mtime = time (NULL);
+
+		switch (ino)
+		{
+		case FuseRootInode:
+			statData->st_mode = S_IFDIR | 0500;
+			statData->st_nlink = 2;
+			return true;
+
+		case FuseVolumeImageInode:
+			statData->st_mode = S_IFREG | 0600;
+			statData->st_nlink = 1;
+			statData->st_size = FuseService::GetVolumeSize();
+			return true;
+
+		case FuseControlInode:
+			statData->st_mode = S_IFREG | 0600;
+			statData->st_nlink = 1;
+			statData->st_size = FuseService::GetVolumeInfo()->Size();
+			return true;
+
+		default:
+			return false;
+		}
+	}
+
+	static void fuse_ll_init (void *userdata, struct fuse_conn_info *conn)
+	{
+		// Replies to reads are spliced to the FUSE device. Data is not moved, as the buffers are reused.
+		if (conn->capable & FUSE_CAP_SPLICE_WRITE)
+			conn->want |= FUSE_CAP_SPLICE_WRITE;
+
+		// Writes are gathered by the page cache into large requests
+		if (conn->capable & FUSE_CAP_WRITEBACK_CACHE)
+			conn->want |= FUSE_CAP_WRITEBACK_CACHE;
+
+		conn->max_write = FuseMaxRequestSize;
+		conn->max_readahead = FuseMaxRequestSize;
+		conn->max_background = FuseMaxBackgroundRequests;
+		conn->congestion_threshold = FuseMaxBackgroundRequests * 3 / 4;
+
+		try
+		{
+			FuseService::Initialize();
+		}
+		catch (exception &e)
+		{
+			SystemLog::WriteException (e);
+		}
+		catch (...)
+		{
+			SystemLog::WriteException (UnknownException (SRC_POS));
+		}
+	}
+
+	static void fuse_ll_destroy (void *userdata)
+	{
+		try
+		{
+			FuseService::Dismount();
+		}
+		catch (exception &e)
+		{
+			SystemLog::WriteException (e);
+		}
+		catch (...)
+		{
+			SystemLog::WriteException (UnknownException (SRC_POS));
+		}
+	}
+
+	static void fuse_ll_lookup (fuse_req_t req, fuse_ino_t parent, const char *name)
+	{
+		try
+		{
+			if (!fuse_ll_check_access_rights (req))
+			{
+				fuse_reply_err (req, EACCES);
+				return;
+			}
+
+			struct fuse_entry_param entry;
+			Memory::Zero (&entry, sizeof (entry));
+
+			if (parent != FuseRootInode)
+				entry.ino = 0;
+			else if (strcmp (name, FuseService::GetVolumeImagePath() + 1) == 0)
+				entry.ino = FuseVolumeImageInode;
+			else if (strcmp (name, FuseService::GetControlPath() + 1) == 0)
+				entry.ino = FuseControlInode;
+
+			if (entry.ino == 0 || !fuse_ll_get_attr (entry.ino, &entry.attr))
+			{
+				fuse_reply_err (req, ENOENT);
+				return;
+			}
+
+			if (entry.ino == FuseVolumeImageInode)
+			{
+				entry.attr_timeout = FuseVolumeImageAttrTimeout;
+				entry.entry_timeout = FuseVolumeImageAttrTimeout;
+			}
+
+			fuse_reply_entry (req, &entry);
+		}
+		catch (...)
+		{
+			fuse_reply_err (req, fuse_ll_error_code());
+		}
+	}
+
+	static void fuse_ll_getattr (fuse_req_t req, fuse_ino_t ino, struct fuse_file_info *fi)
+	{
+		try
+		{
+			if (ino != FuseRootInode && !fuse_ll_check_access_rights (req))
+			{
+				fuse_reply_err (req, EACCES);
+				return;
+			}
+
+			struct stat statData;
+			if (!fuse_ll_get_attr (ino, &statData))
+			{
+				fuse_reply_err (req, ENOENT);
+				return;
+			}
+
+			fuse_reply_attr (req, &statData, ino == FuseVolumeImageInode ? FuseVolumeImageAttrTimeout : 0);
+		}
+		catch (...)
+		{
+			fuse_reply_err (req, fuse_ll_error_code());
+		}
+	}
+
+	static void fuse_ll_access (fuse_req_t req, fuse_ino_t ino, int mask)
+	{
+		fuse_reply_err (req, fuse_ll_check_access_rights (req) ? 0 : EACCES);
+	}
+
+	static void fuse_ll_open (fuse_req_t req, fuse_ino_t ino, struct fuse_file_info *fi)
+	{
+		if (!fuse_ll_check_access_rights (req))
+		{
+			fuse_reply_err (req, EACCES);
+			return;
+		}
+
+		switch (ino)
+		{
+		case FuseVolumeImageInode:
+			// The volume is modified only through this file system, so cached pages remain valid
+			fi->keep_cache = 1;
+			fuse_reply_open (req, fi);
+			break;
+
+		case FuseControlInode:
+			fi->direct_io = 1;
+			fuse_reply_open (req, fi);
+			break;
+
+		case FuseRootInode:
+			fuse_reply_err (req, EISDIR);
+			break;
+
+		default:
+			fuse_reply_err (req, ENOENT);
+			break;
+		}
+	}
+
+	static void fuse_ll_read (fuse_req_t req, fuse_ino_t ino, size_t size, off_t offset, struct fuse_file_info *fi)
+	{
+		try
+		{
+			if (!fuse_ll_check_access_rights (req))
+			{
+				fuse_reply_err (req, EACCES);
+				return;
+			}
+
+			if (ino == FuseVolumeImageInode)
+			{
+				uint64 volumeSize = FuseService::GetVolumeSize();
+
+				// Test for read beyond the end of the volume
+				if ((uint64) offset >= volumeSize)
+				{
+					fuse_reply_buf (req, nullptr, 0);
+					return;
+				}
+
+				if ((uint64) offset + size > volumeSize)
+					size = (size_t) (volumeSize - offset);
+
+				// Non-sector-aligned reads are required by some loop device tools, which may analyze the
+				// volume image before attaching it as a device. They are served from the aligned range read.
+				size_t sectorSize = (size_t) FuseService::GetVolumeSectorSize();
+				uint64 alignedOffset = offset - (offset % sectorSize);
+				size_t alignedSize = size + (size_t) (offset % sectorSize);
+
+				if (alignedSize % sectorSize != 0)
+					alignedSize += sectorSize - (alignedSize % sectorSize);
+
+				PooledSecureBuffer alignedBuffer (alignedSize);
+
+				try
+				{
+					FuseService::ReadVolumeSectors (alignedBuffer, alignedOffset);
+				}
+				catch (MissingVolumeData&)
+				{
+					fuse_reply_buf (req, nullptr, 0);
+					return;
+				}
+
+				// The reply is sent before the buffer is erased and returned to the pool
+				struct fuse_bufvec data = FUSE_BUFVEC_INIT (size);
+				data.buf[0].mem = alignedBuffer.Ptr() + (offset % sectorSize);
+
+				fuse_reply_data (req, &data, (enum fuse_buf_copy_flags) 0);
+				return;
+			}
+
+			if (ino == FuseControlInode)
+			{
+				shared_ptr <Buffer> infoBuf = FuseService::GetVolumeInfo();
+
+				if (offset >= (off_t) infoBuf->Size())
+				{
+					fuse_reply_buf (req, nullptr, 0);
+					return;
+				}
+
+				if (offset + size > infoBuf->Size())
+					size = infoBuf->Size() - offset;
+
+				fuse_reply_buf (req, (const char *) infoBuf->Ptr() + offset, size);
+				return;
+			}
+
+			fuse_reply_err (req, ino == FuseRootInode ? EISDIR : ENOENT);
+		}
+		catch (...)
+		{
+			fuse_reply_err (req, fuse_ll_error_code());
+		}
+	}
+
+	static void fuse_ll_write (fuse_req_t req, fuse_ino_t ino, const char *buf, size_t size, off_t offset, struct fuse_file_info *fi)
+	{
+		try
+		{
+			if (!fuse_ll_check_access_rights (req))
+			{
+				fuse_reply_err (req, EACCES);
+				return;
+			}
+
+			if (ino == FuseVolumeImageInode)
+			{
+				FuseService::WriteVolumeSectors (ConstBufferPtr ((const uint8 *) buf, size), offset);
+				fuse_reply_write (req, size);
+				return;
+			}
+
+			if (ino == FuseControlInode)
+			{
+				if (FuseService::AuxDeviceInfoReceived())
+					FuseService::ReceiveControlCommand (ConstBufferPtr ((const uint8 *) buf, size));
+				else
+					FuseService::ReceiveAuxDeviceInfo (ConstBufferPtr ((const uint8 *) buf, size));
+
+				fuse_reply_write (req, size);
+				return;
+			}
+
+			fuse_reply_err (req, ino == FuseRootInode ? EISDIR : ENOENT);
+		}
+		catch (...)
+		{
+			fuse_reply_err (req, fuse_ll_error_code());
+		}
+	}
+
+	static void fuse_ll_flush (fuse_req_t req, fuse_ino_t ino, struct fuse_file_info *fi)
+	{
+		try
+		{
+			if (!fuse_ll_check_access_rights (req))
+			{
+				fuse_reply_err (req, EACCES);
+				return;
+			}
+
+			// Buffered writes are completed when the volume image is closed, so that errors are reported by close()
+			if (ino == FuseVolumeImageInode)
+				FuseService::FlushVolume (false);
+
+			fuse_reply_err (req, 0);
+		}
+		catch (...)
+		{
+			fuse_reply_err (req, fuse_ll_error_code());
+		}
+	}
+
+	static void fuse_ll_fsync (fuse_req_t req, fuse_ino_t ino, int datasync, struct fuse_file_info *fi)
+	{
+		try
+		{
+			if (!fuse_ll_check_access_rights (req))
+			{
+				fuse_reply_err (req, EACCES);
+				return;
+			}
+
+			if (ino == FuseVolumeImageInode)
+				FuseService::FlushVolume (true);
+
+			fuse_reply_err (req, 0);
+		}
+		catch (...)
+		{
+			fuse_reply_err (req, fuse_ll_error_code());
+		}
+	}
+
+	static void fuse_ll_release (fuse_req_t req, fuse_ino_t ino, struct fuse_file_info *fi)
+	{
+		fuse_reply_err (req, 0);
+	}
+
+	static void fuse_ll_opendir (fuse_req_t req, fuse_ino_t ino, struct fuse_file_info *fi)
+	{
+		if (!fuse_ll_check_access_rights (req))
+			fuse_reply_err (req, EACCES);
+		else if (ino != FuseRootInode)
+			fuse_reply_err (req, ENOTDIR);
+		else
+			fuse_reply_open (req, fi);
+	}
+
+	static void fuse_ll_readdir (fuse_req_t req, fuse_ino_t ino, size_t size, off_t offset, struct fuse_file_info *fi)
+	{
+		try
+		{
+			if (ino != FuseRootInode)
+			{
+				fuse_reply_err (req, ENOTDIR);
+				return;
+			}
+
+			struct DirEntry
+			{
+				const char *Name;
+				fuse_ino_t Inode;
+				mode_t Mode;
+			};
+
+			const DirEntry entries[] =
+			{
+				{ ".", FuseRootInode, S_IFDIR },
+				{ "..", FuseRootInode, S_IFDIR },
+				{ FuseService::GetVolumeImagePath() + 1, FuseVolumeImageInode, S_IFREG },
+				{ FuseService::GetControlPath() + 1, FuseControlInode, S_IFREG }
+			};
+
+			const size_t entryCount = array_capacity (entries);
+
+			// The offset of an entry is the index of the next one
+			vector <char> buffer (size);
+			size_t bufferSize = 0;
+
+			for (size_t i = (size_t) offset; i < entryCount; ++i)
+			{
+				struct stat statData;
+				Memory::Zero (&statData, sizeof (statData));
+				statData.st_ino = entries[i].Inode;
+				statData.st_mode = entries[i].Mode;
+
+				size_t entrySize = fuse_add_direntry (req, &buffer[0] + bufferSize, size - bufferSize, entries[i].Name, &statData, i + 1);
+				if (entrySize > size - bufferSize)
+					break;
+
+				bufferSize += entrySize;
+			}
+
+			fuse_reply_buf (req, bufferSize > 0 ? &buffer[0] : nullptr, bufferSize);
+		}
+		catch (...)
+		{
+			fuse_reply_err (req, fuse_ll_error_code());
+		}
+	}
+
+	static void fuse_ll_releasedir (fuse_req_t req, fuse_ino_t ino, struct fuse_file_info *fi)
+	{
+		fuse_reply_err (req, 0);
+	}
+
+	static void fuse_ll_fsyncdir (fuse_req_t req, fuse_ino_t ino, int datasync, struct fuse_file_info *fi)
+	{
+		fuse_reply_err (req, ino == FuseRootInode ? 0 : ENOTDIR);
+	}
+
+#ifdef TC_LINUX
+	static void fuse_ll_fallocate (fuse_req_t req, fuse_ino_t ino, int mode, off_t offset, off_t length, struct fuse_file_info *fi)
+	{
+		try
+		{
+			if (!fuse_ll_check_access_rights (req))
+			{
+				fuse_reply_err (req, EACCES);
+				return;
+			}
+
+			// Only deallocation is supported, which the loop device requests for discarded data
+			if (ino != FuseVolumeImageInode
+				|| mode != (FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE)
+				|| !FuseService::IsDiscardEnabled())
+			{
+				fuse_reply_err (req, EOPNOTSUPP);
+				return;
+			}
+
+			FuseService::DiscardVolumeSectors (offset, length);
+			fuse_reply_err (req, 0);
+		}
+		catch (...)
+		{
+			fuse_reply_err (req, fuse_ll_error_code());
+		}
+	}
+#endif
+
+	int FuseService::RunLowLevelSession (int argc, char *argv[])
+	{
+		static fuse_lowlevel_ops fuse_ll_oper;
+
+		fuse_ll_oper.access = fuse_ll_access;
+		fuse_ll_oper.destroy = fuse_ll_destroy;
+#ifdef TC_LINUX
+		fuse_ll_oper.fallocate = fuse_ll_fallocate;
+#endif
+		fuse_ll_oper.flush = fuse_ll_flush;
+		fuse_ll_oper.fsync = fuse_ll_fsync;
+		fuse_ll_oper.fsyncdir = fuse_ll_fsyncdir;
+		fuse_ll_oper.getattr = fuse_ll_getattr;
+		fuse_ll_oper.init = fuse_ll_init;
+		fuse_ll_oper.lookup = fuse_ll_lookup;
+		fuse_ll_oper.open = fuse_ll_open;
+		fuse_ll_oper.opendir = fuse_ll_opendir;
+		fuse_ll_oper.read = fuse_ll_read;
+		fuse_ll_oper.readdir = fuse_ll_readdir;
+		fuse_ll_oper.release = fuse_ll_release;
+		fuse_ll_oper.releasedir = fuse_ll_releasedir;
+		fuse_ll_oper.write = fuse_ll_write;
+
+		struct fuse_args args = FUSE_ARGS_INIT (argc, argv);
+		finally_do_arg (struct fuse_args *, &args, { fuse_opt_free_args (finally_arg); });
+
+		struct fuse_cmdline_opts options;
+		Memory::Zero (&options, sizeof (options));
+
+		if (fuse_parse_cmdline (&args, &options) != 0 || !options.mountpoint)
+			return 1;
+
+		finally_do_arg (char *, options.mountpoint, { free (finally_arg); });
+
+		struct fuse_session *session = fuse_session_new (&args, &fuse_ll_oper, sizeof (fuse_ll_oper), nullptr);
+		if (!session)
+			return 1;
+
+		// Termination signals are handled by the signal handler process, and the session ends when the file system is unmounted
+		finally_do_arg (struct fuse_session *, session, { fuse_session_destroy (finally_arg); });
+
+		if (fuse_session_mount (session, options.mountpoint) != 0)
+			return 1;
+
+		finally_do_arg (struct fuse_session *, session, { fuse_session_unmount (finally_arg); });
+
+		// Threads are started by the session loop and by the init handler, after the process has been daemonized
+		if (fuse_daemonize (options.foreground) != 0)
+			return 1;
+
+		struct fuse_loop_config loopConfig;
+		Memory::Zero (&loopConfig, sizeof (loopConfig));
+		loopConfig.clone_fd = 1;
+		loopConfig.max_idle_threads = FuseMaxIdleThreads;
+
+		return fuse_session_loop_mt (session, &loopConfig) == 0 ? 0 : 1;
+	}
+}
@@ -10,15 +10,23 @@
  code distribution packages.
 */
 
-#ifdef TC_OPENBSD
+#ifndef VC_FUSE3
+#if defined (TC_LINUX)
+// fallocate() of the volume image, which carries discards, requires the API of libfuse 2.9
+#define FUSE_USE_VERSION  29
+#elif defined (TC_OPENBSD)
 #define FUSE_USE_VERSION  26
 #else
 #define FUSE_USE_VERSION  25
 #endif
+#endif
 
+#include <ctype.h>
 #include <errno.h>
 #include <fcntl.h>
+#ifndef VC_FUSE3
 #include <fuse.h>
+#endif
 #include <iostream>
 #include <signal.h>
 #include <string.h>
@@ -30,10 +38,13 @@
 #include <sys/wait.h>
 
 #include "FuseService.h"
+#include "NbdServer.h"
 #include "Platform/FileStream.h"
 #include "Platform/MemoryStream.h"
+#include "Platform/SecureBufferPool.h"
 #include "Platform/Serializable.h"
 #include "Platform/SystemLog.h"
+#include "Platform/Trace.h"
 #include "Platform/Unix/Pipe.h"
 #include "Platform/Unix/Poller.h"
 #include "Volume/EncryptionThreadPool.h"
@@ -41,6 +52,7 @@
 
 namespace VeraCrypt
 {
+#ifndef VC_FUSE3
 	static int fuse_service_access (const char *path, int mask)
 	{
 		try
@@ -56,7 +68,7 @@ namespace VeraCrypt
 		return 0;
 	}
 
-#ifdef TC_OPENBSD
+#if FUSE_USE_VERSION >= 26
 	static void *fuse_service_init (struct fuse_conn_info *)
 #else
 	static void *fuse_service_init ()
@@ -64,17 +76,7 @@ namespace VeraCrypt
 	{
 		try
 		{
-			// Termination signals are handled by a separate process to allow clean dismount on shutdown
-			struct sigaction action;
-			Memory::Zero (&action, sizeof (action));
-			action.sa_handler = SIG_IGN;
-
-			sigaction (SIGINT, &action, nullptr);
-			sigaction (SIGQUIT, &action, nullptr);
-			sigaction (SIGTERM, &action, nullptr);
-
-			if (!EncryptionThreadPool::IsRunning())
-				EncryptionThreadPool::Start();
+			FuseService::Initialize();
 		}
 		catch (exception &e)
 		{
@@ -104,6 +106,91 @@ namespace VeraCrypt
 		}
 	}
 
+#ifdef TC_LINUX
+	static int fuse_service_fallocate (const char *path, int mode, off_t offset, off_t length, struct fuse_file_info *fi)
+	{
+		try
+		{
+			if (!FuseService::CheckAccessRights())
+				return -EACCES;
+
+			if (strcmp (path, FuseService::GetVolumeImagePath()) == 0)
+			{
+				// Only deallocation is supported, which the loop device requests for discarded data
+				if (mode != (FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE) || !FuseService::IsDiscardEnabled())
+					return -EOPNOTSUPP;
+
+				FuseService::DiscardVolumeSectors (offset, length);
+				return 0;
+			}
+
+			if (strcmp (path, FuseService::GetControlPath()) == 0)
+				return -EOPNOTSUPP;
+		}
+		catch (...)
+		{
+			return FuseService::ExceptionToErrorCode();
+		}
+
+		return -ENOENT;
+	}
+#endif
+
+	static int fuse_service_flush (const char *path, struct fuse_file_info *fi)
+	{
+		try
+		{
+			if (!FuseService::CheckAccessRights())
+				return -EACCES;
+
+			// Buffered writes are completed when the volume image is closed, so that errors are reported by close()
+			if (strcmp (path, FuseService::GetVolumeImagePath()) == 0)
+				FuseService::FlushVolume (false);
+		}
+		catch (...)
+		{
+			return FuseService::ExceptionToErrorCode();
+		}
+
+		return 0;
+	}
+
+	static int fuse_service_fsync (const char *path, int datasync, struct fuse_file_info *fi)
+	{
+		try
+		{
+			if (!FuseService::CheckAccessRights())
+				return -EACCES;
+
+			if (strcmp (path, FuseService::GetVolumeImagePath()) == 0)
+				FuseService::FlushVolume (true);
+		}
+		catch (...)
+		{
+			return FuseService::ExceptionToErrorCode();
+		}
+
+		return 0;
+	}
+
+	static int fuse_service_fsyncdir (const char *path, int datasync, struct fuse_file_info *fi)
+	{
+		try
+		{
+			if (!FuseService::CheckAccessRights())
+				return -EACCES;
+
+			if (strcmp (path, "/") != 0)
+				return -ENOENT;
+		}
+		catch (...)
+		{
+			return FuseService::ExceptionToErrorCode();
+		}
+
+		return 0;
+	}
+
 	static int fuse_service_getattr (const char *path, struct stat *statData)
 	{
 		try
@@ -220,7 +307,7 @@ namespace VeraCrypt
 						if (alignedSize % sectorSize != 0)
 							alignedSize += sectorSize - (alignedSize % sectorSize);
 
-						SecureBuffer alignedBuffer (alignedSize);
+						PooledSecureBuffer alignedBuffer (alignedSize);
 
 						FuseService::ReadVolumeSectors (alignedBuffer, alignedOffset);
 						BufferPtr ((uint8 *) buf, size).CopyFrom (alignedBuffer.GetRange (offset % sectorSize, size));
@@ -300,9 +387,10 @@ namespace VeraCrypt
 			if (strcmp (path, FuseService::GetControlPath()) == 0)
 			{
 				if (FuseService::AuxDeviceInfoReceived())
-					return -EACCES;
+					FuseService::ReceiveControlCommand (ConstBufferPtr ((const uint8 *)buf, size));
+				else
+					FuseService::ReceiveAuxDeviceInfo (ConstBufferPtr ((const uint8 *)buf, size));
 
-				FuseService::ReceiveAuxDeviceInfo (ConstBufferPtr ((const uint8 *)buf, size));
 				return size;
 			}
 		}
@@ -327,7 +415,13 @@ namespace VeraCrypt
 
 	bool FuseService::CheckAccessRights ()
 	{
-		return fuse_get_context()->uid == 0 || fuse_get_context()->uid == UserId;
+		return CheckAccessRights (fuse_get_context()->uid);
+	}
+#endif // !VC_FUSE3
+
+	bool FuseService::CheckAccessRights (uid_t uid)
+	{
+		return uid == 0 || uid == UserId;
 	}
 
 	void FuseService::CloseMountedVolume ()
@@ -345,14 +439,142 @@ namespace VeraCrypt
 		}
 	}
 
+	void FuseService::ConfigureVolumeIo ()
+	{
+		// Called after the FUSE session has daemonized the process, as background threads and I/O rings would not survive the fork
+		if (Discard)
+			MountedVolume->EnableDiscard();
+
+		if (DirectIo)
+		{
+			try
+			{
+				MountedVolume->EnableDirectIo();
+			}
+			catch (exception &e)
+			{
+				SystemLog::WriteException (e);
+			}
+		}
+
+		if (AsyncIoQueueDepth > 0)
+		{
+			try
+			{
+				uint32 queueDepth = AsyncIoQueueDepth;
+				if (queueDepth > AsyncFile::MaxQueueDepth)
+					queueDepth = AsyncFile::MaxQueueDepth;
+
+				MountedVolume->EnableAsyncIo (queueDepth);
+			}
+			catch (exception &e)
+			{
+				SystemLog::WriteException (e);
+			}
+		}
+
+		if (ReadAheadSize > 0)
+		{
+			try
+			{
+				uint64 readAheadSize = ReadAheadSize;
+				if (readAheadSize > VolumeReadAhead::MaxSize)
+					readAheadSize = VolumeReadAhead::MaxSize;
+
+				MountedVolume->EnableReadAhead ((size_t) readAheadSize);
+			}
+			catch (exception &e)
+			{
+				SystemLog::WriteException (e);
+			}
+		}
+
+		if (WriteBufferSize > 0)
+		{
+			try
+			{
+				uint64 bufferSize = WriteBufferSize;
+				if (bufferSize > VolumeWriteBuffer::MaxSize)
+					bufferSize = VolumeWriteBuffer::MaxSize;
+
+				MountedVolume->EnableWriteBuffer ((size_t) bufferSize);
+			}
+			catch (exception &e)
+			{
+				SystemLog::WriteException (e);
+			}
+		}
+
+		if (SectorCacheSize > 0)
+		{
+			try
+			{
+				uint64 cacheSize = SectorCacheSize;
+				if (cacheSize > VolumeSectorCache::MaxSize)
+					cacheSize = VolumeSectorCache::MaxSize;
+
+				MountedVolume->EnableSectorCache ((size_t) cacheSize);
+			}
+			catch (exception &e)
+			{
+				SystemLog::WriteException (e);
+			}
+		}
+	}
+
+	void FuseService::DiscardVolumeSectors (uint64 byteOffset, uint64 length)
+	{
+		if (!MountedVolume)
+			throw NotInitialized (SRC_POS);
+
+		trace_event_scope ("FuseService::DiscardVolumeSectors", length);
+		MountedVolume->DiscardSectors (byteOffset, length);
+	}
+
 	void FuseService::Dismount ()
 	{
+		VolumeNbdServer.reset();
+
+		if (MountedVolume)
+		{
+			// Pending writes would be discarded when the volume is closed
+			try
+			{
+				MountedVolume->FlushWriteBuffer();
+			}
+			catch (exception &e)
+			{
+				SystemLog::WriteException (e);
+			}
+		}
+
 		CloseMountedVolume();
 
 		if (EncryptionThreadPool::IsRunning())
 			EncryptionThreadPool::Stop();
 	}
 
+	void FuseService::DumpTrace ()
+	{
+#ifdef TC_TRACE
+		ScopeLock lock (TraceDumpMutex);
+		string path = TracePath + "." + StringConverter::ToSingle (++TraceDumpCount) + ".json";
+
+		// The service may run as root, while the trace is written to a directory writable by other users
+		int fd = open (path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, S_IRUSR | S_IWUSR);
+		throw_sys_sub_if (fd == -1, path);
+
+		File traceFile;
+		traceFile.AssignSystemHandle (fd, false);
+
+		if (fchown (fd, UserId, GroupId) == -1) { } // Errors ignored
+
+		Trace::WriteJson (traceFile);
+#else
+		throw NotApplicable (SRC_POS);
+#endif
+	}
+
 	int FuseService::ExceptionToErrorCode ()
 	{
 		try
@@ -393,6 +615,19 @@ namespace VeraCrypt
 		}
 	}
 
+	void FuseService::FlushVolume (bool flushHostFile)
+	{
+		if (!MountedVolume)
+			throw NotInitialized (SRC_POS);
+
+		trace_event_scope ("FuseService::FlushVolume", flushHostFile);
+
+		if (flushHostFile)
+			MountedVolume->Flush();
+		else
+			MountedVolume->FlushWriteBuffer();
+	}
+
 	shared_ptr <Buffer> FuseService::GetVolumeInfo ()
 	{
 		shared_ptr <Stream> stream (new MemoryStream);
@@ -430,7 +665,80 @@ namespace VeraCrypt
 		return MountedVolume->GetSize();
 	}
 
-	void FuseService::Mount (shared_ptr <Volume> openVolume, VolumeSlotNumber slotNumber, const string &fuseMountPoint)
+	void FuseService::Initialize ()
+	{
+		// Termination signals are handled by a separate process to allow clean dismount on shutdown
+		struct sigaction action;
+		Memory::Zero (&action, sizeof (action));
+		action.sa_handler = SIG_IGN;
+
+		sigaction (SIGINT, &action, nullptr);
+		sigaction (SIGQUIT, &action, nullptr);
+		sigaction (SIGTERM, &action, nullptr);
+
+		if (!EncryptionThreadPool::IsRunning())
+			EncryptionThreadPool::Start (PinEncryptionThreads);
+
+		ConfigureVolumeIo();
+
+#ifdef TC_TRACE
+		// The trace is written by a thread, which is woken by the signal handler through a pipe
+		int traceSignalPipe[2];
+		if (pipe (traceSignalPipe) != -1)
+		{
+			struct TraceDumpThreadFunctor : public Functor
+			{
+				TraceDumpThreadFunctor (int readFD) : ReadFD (readFD) { }
+
+				virtual void operator() ()
+				{
+					uint8 buf[1];
+					while (read (ReadFD, buf, sizeof (buf)) == 1)
+					{
+						try
+						{
+							DumpTrace();
+						}
+						catch (exception &e)
+						{
+							SystemLog::WriteException (e);
+						}
+					}
+				}
+
+				int ReadFD;
+			};
+
+			TraceSignalFD = traceSignalPipe[1];
+
+			Thread traceDumpThread;
+			traceDumpThread.Start (new TraceDumpThreadFunctor (traceSignalPipe[0]));
+
+			struct sigaction action;
+			Memory::Zero (&action, sizeof (action));
+			action.sa_handler = OnTraceSignal;
+			action.sa_flags = SA_RESTART;
+
+			sigaction (SIGUSR2, &action, nullptr);
+		}
+#endif
+
+#ifdef TC_LINUX
+		if (!NbdSocketPath.empty())
+		{
+			try
+			{
+				VolumeNbdServer.reset (new NbdServer (MountedVolume, NbdSocketPath, UserId));
+			}
+			catch (exception &e)
+			{
+				SystemLog::WriteException (e);
+			}
+		}
+#endif
+	}
+
+	void FuseService::Mount (shared_ptr <Volume> openVolume, const MountOptions &options, const string &fuseMountPoint)
 	{
 		list <string> args;
 		args.push_back (FuseService::GetDeviceType());
@@ -449,7 +757,7 @@ namespace VeraCrypt
 			args.push_back ("allow_other");
 		}
 
-		ExecFunctor execFunctor (openVolume, slotNumber);
+		ExecFunctor execFunctor (openVolume, options, options.Nbd ? GetNbdSocketPath (fuseMountPoint) : string(), GetTracePath (fuseMountPoint));
 		Process::Execute ("fuse", args, -1, &execFunctor);
 
 		for (int t = 0; true; t++)
@@ -474,6 +782,7 @@ namespace VeraCrypt
 		if (!MountedVolume)
 			throw NotInitialized (SRC_POS);
 
+		trace_event_scope ("FuseService::ReadVolumeSectors", buffer.Size());
 		MountedVolume->ReadSectors (buffer, byteOffset);
 	}
 
@@ -487,6 +796,20 @@ namespace VeraCrypt
 		OpenVolumeInfo.LoopDevice = sr.DeserializeString ("LoopDevice");
 	}
 
+	void FuseService::ReceiveControlCommand (const ConstBufferPtr &buffer)
+	{
+		// Commands are written to the control file as text once the device information has been received
+		// (e.g. echo trace >> control), as the control file cannot be truncated
+		string command ((const char *) buffer.Get(), buffer.Size());
+		while (!command.empty() && isspace ((unsigned char) command[command.size() - 1]))
+			command.erase (command.size() - 1);
+
+		if (command == "trace")
+			DumpTrace();
+		else
+			throw ParameterIncorrect (SRC_POS);
+	}
+
 	void FuseService::SendAuxDeviceInfo (const DirectoryPath &fuseMountPoint, const DevicePath &virtualDevice, const DevicePath &loopDevice)
 	{
 		File fuseServiceControl;
@@ -505,6 +828,7 @@ namespace VeraCrypt
 		if (!MountedVolume)
 			throw NotInitialized (SRC_POS);
 
+		trace_event_scope ("FuseService::WriteVolumeSectors", buffer.Size());
 		MountedVolume->WriteSectors (buffer, byteOffset);
 	}
 
@@ -522,6 +846,11 @@ namespace VeraCrypt
 		_exit (0);
 	}
 
+	void FuseService::OnTraceSignal (int signal)
+	{
+		if (TraceSignalFD != -1 && write (TraceSignalFD, "", 1)) { } // Errors ignored
+	}
+
 	void FuseService::ExecFunctor::operator() (int argc, char *argv[])
 	{
 		struct timeval tv;
@@ -530,6 +859,15 @@ namespace VeraCrypt
 
 		FuseService::MountedVolume = MountedVolume;
 		FuseService::SlotNumber = SlotNumber;
+		FuseService::AsyncIoQueueDepth = AsyncIoQueueDepth;
+		FuseService::DirectIo = DirectIo;
+		FuseService::Discard = Discard;
+		FuseService::NbdSocketPath = NbdSocketPath;
+		FuseService::PinEncryptionThreads = PinEncryptionThreads;
+		FuseService::ReadAheadSize = ReadAheadSize;
+		FuseService::SectorCacheSize = SectorCacheSize;
+		FuseService::TracePath = TracePath;
+		FuseService::WriteBufferSize = WriteBufferSize;
 
 		FuseService::UserId = getuid();
 		FuseService::GroupId = getgid();
@@ -550,10 +888,17 @@ namespace VeraCrypt
 			catch (...) { }
 		}
 
+#ifndef VC_FUSE3
 		static fuse_operations fuse_service_oper;
 
 		fuse_service_oper.access = fuse_service_access;
 		fuse_service_oper.destroy = fuse_service_destroy;
+#ifdef TC_LINUX
+		fuse_service_oper.fallocate = fuse_service_fallocate;
+#endif
+		fuse_service_oper.flush = fuse_service_flush;
+		fuse_service_oper.fsync = fuse_service_fsync;
+		fuse_service_oper.fsyncdir = fuse_service_fsyncdir;
 		fuse_service_oper.getattr = fuse_service_getattr;
 		fuse_service_oper.init = fuse_service_init;
 		fuse_service_oper.open = fuse_service_open;
@@ -561,6 +906,7 @@ namespace VeraCrypt
 		fuse_service_oper.read = fuse_service_read;
 		fuse_service_oper.readdir = fuse_service_readdir;
 		fuse_service_oper.write = fuse_service_write;
+#endif
 
 		// Create a new session
 		setsid ();
@@ -592,7 +938,9 @@ namespace VeraCrypt
 
 		SignalHandlerPipe->GetWriteFD();
 
-#ifdef TC_OPENBSD
+#if defined (VC_FUSE3)
+		_exit (RunLowLevelSession (argc, argv));
+#elif FUSE_USE_VERSION >= 26
 		_exit (fuse_main (argc, argv, &fuse_service_oper, NULL));
 #else
 		_exit (fuse_main (argc, argv, &fuse_service_oper));
@@ -602,7 +950,20 @@ namespace VeraCrypt
 	VolumeInfo FuseService::OpenVolumeInfo;
 	Mutex FuseService::OpenVolumeInfoMutex;
 	shared_ptr <Volume> FuseService::MountedVolume;
+	uint32 FuseService::AsyncIoQueueDepth;
+	bool FuseService::DirectIo;
+	bool FuseService::Discard;
+	string FuseService::NbdSocketPath;
+	unique_ptr <NbdServer> FuseService::VolumeNbdServer;
+	bool FuseService::PinEncryptionThreads;
+	uint64 FuseService::ReadAheadSize;
+	uint64 FuseService::SectorCacheSize;
 	VolumeSlotNumber FuseService::SlotNumber;
+	string FuseService::TracePath;
+	uint32 FuseService::TraceDumpCount = 0;
+	Mutex FuseService::TraceDumpMutex;
+	int FuseService::TraceSignalFD = -1;
+	uint64 FuseService::WriteBufferSize;
 	uid_t FuseService::UserId;
 	gid_t FuseService::GroupId;
 	unique_ptr <Pipe> FuseService::SignalHandlerPipe;
@@ -16,11 +16,13 @@
 #include "Platform/Platform.h"
 #include "Platform/Unix/Pipe.h"
 #include "Platform/Unix/Process.h"
+#include "Core/MountOptions.h"
 #include "Volume/VolumeInfo.h"
 #include "Volume/Volume.h"
 
 namespace VeraCrypt
 {
+	class NbdServer;
 
 	class FuseService
 	{
@@ -28,15 +30,24 @@ namespace VeraCrypt
 		class ExecFunctor : public ProcessExecFunctor
 		{
 		public:
-			ExecFunctor (shared_ptr <Volume> openVolume, VolumeSlotNumber slotNumber)
-				: MountedVolume (openVolume), SlotNumber (slotNumber)
+			ExecFunctor (shared_ptr <Volume> openVolume, const MountOptions &options, const string &nbdSocketPath, const string &tracePath)
+				: MountedVolume (openVolume), AsyncIoQueueDepth (options.AsyncIoQueueDepth), DirectIo (options.DirectIo), Discard (options.Discard), NbdSocketPath (nbdSocketPath), PinEncryptionThreads (options.PinEncryptionThreads), ReadAheadSize (options.ReadAheadSize), SectorCacheSize (options.SectorCacheSize), SlotNumber (options.SlotNumber), TracePath (tracePath), WriteBufferSize (options.WriteBufferSize)
 			{
 			}
 			virtual void operator() (int argc, char *argv[]);
 
 		protected:
 			shared_ptr <Volume> MountedVolume;
+			uint32 AsyncIoQueueDepth;
+			bool DirectIo;
+			bool Discard;
+			string NbdSocketPath;
+			bool PinEncryptionThreads;
+			uint64 ReadAheadSize;
+			uint64 SectorCacheSize;
 			VolumeSlotNumber SlotNumber;
+			string TracePath;
+			uint64 WriteBufferSize;
 		};
 
 		friend class ExecFunctor;
@@ -44,19 +55,29 @@ namespace VeraCrypt
 	public:
 		static bool AuxDeviceInfoReceived () { return !OpenVolumeInfo.VirtualDevice.IsEmpty(); }
 		static bool CheckAccessRights ();
+		static bool CheckAccessRights (uid_t uid);
+		static void ConfigureVolumeIo ();
+		static void DiscardVolumeSectors (uint64 byteOffset, uint64 length);
 		static void Dismount ();
+		static void DumpTrace ();
 		static int ExceptionToErrorCode ();
+		static void FlushVolume (bool flushHostFile);
 		static const char *GetControlPath () { return "/control"; }
 		static const char *GetVolumeImagePath ();
 		static string GetDeviceType () { return "veracrypt"; }
 		static uid_t GetGroupId () { return GroupId; }
+		static string GetNbdSocketPath (const DirectoryPath &fuseMountPoint) { return string (fuseMountPoint) + ".nbd"; }
+		static string GetTracePath (const DirectoryPath &fuseMountPoint) { return string (fuseMountPoint) + ".trace"; }
 		static uid_t GetUserId () { return UserId; }
 		static shared_ptr <Buffer> GetVolumeInfo ();
 		static uint64 GetVolumeSize ();
+		static void Initialize ();
+		static bool IsDiscardEnabled () { return MountedVolume && MountedVolume->IsDiscardEnabled(); }
 		static uint64 GetVolumeSectorSize () { return MountedVolume->GetSectorSize(); }
-		static void Mount (shared_ptr <Volume> openVolume, VolumeSlotNumber slotNumber, const string &fuseMountPoint);
+		static void Mount (shared_ptr <Volume> openVolume, const MountOptions &options, const string &fuseMountPoint);
 		static void ReadVolumeSectors (const BufferPtr &buffer, uint64 byteOffset);
 		static void ReceiveAuxDeviceInfo (const ConstBufferPtr &buffer);
+		static void ReceiveControlCommand (const ConstBufferPtr &buffer);
 		static void SendAuxDeviceInfo (const DirectoryPath &fuseMountPoint, const DevicePath &virtualDevice, const DevicePath &loopDevice = DevicePath());
 		static void WriteVolumeSectors (const ConstBufferPtr &buffer, uint64 byteOffset);
 
@@ -64,11 +85,26 @@ namespace VeraCrypt
 		FuseService ();
 		static void CloseMountedVolume ();
 		static void OnSignal (int signal);
+		static void OnTraceSignal (int signal);
+		static int RunLowLevelSession (int argc, char *argv[]);
 
 		static VolumeInfo OpenVolumeInfo;
 		static Mutex OpenVolumeInfoMutex;
 		static shared_ptr <Volume> MountedVolume;
+		static uint32 AsyncIoQueueDepth;
+		static bool DirectIo;
+		static bool Discard;
+		static string NbdSocketPath;
+		static unique_ptr <NbdServer> VolumeNbdServer;
+		static bool PinEncryptionThreads;
+		static uint64 ReadAheadSize;
+		static uint64 SectorCacheSize;
 		static VolumeSlotNumber SlotNumber;
+		static string TracePath;
+		static uint32 TraceDumpCount;
+		static Mutex TraceDumpMutex;
+		static int TraceSignalFD;
+		static uint64 WriteBufferSize;
 		static uid_t UserId;
 		static gid_t GroupId;
 		static unique_ptr <Pipe> SignalHandlerPipe;
@@ -0,0 +1,651 @@
+/*
+ Derived from source code of TrueCrypt 7.1a, which is
+ Copyright (c) 2008-2012 TrueCrypt Developers Association and which is governed
+ by the TrueCrypt License 3.0.
+
+ Modifications and additions to the original source code (contained in this file)
+ and all other portions of this file are Copyright (c) 2013-2025 IDRIX
+ and are governed by the Apache License 2.0 the full text of which is
+ contained in the file License.txt included in VeraCrypt binary and source
+ code distribution packages.
+*/
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "NbdServer.h"
+#include "Platform/Finally.h"
+#include "Platform/SecureBufferPool.h"
+#include "Platform/SystemLog.h"
+#include "Platform/Trace.h"
+
+namespace VeraCrypt
+{
+	// Protocol constants as defined by the NBD protocol specification
+	static const uint64 NbdMagic = 0x4e42444d41474943ULL;				// "NBDMAGIC"
+	static const uint64 NbdOptionMagic = 0x49484156454f5054ULL;			// "IHAVEOPT"
+	static const uint64 NbdOptionReplyMagic = 0x0003e889045565a9ULL;
+	static const uint32 NbdRequestMagic = 0x25609513;
+	static const uint32 NbdSimpleReplyMagic = 0x67446698;
+
+	static const uint16 NbdFlagFixedNewstyle = 1 << 0;
+	static const uint16 NbdFlagNoZeroes = 1 << 1;
+
+	static const uint16 NbdFlagHasFlags = 1 << 0;
+	static const uint16 NbdFlagReadOnly = 1 << 1;
+	static const uint16 NbdFlagSendFlush = 1 << 2;
+	static const uint16 NbdFlagSendFua = 1 << 3;
+	static const uint16 NbdFlagSendTrim = 1 << 5;
+	static const uint16 NbdFlagCanMultiConn = 1 << 8;
+
+	static const uint32 NbdOptExportName = 1;
+	static const uint32 NbdOptAbort = 2;
+	static const uint32 NbdOptList = 3;
+	static const uint32 NbdOptInfo = 6;
+	static const uint32 NbdOptGo = 7;
+
+	static const uint32 NbdRepAck = 1;
+	static const uint32 NbdRepServer = 2;
+	static const uint32 NbdRepInfo = 3;
+	static const uint32 NbdRepErrUnsup = 0x80000001;
+	static const uint32 NbdRepErrInvalid = 0x80000003;
+
+	static const uint16 NbdInfoExport = 0;
+	static const uint16 NbdInfoBlockSize = 3;
+
+	static const uint16 NbdCmdRead = 0;
+	static const uint16 NbdCmdWrite = 1;
+	static const uint16 NbdCmdDisc = 2;
+	static const uint16 NbdCmdFlush = 3;
+	static const uint16 NbdCmdTrim = 4;
+
+	static const uint16 NbdCmdFlagFua = 1 << 0;
+
+	static const uint32 NbdErrorPermission = 1;
+	static const uint32 NbdErrorIo = 5;
+	static const uint32 NbdErrorNoMemory = 12;
+	static const uint32 NbdErrorInvalid = 22;
+	static const uint32 NbdErrorNoSpace = 28;
+
+	static const uint32 NbdMaxOptionLength = 4096;
+
+	static uint16 GetUInt16 (const uint8 *data) { uint16 v; memcpy (&v, data, sizeof (v)); return Endian::Big (v); }
+	static uint32 GetUInt32 (const uint8 *data) { uint32 v; memcpy (&v, data, sizeof (v)); return Endian::Big (v); }
+	static uint64 GetUInt64 (const uint8 *data) { uint64 v; memcpy (&v, data, sizeof (v)); return Endian::Big (v); }
+
+	static void PutUInt16 (uint8 *data, uint16 v) { v = Endian::Big (v); memcpy (data, &v, sizeof (v)); }
+	static void PutUInt32 (uint8 *data, uint32 v) { v = Endian::Big (v); memcpy (data, &v, sizeof (v)); }
+	static void PutUInt64 (uint8 *data, uint64 v) { v = Endian::Big (v); memcpy (data, &v, sizeof (v)); }
+
+	NbdServer::NbdServer (shared_ptr <Volume> volume, const string &socketPath, uid_t userId)
+		: MountedVolume (volume), SocketPath (socketPath), UserId (userId), ListenSocket (-1), Stopping (false)
+	{
+		struct sockaddr_un address;
+		Memory::Zero (&address, sizeof (address));
+		address.sun_family = AF_UNIX;
+
+		if (socketPath.empty() || socketPath.size() >= sizeof (address.sun_path))
+			throw ParameterIncorrect (SRC_POS);
+
+		strcpy (address.sun_path, socketPath.c_str());
+
+		ListenSocket = socket (AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+		throw_sys_if (ListenSocket == -1);
+
+		try
+		{
+			// A socket left by a process which did not exit cleanly would prevent binding
+			unlink (socketPath.c_str());
+
+			mode_t mask = umask (S_IRWXG | S_IRWXO);
+			int r = bind (ListenSocket, (struct sockaddr *) &address, sizeof (address));
+			umask (mask);
+
+			throw_sys_sub_if (r == -1, socketPath);
+			throw_sys_sub_if (listen (ListenSocket, (int) MaxConnections) == -1, socketPath);
+
+			struct AcceptThreadFunctor : public Functor
+			{
+				AcceptThreadFunctor (NbdServer *server) : Server (server) { }
+
+				virtual void operator() ()
+				{
+					Server->AcceptThreadProc();
+				}
+
+				NbdServer *Server;
+			};
+
+			AcceptThread.reset (new Thread);
+			AcceptThread->Start (new AcceptThreadFunctor (this));
+		}
+		catch (...)
+		{
+			close (ListenSocket);
+			unlink (socketPath.c_str());
+			throw;
+		}
+	}
+
+	NbdServer::~NbdServer ()
+	{
+		Stopping = true;
+
+		// Shutting down the listening socket makes accept() fail
+		shutdown (ListenSocket, SHUT_RDWR);
+		AcceptThread->Join();
+
+		close (ListenSocket);
+		unlink (SocketPath.c_str());
+
+		ReapConnections (true);
+	}
+
+	void NbdServer::AcceptThreadProc ()
+	{
+		while (!Stopping)
+		{
+			int socket = accept4 (ListenSocket, nullptr, nullptr, SOCK_CLOEXEC);
+
+			if (socket == -1)
+			{
+				if (Stopping)
+					break;
+
+				if (errno != EINTR && errno != ECONNABORTED)
+				{
+					SystemLog::WriteException (SystemException (SRC_POS));
+					Thread::Sleep (100);
+				}
+				continue;
+			}
+
+			ReapConnections (false);
+
+			ScopeLock lock (ConnectionsMutex);
+
+			if (Connections.size() >= MaxConnections)
+			{
+				close (socket);
+				continue;
+			}
+
+			struct ConnectionFunctor : public Functor
+			{
+				ConnectionFunctor (NbdServer *server, Connection *connection) : Server (server), ServedConnection (connection) { }
+
+				virtual void operator() ()
+				{
+					finally_do_arg (Connection *, ServedConnection, { finally_arg->Finished = true; });
+
+					// Errors terminate the connection, which the client reports to its user
+					try
+					{
+						Server->ServeConnection (ServedConnection->Socket);
+					}
+					catch (...) { }
+				}
+
+				NbdServer *Server;
+				Connection *ServedConnection;
+			};
+
+			shared_ptr <Connection> connection (new Connection (socket));
+
+			try
+			{
+				connection->ConnectionThread.reset (new Thread);
+				connection->ConnectionThread->Start (new ConnectionFunctor (this, connection.get()));
+			}
+			catch (exception &e)
+			{
+				SystemLog::WriteException (e);
+				close (socket);
+				continue;
+			}
+
+			Connections.push_back (connection);
+		}
+	}
+
+	bool NbdServer::CheckPeerCredentials (int socket) const
+	{
+		struct ucred credentials;
+		socklen_t credentialsSize = sizeof (credentials);
+
+		if (getsockopt (socket, SOL_SOCKET, SO_PEERCRED, &credentials, &credentialsSize) == -1)
+			return false;
+
+		return credentials.uid == 0 || credentials.uid == UserId;
+	}
+
+	uint32 NbdServer::ExceptionToNbdError ()
+	{
+		try
+		{
+			throw;
+		}
+		catch (std::bad_alloc&)
+		{
+			return NbdErrorNoMemory;
+		}
+		catch (ParameterIncorrect &e)
+		{
+			SystemLog::WriteException (e);
+			return NbdErrorInvalid;
+		}
+		catch (VolumeProtected&)
+		{
+			return NbdErrorPermission;
+		}
+		catch (VolumeReadOnly&)
+		{
+			return NbdErrorPermission;
+		}
+		catch (SystemException &e)
+		{
+			SystemLog::WriteException (e);
+			return e.GetErrorCode() == ENOSPC ? NbdErrorNoSpace : NbdErrorIo;
+		}
+		catch (std::exception &e)
+		{
+			SystemLog::WriteException (e);
+			return NbdErrorIo;
+		}
+		catch (...)
+		{
+			SystemLog::WriteException (UnknownException (SRC_POS));
+			return NbdErrorIo;
+		}
+	}
+
+	void NbdServer::ExecuteRequest (int socket, uint16 flags, uint16 type, uint64 handle, uint64 offset, uint32 length)
+	{
+		uint64 volumeSize = MountedVolume->GetSize();
+		uint64 sectorSize = MountedVolume->GetSectorSize();
+		bool outOfRange = offset > volumeSize || length > volumeSize - offset;
+
+		trace_event_scope ("NbdServer::ExecuteRequest", type);
+
+		switch (type)
+		{
+		case NbdCmdRead:
+			{
+				if (outOfRange || length > MaxRequestSize)
+				{
+					SendSimpleReply (socket, handle, NbdErrorInvalid);
+					return;
+				}
+
+				if (length == 0)
+				{
+					SendSimpleReply (socket, handle, 0);
+					return;
+				}
+
+				// Requests not aligned to sectors are served from the sectors which contain them
+				uint64 alignedOffset = offset - offset % sectorSize;
+				uint64 alignedEndOffset = offset + length;
+
+				if (alignedEndOffset % sectorSize != 0)
+					alignedEndOffset += sectorSize - alignedEndOffset % sectorSize;
+
+				PooledSecureBuffer buffer ((size_t) (alignedEndOffset - alignedOffset));
+
+				try
+				{
+					MountedVolume->ReadSectors (buffer, alignedOffset);
+				}
+				catch (...)
+				{
+					SendSimpleReply (socket, handle, ExceptionToNbdError());
+					return;
+				}
+
+				SendSimpleReply (socket, handle, 0, buffer.GetRange ((size_t) (offset - alignedOffset), length));
+			}
+			break;
+
+		case NbdCmdWrite:
+			{
+				// The data of a request which is too large cannot be skipped safely
+				if (length > MaxRequestSize)
+					throw ParameterTooLarge (SRC_POS);
+
+				if (length == 0)
+				{
+					SendSimpleReply (socket, handle, 0);
+					return;
+				}
+
+				PooledSecureBuffer buffer (length);
+				ReceiveData (socket, buffer, length);
+
+				if (outOfRange || offset % sectorSize != 0 || length % sectorSize != 0)
+				{
+					SendSimpleReply (socket, handle, NbdErrorInvalid);
+					return;
+				}
+
+				try
+				{
+					MountedVolume->WriteSectors (buffer, offset);
+
+					if (flags & NbdCmdFlagFua)
+						MountedVolume->Flush();
+				}
+				catch (...)
+				{
+					SendSimpleReply (socket, handle, ExceptionToNbdError());
+					return;
+				}
+
+				SendSimpleReply (socket, handle, 0);
+			}
+			break;
+
+		case NbdCmdFlush:
+			try
+			{
+				MountedVolume->Flush();
+			}
+			catch (...)
+			{
+				SendSimpleReply (socket, handle, ExceptionToNbdError());
+				return;
+			}
+
+			SendSimpleReply (socket, handle, 0);
+			break;
+
+		case NbdCmdTrim:
+			{
+				if (outOfRange || !MountedVolume->IsDiscardEnabled())
+				{
+					SendSimpleReply (socket, handle, NbdErrorInvalid);
+					return;
+				}
+
+				// Partial sectors at the ends of the range are kept, as trimming is advisory
+				uint64 startOffset = offset;
+				uint64 endOffset = offset + length - (offset + length) % sectorSize;
+
+				if (startOffset % sectorSize != 0)
+					startOffset += sectorSize - startOffset % sectorSize;
+
+				try
+				{
+					if (endOffset > startOffset)
+						MountedVolume->DiscardSectors (startOffset, endOffset - startOffset);
+
+					if (flags & NbdCmdFlagFua)
+						MountedVolume->Flush();
+				}
+				catch (...)
+				{
+					SendSimpleReply (socket, handle, ExceptionToNbdError());
+					return;
+				}
+
+				SendSimpleReply (socket, handle, 0);
+			}
+			break;
+
+		default:
+			SendSimpleReply (socket, handle, NbdErrorInvalid);
+			break;
+		}
+	}
+
+	uint16 NbdServer::GetTransmissionFlags () const
+	{
+		// A flush received on any connection covers writes completed on all connections, as they share the volume
+		uint16 flags = NbdFlagHasFlags | NbdFlagSendFlush | NbdFlagSendFua | NbdFlagCanMultiConn;
+
+		if (MountedVolume->GetProtectionType() == VolumeProtection::ReadOnly)
+			flags |= NbdFlagReadOnly;
+
+		if (MountedVolume->IsDiscardEnabled())
+			flags |= NbdFlagSendTrim;
+
+		return flags;
+	}
+
+	bool NbdServer::Negotiate (int socket)
+	{
+		uint8 greeting[18];
+		PutUInt64 (greeting, NbdMagic);
+		PutUInt64 (greeting + 8, NbdOptionMagic);
+		PutUInt16 (greeting + 16, NbdFlagFixedNewstyle | NbdFlagNoZeroes);
+		SendData (socket, greeting, sizeof (greeting));
+
+		uint8 clientFlagsData[4];
+		ReceiveData (socket, clientFlagsData, sizeof (clientFlagsData));
+		uint32 clientFlags = GetUInt32 (clientFlagsData);
+
+		if (clientFlags & ~(uint32) (NbdFlagFixedNewstyle | NbdFlagNoZeroes))
+			return false;
+
+		Buffer optionData (NbdMaxOptionLength);
+
+		while (!Stopping)
+		{
+			uint8 optionHeader[16];
+			ReceiveData (socket, optionHeader, sizeof (optionHeader));
+
+			uint32 option = GetUInt32 (optionHeader + 8);
+			uint32 length = GetUInt32 (optionHeader + 12);
+
+			if (GetUInt64 (optionHeader) != NbdOptionMagic || length > NbdMaxOptionLength)
+				return false;
+
+			ReceiveData (socket, optionData.Ptr(), length);
+
+			switch (option)
+			{
+			case NbdOptExportName:
+				{
+					// The volume is the only export and is therefore served under any name
+					uint8 reply[10 + 124];
+					Memory::Zero (reply, sizeof (reply));
+
+					PutUInt64 (reply, MountedVolume->GetSize());
+					PutUInt16 (reply + 8, GetTransmissionFlags());
+
+					SendData (socket, reply, (clientFlags & NbdFlagNoZeroes) ? 10 : sizeof (reply));
+				}
+				return true;
+
+			case NbdOptAbort:
+				SendOptionReply (socket, option, NbdRepAck);
+				return false;
+
+			case NbdOptList:
+				if (length != 0)
+				{
+					SendOptionReply (socket, option, NbdRepErrInvalid);
+					break;
+				}
+				else
+				{
+					uint8 exportName[4];
+					PutUInt32 (exportName, 0);
+
+					SendOptionReply (socket, option, NbdRepServer, ConstBufferPtr (exportName, sizeof (exportName)));
+					SendOptionReply (socket, option, NbdRepAck);
+				}
+				break;
+
+			case NbdOptInfo:
+			case NbdOptGo:
+				{
+					uint32 nameLength = length >= 4 ? GetUInt32 (optionData.Ptr()) : 0;
+
+					if (length < 6 || nameLength > length - 6
+						|| length != 6 + nameLength + 2 * (uint32) GetUInt16 (optionData.Ptr() + 4 + nameLength))
+					{
+						SendOptionReply (socket, option, NbdRepErrInvalid);
+						break;
+					}
+
+					uint8 exportInfo[12];
+					PutUInt16 (exportInfo, NbdInfoExport);
+					PutUInt64 (exportInfo + 2, MountedVolume->GetSize());
+					PutUInt16 (exportInfo + 10, GetTransmissionFlags());
+
+					// Block size constraints are sent even if not requested, as writes must be sector-aligned
+					uint32 sectorSize = (uint32) MountedVolume->GetSectorSize();
+
+					uint8 blockSizeInfo[14];
+					PutUInt16 (blockSizeInfo, NbdInfoBlockSize);
+					PutUInt32 (blockSizeInfo + 2, sectorSize);
+					PutUInt32 (blockSizeInfo + 6, sectorSize > 4096 ? sectorSize : 4096);
+					PutUInt32 (blockSizeInfo + 10, MaxRequestSize);
+
+					SendOptionReply (socket, option, NbdRepInfo, ConstBufferPtr (exportInfo, sizeof (exportInfo)));
+					SendOptionReply (socket, option, NbdRepInfo, ConstBufferPtr (blockSizeInfo, sizeof (blockSizeInfo)));
+					SendOptionReply (socket, option, NbdRepAck);
+
+					if (option == NbdOptGo)
+						return true;
+				}
+				break;
+
+			default:
+				SendOptionReply (socket, option, NbdRepErrUnsup);
+				break;
+			}
+		}
+
+		return false;
+	}
+
+	void NbdServer::ReapConnections (bool all)
+	{
+		list < shared_ptr <Connection> > finishedConnections;
+
+		{
+			ScopeLock lock (ConnectionsMutex);
+
+			for (list < shared_ptr <Connection> >::iterator i = Connections.begin(); i != Connections.end();)
+			{
+				if (all || (*i)->Finished)
+				{
+					// Blocked receives of connections still being served return end of stream
+					if (all)
+						shutdown ((*i)->Socket, SHUT_RDWR);
+
+					finishedConnections.push_back (*i);
+					i = Connections.erase (i);
+				}
+				else
+				{
+					++i;
+				}
+			}
+		}
+
+		foreach (shared_ptr <Connection> connection, finishedConnections)
+		{
+			connection->ConnectionThread->Join();
+			close (connection->Socket);
+		}
+	}
+
+	void NbdServer::ReceiveData (int socket, void *data, size_t size)
+	{
+		uint8 *dataPtr = (uint8 *) data;
+
+		while (size > 0)
+		{
+			ssize_t r = recv (socket, dataPtr, size, 0);
+
+			if (r == -1 && errno == EINTR)
+				continue;
+
+			throw_sys_if (r == -1);
+
+			if (r == 0)
+				throw InsufficientData (SRC_POS);
+
+			dataPtr += r;
+			size -= r;
+		}
+	}
+
+	void NbdServer::SendData (int socket, const void *data, size_t size, bool more)
+	{
+		const uint8 *dataPtr = (const uint8 *) data;
+
+		while (size > 0)
+		{
+			ssize_t r = send (socket, dataPtr, size, MSG_NOSIGNAL | (more ? MSG_MORE : 0));
+
+			if (r == -1 && errno == EINTR)
+				continue;
+
+			throw_sys_if (r == -1);
+
+			dataPtr += r;
+			size -= r;
+		}
+	}
+
+	void NbdServer::SendOptionReply (int socket, uint32 option, uint32 replyType, const ConstBufferPtr &data)
+	{
+		uint8 header[20];
+		PutUInt64 (header, NbdOptionReplyMagic);
+		PutUInt32 (header + 8, option);
+		PutUInt32 (header + 12, replyType);
+		PutUInt32 (header + 16, (uint32) data.Size());
+
+		SendData (socket, header, sizeof (header), data.Size() > 0);
+
+		if (data.Size() > 0)
+			SendData (socket, data.Get(), data.Size());
+	}
+
+	void NbdServer::SendSimpleReply (int socket, uint64 handle, uint32 error, const ConstBufferPtr &data)
+	{
+		uint8 header[16];
+		PutUInt32 (header, NbdSimpleReplyMagic);
+		PutUInt32 (header + 4, error);
+		memcpy (header + 8, &handle, sizeof (handle));
+
+		SendData (socket, header, sizeof (header), data.Size() > 0);
+
+		if (data.Size() > 0)
+			SendData (socket, data.Get(), data.Size());
+	}
+
+	void NbdServer::ServeConnection (int socket)
+	{
+		if (!CheckPeerCredentials (socket) || !Negotiate (socket))
+			return;
+
+		while (!Stopping)
+		{
+			uint8 request[28];
+			ReceiveData (socket, request, sizeof (request));
+
+			if (GetUInt32 (request) != NbdRequestMagic)
+				return;
+
+			uint16 flags = GetUInt16 (request + 4);
+			uint16 type = GetUInt16 (request + 6);
+
+			// The handle is opaque to the server and is returned unchanged
+			uint64 handle;
+			memcpy (&handle, request + 8, sizeof (handle));
+
+			if (type == NbdCmdDisc)
+				return;
+
+			ExecuteRequest (socket, flags, type, handle, GetUInt64 (request + 16), GetUInt32 (request + 24));
+		}
+	}
+}
@@ -0,0 +1,75 @@
+/*
+ Derived from source code of TrueCrypt 7.1a, which is
+ Copyright (c) 2008-2012 TrueCrypt Developers Association and which is governed
+ by the TrueCrypt License 3.0.
+
+ Modifications and additions to the original source code (contained in this file)
+ and all other portions of this file are Copyright (c) 2013-2025 IDRIX
+ and are governed by the Apache License 2.0 the full text of which is
+ contained in the file License.txt included in VeraCrypt binary and source
+ code distribution packages.
+*/
+
+#ifndef TC_HEADER_Driver_Fuse_NbdServer
+#define TC_HEADER_Driver_Fuse_NbdServer
+
+#include <atomic>
+#include <sys/types.h>
+#include "Platform/Platform.h"
+#include "Volume/Volume.h"
+
+namespace VeraCrypt
+{
+	// Serves the data of a mounted volume as a single export over the NBD protocol (fixed newstyle
+	// negotiation, simple replies) on a UNIX domain socket, so that the kernel NBD client can attach
+	// the volume as a block device without a loop device and a FUSE file. Each connection is served
+	// by its own thread and all connections share the volume, which permits multiple connections.
+	// Only root and the user who mounted the volume may connect.
+	class NbdServer
+	{
+	public:
+		NbdServer (shared_ptr <Volume> volume, const string &socketPath, uid_t userId);
+		virtual ~NbdServer ();
+
+		static const size_t MaxConnections = 64;
+		static const uint32 MaxRequestSize = 32 * 1024 * 1024;
+
+	protected:
+		struct Connection
+		{
+			Connection (int socket) : Finished (false), Socket (socket) { }
+
+			std::atomic <bool> Finished;
+			int Socket;
+			shared_ptr <Thread> ConnectionThread;
+		};
+
+		void AcceptThreadProc ();
+		bool CheckPeerCredentials (int socket) const;
+		static uint32 ExceptionToNbdError ();
+		void ExecuteRequest (int socket, uint16 flags, uint16 type, uint64 handle, uint64 offset, uint32 length);
+		uint16 GetTransmissionFlags () const;
+		bool Negotiate (int socket);
+		void ReapConnections (bool all);
+		static void ReceiveData (int socket, void *data, size_t size);
+		static void SendData (int socket, const void *data, size_t size, bool more = false);
+		static void SendOptionReply (int socket, uint32 option, uint32 replyType, const ConstBufferPtr &data = ConstBufferPtr());
+		static void SendSimpleReply (int socket, uint64 handle, uint32 error, const ConstBufferPtr &data = ConstBufferPtr());
+		void ServeConnection (int socket);
+
+		shared_ptr <Volume> MountedVolume;
+		string SocketPath;
+		uid_t UserId;
+		int ListenSocket;
+		shared_ptr <Thread> AcceptThread;
+		Mutex ConnectionsMutex;
+		list < shared_ptr <Connection> > Connections;
+		std::atomic <bool> Stopping;
+
+	private:
+		NbdServer (const NbdServer &);
+		NbdServer &operator= (const NbdServer &);
+	};
+}
+
+#endif // TC_HEADER_Driver_Fuse_NbdServer
@@ -436,17 +436,34 @@ namespace VeraCrypt
 			while (tokenizer.HasMoreTokens())
 			{
 				wxString token = tokenizer.GetNextToken();
+				wxString value;
 
-				if (token == L"headerbak")
+				if (token == L"directio")
+					ArgMountOptions.DirectIo = true;
+				else if (token == L"discard")
+					ArgMountOptions.Discard = true;
+				else if (token == L"headerbak")
 					ArgMountOptions.UseBackupHeaders = true;
+				else if (token.StartsWith (L"iodepth=", &value))
+					ArgMountOptions.AsyncIoQueueDepth = StringConverter::ToUInt32 (wstring (value));
+				else if (token == L"nbd")
+					ArgMountOptions.Nbd = true;
 				else if (token == L"nokernelcrypto")
 					ArgMountOptions.NoKernelCrypto = true;
+				else if (token == L"pinthreads")
+					ArgMountOptions.PinEncryptionThreads = true;
+				else if (token.StartsWith (L"readahead=", &value))
+					ArgMountOptions.ReadAheadSize = StringConverter::ToUInt64 (wstring (value)) * 1024;
 				else if (token == L"readonly" || token == L"ro")
 					ArgMountOptions.Protection = VolumeProtection::ReadOnly;
+				else if (token.StartsWith (L"sectorcache=", &value))
+					ArgMountOptions.SectorCacheSize = StringConverter::ToUInt64 (wstring (value)) * 1024 * 1024;
 				else if (token == L"system")
 					ArgMountOptions.PartitionInSystemEncryptionScope = true;
 				else if (token == L"timestamp" || token == L"ts")
 					ArgMountOptions.PreserveTimestamps = false;
+				else if (token.StartsWith (L"writebuffer=", &value))
+					ArgMountOptions.WriteBufferSize = StringConverter::ToUInt64 (wstring (value)) * 1024;
 #ifdef TC_WINDOWS
 				else if (token == L"removable" || token == L"rm")
 					ArgMountOptions.Removable = true;
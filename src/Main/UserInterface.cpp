@@ -292,6 +292,14 @@ namespace VeraCrypt
 			prop << LangString["MODE_OF_OPERATION"] << L": " << volume.EncryptionModeName << L'\n';
 			prop << LangString["PKCS5_PRF"] << L": " << volume.Pkcs5PrfName << L'\n';
 
+			// Time spent on each (layout, KDF) candidate tried when the volume was opened
+			foreach (const VolumeHeaderProbeResult &result, volume.HeaderProbeResults)
+			{
+				const char *status = result.HeaderDecrypted ? "HEADER_PROBE_DECRYPTED" : (result.Completed ? "HEADER_PROBE_FAILED" : "HEADER_PROBE_CANCELLED");
+				prop << LangString["HEADER_KEY_DERIVATION"] << L": " << StringFormatter (LangString["HEADER_PROBE_SUMMARY"], VolumeTypeToString (result.LayoutType, VolumeProtection::None),
+					result.KdfName, result.ElapsedTime / 1000 / 1000, LangString[status]) << L'\n';
+			}
+
 			prop << LangString["VOLUME_FORMAT_VERSION"] << L": " << (volume.MinRequiredProgramVersion < 0x10b ? 1 : 2) << L'\n';
 			prop << LangString["BACKUP_HEADER"] << L": " << LangString[volume.MinRequiredProgramVersion >= 0x10b ? "UISTR_YES" : "UISTR_NO"] << L'\n';
 
@@ -301,6 +309,21 @@ namespace VeraCrypt
 #endif
 			prop << LangString["TOTAL_DATA_READ"] << L": " << SizeToString (volume.TotalDataRead) << L'\n';
 			prop << LangString["TOTAL_DATA_WRITTEN"] << L": " << SizeToString (volume.TotalDataWritten) << L'\n';
+
+			const VolumeStatistics &stats = volume.Statistics;
+			prop << LangString["IO_READ_OPERATIONS"] << L": " << stats.ReadOperations << L'\n';
+			prop << LangString["IO_WRITE_OPERATIONS"] << L": " << stats.WriteOperations << L'\n';
+			prop << LangString["IO_READ_LATENCY"] << L": " << LatencyToString (stats.Latency[VolumeLatency::Read]) << L'\n';
+			prop << LangString["IO_READ_HOST_LATENCY"] << L": " << LatencyToString (stats.Latency[VolumeLatency::ReadHost]) << L'\n';
+			prop << LangString["IO_READ_CRYPTO_LATENCY"] << L": " << LatencyToString (stats.Latency[VolumeLatency::ReadCrypto]) << L'\n';
+			prop << LangString["IO_WRITE_LATENCY"] << L": " << LatencyToString (stats.Latency[VolumeLatency::Write]) << L'\n';
+			prop << LangString["IO_WRITE_HOST_LATENCY"] << L": " << LatencyToString (stats.Latency[VolumeLatency::WriteHost]) << L'\n';
+			prop << LangString["IO_WRITE_CRYPTO_LATENCY"] << L": " << LatencyToString (stats.Latency[VolumeLatency::WriteCrypto]) << L'\n';
+
+			const EncryptionThreadPool::Configuration &pool = volume.ThreadPoolConfiguration;
+			wstring cpuQuota = pool.CpuQuota != 0 ? StringConverter::ToWide ((double) pool.CpuQuota / 1000) : wstring (LangString["NONE"]);
+			prop << LangString["ENCRYPTION_THREADS"] << L": " << StringFormatter (LangString["ENCRYPTION_THREADS_SUMMARY"], pool.ThreadCount, pool.AvailableCpuCount, cpuQuota,
+				pool.NumaNodeCount, LangString[pool.ThreadsPinned ? "UISTR_YES" : "UISTR_NO"]) << L'\n';
 #ifdef TC_LINUX
 			}
 #endif
@@ -602,6 +625,38 @@ namespace VeraCrypt
 		}
 	}
 
+	wxString UserInterface::LatencyToString (const LatencyHistogram &latency) const
+	{
+		uint64 count = latency.GetCount();
+		if (count == 0)
+			return L"-";
+
+		wxString s = StringFormatter (LangString["IO_LATENCY_SUMMARY"], count, latency.GetMeanTime() / 1000, latency.GetPercentileLimit (50), latency.GetPercentileLimit (99));
+
+		// Non-empty buckets of the histogram, each labelled by its upper limit in microseconds
+		s << L" [";
+		bool first = true;
+		for (size_t i = 0; i < LatencyHistogram::BucketCount; ++i)
+		{
+			if (latency.Buckets[i] == 0)
+				continue;
+
+			if (!first)
+				s << L' ';
+			first = false;
+
+			if (i == LatencyHistogram::BucketCount - 1)
+				s << L">=" << LatencyHistogram::GetBucketLimit (i - 1);
+			else
+				s << L'<' << LatencyHistogram::GetBucketLimit (i);
+
+			s << L':' << latency.Buckets[i];
+		}
+		s << L']';
+
+		return s;
+	}
+
 	void UserInterface::ListMountedVolumes (const VolumeInfoList &volumes) const
 	{
 		if (volumes.size() < 1)
@@ -1293,14 +1348,35 @@ const FileManager fileManagers[] = {
 					"\n"
 					"-m, --mount-options=OPTION1[,OPTION2,OPTION3,...]\n"
 					" Specifies comma-separated mount options for a VeraCrypt volume:\n"
+					"  directio: Bypass the system cache when accessing the host file or device of\n"
+					"   a volume, so that its data is not cached in addition to the mounted\n"
+					"   filesystem (Linux/macOS/FreeBSD).\n"
+					"  discard: Deallocate the areas of the host file of a volume which correspond\n"
+					"   to discarded (trimmed) volume data. Note that the layout of deallocated\n"
+					"   areas reveals which parts of the volume are unused, which may weaken\n"
+					"   plausible deniability of hidden volumes (Linux).\n"
 					"  headerbak: Use backup headers when mounting a volume.\n"
+					"  iodepth=DEPTH: Keep up to DEPTH host transfers of large reads and writes in\n"
+					"   flight using io_uring (Linux).\n"
+					"  nbd: Attach the volume as a network block device (/dev/nbdN) served over a\n"
+					"   local UNIX socket instead of a loop device. Kernel cryptographic services\n"
+					"   are not used. Requires the nbd kernel module and nbd-client (Linux).\n"
 					"  nokernelcrypto: Do not use kernel cryptographic services.\n"
+					"  pinthreads: Bind each encryption thread of the volume to one CPU, filling\n"
+					"   one NUMA node before the next (Linux).\n"
+					"  readahead=SIZE: Prefetch and decrypt up to SIZE KiB of volume data ahead of\n"
+					"   sequential reads (Linux/macOS/FreeBSD).\n"
 					"  readonly|ro: Mount volume as read-only.\n"
+					"  sectorcache=SIZE: Cache up to SIZE MiB of decrypted volume data that is\n"
+					"   read in small requests, such as filesystem metadata (Linux/macOS/FreeBSD).\n"
 					"  system: Mount partition using system encryption.\n"
 					"  timestamp|ts: Do not restore host-file modification timestamp when a volume\n"
 					"   is unmounted (note that the operating system under certain circumstances\n"
 					"   does not alter host-file timestamps, which may be mistakenly interpreted\n"
 					"   to mean that this option does not work).\n"
+					"  writebuffer=SIZE: Combine small writes to adjacent sectors in up to SIZE KiB\n"
+					"   of memory before they are encrypted and written, for at most 50 ms or until\n"
+					"   the filesystem is synchronized (Linux/macOS/FreeBSD).\n"
 					" See also option --fs-options.\n"
 					"\n"
 					"--new-keyfiles=KEYFILE1[,KEYFILE2,KEYFILE3,...]\n"
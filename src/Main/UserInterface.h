@@ -55,6 +55,7 @@ namespace VeraCrypt
 		virtual void ImportTokenKeyfiles () const = 0;
 		virtual void Init ();
 		virtual void InitSecurityTokenLibrary () const = 0;
+		virtual wxString LatencyToString (const LatencyHistogram &latency) const;
 		virtual void ListMountedVolumes (const VolumeInfoList &volumes) const;
 		virtual void ListTokenKeyfiles () const = 0;
 		virtual void ListSecurityTokenKeyfiles () const = 0;
@@ -0,0 +1,67 @@
+/*
+ Derived from source code of TrueCrypt 7.1a, which is
+ Copyright (c) 2008-2012 TrueCrypt Developers Association and which is governed
+ by the TrueCrypt License 3.0.
+
+ Modifications and additions to the original source code (contained in this file)
+ and all other portions of this file are Copyright (c) 2013-2025 IDRIX
+ and are governed by the Apache License 2.0 the full text of which is
+ contained in the file License.txt included in VeraCrypt binary and source
+ code distribution packages.
+*/
+
+#ifndef TC_HEADER_Platform_AsyncFile
+#define TC_HEADER_Platform_AsyncFile
+
+#include "PlatformBase.h"
+#include "Buffer.h"
+#include "File.h"
+#include "MpmcQueue.h"
+
+namespace VeraCrypt
+{
+	// Positioned file I/O that keeps up to QueueDepth transfers in flight (io_uring on Linux). A request
+	// is split into chunks which are submitted in batches, and each chunk is passed to a handler as soon
+	// as it has been read, or requested from a handler just before it is written, so that the caller can
+	// process one chunk while the transfers of the others are in progress. Transfers which the kernel
+	// completes only partially or fails are retried synchronously using the File, which reports errors.
+	class AsyncFile
+	{
+	public:
+		struct ChunkHandler
+		{
+			virtual ~ChunkHandler () { }
+			virtual void operator() (const BufferPtr &chunk, uint64 position) = 0;
+		};
+
+		AsyncFile (shared_ptr <File> file, size_t queueDepth);
+		virtual ~AsyncFile ();
+
+		size_t GetQueueDepth () const { return QueueDepth; }
+		static bool IsSupported ();
+		uint64 ReadAt (const BufferPtr &buffer, uint64 position, size_t chunkSize, ChunkHandler &readHandler);
+		void WriteAt (uint64 length, uint64 position, size_t chunkSize, ChunkHandler &writeHandler);
+
+		static const size_t MaxChunkSize = 256 * 1024;
+		static const size_t MaxQueueDepth = 64;
+
+	protected:
+		struct Ring;
+
+		Ring *AcquireRing ();
+		void ReleaseRing (Ring *ring);
+
+		shared_ptr <File> HostFile;
+		size_t QueueDepth;
+		MpmcQueue <Ring *> FreeRings;
+
+		// Rings are created for each thread performing I/O concurrently and kept for reuse
+		static const size_t MaxFreeRings = 16;
+
+	private:
+		AsyncFile (const AsyncFile &);
+		AsyncFile &operator= (const AsyncFile &);
+	};
+}
+
+#endif // TC_HEADER_Platform_AsyncFile
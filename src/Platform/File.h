@@ -45,7 +45,8 @@ namespace VeraCrypt
 			// Bitmap
 			FlagsNone = 0,
 			PreserveTimestamps = 1 << 0,
-			DisableWriteCaching = 1 << 1
+			DisableWriteCaching = 1 << 1,
+			DirectIo = 1 << 2
 		};
 
 #ifdef TC_WINDOWS
@@ -54,7 +55,7 @@ namespace VeraCrypt
 		typedef int SystemFileHandleType;
 #endif
 
-		File () : FileIsOpen (false), mFileOpenFlags (FlagsNone), SharedHandle (false), FileHandle (0)
+		File () : FileIsOpen (false), mFileOpenFlags (FlagsNone), SharedHandle (false), FileHandle (0), DirectIoAlignment (0)
 #ifndef TC_WINDOWS
 				,AccTime(0), ModTime (0)
 #endif
@@ -73,15 +74,20 @@ namespace VeraCrypt
 		void Close ();
 		static void Copy (const FilePath &sourcePath, const FilePath &destinationPath, bool preserveTimestamps = true);
 		void Delete ();
+		void EnableDirectIo ();
 		void Flush () const;
 		uint32 GetDeviceSectorSize () const;
+		size_t GetDirectIoAlignment () const { return DirectIoAlignment; }
 		static size_t GetOptimalReadSize () { return OptimalReadSize; }
 		static size_t GetOptimalWriteSize ()  { return OptimalWriteSize; }
 		uint64 GetPartitionDeviceStartOffset () const;
+		bool IsDirectIoEnabled () const { return DirectIoAlignment > 0; }
 		bool IsOpen () const { return FileIsOpen; }
 		FilePath GetPath () const;
+		SystemFileHandleType GetSystemHandle () const { return FileHandle; }
 		uint64 Length () const;
 		void Open (const FilePath &path, FileOpenMode mode = OpenRead, FileShareMode shareMode = ShareReadWrite, FileOpenFlags flags = FlagsNone);
+		void PunchHole (uint64 position, uint64 length) const;
 		uint64 Read (const BufferPtr &buffer) const;
 		void ReadCompleteBuffer (const BufferPtr &buffer) const;
 		uint64 ReadAt (const BufferPtr &buffer, uint64 position) const;
@@ -103,6 +109,9 @@ namespace VeraCrypt
 		FilePath Path;
 		SystemFileHandleType FileHandle;
 
+		// Alignment of the position, size and memory of transfers bypassing the system cache (0 if cached)
+		size_t DirectIoAlignment;
+
 #ifdef TC_WINDOWS
 #else
 		time_t AccTime;
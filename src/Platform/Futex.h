@@ -0,0 +1,49 @@
+/*
+ Derived from source code of TrueCrypt 7.1a, which is
+ Copyright (c) 2008-2012 TrueCrypt Developers Association and which is governed
+ by the TrueCrypt License 3.0.
+
+ Modifications and additions to the original source code (contained in this file)
+ and all other portions of this file are Copyright (c) 2013-2025 IDRIX
+ and are governed by the Apache License 2.0 the full text of which is
+ contained in the file License.txt included in VeraCrypt binary and source
+ code distribution packages.
+*/
+
+#ifndef TC_HEADER_Platform_Futex
+#define TC_HEADER_Platform_Futex
+
+#include <atomic>
+#include "PlatformBase.h"
+
+#if defined (__i386__) || defined (__x86_64__)
+#	define TC_CPU_RELAX() __builtin_ia32_pause()
+#elif defined (__aarch64__) || defined (__arm__)
+#	define TC_CPU_RELAX() __asm__ __volatile__ ("yield")
+#else
+#	define TC_CPU_RELAX() do { } while (0)
+#endif
+
+namespace VeraCrypt
+{
+	// Parks threads on the address of a 32-bit atomic word. Wait() returns when woken, spuriously or
+	// immediately if the word no longer holds the expected value, so callers re-check their condition.
+	// Wake() only uses the address of the word and may therefore be called after its owner has observed
+	// the final value and released it.
+	class Futex
+	{
+	public:
+		static void Wait (const std::atomic <uint32> &word, uint32 expectedValue);
+		static void Wake (const std::atomic <uint32> &word, uint32 count = 1);
+		static void WakeAll (const std::atomic <uint32> &word) { Wake (word, 0x7fffffff); }
+
+		// Number of TC_CPU_RELAX() iterations worth spinning before parking; zero on uniprocessor systems,
+		// where the thread that ends the wait cannot run while the waiter spins
+		static int GetSpinCount ();
+
+	private:
+		Futex ();
+	};
+}
+
+#endif // TC_HEADER_Platform_Futex
@@ -0,0 +1,261 @@
+/*
+ Derived from source code of TrueCrypt 7.1a, which is
+ Copyright (c) 2008-2012 TrueCrypt Developers Association and which is governed
+ by the TrueCrypt License 3.0.
+
+ Modifications and additions to the original source code (contained in this file)
+ and all other portions of this file are Copyright (c) 2013-2025 IDRIX
+ and are governed by the Apache License 2.0 the full text of which is
+ contained in the file License.txt included in VeraCrypt binary and source
+ code distribution packages.
+*/
+
+#ifndef TC_HEADER_Platform_MpmcQueue
+#define TC_HEADER_Platform_MpmcQueue
+
+#include <atomic>
+#include "PlatformBase.h"
+#include "Exception.h"
+#include "Futex.h"
+
+namespace VeraCrypt
+{
+	// Bounded lock-free multi-producer multi-consumer queue. Every cell carries a sequence number that tells
+	// producers and consumers whether it is free for the current lap of the ring, so a push or a pop is one
+	// compare-and-swap on the enqueue or dequeue position. Blocking Push() and Pop() spin for a short while
+	// and then park on a futex until the queue becomes non-full or non-empty.
+	template <class T>
+	class MpmcQueue
+	{
+	public:
+		explicit MpmcQueue (size_t capacity)
+			: Cells (new Cell[capacity]), Mask (capacity - 1)
+		{
+			if (capacity < 2 || (capacity & (capacity - 1)) != 0)
+				throw ParameterIncorrect (SRC_POS);
+
+			Reset();
+		}
+
+		~MpmcQueue () { delete[] Cells; }
+
+		// Stops blocked and future Pop() calls from waiting once the queue is empty
+		void Close ()
+		{
+			Closed.store (true);
+			Notify (NotEmpty, true);
+		}
+
+		bool IsClosed () const { return Closed.load(); }
+
+		// Blocks while the queue is full
+		void Push (const T &item)
+		{
+			Push (&item, 1);
+		}
+
+		// Enqueues items in order and wakes at most one parked consumer per item
+		void Push (const T *items, size_t count)
+		{
+			size_t pushed = 0;
+
+			for (size_t i = 0; i < count; ++i)
+			{
+				if (!TryPush (items[i]))
+				{
+					// Consumers must see what has been pushed so far before this thread parks
+					if (pushed > 0)
+						Notify (NotEmpty, false, pushed);
+					pushed = 0;
+
+					const T &item = items[i];
+					WaitFor (NotFull, [this, &item]() { return TryPush (item); });
+				}
+
+				++pushed;
+			}
+
+			if (pushed > 0)
+				Notify (NotEmpty, false, pushed);
+		}
+
+		// Blocks while the queue is empty; returns false if it is empty and closed
+		bool Pop (T &item)
+		{
+			bool popped = false;
+
+			WaitFor (NotEmpty, [this, &item, &popped]()
+			{
+				popped = TryPop (item);
+				return popped || Closed.load (std::memory_order_acquire);
+			});
+
+			if (!popped)
+				popped = TryPop (item);
+
+			if (popped)
+				Notify (NotFull, false);
+
+			return popped;
+		}
+
+		// Must not be called while other threads use the queue
+		void Reset ()
+		{
+			for (size_t i = 0; i <= Mask; ++i)
+			{
+				Cells[i].Sequence.store (i, std::memory_order_relaxed);
+				Cells[i].Item = T();
+			}
+
+			EnqueuePosition.store (0, std::memory_order_relaxed);
+			DequeuePosition.store (0, std::memory_order_relaxed);
+			Closed.store (false);
+		}
+
+		bool TryPop (T &item)
+		{
+			size_t position = DequeuePosition.load (std::memory_order_relaxed);
+
+			for (;;)
+			{
+				Cell &cell = Cells[position & Mask];
+				size_t sequence = cell.Sequence.load (std::memory_order_acquire);
+				intptr_t lap = (intptr_t) sequence - (intptr_t) (position + 1);
+
+				if (lap == 0)
+				{
+					if (DequeuePosition.compare_exchange_weak (position, position + 1, std::memory_order_relaxed))
+					{
+						item = std::move (cell.Item);
+						cell.Sequence.store (position + Mask + 1, std::memory_order_release);
+						return true;
+					}
+				}
+				else if (lap < 0)
+				{
+					return false;
+				}
+				else
+				{
+					position = DequeuePosition.load (std::memory_order_relaxed);
+				}
+			}
+		}
+
+		bool TryPush (const T &item)
+		{
+			size_t position = EnqueuePosition.load (std::memory_order_relaxed);
+
+			for (;;)
+			{
+				Cell &cell = Cells[position & Mask];
+				size_t sequence = cell.Sequence.load (std::memory_order_acquire);
+				intptr_t lap = (intptr_t) sequence - (intptr_t) position;
+
+				if (lap == 0)
+				{
+					if (EnqueuePosition.compare_exchange_weak (position, position + 1, std::memory_order_relaxed))
+					{
+						cell.Item = item;
+						cell.Sequence.store (position + 1, std::memory_order_release);
+						return true;
+					}
+				}
+				else if (lap < 0)
+				{
+					return false;
+				}
+				else
+				{
+					position = EnqueuePosition.load (std::memory_order_relaxed);
+				}
+			}
+		}
+
+	protected:
+		static const size_t CacheLineSize = 64;
+
+		struct Cell
+		{
+			std::atomic <size_t> Sequence;
+			T Item;
+		};
+
+		// Parked threads wait for Epoch to change. Notify() only touches Epoch and issues a system call
+		// if Waiters is non-zero, which keeps the uncontended paths free of system calls.
+		struct ParkingSpot
+		{
+			ParkingSpot () : Epoch (0), Waiters (0) { }
+
+			std::atomic <uint32> Epoch;
+			std::atomic <uint32> Waiters;
+			uint8 Padding[CacheLineSize - 2 * sizeof (uint32)];
+		};
+
+		void Notify (ParkingSpot &spot, bool all, size_t count = 1)
+		{
+			// Orders the preceding queue update before the load of Waiters; pairs with the fence in WaitFor()
+			std::atomic_thread_fence (std::memory_order_seq_cst);
+
+			if (spot.Waiters.load (std::memory_order_relaxed) != 0)
+			{
+				spot.Epoch.fetch_add (1, std::memory_order_release);
+
+				if (all)
+					Futex::WakeAll (spot.Epoch);
+				else
+					Futex::Wake (spot.Epoch, (uint32) count);
+			}
+		}
+
+		template <class Condition>
+		void WaitFor (ParkingSpot &spot, Condition condition)
+		{
+			for (int spin = Futex::GetSpinCount(); spin > 0; --spin)
+			{
+				if (condition())
+					return;
+
+				TC_CPU_RELAX();
+			}
+
+			for (;;)
+			{
+				spot.Waiters.fetch_add (1, std::memory_order_relaxed);
+				std::atomic_thread_fence (std::memory_order_seq_cst);
+				// A waiter that reads the incremented epoch also sees the update published before it
+				uint32 epoch = spot.Epoch.load (std::memory_order_acquire);
+
+				if (condition())
+				{
+					spot.Waiters.fetch_sub (1, std::memory_order_relaxed);
+					return;
+				}
+
+				Futex::Wait (spot.Epoch, epoch);
+				spot.Waiters.fetch_sub (1, std::memory_order_relaxed);
+
+				if (condition())
+					return;
+			}
+		}
+
+		Cell *Cells;
+		const size_t Mask;
+		uint8 Padding0[CacheLineSize];
+		std::atomic <size_t> EnqueuePosition;
+		uint8 Padding1[CacheLineSize - sizeof (size_t)];
+		std::atomic <size_t> DequeuePosition;
+		uint8 Padding2[CacheLineSize - sizeof (size_t)];
+		std::atomic <bool> Closed;
+		ParkingSpot NotEmpty;
+		ParkingSpot NotFull;
+
+	private:
+		MpmcQueue (const MpmcQueue &);
+		MpmcQueue &operator= (const MpmcQueue &);
+	};
+}
+
+#endif // TC_HEADER_Platform_MpmcQueue
@@ -17,6 +17,7 @@
 #include "ForEach.h"
 #include "MemoryStream.h"
 #include "Mutex.h"
+#include "SecureBufferPool.h"
 #include "Serializable.h"
 #include "SharedPtr.h"
 #include "StringConverter.h"
@@ -26,6 +27,36 @@
 
 namespace VeraCrypt
 {
+	// SecureBufferPool, PooledSecureBuffer
+	void PlatformTest::SecureBufferPoolTest ()
+	{
+		SecureBufferPool pool;
+		uint8 *pooledPtr;
+
+		{
+			PooledSecureBuffer buffer (1000, pool);
+			if (buffer.Size() != 1000 || ((uintptr_t) buffer.Ptr() % SecureBufferPool::Alignment) != 0)
+				throw TestFailed (SRC_POS);
+
+			Memory::Copy (buffer.Ptr(), "secret", 6);
+			pooledPtr = buffer.Ptr();
+		}
+
+		{
+			// Buffers of the same size class are reused and have been wiped
+			PooledSecureBuffer buffer (SecureBufferPool::MinPooledSize, pool);
+			if (buffer.Ptr() != pooledPtr || buffer.Ptr()[0] != 0 || buffer.Ptr()[5] != 0)
+				throw TestFailed (SRC_POS);
+
+			PooledSecureBuffer largeBuffer (SecureBufferPool::MaxPooledSize + 1, pool);
+			largeBuffer.GetRange (SecureBufferPool::MaxPooledSize, 1).Zero();
+		}
+
+		SecureBufferPool::Statistics statistics = pool.GetStatistics();
+		if (statistics.Hits != 1 || statistics.Misses != 2 || statistics.Discards != 0)
+			throw TestFailed (SRC_POS);
+	}
+
 	// make_shared_auto, File, Stream, MemoryStream, Endian, Serializer, Serializable
 	void PlatformTest::SerializerTest ()
 	{
@@ -344,6 +375,7 @@ namespace VeraCrypt
 			testList.pop_front();
 		}
 
+		SecureBufferPoolTest();
 		SerializerTest();
 		ThreadTest();
 
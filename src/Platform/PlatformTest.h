@@ -36,6 +36,7 @@ namespace VeraCrypt
 		};
 
 		PlatformTest ();
+		static void SecureBufferPoolTest ();
 		static void SerializerTest ();
 		static void ThreadTest ();
 		static TC_THREAD_PROC ThreadTestProc (void *param);
@@ -0,0 +1,153 @@
+/*
+ Derived from source code of TrueCrypt 7.1a, which is
+ Copyright (c) 2008-2012 TrueCrypt Developers Association and which is governed
+ by the TrueCrypt License 3.0.
+
+ Modifications and additions to the original source code (contained in this file)
+ and all other portions of this file are Copyright (c) 2013-2025 IDRIX
+ and are governed by the Apache License 2.0 the full text of which is
+ contained in the file License.txt included in VeraCrypt binary and source
+ code distribution packages.
+*/
+
+#ifdef TC_UNIX
+#	include <sys/mman.h>
+#endif
+
+#include "SecureBufferPool.h"
+#include "Exception.h"
+#include "Memory.h"
+
+namespace VeraCrypt
+{
+	SecureBufferPool::SecureBufferPool () : Hits (0), Misses (0), Discards (0)
+	{
+		for (size_t i = 0; i < SizeClassCount; ++i)
+			FreeBuffers[i] = nullptr;
+
+		try
+		{
+			for (size_t i = 0; i < SizeClassCount; ++i)
+			{
+				size_t capacity = MaxFreeBytesPerSizeClass / GetSizeClassBufferSize (i);
+
+				if (capacity > MaxFreeBuffersPerSizeClass)
+					capacity = MaxFreeBuffersPerSizeClass;
+				if (capacity < 2)
+					capacity = 2;
+
+				FreeBuffers[i] = new MpmcQueue <uint8 *> (capacity);
+			}
+		}
+		catch (...)
+		{
+			for (size_t i = 0; i < SizeClassCount; ++i)
+				delete FreeBuffers[i];
+			throw;
+		}
+	}
+
+	SecureBufferPool::~SecureBufferPool ()
+	{
+		for (size_t i = 0; i < SizeClassCount; ++i)
+		{
+			uint8 *buffer;
+			while (FreeBuffers[i]->TryPop (buffer))
+				FreeBuffer (buffer, GetSizeClassBufferSize (i));
+
+			delete FreeBuffers[i];
+		}
+	}
+
+	uint8 *SecureBufferPool::Acquire (size_t size)
+	{
+		if (size < 1)
+			throw ParameterIncorrect (SRC_POS);
+
+		if (size > MaxPooledSize)
+		{
+			Misses.fetch_add (1, std::memory_order_relaxed);
+			return AllocateBuffer ((size + Alignment - 1) & ~(Alignment - 1));
+		}
+
+		size_t sizeClass = GetSizeClass (size);
+		uint8 *buffer;
+
+		if (FreeBuffers[sizeClass]->TryPop (buffer))
+		{
+			Hits.fetch_add (1, std::memory_order_relaxed);
+			return buffer;
+		}
+
+		Misses.fetch_add (1, std::memory_order_relaxed);
+		return AllocateBuffer (GetSizeClassBufferSize (sizeClass));
+	}
+
+	uint8 *SecureBufferPool::AllocateBuffer (size_t size)
+	{
+		uint8 *buffer = static_cast <uint8 *> (Memory::AllocateAligned (size, Alignment));
+
+#ifdef TC_UNIX
+		// Failure to lock the buffer (e.g. due to RLIMIT_MEMLOCK) is not fatal
+		mlock (buffer, size);
+#endif
+		return buffer;
+	}
+
+	void SecureBufferPool::FreeBuffer (uint8 *buffer, size_t size)
+	{
+#ifdef TC_UNIX
+		munlock (buffer, size);
+#endif
+		Memory::FreeAligned (buffer);
+	}
+
+	SecureBufferPool &SecureBufferPool::GetDefault ()
+	{
+		// Never destroyed, as I/O threads may still release buffers while static objects are destructed
+		static SecureBufferPool *pool = new SecureBufferPool;
+		return *pool;
+	}
+
+	size_t SecureBufferPool::GetSizeClass (size_t size)
+	{
+		size_t sizeClass = 0;
+		while (GetSizeClassBufferSize (sizeClass) < size)
+			++sizeClass;
+
+		return sizeClass;
+	}
+
+	SecureBufferPool::Statistics SecureBufferPool::GetStatistics () const
+	{
+		Statistics statistics;
+		statistics.Hits = Hits.load (std::memory_order_relaxed);
+		statistics.Misses = Misses.load (std::memory_order_relaxed);
+		statistics.Discards = Discards.load (std::memory_order_relaxed);
+		return statistics;
+	}
+
+	void SecureBufferPool::Release (uint8 *buffer, size_t size)
+	{
+		if (buffer == nullptr)
+			return;
+
+		// Buffer sizes are multiples of the alignment, so the rounded-up range is part of the buffer
+		size_t eraseSize = (size + 7) & ~(size_t) 7;
+		FAST_ERASE64 (buffer, eraseSize);
+
+		if (size > MaxPooledSize)
+		{
+			FreeBuffer (buffer, (size + Alignment - 1) & ~(Alignment - 1));
+			return;
+		}
+
+		size_t sizeClass = GetSizeClass (size);
+
+		if (!FreeBuffers[sizeClass]->TryPush (buffer))
+		{
+			Discards.fetch_add (1, std::memory_order_relaxed);
+			FreeBuffer (buffer, GetSizeClassBufferSize (sizeClass));
+		}
+	}
+}
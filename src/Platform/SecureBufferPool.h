@@ -0,0 +1,97 @@
+/*
+ Derived from source code of TrueCrypt 7.1a, which is
+ Copyright (c) 2008-2012 TrueCrypt Developers Association and which is governed
+ by the TrueCrypt License 3.0.
+
+ Modifications and additions to the original source code (contained in this file)
+ and all other portions of this file are Copyright (c) 2013-2025 IDRIX
+ and are governed by the Apache License 2.0 the full text of which is
+ contained in the file License.txt included in VeraCrypt binary and source
+ code distribution packages.
+*/
+
+#ifndef TC_HEADER_Platform_SecureBufferPool
+#define TC_HEADER_Platform_SecureBufferPool
+
+#include <atomic>
+#include "PlatformBase.h"
+#include "Buffer.h"
+#include "MpmcQueue.h"
+
+namespace VeraCrypt
+{
+	// Keeps page-aligned buffers for data that must not outlive a request, such as plaintext on the
+	// I/O path. Buffers are grouped by power-of-two size classes, locked in memory where the system
+	// permits it, and wiped when they are returned. Requests larger than MaxPooledSize bypass the pool.
+	class SecureBufferPool
+	{
+	public:
+		struct Statistics
+		{
+			uint64 Hits;
+			uint64 Misses;
+			uint64 Discards;
+		};
+
+		SecureBufferPool ();
+		virtual ~SecureBufferPool ();
+
+		uint8 *Acquire (size_t size);
+		static SecureBufferPool &GetDefault ();
+		Statistics GetStatistics () const;
+		void Release (uint8 *buffer, size_t size);
+
+		static const size_t Alignment = 4096;
+		static const size_t MinPooledSize = 4096;
+		static const size_t MaxPooledSize = 1024 * 1024;
+
+	protected:
+		static const size_t SizeClassCount = 9;
+		static const size_t MaxFreeBytesPerSizeClass = 1024 * 1024;
+		static const size_t MaxFreeBuffersPerSizeClass = 16;
+
+		static uint8 *AllocateBuffer (size_t size);
+		static void FreeBuffer (uint8 *buffer, size_t size);
+		static size_t GetSizeClass (size_t size);
+		static size_t GetSizeClassBufferSize (size_t sizeClass) { return MinPooledSize << sizeClass; }
+
+		MpmcQueue <uint8 *> *FreeBuffers[SizeClassCount];
+		std::atomic <uint64> Hits;
+		std::atomic <uint64> Misses;
+		std::atomic <uint64> Discards;
+
+	private:
+		SecureBufferPool (const SecureBufferPool &);
+		SecureBufferPool &operator= (const SecureBufferPool &);
+	};
+
+	// Scoped buffer obtained from a SecureBufferPool and wiped when it goes out of scope
+	class PooledSecureBuffer
+	{
+	public:
+		PooledSecureBuffer (size_t size, SecureBufferPool &pool = SecureBufferPool::GetDefault())
+			: DataPtr (pool.Acquire (size)), DataSize (size), Pool (pool) { }
+
+		~PooledSecureBuffer () { Pool.Release (DataPtr, DataSize); }
+
+		void CopyFrom (const ConstBufferPtr &bufferPtr) const { BufferPtr (DataPtr, DataSize).CopyFrom (bufferPtr); }
+		BufferPtr GetRange (size_t offset, size_t size) const { return BufferPtr (DataPtr, DataSize).GetRange (offset, size); }
+		uint8 *Ptr () const { return DataPtr; }
+		size_t Size () const { return DataSize; }
+
+		operator uint8 * () const { return DataPtr; }
+		operator BufferPtr () const { return BufferPtr (DataPtr, DataSize); }
+		operator ConstBufferPtr () const { return ConstBufferPtr (DataPtr, DataSize); }
+
+	protected:
+		uint8 *DataPtr;
+		size_t DataSize;
+		SecureBufferPool &Pool;
+
+	private:
+		PooledSecureBuffer (const PooledSecureBuffer &);
+		PooledSecureBuffer &operator= (const PooledSecureBuffer &);
+	};
+}
+
+#endif // TC_HEADER_Platform_SecureBufferPool
@@ -20,6 +20,9 @@ namespace VeraCrypt
 	class SystemInfo
 	{
 	public:
+		static vector <uint32> GetAvailableCpus ();
+		static uint32 GetCpuQuota ();
+		static int GetCpuNumaNode (uint32 cpu);
 		static wstring GetPlatformName ();
 		static vector <int> GetVersion ();
 		static bool IsVersionAtLeast (int versionNumber1, int versionNumber2, int versionNumber3 = 0);
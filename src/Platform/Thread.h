@@ -48,6 +48,8 @@ namespace VeraCrypt
 			Start (Thread::FunctorEntry, (void *)functor);
 		}
 
+		// Restricts the calling thread to one CPU; returns false if not supported or permitted
+		static bool SetCurrentThreadAffinity (uint32 cpu);
 		static void Sleep (uint32 milliSeconds);
 
 	protected:
@@ -0,0 +1,165 @@
+/*
+ Derived from source code of TrueCrypt 7.1a, which is
+ Copyright (c) 2008-2012 TrueCrypt Developers Association and which is governed
+ by the TrueCrypt License 3.0.
+
+ Modifications and additions to the original source code (contained in this file)
+ and all other portions of this file are Copyright (c) 2013-2025 IDRIX
+ and are governed by the Apache License 2.0 the full text of which is
+ contained in the file License.txt included in VeraCrypt binary and source
+ code distribution packages.
+*/
+
+#include <stdio.h>
+
+#ifdef TC_UNIX
+#	include <unistd.h>
+#endif
+
+#ifdef TC_LINUX
+#	include <sys/syscall.h>
+#endif
+
+#if (defined (TC_ARCH_X86) || defined (TC_ARCH_X64)) && defined (__GNUC__)
+#	include <x86intrin.h>
+#	define TC_TRACE_TSC
+#endif
+
+#include "Time.h"
+#include "Trace.h"
+
+namespace VeraCrypt
+{
+	// Marks the ring of a thread as free when the thread exits, so that it can be reused by a new thread
+	struct TraceRingOwner
+	{
+		TraceRingOwner () : OwnedRing (nullptr) { }
+		~TraceRingOwner () { if (OwnedRing) OwnedRing->InUse = false; }
+
+		Trace::Ring *OwnedRing;
+	};
+
+	static thread_local TraceRingOwner ThreadRingOwner;
+
+	Trace::Ring *Trace::GetThreadRing ()
+	{
+		if (ThreadRingOwner.OwnedRing)
+			return ThreadRingOwner.OwnedRing;
+
+		Ring *ring = nullptr;
+		{
+			ScopeLock lock (RingsMutex);
+
+			// Rings of exited threads are reused, while their events are kept until they are overwritten
+			foreach (Ring *r, Rings)
+			{
+				bool inUse = false;
+				if (r->InUse.compare_exchange_strong (inUse, true))
+				{
+					ring = r;
+					break;
+				}
+			}
+
+			if (!ring)
+			{
+				ring = new Ring;
+				ring->InUse = true;
+				Rings.push_back (ring);
+			}
+		}
+
+#ifdef TC_LINUX
+		ring->ThreadId = (uint32) syscall (SYS_gettid);
+#else
+		static std::atomic <uint32> threadCount (0);
+		ring->ThreadId = ++threadCount;
+#endif
+
+		ThreadRingOwner.OwnedRing = ring;
+		return ring;
+	}
+
+	uint64 Trace::GetTimestamp ()
+	{
+#ifdef TC_TRACE_TSC
+		return __rdtsc();
+#else
+		return Time::GetMonotonic();
+#endif
+	}
+
+	void Trace::Record (char phase, const char *name, uint64 argument)
+	{
+		Ring *ring = GetThreadRing();
+		uint64 position = ring->Position.load (std::memory_order_relaxed);
+
+		Event &event = ring->Events[position % RingSize];
+		event.Timestamp = GetTimestamp();
+		event.Name = name;
+		event.Argument = argument;
+		event.ThreadId = ring->ThreadId;
+		event.Phase = phase;
+
+		ring->Position.store (position + 1, std::memory_order_release);
+	}
+
+	void Trace::WriteJson (File &file)
+	{
+		// Timestamps are converted to time using the rate measured since the start of the process,
+		// which requires a constant rate of the time-stamp counter
+		uint64 endTimestamp = GetTimestamp();
+		uint64 endTime = Time::GetMonotonic();
+
+		double timePerTick = 1.0;
+		if (endTimestamp > StartTimestamp && endTime > StartTime)
+			timePerTick = (double) (endTime - StartTime) / (double) (endTimestamp - StartTimestamp);
+
+#ifdef TC_UNIX
+		int processId = (int) getpid();
+#else
+		int processId = 0;
+#endif
+		string json = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+		bool first = true;
+
+		ScopeLock lock (RingsMutex);
+
+		foreach (Ring *ring, Rings)
+		{
+			// Events are read while they may be overwritten by the owning thread, which may damage the oldest events
+			uint64 end = ring->Position.load (std::memory_order_acquire);
+			uint64 start = end > RingSize ? end - RingSize : 0;
+
+			for (uint64 i = start; i < end; ++i)
+			{
+				const Event &event = ring->Events[i % RingSize];
+				double time = (double) (int64) (event.Timestamp - StartTimestamp) * timePerTick / 1000.0;
+
+				char entry[256];
+				int length = snprintf (entry, sizeof (entry), "%s\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":%d,\"tid\":%u%s,\"args\":{\"arg\":%llu}}",
+					first ? "" : ",", event.Name, event.Phase, time, processId, (unsigned int) event.ThreadId,
+					event.Phase == 'i' ? ",\"s\":\"t\"" : "", (unsigned long long) event.Argument);
+
+				if (length > 0)
+					json.append (entry, (size_t) length < sizeof (entry) ? (size_t) length : sizeof (entry) - 1);
+
+				first = false;
+
+				if (json.size() >= 64 * 1024)
+				{
+					file.Write (ConstBufferPtr ((const uint8 *) json.data(), json.size()));
+					json.clear();
+				}
+			}
+		}
+
+		json += "\n]}\n";
+		file.Write (ConstBufferPtr ((const uint8 *) json.data(), json.size()));
+	}
+
+	list <Trace::Ring *> Trace::Rings;
+	Mutex Trace::RingsMutex;
+	uint64 Trace::StartTimestamp = Trace::GetTimestamp();
+	uint64 Trace::StartTime = Time::GetMonotonic();
+}
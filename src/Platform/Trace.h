@@ -0,0 +1,96 @@
+/*
+ Derived from source code of TrueCrypt 7.1a, which is
+ Copyright (c) 2008-2012 TrueCrypt Developers Association and which is governed
+ by the TrueCrypt License 3.0.
+
+ Modifications and additions to the original source code (contained in this file)
+ and all other portions of this file are Copyright (c) 2013-2025 IDRIX
+ and are governed by the Apache License 2.0 the full text of which is
+ contained in the file License.txt included in VeraCrypt binary and source
+ code distribution packages.
+*/
+
+#ifndef TC_HEADER_Platform_Trace
+#define TC_HEADER_Platform_Trace
+
+#include <atomic>
+#include "PlatformBase.h"
+#include "File.h"
+#include "Mutex.h"
+
+namespace VeraCrypt
+{
+	// Records events of the I/O and encryption pipeline into a ring buffer of each thread, which
+	// can be written out in the Chrome trace event format (chrome://tracing, Perfetto). Events are
+	// recorded only when built with TC_TRACE defined (make TRACE=1), as the trace_event* macros expand
+	// to nothing otherwise. Names must be string literals.
+	class Trace
+	{
+	public:
+		static void Record (char phase, const char *name, uint64 argument);
+		static void WriteJson (File &file);
+
+		static const size_t RingSize = 16384;
+
+	protected:
+		struct Event
+		{
+			uint64 Timestamp;
+			const char *Name;
+			uint64 Argument;
+			uint32 ThreadId;
+			char Phase;
+		};
+
+		struct Ring
+		{
+			Ring () : Position (0), ThreadId (0), InUse (false) { }
+
+			Event Events[RingSize];
+			std::atomic <uint64> Position;
+			uint32 ThreadId;
+			std::atomic <bool> InUse;
+		};
+
+		static Ring *GetThreadRing ();
+		static uint64 GetTimestamp ();
+
+		static list <Ring *> Rings;
+		static Mutex RingsMutex;
+		static uint64 StartTimestamp;
+		static uint64 StartTime;
+
+	private:
+		Trace ();
+
+		friend struct TraceRingOwner;
+	};
+
+	class TraceScope
+	{
+	public:
+		TraceScope (const char *name, uint64 argument) : Name (name) { Trace::Record ('B', name, argument); }
+		~TraceScope () { Trace::Record ('E', Name, 0); }
+
+	protected:
+		const char *Name;
+
+	private:
+		TraceScope (const TraceScope &);
+		TraceScope &operator= (const TraceScope &);
+	};
+}
+
+#ifdef TC_TRACE
+#	define trace_event(NAME, ARGUMENT) VeraCrypt::Trace::Record ('i', (NAME), (uint64) (ARGUMENT))
+#	define trace_event_begin(NAME, ARGUMENT) VeraCrypt::Trace::Record ('B', (NAME), (uint64) (ARGUMENT))
+#	define trace_event_end(NAME) VeraCrypt::Trace::Record ('E', (NAME), 0)
+#	define trace_event_scope(NAME, ARGUMENT) VeraCrypt::TraceScope TC_JOIN(trace_event_scope,__LINE__) ((NAME), (uint64) (ARGUMENT))
+#else
+#	define trace_event(NAME, ARGUMENT)
+#	define trace_event_begin(NAME, ARGUMENT)
+#	define trace_event_end(NAME)
+#	define trace_event_scope(NAME, ARGUMENT)
+#endif
+
+#endif // TC_HEADER_Platform_Trace
@@ -0,0 +1,587 @@
+/*
+ Derived from source code of TrueCrypt 7.1a, which is
+ Copyright (c) 2008-2012 TrueCrypt Developers Association and which is governed
+ by the TrueCrypt License 3.0.
+
+ Modifications and additions to the original source code (contained in this file)
+ and all other portions of this file are Copyright (c) 2013-2025 IDRIX
+ and are governed by the Apache License 2.0 the full text of which is
+ contained in the file License.txt included in VeraCrypt binary and source
+ code distribution packages.
+*/
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+
+#ifdef TC_LINUX
+#	include <sys/syscall.h>
+#	ifdef __has_include
+#		if __has_include (<linux/io_uring.h>)
+#			include <linux/io_uring.h>
+#		endif
+#	endif
+#	if defined (IORING_OFF_SQ_RING) && defined (__NR_io_uring_setup)
+#		define TC_IO_URING
+#	endif
+#endif
+
+#include "Platform/AsyncFile.h"
+#include "Platform/Memory.h"
+#include "Platform/SystemException.h"
+#include "Platform/Trace.h"
+
+namespace VeraCrypt
+{
+#ifdef TC_IO_URING
+
+	// The system calls are used directly, as liburing is not available on all supported distributions
+	static int IoUringSetup (uint32 entries, struct io_uring_params *params)
+	{
+		return (int) syscall (__NR_io_uring_setup, entries, params);
+	}
+
+	static int IoUringEnter (int ringHandle, uint32 toSubmit, uint32 minComplete, uint32 flags)
+	{
+		return (int) syscall (__NR_io_uring_enter, ringHandle, toSubmit, minComplete, flags, nullptr, 0);
+	}
+
+	static int IoUringRegister (int ringHandle, uint32 opcode, const void *arg, uint32 argCount)
+	{
+		return (int) syscall (__NR_io_uring_register, ringHandle, opcode, arg, argCount);
+	}
+
+	struct AsyncFile::Ring
+	{
+		struct Transfer
+		{
+			uint8 *Data;
+			size_t Length;
+			uint64 Position;
+		};
+
+		Ring (int fileHandle, size_t queueDepth);
+		~Ring ();
+
+		void AllocateBuffers ();
+		void Drain ();
+		void Enter (uint32 minComplete);
+		size_t GetInFlightCount () const { return InFlightCount; }
+		bool PopCompletion (size_t &slot, int &result);
+		void PrepareRead (size_t slot);
+		void PrepareWrite (size_t slot);
+
+		int RingHandle;
+		int FileHandle;
+		bool FileRegistered;
+		bool Broken;
+
+		uint8 *SqRing;
+		size_t SqRingSize;
+		uint8 *CqRing;
+		size_t CqRingSize;
+		struct io_uring_sqe *Sqes;
+		size_t SqesSize;
+
+		uint32 *SqTail;
+		uint32 SqMask;
+		uint32 *SqArray;
+		uint32 *CqHead;
+		uint32 *CqTail;
+		uint32 CqMask;
+		struct io_uring_cqe *Cqes;
+
+		uint32 PendingSubmissions;
+		size_t InFlightCount;
+
+		uint8 *Buffers;
+		size_t BuffersSize;
+		bool BuffersRegistered;
+
+		vector <Transfer> Transfers;
+		vector <struct iovec> TransferVectors;
+		vector <size_t> FreeSlots;
+
+	protected:
+		struct io_uring_sqe *GetSqe (size_t slot);
+	};
+
+	AsyncFile::Ring::Ring (int fileHandle, size_t queueDepth)
+		: RingHandle (-1),
+		FileHandle (fileHandle),
+		FileRegistered (false),
+		Broken (false),
+		SqRing (nullptr),
+		SqRingSize (0),
+		CqRing (nullptr),
+		CqRingSize (0),
+		Sqes (nullptr),
+		SqesSize (0),
+		PendingSubmissions (0),
+		InFlightCount (0),
+		Buffers (nullptr),
+		BuffersSize (0),
+		BuffersRegistered (false),
+		Transfers (queueDepth),
+		TransferVectors (queueDepth)
+	{
+		struct io_uring_params params;
+		Memory::Zero (&params, sizeof (params));
+
+		RingHandle = IoUringSetup ((uint32) queueDepth, &params);
+		throw_sys_if (RingHandle == -1);
+
+		try
+		{
+			SqRingSize = params.sq_off.array + params.sq_entries * sizeof (uint32);
+			CqRingSize = params.cq_off.cqes + params.cq_entries * sizeof (struct io_uring_cqe);
+			SqesSize = params.sq_entries * sizeof (struct io_uring_sqe);
+
+			void *memory = mmap (nullptr, SqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, RingHandle, IORING_OFF_SQ_RING);
+			throw_sys_if (memory == MAP_FAILED);
+			SqRing = static_cast <uint8 *> (memory);
+
+			memory = mmap (nullptr, CqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, RingHandle, IORING_OFF_CQ_RING);
+			throw_sys_if (memory == MAP_FAILED);
+			CqRing = static_cast <uint8 *> (memory);
+
+			memory = mmap (nullptr, SqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, RingHandle, IORING_OFF_SQES);
+			throw_sys_if (memory == MAP_FAILED);
+			Sqes = static_cast <struct io_uring_sqe *> (memory);
+		}
+		catch (...)
+		{
+			if (SqRing)
+				munmap (SqRing, SqRingSize);
+			if (CqRing)
+				munmap (CqRing, CqRingSize);
+			close (RingHandle);
+			throw;
+		}
+
+		SqTail = reinterpret_cast <uint32 *> (SqRing + params.sq_off.tail);
+		SqMask = *reinterpret_cast <uint32 *> (SqRing + params.sq_off.ring_mask);
+		SqArray = reinterpret_cast <uint32 *> (SqRing + params.sq_off.array);
+		CqHead = reinterpret_cast <uint32 *> (CqRing + params.cq_off.head);
+		CqTail = reinterpret_cast <uint32 *> (CqRing + params.cq_off.tail);
+		CqMask = *reinterpret_cast <uint32 *> (CqRing + params.cq_off.ring_mask);
+		Cqes = reinterpret_cast <struct io_uring_cqe *> (CqRing + params.cq_off.cqes);
+
+		// A registered file saves the kernel a lookup of the descriptor for every transfer
+		if (IoUringRegister (RingHandle, IORING_REGISTER_FILES, &fileHandle, 1) == 0)
+		{
+			FileHandle = 0;
+			FileRegistered = true;
+		}
+
+		for (size_t slot = queueDepth; slot > 0; --slot)
+			FreeSlots.push_back (slot - 1);
+	}
+
+	AsyncFile::Ring::~Ring ()
+	{
+		// Closing the ring releases the registered file and buffers
+		close (RingHandle);
+
+		munmap (Sqes, SqesSize);
+		munmap (CqRing, CqRingSize);
+		munmap (SqRing, SqRingSize);
+
+		if (Buffers)
+		{
+			for (size_t offset = 0; offset < BuffersSize; offset += MaxChunkSize)
+				FAST_ERASE64 (Buffers + offset, MaxChunkSize);
+
+			munlock (Buffers, BuffersSize);
+			Memory::FreeAligned (Buffers);
+		}
+	}
+
+	void AsyncFile::Ring::AllocateBuffers ()
+	{
+		if (Buffers)
+			return;
+
+		// Each buffer is aligned to its size so as to satisfy the alignment requirements of direct I/O
+		BuffersSize = Transfers.size() * MaxChunkSize;
+		Buffers = static_cast <uint8 *> (Memory::AllocateAligned (BuffersSize, MaxChunkSize));
+
+		// Failure to lock the buffers (e.g. due to RLIMIT_MEMLOCK) is not fatal
+		mlock (Buffers, BuffersSize);
+
+		vector <struct iovec> bufferVectors (Transfers.size());
+		for (size_t i = 0; i < bufferVectors.size(); ++i)
+		{
+			bufferVectors[i].iov_base = Buffers + i * MaxChunkSize;
+			bufferVectors[i].iov_len = MaxChunkSize;
+		}
+
+		// Registered buffers are mapped by the kernel once instead of for every transfer
+		BuffersRegistered = IoUringRegister (RingHandle, IORING_REGISTER_BUFFERS, &bufferVectors.front(), (uint32) bufferVectors.size()) == 0;
+	}
+
+	void AsyncFile::Ring::Drain ()
+	{
+		// Transfers must not outlive the buffers they refer to
+		while (InFlightCount > 0)
+		{
+			try
+			{
+				Enter (1);
+			}
+			catch (...)
+			{
+				Broken = true;
+				return;
+			}
+
+			size_t slot;
+			int result;
+			while (PopCompletion (slot, result)) { }
+		}
+	}
+
+	void AsyncFile::Ring::Enter (uint32 minComplete)
+	{
+		if (PendingSubmissions == 0 && minComplete == 0)
+			return;
+
+		for (;;)
+		{
+			int submitted = IoUringEnter (RingHandle, PendingSubmissions, minComplete, minComplete > 0 ? IORING_ENTER_GETEVENTS : 0);
+
+			if (submitted >= 0)
+			{
+				PendingSubmissions -= (uint32) submitted;
+
+				if (PendingSubmissions == 0 || minComplete > 0)
+					return;
+			}
+			else if (errno == EINTR)
+			{
+				continue;
+			}
+			else if ((errno == EAGAIN || errno == EBUSY) && InFlightCount > PendingSubmissions)
+			{
+				// Resources are released as submitted transfers complete
+				minComplete = 1;
+				if (IoUringEnter (RingHandle, 0, minComplete, IORING_ENTER_GETEVENTS) == -1 && errno != EINTR)
+					throw SystemException (SRC_POS);
+			}
+			else
+			{
+				throw SystemException (SRC_POS);
+			}
+		}
+	}
+
+	struct io_uring_sqe *AsyncFile::Ring::GetSqe (size_t slot)
+	{
+		uint32 tail = *SqTail;
+		struct io_uring_sqe *sqe = &Sqes[tail & SqMask];
+
+		Memory::Zero (sqe, sizeof (*sqe));
+		sqe->fd = FileHandle;
+		sqe->flags = FileRegistered ? IOSQE_FIXED_FILE : 0;
+		sqe->off = Transfers[slot].Position;
+		sqe->user_data = slot;
+
+		SqArray[tail & SqMask] = tail & SqMask;
+		return sqe;
+	}
+
+	bool AsyncFile::Ring::PopCompletion (size_t &slot, int &result)
+	{
+		uint32 head = *CqHead;
+		if (head == __atomic_load_n (CqTail, __ATOMIC_ACQUIRE))
+			return false;
+
+		struct io_uring_cqe *cqe = &Cqes[head & CqMask];
+		slot = (size_t) cqe->user_data;
+		result = cqe->res;
+
+		__atomic_store_n (CqHead, head + 1, __ATOMIC_RELEASE);
+
+		FreeSlots.push_back (slot);
+		--InFlightCount;
+		return true;
+	}
+
+	void AsyncFile::Ring::PrepareRead (size_t slot)
+	{
+		Transfer &transfer = Transfers[slot];
+		TransferVectors[slot].iov_base = transfer.Data;
+		TransferVectors[slot].iov_len = transfer.Length;
+
+		struct io_uring_sqe *sqe = GetSqe (slot);
+		sqe->opcode = IORING_OP_READV;
+		sqe->addr = (uint64) (uintptr_t) &TransferVectors[slot];
+		sqe->len = 1;
+
+		__atomic_store_n (SqTail, *SqTail + 1, __ATOMIC_RELEASE);
+		++PendingSubmissions;
+		++InFlightCount;
+	}
+
+	void AsyncFile::Ring::PrepareWrite (size_t slot)
+	{
+		Transfer &transfer = Transfers[slot];
+		struct io_uring_sqe *sqe = GetSqe (slot);
+
+		if (BuffersRegistered)
+		{
+			sqe->opcode = IORING_OP_WRITE_FIXED;
+			sqe->addr = (uint64) (uintptr_t) transfer.Data;
+			sqe->len = (uint32) transfer.Length;
+			sqe->buf_index = (uint16) slot;
+		}
+		else
+		{
+			TransferVectors[slot].iov_base = transfer.Data;
+			TransferVectors[slot].iov_len = transfer.Length;
+
+			sqe->opcode = IORING_OP_WRITEV;
+			sqe->addr = (uint64) (uintptr_t) &TransferVectors[slot];
+			sqe->len = 1;
+		}
+
+		__atomic_store_n (SqTail, *SqTail + 1, __ATOMIC_RELEASE);
+		++PendingSubmissions;
+		++InFlightCount;
+	}
+
+	AsyncFile::AsyncFile (shared_ptr <File> file, size_t queueDepth)
+		: HostFile (file), QueueDepth (queueDepth), FreeRings (MaxFreeRings)
+	{
+		if (queueDepth < 1 || queueDepth > MaxQueueDepth)
+			throw ParameterIncorrect (SRC_POS);
+
+		if (!IsSupported())
+			throw NotImplemented (SRC_POS);
+	}
+
+	AsyncFile::~AsyncFile ()
+	{
+		Ring *ring;
+		while (FreeRings.TryPop (ring))
+			delete ring;
+	}
+
+	AsyncFile::Ring *AsyncFile::AcquireRing ()
+	{
+		Ring *ring;
+		if (FreeRings.TryPop (ring))
+			return ring;
+
+		return new Ring (HostFile->GetSystemHandle(), QueueDepth);
+	}
+
+	bool AsyncFile::IsSupported ()
+	{
+		// io_uring may be disabled by the kernel configuration, a sysctl or a seccomp filter
+		static const bool supported = []()
+		{
+			struct io_uring_params params;
+			Memory::Zero (&params, sizeof (params));
+
+			int ringHandle = IoUringSetup (1, &params);
+			if (ringHandle == -1)
+				return false;
+
+			close (ringHandle);
+			return true;
+		}();
+
+		return supported;
+	}
+
+	uint64 AsyncFile::ReadAt (const BufferPtr &buffer, uint64 position, size_t chunkSize, ChunkHandler &readHandler)
+	{
+		if (chunkSize < 1)
+			throw ParameterIncorrect (SRC_POS);
+
+		trace_event_scope ("AsyncFile::ReadAt", buffer.Size());
+
+		Ring *ring = AcquireRing();
+		size_t bufferOffset = 0;
+		uint64 bytesRead = 0;
+		bool endOfFile = false;
+
+		try
+		{
+			for (;;)
+			{
+				// All chunks that fit in the ring are submitted by a single system call
+				while (bufferOffset < buffer.Size() && !endOfFile && !ring->FreeSlots.empty())
+				{
+					size_t slot = ring->FreeSlots.back();
+					ring->FreeSlots.pop_back();
+
+					Ring::Transfer &transfer = ring->Transfers[slot];
+					transfer.Data = buffer.Get() + bufferOffset;
+					transfer.Length = buffer.Size() - bufferOffset < chunkSize ? buffer.Size() - bufferOffset : chunkSize;
+					transfer.Position = position + bufferOffset;
+
+					ring->PrepareRead (slot);
+					bufferOffset += transfer.Length;
+				}
+
+				if (ring->GetInFlightCount() == 0)
+					break;
+
+				ring->Enter (1);
+
+				size_t slot;
+				int result;
+				while (ring->PopCompletion (slot, result))
+				{
+					Ring::Transfer &transfer = ring->Transfers[slot];
+					size_t transferred = result > 0 ? (size_t) result : 0;
+
+					while (transferred < transfer.Length)
+					{
+						uint64 length = HostFile->ReadAt (BufferPtr (transfer.Data + transferred, transfer.Length - transferred), transfer.Position + transferred);
+						if (length == 0)
+							break;
+
+						transferred += (size_t) length;
+					}
+
+					bytesRead += transferred;
+
+					if (transferred < transfer.Length)
+						endOfFile = true;
+					else
+						readHandler (BufferPtr (transfer.Data, transfer.Length), transfer.Position);
+				}
+			}
+		}
+		catch (...)
+		{
+			ring->Drain();
+			ReleaseRing (ring);
+			throw;
+		}
+
+		ReleaseRing (ring);
+		return bytesRead;
+	}
+
+	void AsyncFile::ReleaseRing (Ring *ring)
+	{
+		if (ring->Broken || !FreeRings.TryPush (ring))
+			delete ring;
+	}
+
+	void AsyncFile::WriteAt (uint64 length, uint64 position, size_t chunkSize, ChunkHandler &writeHandler)
+	{
+		if (chunkSize < 1 || chunkSize > MaxChunkSize)
+			throw ParameterIncorrect (SRC_POS);
+
+		trace_event_scope ("AsyncFile::WriteAt", length);
+
+		Ring *ring = AcquireRing();
+		uint64 offset = 0;
+
+		try
+		{
+			ring->AllocateBuffers();
+
+			for (;;)
+			{
+				while (offset < length && !ring->FreeSlots.empty())
+				{
+					size_t slot = ring->FreeSlots.back();
+					ring->FreeSlots.pop_back();
+
+					Ring::Transfer &transfer = ring->Transfers[slot];
+					transfer.Data = ring->Buffers + slot * MaxChunkSize;
+					transfer.Length = length - offset < chunkSize ? (size_t) (length - offset) : chunkSize;
+					transfer.Position = position + offset;
+
+					try
+					{
+						writeHandler (BufferPtr (transfer.Data, transfer.Length), transfer.Position);
+					}
+					catch (...)
+					{
+						ring->FreeSlots.push_back (slot);
+						throw;
+					}
+
+					// Each chunk is submitted as soon as it is ready so that the transfer overlaps the preparation of the next one
+					ring->PrepareWrite (slot);
+					ring->Enter (0);
+					offset += transfer.Length;
+				}
+
+				if (ring->GetInFlightCount() == 0)
+					break;
+
+				ring->Enter (1);
+
+				size_t slot;
+				int result;
+				while (ring->PopCompletion (slot, result))
+				{
+					Ring::Transfer &transfer = ring->Transfers[slot];
+					size_t transferred = result > 0 ? (size_t) result : 0;
+
+					if (transferred < transfer.Length)
+						HostFile->WriteAt (ConstBufferPtr (transfer.Data + transferred, transfer.Length - transferred), transfer.Position + transferred);
+				}
+			}
+		}
+		catch (...)
+		{
+			ring->Drain();
+			ReleaseRing (ring);
+			throw;
+		}
+
+		ReleaseRing (ring);
+	}
+
+#else // TC_IO_URING
+
+	struct AsyncFile::Ring
+	{
+	};
+
+	AsyncFile::AsyncFile (shared_ptr <File> file, size_t queueDepth)
+		: HostFile (file), QueueDepth (queueDepth), FreeRings (MaxFreeRings)
+	{
+		throw NotImplemented (SRC_POS);
+	}
+
+	AsyncFile::~AsyncFile ()
+	{
+	}
+
+	AsyncFile::Ring *AsyncFile::AcquireRing ()
+	{
+		throw NotImplemented (SRC_POS);
+	}
+
+	bool AsyncFile::IsSupported ()
+	{
+		return false;
+	}
+
+	uint64 AsyncFile::ReadAt (const BufferPtr &buffer, uint64 position, size_t chunkSize, ChunkHandler &readHandler)
+	{
+		throw NotImplemented (SRC_POS);
+	}
+
+	void AsyncFile::ReleaseRing (Ring *ring)
+	{
+	}
+
+	void AsyncFile::WriteAt (uint64 length, uint64 position, size_t chunkSize, ChunkHandler &writeHandler)
+	{
+		throw NotImplemented (SRC_POS);
+	}
+
+#endif // TC_IO_URING
+}
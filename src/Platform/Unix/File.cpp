@@ -44,6 +44,7 @@
 
 #include "Platform/File.h"
 #include "Platform/TextReader.h"
+#include "Platform/Trace.h"
 
 namespace VeraCrypt
 {
@@ -97,6 +98,48 @@ namespace VeraCrypt
 		Path.Delete();
 	}
 
+	void File::EnableDirectIo ()
+	{
+		if_debug (ValidateState());
+
+#if defined (O_DIRECT)
+		size_t alignment = 0;
+
+#	if defined (TC_LINUX) && defined (STATX_DIOALIGN)
+		struct statx statxData;
+		if (statx (FileHandle, "", AT_EMPTY_PATH, STATX_DIOALIGN, &statxData) == 0
+			&& (statxData.stx_mask & STATX_DIOALIGN)
+			&& statxData.stx_dio_offset_align > 0)
+		{
+			alignment = statxData.stx_dio_offset_align;
+			if (statxData.stx_dio_mem_align > alignment)
+				alignment = statxData.stx_dio_mem_align;
+		}
+#	endif
+		if (alignment == 0)
+		{
+			// The logical block size of a device, or the largest alignment commonly required by filesystems
+			if (Path.IsDevice())
+				alignment = GetDeviceSectorSize();
+			else
+				alignment = 4096;
+		}
+
+		int flags = fcntl (FileHandle, F_GETFL);
+		throw_sys_sub_if (flags == -1, wstring (Path));
+		throw_sys_sub_if (fcntl (FileHandle, F_SETFL, flags | O_DIRECT) == -1, wstring (Path));
+
+		DirectIoAlignment = alignment;
+
+#elif defined (F_NOCACHE)
+		// Uncached transfers have no alignment requirements
+		throw_sys_sub_if (fcntl (FileHandle, F_NOCACHE, 1) == -1, wstring (Path));
+		DirectIoAlignment = 1;
+#else
+		throw NotImplemented (SRC_POS);
+#endif
+	}
+
 
 	void File::Flush () const
 	{
@@ -335,6 +378,32 @@ namespace VeraCrypt
 		Path = path;
 		mFileOpenFlags = flags;
 		FileIsOpen = true;
+		DirectIoAlignment = 0;
+
+		if (flags & File::DirectIo)
+		{
+			try
+			{
+				EnableDirectIo();
+			}
+			catch (...)
+			{
+				Close();
+				throw;
+			}
+		}
+	}
+
+	void File::PunchHole (uint64 position, uint64 length) const
+	{
+		if_debug (ValidateState());
+
+#ifdef TC_LINUX
+		// Deallocates the range, which then reads as zeros, without changing the size of the file
+		throw_sys_sub_if (fallocate (FileHandle, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, position, length) == -1, wstring (Path));
+#else
+		throw NotImplemented (SRC_POS);
+#endif
 	}
 
 	uint64 File::Read (const BufferPtr &buffer) const
@@ -357,6 +426,7 @@ namespace VeraCrypt
 #ifdef TC_TRACE_FILE_OPERATIONS
 		TraceFileOperation (FileHandle, Path, false, buffer.Size(), position);
 #endif
+		trace_event_scope ("File::ReadAt", buffer.Size());
 		ssize_t bytesRead = pread (FileHandle, buffer, buffer.Size(), position);
 		throw_sys_sub_if (bytesRead == -1, wstring (Path));
 
@@ -402,6 +472,7 @@ namespace VeraCrypt
 #ifdef TC_TRACE_FILE_OPERATIONS
 		TraceFileOperation (FileHandle, Path, true, buffer.Size(), position);
 #endif
+		trace_event_scope ("File::WriteAt", buffer.Size());
 		throw_sys_sub_if (pwrite (FileHandle, buffer, buffer.Size(), position) != (ssize_t) buffer.Size(), wstring (Path));
 	}
 }
@@ -0,0 +1,98 @@
+/*
+ Derived from source code of TrueCrypt 7.1a, which is
+ Copyright (c) 2008-2012 TrueCrypt Developers Association and which is governed
+ by the TrueCrypt License 3.0.
+
+ Modifications and additions to the original source code (contained in this file)
+ and all other portions of this file are Copyright (c) 2013-2025 IDRIX
+ and are governed by the Apache License 2.0 the full text of which is
+ contained in the file License.txt included in VeraCrypt binary and source
+ code distribution packages.
+*/
+
+#include <unistd.h>
+#ifdef TC_LINUX
+#	include <errno.h>
+#	include <linux/futex.h>
+#	include <sys/syscall.h>
+#else
+#	include <pthread.h>
+#endif
+#include "Platform/Futex.h"
+#include "Platform/SystemException.h"
+
+namespace VeraCrypt
+{
+	int Futex::GetSpinCount ()
+	{
+		static int spinCount = -1;
+
+		if (spinCount < 0)
+			spinCount = (sysconf (_SC_NPROCESSORS_ONLN) > 1) ? 64 : 0;
+
+		return spinCount;
+	}
+
+#ifdef TC_LINUX
+
+	void Futex::Wait (const std::atomic <uint32> &word, uint32 expectedValue)
+	{
+		if (syscall (SYS_futex, &word, FUTEX_WAIT_PRIVATE, expectedValue, nullptr, nullptr, 0) == -1
+			&& errno != EAGAIN && errno != EINTR)
+		{
+			throw SystemException (SRC_POS);
+		}
+	}
+
+	void Futex::Wake (const std::atomic <uint32> &word, uint32 count)
+	{
+		syscall (SYS_futex, &word, FUTEX_WAKE_PRIVATE, (int) count, nullptr, nullptr, 0);
+	}
+
+#else // !TC_LINUX
+
+	// Waiters are parked on condition variables selected by a hash of the word address. The word is compared
+	// under the bucket mutex, which Wake() also takes, so a wake-up between the comparison and the wait is not lost.
+	struct FutexBucket
+	{
+		FutexBucket ()
+		{
+			pthread_mutex_init (&BucketMutex, nullptr);
+			pthread_cond_init (&BucketCondition, nullptr);
+		}
+
+		pthread_mutex_t BucketMutex;
+		pthread_cond_t BucketCondition;
+	};
+
+	static FutexBucket FutexBuckets[64];
+
+	static FutexBucket &GetFutexBucket (const std::atomic <uint32> &word)
+	{
+		uintptr_t address = (uintptr_t) &word;
+		return FutexBuckets[(address >> 2 ^ address >> 8) % array_capacity (FutexBuckets)];
+	}
+
+	void Futex::Wait (const std::atomic <uint32> &word, uint32 expectedValue)
+	{
+		FutexBucket &bucket = GetFutexBucket (word);
+
+		pthread_mutex_lock (&bucket.BucketMutex);
+
+		if (word.load() == expectedValue)
+			pthread_cond_wait (&bucket.BucketCondition, &bucket.BucketMutex);
+
+		pthread_mutex_unlock (&bucket.BucketMutex);
+	}
+
+	void Futex::Wake (const std::atomic <uint32> &word, uint32 count)
+	{
+		FutexBucket &bucket = GetFutexBucket (word);
+
+		pthread_mutex_lock (&bucket.BucketMutex);
+		pthread_cond_broadcast (&bucket.BucketCondition);
+		pthread_mutex_unlock (&bucket.BucketMutex);
+	}
+
+#endif // !TC_LINUX
+}
@@ -10,12 +10,192 @@
  code distribution packages.
 */
 
+#include "Platform/Directory.h"
+#include "Platform/Finally.h"
+#include "Platform/ForEach.h"
 #include "Platform/SystemException.h"
 #include "Platform/SystemInfo.h"
+#include "Platform/TextReader.h"
 #include <sys/utsname.h>
+#include <unistd.h>
+
+#ifdef TC_LINUX
+#	include <sched.h>
+#endif
+
+#ifdef TC_MACOSX
+#	include <sys/types.h>
+#	include <sys/sysctl.h>
+#endif
 
 namespace VeraCrypt
 {
+	vector <uint32> SystemInfo::GetAvailableCpus ()
+	{
+		vector <uint32> cpus;
+
+#ifdef TC_LINUX
+		// The affinity mask may have been restricted by taskset, cpusets or a container runtime
+		long configuredCpuCount = sysconf (_SC_NPROCESSORS_CONF);
+		size_t maxCpuCount = configuredCpuCount > CPU_SETSIZE ? (size_t) configuredCpuCount : CPU_SETSIZE;
+
+		for (int attempt = 0; attempt < 8; ++attempt, maxCpuCount *= 2)
+		{
+			cpu_set_t *cpuSet = CPU_ALLOC (maxCpuCount);
+			throw_sys_if (!cpuSet);
+			finally_do_arg (cpu_set_t*, cpuSet, { CPU_FREE (finally_arg); });
+
+			size_t cpuSetSize = CPU_ALLOC_SIZE (maxCpuCount);
+			CPU_ZERO_S (cpuSetSize, cpuSet);
+
+			if (sched_getaffinity (0, cpuSetSize, cpuSet) == -1)
+			{
+				if (errno == EINVAL)
+					continue;
+
+				break;
+			}
+
+			for (size_t cpu = 0; cpu < maxCpuCount; ++cpu)
+			{
+				if (CPU_ISSET_S (cpu, cpuSetSize, cpuSet))
+					cpus.push_back ((uint32) cpu);
+			}
+
+			break;
+		}
+#endif
+
+		if (cpus.empty())
+		{
+			long cpuCount = -1;
+
+#if defined (_SC_NPROCESSORS_ONLN)
+			cpuCount = sysconf (_SC_NPROCESSORS_ONLN);
+#elif defined (TC_MACOSX)
+			int cpuCountSys;
+			int mib[2] = { CTL_HW, HW_NCPU };
+
+			size_t len = sizeof (cpuCountSys);
+			if (sysctl (mib, 2, &cpuCountSys, &len, nullptr, 0) != -1)
+				cpuCount = cpuCountSys;
+#endif
+			if (cpuCount < 1)
+				cpuCount = 1;
+
+			for (long cpu = 0; cpu < cpuCount; ++cpu)
+				cpus.push_back ((uint32) cpu);
+		}
+
+		return cpus;
+	}
+
+	uint32 SystemInfo::GetCpuQuota ()
+	{
+		// Thousandths of a CPU allowed by the cgroup hierarchy of the process, or zero if unlimited
+		uint32 quota = 0;
+
+#ifdef TC_LINUX
+		// cgroup v1 (CFS bandwidth control), where a container usually sees its own group at the mount root
+		try
+		{
+			TextReader quotaReader ("/sys/fs/cgroup/cpu/cpu.cfs_quota_us");
+			TextReader periodReader ("/sys/fs/cgroup/cpu/cpu.cfs_period_us");
+
+			string quotaLine, periodLine;
+			if (quotaReader.ReadLine (quotaLine) && periodReader.ReadLine (periodLine) && !quotaLine.empty() && quotaLine[0] != '-')
+			{
+				uint64 period = StringConverter::ToUInt64 (StringConverter::Trim (periodLine));
+
+				if (period != 0)
+				{
+					uint64 v1Quota = StringConverter::ToUInt64 (StringConverter::Trim (quotaLine)) * 1000 / period;
+					quota = v1Quota < 1 ? 1 : (uint32) v1Quota;
+				}
+			}
+		}
+		catch (...) { }
+
+		// cgroup v2
+		try
+		{
+			string cgroupPath;
+			TextReader cgroupReader ("/proc/self/cgroup");
+
+			string line;
+			while (cgroupReader.ReadLine (line))
+			{
+				if (line.find ("0::") == 0)
+				{
+					cgroupPath = line.substr (3);
+					break;
+				}
+			}
+
+			if (cgroupPath.empty() || cgroupPath[0] != '/')
+				return 0;
+
+			// Every level of the hierarchy may limit the CPU time of the process
+			for (;;)
+			{
+				try
+				{
+					TextReader cpuMaxReader ("/sys/fs/cgroup" + (cgroupPath == "/" ? string() : cgroupPath) + "/cpu.max");
+
+					if (cpuMaxReader.ReadLine (line))
+					{
+						vector <string> fields = StringConverter::Split (line);
+
+						if (fields.size() == 2 && fields[0] != "max")
+						{
+							uint64 period = StringConverter::ToUInt64 (fields[1]);
+
+							if (period != 0)
+							{
+								uint64 levelQuota = StringConverter::ToUInt64 (fields[0]) * 1000 / period;
+								if (levelQuota < 1)
+									levelQuota = 1;
+
+								if (quota == 0 || levelQuota < quota)
+									quota = (uint32) levelQuota;
+							}
+						}
+					}
+				}
+				catch (...) { }
+
+				size_t p = cgroupPath.find_last_of ('/');
+				if (p == 0 || p == string::npos)
+					break;
+
+				cgroupPath = cgroupPath.substr (0, p);
+			}
+		}
+		catch (...) { }
+#endif
+		return quota;
+	}
+
+	int SystemInfo::GetCpuNumaNode (uint32 cpu)
+	{
+#ifdef TC_LINUX
+		try
+		{
+			string cpuPath = "/sys/devices/system/cpu/cpu" + StringConverter::ToSingle (cpu);
+
+			foreach_ref (const FilePath &path, Directory::GetFilePaths (cpuPath, false))
+			{
+				string name = string (path).substr (cpuPath.size() + 1);
+
+				if (name.size() > 4 && name.find ("node") == 0 && name.find_first_not_of ("0123456789", 4) == string::npos)
+					return (int) StringConverter::ToUInt32 (name.substr (4));
+			}
+		}
+		catch (...) { }
+#endif
+		return -1;
+	}
+
 	wstring SystemInfo::GetPlatformName ()
 	{
 #ifdef TC_LINUX
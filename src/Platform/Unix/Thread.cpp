@@ -12,6 +12,12 @@
 
 #include <pthread.h>
 #include <unistd.h>
+
+#ifdef TC_LINUX
+#	include <sched.h>
+#endif
+
+#include "Platform/Finally.h"
 #include "Platform/SystemException.h"
 #include "Platform/Thread.h"
 #include "Platform/SystemLog.h"
@@ -35,6 +41,8 @@ namespace VeraCrypt
 		if (status != 0)
 			throw SystemException (SRC_POS, status);
 
+		finally_do_arg (pthread_attr_t*, &attr, { pthread_attr_destroy (finally_arg); });
+
 		status = pthread_attr_getstacksize (&attr, &stackSize);
 		if (status != 0)
 			throw SystemException (SRC_POS, status);
@@ -46,11 +54,30 @@ namespace VeraCrypt
 				throw SystemException (SRC_POS, status);
 		}
 
-		status = pthread_create (&SystemHandle, nullptr, threadProc, parameter);
+		status = pthread_create (&SystemHandle, &attr, threadProc, parameter);
 		if (status != 0)
 			throw SystemException (SRC_POS, status);
 	}
 
+	bool Thread::SetCurrentThreadAffinity (uint32 cpu)
+	{
+#ifdef TC_LINUX
+		cpu_set_t *cpuSet = CPU_ALLOC (cpu + 1);
+		if (!cpuSet)
+			return false;
+
+		finally_do_arg (cpu_set_t*, cpuSet, { CPU_FREE (finally_arg); });
+
+		size_t cpuSetSize = CPU_ALLOC_SIZE (cpu + 1);
+		CPU_ZERO_S (cpuSetSize, cpuSet);
+		CPU_SET_S (cpu, cpuSetSize, cpuSet);
+
+		return pthread_setaffinity_np (pthread_self(), cpuSetSize, cpuSet) == 0;
+#else
+		return false;
+#endif
+	}
+
 	void Thread::Sleep (uint32 milliSeconds)
 	{
 		::usleep (milliSeconds * 1000);
@@ -24,4 +24,12 @@ namespace VeraCrypt
 		// Unix time => Windows file time
 		return  ((uint64) tv.tv_sec + 134774LL * 24 * 3600) * 1000LL * 1000 * 10;
 	}
+
+	uint64 Time::GetMonotonic ()
+	{
+		struct timespec ts;
+		clock_gettime (CLOCK_MONOTONIC, &ts);
+
+		return (uint64) ts.tv_sec * 1000LL * 1000 * 1000 + (uint64) ts.tv_nsec;
+	}
 }
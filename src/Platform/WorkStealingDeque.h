@@ -0,0 +1,114 @@
+/*
+ Derived from source code of TrueCrypt 7.1a, which is
+ Copyright (c) 2008-2012 TrueCrypt Developers Association and which is governed
+ by the TrueCrypt License 3.0.
+
+ Modifications and additions to the original source code (contained in this file)
+ and all other portions of this file are Copyright (c) 2013-2025 IDRIX
+ and are governed by the Apache License 2.0 the full text of which is
+ contained in the file License.txt included in VeraCrypt binary and source
+ code distribution packages.
+*/
+
+#ifndef TC_HEADER_Platform_WorkStealingDeque
+#define TC_HEADER_Platform_WorkStealingDeque
+
+#include <atomic>
+#include "PlatformBase.h"
+#include "Exception.h"
+
+namespace VeraCrypt
+{
+	// Bounded Chase-Lev deque. The owning thread pushes and pops items at the bottom without contention,
+	// while any other thread may steal the oldest item from the top with one compare-and-swap. A thief may
+	// read an item which is being overwritten by the owner, in which case its compare-and-swap fails and
+	// the item is discarded; T must therefore be trivially copyable.
+	template <class T>
+	class WorkStealingDeque
+	{
+	public:
+		explicit WorkStealingDeque (size_t capacity)
+			: Cells (nullptr), Mask (capacity - 1), Top (0), Bottom (0)
+		{
+			if (capacity < 2 || (capacity & (capacity - 1)) != 0)
+				throw ParameterIncorrect (SRC_POS);
+
+			Cells = new T[capacity];
+		}
+
+		~WorkStealingDeque () { delete[] Cells; }
+
+		// Owner only; returns false if the deque is full
+		bool Push (const T &item)
+		{
+			int64 bottom = Bottom.load (std::memory_order_relaxed);
+			int64 top = Top.load (std::memory_order_acquire);
+
+			if (bottom - top > (int64) Mask)
+				return false;
+
+			Cells[bottom & Mask] = item;
+			std::atomic_thread_fence (std::memory_order_release);
+			Bottom.store (bottom + 1, std::memory_order_relaxed);
+			return true;
+		}
+
+		// Owner only; takes the most recently pushed item
+		bool Pop (T &item)
+		{
+			int64 bottom = Bottom.load (std::memory_order_relaxed) - 1;
+			Bottom.store (bottom, std::memory_order_relaxed);
+			std::atomic_thread_fence (std::memory_order_seq_cst);
+			int64 top = Top.load (std::memory_order_relaxed);
+
+			if (top > bottom)
+			{
+				Bottom.store (bottom + 1, std::memory_order_relaxed);
+				return false;
+			}
+
+			item = Cells[bottom & Mask];
+
+			if (top == bottom)
+			{
+				// The last item may be taken by a thief at the same time
+				bool taken = Top.compare_exchange_strong (top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+				Bottom.store (bottom + 1, std::memory_order_relaxed);
+				return taken;
+			}
+
+			return true;
+		}
+
+		// Any thread; takes the oldest item, which is usually the largest piece of work
+		bool Steal (T &item)
+		{
+			int64 top = Top.load (std::memory_order_acquire);
+			std::atomic_thread_fence (std::memory_order_seq_cst);
+			int64 bottom = Bottom.load (std::memory_order_acquire);
+
+			if (top >= bottom)
+				return false;
+
+			item = Cells[top & Mask];
+			return Top.compare_exchange_strong (top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+		}
+
+	protected:
+		static const size_t CacheLineSize = 64;
+
+		T *Cells;
+		const size_t Mask;
+		uint8 Padding0[CacheLineSize];
+		std::atomic <int64> Top;
+		uint8 Padding1[CacheLineSize - sizeof (int64)];
+		std::atomic <int64> Bottom;
+		uint8 Padding2[CacheLineSize - sizeof (int64)];
+
+	private:
+		WorkStealingDeque (const WorkStealingDeque &);
+		WorkStealingDeque &operator= (const WorkStealingDeque &);
+	};
+}
+
+#endif // TC_HEADER_Platform_WorkStealingDeque
@@ -0,0 +1,177 @@
+#include <cstring>
+#include <sstream>
+#include <iomanip>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "Testing.h"
+#include "Platform/AsyncFile.h"
+#include "Platform/Time.h"
+#include "Crypto/cpu.h"
+#include "EncryptionAlgorithm.h"
+#include "EncryptionModeXTS.h"
+#include "EncryptionThreadPool.h"
+
+#define BENCHMARK_FILE_PATH "AsyncFileBenchmarkTest.tmp"
+#define BENCHMARK_FILE_SIZE (64 * 1024 * 1024)
+#define BENCHMARK_REQUEST_SIZE (2 * 1024 * 1024)
+#define BENCHMARK_CHUNK_SIZE (64 * 1024)
+#define BENCHMARK_SECTOR_SIZE 512
+
+// Common/Crypto.h declares a C struct EncryptionAlgorithm, hence no "using namespace VeraCrypt"
+namespace VeraCrypt {
+
+const size_t QueueDepths[] = { 1, 2, 4, 8, 16, 32 };
+
+shared_ptr<VeraCrypt::EncryptionAlgorithm> BenchmarkEA;
+
+void FillBuffer(uint8 *b, size_t size, uint64 position) {
+    for (size_t i = 0; i < size; ++i) {
+        b[i] = (uint8) ((position + i) * 131 + ((position + i) >> 12));
+    }
+}
+
+double MiBPerSecond(uint64 size, uint64 elapsedTime) {
+    return (double) size / (1024 * 1024) / ((double) elapsedTime / 1000000000);
+}
+
+// Drops the cached pages of the file so that reads are served by the device
+void DropCache(File &file) {
+    fdatasync(file.GetSystemHandle());
+    posix_fadvise(file.GetSystemHandle(), 0, 0, POSIX_FADV_DONTNEED);
+}
+
+struct DecryptChunk : public AsyncFile::ChunkHandler {
+    virtual void operator()(const BufferPtr &chunk, uint64 position) {
+        BenchmarkEA->DecryptSectors(chunk, position / BENCHMARK_SECTOR_SIZE, chunk.Size() / BENCHMARK_SECTOR_SIZE, BENCHMARK_SECTOR_SIZE);
+    }
+};
+
+struct EncryptChunk : public AsyncFile::ChunkHandler {
+    virtual void operator()(const BufferPtr &chunk, uint64 position) {
+        FillBuffer(chunk.Get(), chunk.Size(), position);
+        BenchmarkEA->EncryptSectors(chunk, position / BENCHMARK_SECTOR_SIZE, chunk.Size() / BENCHMARK_SECTOR_SIZE, BENCHMARK_SECTOR_SIZE);
+    }
+};
+
+// Verifies that decrypted data read from the file matches the plaintext written to it
+void VerifyRequest(shared_ptr<TestResult> r, const BufferPtr &buffer, uint64 position) {
+    Buffer expected(buffer.Size());
+    FillBuffer(expected.Ptr(), expected.Size(), position);
+
+    if (memcmp(buffer.Get(), expected.Ptr(), buffer.Size()) != 0) {
+        r->Failed("decrypted data differs from the data written");
+    }
+}
+
+void ReadBenchmark(shared_ptr<TestResult> r, shared_ptr<File> file, AsyncFile *asyncFile) {
+    SecureBuffer buffer(BENCHMARK_REQUEST_SIZE);
+    DecryptChunk decryptChunk;
+
+    DropCache(*file);
+    uint64 start = Time::GetMonotonic();
+
+    for (uint64 position = 0; position < BENCHMARK_FILE_SIZE; position += BENCHMARK_REQUEST_SIZE) {
+        if (asyncFile) {
+            if (asyncFile->ReadAt(buffer, position, BENCHMARK_CHUNK_SIZE, decryptChunk) != buffer.Size())
+                r->Failed("short read");
+        } else {
+            if (file->ReadAt(buffer, position) != buffer.Size())
+                r->Failed("short read");
+            decryptChunk(buffer, position);
+        }
+
+        if (position == 0 || position + BENCHMARK_REQUEST_SIZE == BENCHMARK_FILE_SIZE)
+            VerifyRequest(r, buffer, position);
+    }
+
+    uint64 elapsed = Time::GetMonotonic() - start;
+
+    stringstream s;
+    s << fixed << setprecision(1) << "read and decrypt " << MiBPerSecond(BENCHMARK_FILE_SIZE, elapsed) << " MiB/s";
+    r->Info(s.str());
+}
+
+void WriteBenchmark(shared_ptr<TestResult> r, shared_ptr<File> file, AsyncFile *asyncFile) {
+    SecureBuffer buffer(BENCHMARK_REQUEST_SIZE);
+    EncryptChunk encryptChunk;
+
+    uint64 start = Time::GetMonotonic();
+
+    for (uint64 position = 0; position < BENCHMARK_FILE_SIZE; position += BENCHMARK_REQUEST_SIZE) {
+        if (asyncFile) {
+            asyncFile->WriteAt(BENCHMARK_REQUEST_SIZE, position, BENCHMARK_CHUNK_SIZE, encryptChunk);
+        } else {
+            encryptChunk(buffer, position);
+            file->WriteAt(buffer, position);
+        }
+    }
+
+    fdatasync(file->GetSystemHandle());
+    uint64 elapsed = Time::GetMonotonic() - start;
+
+    stringstream s;
+    s << fixed << setprecision(1) << "encrypt and write " << MiBPerSecond(BENCHMARK_FILE_SIZE, elapsed) << " MiB/s";
+    r->Info(s.str());
+}
+
+shared_ptr<File> OpenBenchmarkFile() {
+    shared_ptr<File> file(new File);
+    file->Open(BENCHMARK_FILE_PATH, File::CreateReadWrite);
+    return file;
+}
+
+void SynchronousIo(shared_ptr<TestResult> r) {
+    shared_ptr<File> file = OpenBenchmarkFile();
+    WriteBenchmark(r, file, nullptr);
+    ReadBenchmark(r, file, nullptr);
+}
+
+void AsynchronousIo(shared_ptr<TestResult> r, const size_t *queueDepth) {
+    if (!AsyncFile::IsSupported()) {
+        r->Info("asynchronous I/O is not available");
+        return;
+    }
+
+    shared_ptr<File> file = OpenBenchmarkFile();
+    AsyncFile asyncFile(file, *queueDepth);
+
+    WriteBenchmark(r, file, &asyncFile);
+    ReadBenchmark(r, file, &asyncFile);
+}
+
+}
+
+int main() {
+    using namespace VeraCrypt;
+    Testing t;
+
+#ifdef CRYPTOPP_CPUID_AVAILABLE
+    DetectX86Features();
+#endif
+    EncryptionThreadPool::Start();
+
+    BenchmarkEA.reset(new VeraCrypt::AES());
+    SecureBuffer key(BenchmarkEA->GetKeySize()), secondaryKey(BenchmarkEA->GetKeySize());
+    FillBuffer(key.Ptr(), key.Size(), 1);
+    FillBuffer(secondaryKey.Ptr(), secondaryKey.Size(), 2);
+    BenchmarkEA->SetKey(key);
+
+    shared_ptr<EncryptionMode> mode(new EncryptionModeXTS());
+    BenchmarkEA->SetMode(mode);
+    mode->SetKey(secondaryKey);
+
+    t.AddTest("SynchronousIo", &SynchronousIo);
+
+    for (const size_t &queueDepth : QueueDepths) {
+        stringstream name;
+        name << "AsynchronousIo-qd" << queueDepth;
+        t.AddTest(TestSuite::param<const size_t>(name.str(), &AsynchronousIo, &queueDepth));
+    }
+
+    t.Main();
+
+    BenchmarkEA.reset();
+    EncryptionThreadPool::Stop();
+    unlink(BENCHMARK_FILE_PATH);
+}
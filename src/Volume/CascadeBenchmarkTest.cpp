@@ -0,0 +1,120 @@
+#include <cstring>
+#include <sstream>
+#include <iomanip>
+
+#include "Testing.h"
+#include "Platform/Time.h"
+#include "Platform/StringConverter.h"
+#include "EncryptionAlgorithm.h"
+#include "EncryptionModeXTS.h"
+
+#define BENCHMARK_BUFFER_SIZE (1024 * 1024)
+#define BENCHMARK_ROUNDS 8
+
+// Common/Crypto.h declares a C struct EncryptionAlgorithm, hence no "using namespace VeraCrypt"
+namespace VeraCrypt {
+
+void FillBuffer(const BufferPtr &buffer, uint8 seed) {
+    uint8 *b = buffer.Get();
+    for (size_t i = 0; i < buffer.Size(); ++i) {
+        b[i] = (uint8) (i * 131 + seed);
+    }
+}
+
+// The cascade as it was processed before fusing: every cipher makes its own XTS pass over the whole buffer
+void EncryptCipherByCipher(const EncryptionAlgorithm &ea, const ConstBufferPtr &key, const ConstBufferPtr &secondaryKey, const BufferPtr &data) {
+    size_t keyOffset = 0;
+    for (auto c = ea.GetCiphers().begin(); c != ea.GetCiphers().end(); ++c) {
+        size_t keySize = (*c)->GetKeySize();
+
+        shared_ptr<Cipher> cipher = (*c)->GetNew();
+        cipher->SetKey(key.GetRange(keyOffset, keySize));
+
+        CipherList ciphers;
+        ciphers.push_back(cipher);
+
+        EncryptionModeXTS mode;
+        mode.SetCiphers(ciphers);
+        mode.SetKey(secondaryKey.GetRange(keyOffset, keySize));
+        mode.Encrypt(data.Get(), data.Size());
+
+        keyOffset += keySize;
+    }
+}
+
+double MiBPerSecond(uint64 elapsedTime) {
+    return (double) BENCHMARK_BUFFER_SIZE / (1024 * 1024) / ((double) elapsedTime / 1000000000);
+}
+
+void CascadeBenchmark(shared_ptr<TestResult> r, EncryptionAlgorithm *ea) {
+    SecureBuffer key(ea->GetKeySize());
+    SecureBuffer secondaryKey(ea->GetKeySize());
+    FillBuffer(key, 1);
+    FillBuffer(secondaryKey, 2);
+
+    ea->SetKey(key);
+    shared_ptr<EncryptionMode> mode(new EncryptionModeXTS());
+    ea->SetMode(mode);
+    mode->SetKey(secondaryKey);
+
+    Buffer plaintext(BENCHMARK_BUFFER_SIZE);
+    Buffer reference(BENCHMARK_BUFFER_SIZE);
+    Buffer data(BENCHMARK_BUFFER_SIZE);
+    FillBuffer(plaintext, 3);
+
+    uint64 separateTime = 0, fusedTime = 0, fusedDecryptTime = 0;
+
+    for (int round = 0; round < BENCHMARK_ROUNDS; ++round) {
+        reference.CopyFrom(plaintext);
+        uint64 start = Time::GetMonotonic();
+        EncryptCipherByCipher(*ea, key, secondaryKey, reference);
+        uint64 elapsed = Time::GetMonotonic() - start;
+        if (round == 0 || elapsed < separateTime)
+            separateTime = elapsed;
+
+        data.CopyFrom(plaintext);
+        start = Time::GetMonotonic();
+        ea->Encrypt(data);
+        elapsed = Time::GetMonotonic() - start;
+        if (round == 0 || elapsed < fusedTime)
+            fusedTime = elapsed;
+
+        if (memcmp(data.Ptr(), reference.Ptr(), data.Size()) != 0) {
+            r->Failed("fused cascade ciphertext differs from cipher-by-cipher ciphertext");
+        }
+
+        start = Time::GetMonotonic();
+        ea->Decrypt(data);
+        elapsed = Time::GetMonotonic() - start;
+        if (round == 0 || elapsed < fusedDecryptTime)
+            fusedDecryptTime = elapsed;
+
+        if (memcmp(data.Ptr(), plaintext.Ptr(), data.Size()) != 0) {
+            r->Failed("fused cascade decryption does not restore the plaintext");
+        }
+    }
+
+    stringstream s;
+    s << fixed << setprecision(1)
+        << "cipher by cipher " << MiBPerSecond(separateTime) << " MiB/s, "
+        << "fused " << MiBPerSecond(fusedTime) << " MiB/s "
+        << "(x" << setprecision(2) << (double) separateTime / fusedTime << "), "
+        << "fused decryption " << setprecision(1) << MiBPerSecond(fusedDecryptTime) << " MiB/s";
+    r->Info(s.str());
+}
+
+}
+
+int main() {
+    using namespace VeraCrypt;
+    Testing t;
+
+    EncryptionAlgorithmList algorithms = VeraCrypt::EncryptionAlgorithm::GetAvailableAlgorithms();
+    for (auto ea = algorithms.begin(); ea != algorithms.end(); ++ea) {
+        if ((*ea)->GetCiphers().size() > 1 && (*ea)->IsModeSupported(shared_ptr<EncryptionMode>(new EncryptionModeXTS()))) {
+            t.AddTest(TestSuite::param<VeraCrypt::EncryptionAlgorithm>(StringConverter::ToSingle((*ea)->GetName()), &CascadeBenchmark, ea->get()));
+        }
+    }
+
+    t.Main();
+}
@@ -21,6 +21,9 @@
 #ifdef TC_AES_HW_CPU
 #	include "Crypto/Aes_hw_cpu.h"
 #endif
+#ifdef TC_AES_HW_VAES
+#	include "Crypto/Aes_hw_vaes.h"
+#endif
 
 extern "C" int IsAesHwCpuSupported ()
 {
@@ -39,6 +42,83 @@ extern "C" int IsAesHwCpuSupported ()
 #endif
 }
 
+#ifdef TC_AES_HW_VAES
+// Number of blocks per instruction of the widest VAES kernel usable on this CPU (0 if none)
+static int GetAesVaesKernelWidth ()
+{
+	static int width = -1;
+
+	if (width < 0)
+	{
+		if (aes_vaes_has_avx512() && HasVAES() && HasVPCLMULQDQ() && HasSAVX512F() && HasSAVX512VL())
+			width = 4;
+		else if (aes_vaes_has_avx2() && HasVAES() && HasVPCLMULQDQ() && HasSAVX2())
+			width = 2;
+		else
+			width = 0;
+	}
+	return width;
+}
+#endif
+
+#if CRYPTOPP_BOOL_SSE2_INTRINSICS_AVAILABLE && !defined(CRYPTOPP_DISABLE_ASM) && !defined(WOLFCRYPT_BACKEND)
+// Number of blocks per call of the widest bitsliced Serpent kernel usable on this CPU (4 if only SSE2)
+static int GetSerpentKernelWidth ()
+{
+	static int width = -1;
+
+	if (width < 0)
+	{
+		if (serpent_simd_has_avx512() && HasSAVX512F() && HasSAVX512VL())
+			width = 16;
+		else if (serpent_simd_has_avx2() && HasSAVX2())
+			width = 8;
+		else
+			width = 4;
+	}
+	return width;
+}
+#endif
+
+#if CRYPTOPP_BOOL_X64 && !defined(CRYPTOPP_DISABLE_ASM) && !defined(WOLFCRYPT_BACKEND)
+static bool IsTwofishAvx2Available ()
+{
+	static int state = -1;
+
+	if (state < 0)
+		state = (twofish_has_avx2() && HasSAVX2()) ? 1 : 0;
+	return state != 0;
+}
+
+// 32-way Camellia kernel usable on this CPU: 2 for VAES, 1 for AVX2 with AES-NI, 0 if none
+static int GetCamelliaKernel ()
+{
+	static int kernel = -1;
+
+	if (kernel < 0)
+	{
+		if (camellia_has_vaes() && HasVAES() && HasSAVX2())
+			kernel = 2;
+		else if (camellia_has_avx2() && HasSAVX2() && HasAESNI())
+			kernel = 1;
+		else
+			kernel = 0;
+	}
+	return kernel;
+}
+#endif
+
+#if CRYPTOPP_BOOL_SSE2_INTRINSICS_AVAILABLE && !defined(WOLFCRYPT_BACKEND)
+static bool IsKuznyechikGfniAvailable ()
+{
+	static int state = -1;
+
+	if (state < 0)
+		state = (kuznyechik_has_gfni() && HasGFNI() && HasSAVX512BW() && HasSAVX512VL() && HasSAVX512VBMI()) ? 1 : 0;
+	return state != 0;
+}
+#endif
+
 namespace VeraCrypt
 {
 	Cipher::Cipher () : Initialized (false)
@@ -239,6 +319,56 @@ namespace VeraCrypt
 	}
     #endif
 
+	bool CipherAES::DecryptDataUnitsXTS (const Cipher &secondaryCipher, uint8 *data, uint64 blockCount, uint64 dataUnitNo, unsigned int startBlock) const
+	{
+		if (!Initialized)
+			throw NotInitialized (SRC_POS);
+
+#ifdef TC_AES_HW_VAES
+		const CipherAES *tweakCipher = dynamic_cast <const CipherAES *> (&secondaryCipher);
+
+		if (tweakCipher && IsHwSupportAvailable())
+		{
+			switch (GetAesVaesKernelWidth())
+			{
+			case 4:
+				aes_vaes_xts_decrypt_avx512 (ScheduledKey.Ptr() + sizeof (aes_encrypt_ctx), tweakCipher->ScheduledKey.Ptr(), data, blockCount, dataUnitNo, startBlock);
+				return true;
+
+			case 2:
+				aes_vaes_xts_decrypt_avx2 (ScheduledKey.Ptr() + sizeof (aes_encrypt_ctx), tweakCipher->ScheduledKey.Ptr(), data, blockCount, dataUnitNo, startBlock);
+				return true;
+			}
+		}
+#endif
+		return false;
+	}
+
+	bool CipherAES::EncryptDataUnitsXTS (const Cipher &secondaryCipher, uint8 *data, uint64 blockCount, uint64 dataUnitNo, unsigned int startBlock) const
+	{
+		if (!Initialized)
+			throw NotInitialized (SRC_POS);
+
+#ifdef TC_AES_HW_VAES
+		const CipherAES *tweakCipher = dynamic_cast <const CipherAES *> (&secondaryCipher);
+
+		if (tweakCipher && IsHwSupportAvailable())
+		{
+			switch (GetAesVaesKernelWidth())
+			{
+			case 4:
+				aes_vaes_xts_encrypt_avx512 (ScheduledKey.Ptr(), tweakCipher->ScheduledKey.Ptr(), data, blockCount, dataUnitNo, startBlock);
+				return true;
+
+			case 2:
+				aes_vaes_xts_encrypt_avx2 (ScheduledKey.Ptr(), tweakCipher->ScheduledKey.Ptr(), data, blockCount, dataUnitNo, startBlock);
+				return true;
+			}
+		}
+#endif
+		return false;
+	}
+
 	size_t CipherAES::GetScheduledKeySize () const
 	{
 		return sizeof(aes_encrypt_ctx) + sizeof(aes_decrypt_ctx);
@@ -301,7 +431,25 @@ namespace VeraCrypt
 		if ((blockCount >= 4)
 			&& IsHwSupportAvailable())
 		{
-			serpent_encrypt_blocks (data, data, blockCount, ScheduledKey.Ptr());
+			const unsigned __int32 *roundKey = ((const unsigned __int32 *) ScheduledKey.Ptr()) + 8;
+			int width = GetSerpentKernelWidth ();
+
+			if (width >= 16 && blockCount >= 16)
+			{
+				serpent_simd_encrypt_blocks_avx512 (data, data, blockCount, roundKey);
+				data += (blockCount & ~(size_t) 15) * 16;
+				blockCount &= 15;
+			}
+
+			if (width >= 8 && blockCount >= 8)
+			{
+				serpent_simd_encrypt_blocks_avx2 (data, data, blockCount, roundKey);
+				data += (blockCount & ~(size_t) 7) * 16;
+				blockCount &= 7;
+			}
+
+			if (blockCount > 0)
+				serpent_encrypt_blocks (data, data, blockCount, ScheduledKey.Ptr());
 		}
 		else
 #endif
@@ -317,7 +465,25 @@ namespace VeraCrypt
 		if ((blockCount >= 4)
 			&& IsHwSupportAvailable())
 		{
-			serpent_decrypt_blocks (data, data, blockCount, ScheduledKey.Ptr());
+			const unsigned __int32 *roundKey = ((const unsigned __int32 *) ScheduledKey.Ptr()) + 8;
+			int width = GetSerpentKernelWidth ();
+
+			if (width >= 16 && blockCount >= 16)
+			{
+				serpent_simd_decrypt_blocks_avx512 (data, data, blockCount, roundKey);
+				data += (blockCount & ~(size_t) 15) * 16;
+				blockCount &= 15;
+			}
+
+			if (width >= 8 && blockCount >= 8)
+			{
+				serpent_simd_decrypt_blocks_avx2 (data, data, blockCount, roundKey);
+				data += (blockCount & ~(size_t) 7) * 16;
+				blockCount &= 7;
+			}
+
+			if (blockCount > 0)
+				serpent_decrypt_blocks (data, data, blockCount, ScheduledKey.Ptr());
 		}
 		else
 #endif
@@ -369,7 +535,15 @@ namespace VeraCrypt
 			throw NotInitialized (SRC_POS);
 
 #if CRYPTOPP_BOOL_X64 && !defined(CRYPTOPP_DISABLE_ASM)
-		twofish_encrypt_blocks ( (TwofishInstance *) ScheduledKey.Ptr(), data, data, blockCount);
+		if (blockCount >= 16 && IsTwofishAvx2Available())
+		{
+			twofish_encrypt_blocks_avx2 ((const TwofishInstance *) ScheduledKey.Ptr(), data, data, blockCount);
+			data += (blockCount & ~(size_t) 15) * 16;
+			blockCount &= 15;
+		}
+
+		if (blockCount > 0)
+			twofish_encrypt_blocks ( (TwofishInstance *) ScheduledKey.Ptr(), data, data, blockCount);
 #else
 		Cipher::EncryptBlocks (data, blockCount);
 #endif
@@ -381,7 +555,15 @@ namespace VeraCrypt
 			throw NotInitialized (SRC_POS);
 
 #if CRYPTOPP_BOOL_X64 && !defined(CRYPTOPP_DISABLE_ASM)
-		twofish_decrypt_blocks ( (TwofishInstance *) ScheduledKey.Ptr(), data, data, blockCount);
+		if (blockCount >= 16 && IsTwofishAvx2Available())
+		{
+			twofish_decrypt_blocks_avx2 ((const TwofishInstance *) ScheduledKey.Ptr(), data, data, blockCount);
+			data += (blockCount & ~(size_t) 15) * 16;
+			blockCount &= 15;
+		}
+
+		if (blockCount > 0)
+			twofish_decrypt_blocks ( (TwofishInstance *) ScheduledKey.Ptr(), data, data, blockCount);
 #else
 		Cipher::DecryptBlocks (data, blockCount);
 #endif
@@ -423,7 +605,21 @@ namespace VeraCrypt
 			throw NotInitialized (SRC_POS);
 
 #if CRYPTOPP_BOOL_X64 && !defined(CRYPTOPP_DISABLE_ASM)
-		camellia_encrypt_blocks ( ScheduledKey.Ptr(), data, data, blockCount);
+		int kernel = (blockCount >= 32) ? GetCamelliaKernel () : 0;
+
+		if (kernel != 0)
+		{
+			if (kernel == 2)
+				camellia_encrypt_blocks_vaes (ScheduledKey.Ptr(), data, data, blockCount);
+			else
+				camellia_encrypt_blocks_avx2 (ScheduledKey.Ptr(), data, data, blockCount);
+
+			data += (blockCount & ~(size_t) 31) * 16;
+			blockCount &= 31;
+		}
+
+		if (blockCount > 0)
+			camellia_encrypt_blocks ( ScheduledKey.Ptr(), data, data, blockCount);
 #else
 		Cipher::EncryptBlocks (data, blockCount);
 #endif
@@ -435,7 +631,21 @@ namespace VeraCrypt
 			throw NotInitialized (SRC_POS);
 
 #if CRYPTOPP_BOOL_X64 && !defined(CRYPTOPP_DISABLE_ASM)
-		camellia_decrypt_blocks ( ScheduledKey.Ptr(), data, data, blockCount);
+		int kernel = (blockCount >= 32) ? GetCamelliaKernel () : 0;
+
+		if (kernel != 0)
+		{
+			if (kernel == 2)
+				camellia_decrypt_blocks_vaes (ScheduledKey.Ptr(), data, data, blockCount);
+			else
+				camellia_decrypt_blocks_avx2 (ScheduledKey.Ptr(), data, data, blockCount);
+
+			data += (blockCount & ~(size_t) 31) * 16;
+			blockCount &= 31;
+		}
+
+		if (blockCount > 0)
+			camellia_decrypt_blocks ( ScheduledKey.Ptr(), data, data, blockCount);
 #else
 		Cipher::DecryptBlocks (data, blockCount);
 #endif
@@ -479,7 +689,15 @@ namespace VeraCrypt
 		if ((blockCount >= 4)
 			&& IsHwSupportAvailable())
 		{
-			kuznyechik_encrypt_blocks (data, data, blockCount, (kuznyechik_kds *) ScheduledKey.Ptr());
+			if (blockCount >= 16 && IsKuznyechikGfniAvailable())
+			{
+				kuznyechik_encrypt_blocks_gfni (data, data, blockCount, (const kuznyechik_kds *) ScheduledKey.Ptr());
+				data += (blockCount & ~(size_t) 15) * 16;
+				blockCount &= 15;
+			}
+
+			if (blockCount > 0)
+				kuznyechik_encrypt_blocks (data, data, blockCount, (kuznyechik_kds *) ScheduledKey.Ptr());
 		}
 		else
 #endif
@@ -495,7 +713,15 @@ namespace VeraCrypt
 		if ((blockCount >= 4)
 			&& IsHwSupportAvailable())
 		{
-			kuznyechik_decrypt_blocks (data, data, blockCount, (kuznyechik_kds *) ScheduledKey.Ptr());
+			if (blockCount >= 16 && IsKuznyechikGfniAvailable())
+			{
+				kuznyechik_decrypt_blocks_gfni (data, data, blockCount, (const kuznyechik_kds *) ScheduledKey.Ptr());
+				data += (blockCount & ~(size_t) 15) * 16;
+				blockCount &= 15;
+			}
+
+			if (blockCount > 0)
+				kuznyechik_decrypt_blocks (data, data, blockCount, (kuznyechik_kds *) ScheduledKey.Ptr());
 		}
 		else
 #endif
@@ -46,6 +46,10 @@ namespace VeraCrypt
 		virtual shared_ptr <Cipher> GetNew () const = 0;
 		virtual bool IsHwSupportAvailable () const { return false; }
 		static bool IsHwSupportEnabled () { return HwSupportEnabled; }
+		// XTS over consecutive blocks of data units, whitening included, in a single call.
+		// Returns false if the cipher has no such kernel for this CPU and the caller must use EncryptBlocks().
+		virtual bool EncryptDataUnitsXTS (const Cipher &secondaryCipher, uint8 *data, uint64 blockCount, uint64 dataUnitNo, unsigned int startBlock) const { return false; }
+		virtual bool DecryptDataUnitsXTS (const Cipher &secondaryCipher, uint8 *data, uint64 blockCount, uint64 dataUnitNo, unsigned int startBlock) const { return false; }
 		virtual void SetKey (const ConstBufferPtr &key);
 
 		static const int MaxBlockSize = 16;
@@ -143,7 +147,22 @@ namespace VeraCrypt
 	virtual void EncryptBlocks (uint8 *data, size_t blockCount) const; \
 	virtual bool IsHwSupportAvailable () const;
 
+#undef TC_CIPHER_ADD_METHODS
+#define TC_CIPHER_ADD_METHODS \
+	virtual void DecryptBlocks (uint8 *data, size_t blockCount) const; \
+	virtual void EncryptBlocks (uint8 *data, size_t blockCount) const; \
+	virtual bool IsHwSupportAvailable () const; \
+	virtual bool EncryptDataUnitsXTS (const Cipher &secondaryCipher, uint8 *data, uint64 blockCount, uint64 dataUnitNo, unsigned int startBlock) const; \
+	virtual bool DecryptDataUnitsXTS (const Cipher &secondaryCipher, uint8 *data, uint64 blockCount, uint64 dataUnitNo, unsigned int startBlock) const;
+
 	TC_CIPHER (AES, 16, 32);
+
+#undef TC_CIPHER_ADD_METHODS
+#define TC_CIPHER_ADD_METHODS \
+	virtual void DecryptBlocks (uint8 *data, size_t blockCount) const; \
+	virtual void EncryptBlocks (uint8 *data, size_t blockCount) const; \
+	virtual bool IsHwSupportAvailable () const;
+
 	TC_CIPHER (Serpent, 16, 32);
 	TC_CIPHER (Twofish, 16, 32);
 	TC_CIPHER (Camellia, 16, 32);
@@ -43,6 +43,39 @@ namespace VeraCrypt
 		Mode->DecryptSectors (data, sectorIndex, sectorCount, sectorSize);
 	}
 
+	void EncryptionAlgorithm::DecryptSectors (const SectorRun *runs, size_t runCount, size_t sectorSize) const
+	{
+		if_debug (ValidateState());
+		Mode->DecryptSectors (runs, runCount, sectorSize);
+	}
+
+	void EncryptionAlgorithm::DecryptSparseSectors (uint8 *data, uint64 sectorIndex, uint64 sectorCount, size_t sectorSize) const
+	{
+		if_debug (ValidateState());
+
+		// Sectors consisting of zero bytes were read from holes of a sparse host file and are returned as
+		// zeros. Ciphertext of zero bytes only is practically impossible. Other sectors are decrypted in runs,
+		// which are dispatched as one batch.
+		vector <SectorRun> runs;
+		uint64 runStart = 0;
+
+		for (uint64 i = 0; i <= sectorCount; ++i)
+		{
+			uint8 *sector = data + i * sectorSize;
+
+			if (i < sectorCount && (sector[0] != 0 || memcmp (sector, sector + 1, sectorSize - 1) != 0))
+				continue;
+
+			if (i > runStart)
+				runs.push_back (SectorRun (data + runStart * sectorSize, sectorIndex + runStart, i - runStart));
+
+			runStart = i + 1;
+		}
+
+		if (!runs.empty())
+			Mode->DecryptSectors (&runs.front(), runs.size(), sectorSize);
+	}
+
 	void EncryptionAlgorithm::Encrypt (uint8 *data, uint64 length) const
 	{
 		if_debug (ValidateState());
@@ -60,6 +93,12 @@ namespace VeraCrypt
 		Mode->EncryptSectors (data, sectorIndex, sectorCount, sectorSize);
 	}
 
+	void EncryptionAlgorithm::EncryptSectors (const SectorRun *runs, size_t runCount, size_t sectorSize) const
+	{
+		if_debug (ValidateState ());
+		Mode->EncryptSectors (runs, runCount, sectorSize);
+	}
+
 	EncryptionAlgorithmList EncryptionAlgorithm::GetAvailableAlgorithms ()
 	{
 		EncryptionAlgorithmList l;
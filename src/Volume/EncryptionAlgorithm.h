@@ -30,9 +30,12 @@ namespace VeraCrypt
 		virtual void Decrypt (uint8 *data, uint64 length) const;
 		virtual void Decrypt (const BufferPtr &data) const;
 		virtual void DecryptSectors (uint8 *data, uint64 sectorIndex, uint64 sectorCount, size_t sectorSize) const;
+		virtual void DecryptSectors (const SectorRun *runs, size_t runCount, size_t sectorSize) const;
+		virtual void DecryptSparseSectors (uint8 *data, uint64 sectorIndex, uint64 sectorCount, size_t sectorSize) const;
 		virtual void Encrypt (uint8 *data, uint64 length) const;
 		virtual void Encrypt (const BufferPtr &data) const;
 		virtual void EncryptSectors (uint8 *data, uint64 sectorIndex, uint64 sectorCount, size_t sectorSize) const;
+		virtual void EncryptSectors (const SectorRun *runs, size_t runCount, size_t sectorSize) const;
 		static EncryptionAlgorithmList GetAvailableAlgorithms ();
 		virtual const CipherList &GetCiphers () const { return Ciphers; }
 		virtual shared_ptr <EncryptionAlgorithm> GetNew () const = 0;
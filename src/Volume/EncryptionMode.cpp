@@ -19,7 +19,7 @@
 
 namespace VeraCrypt
 {
-	EncryptionMode::EncryptionMode () : KeySet (false), SectorOffset (0)
+	EncryptionMode::EncryptionMode () : KeySet (false), MinFragmentSize (0), SectorOffset (0)
 	{
 	}
 
@@ -32,11 +32,21 @@ namespace VeraCrypt
 		EncryptionThreadPool::DoWork (EncryptionThreadPool::WorkType::DecryptDataUnits, this, data, sectorIndex, sectorCount, sectorSize);
 	}
 
+	void EncryptionMode::DecryptSectors (const SectorRun *runs, size_t runCount, size_t sectorSize) const
+	{
+		EncryptionThreadPool::DoWork (EncryptionThreadPool::WorkType::DecryptDataUnits, this, runs, runCount, sectorSize);
+	}
+
 	void EncryptionMode::EncryptSectors (uint8 *data, uint64 sectorIndex, uint64 sectorCount, size_t sectorSize) const
 	{
 		EncryptionThreadPool::DoWork (EncryptionThreadPool::WorkType::EncryptDataUnits, this, data, sectorIndex, sectorCount, sectorSize);
 	}
 
+	void EncryptionMode::EncryptSectors (const SectorRun *runs, size_t runCount, size_t sectorSize) const
+	{
+		EncryptionThreadPool::DoWork (EncryptionThreadPool::WorkType::EncryptDataUnits, this, runs, runCount, sectorSize);
+	}
+
 	EncryptionModeList EncryptionMode::GetAvailableModes ()
 	{
 		EncryptionModeList l;
@@ -13,6 +13,7 @@
 #ifndef TC_HEADER_Encryption_EncryptionMode
 #define TC_HEADER_Encryption_EncryptionMode
 
+#include <atomic>
 #include "Platform/Platform.h"
 #include "Common/Crypto.h"
 #include "Cipher.h"
@@ -22,6 +23,17 @@ namespace VeraCrypt
 	class EncryptionMode;
 	typedef list < shared_ptr <EncryptionMode> > EncryptionModeList;
 
+	// Contiguous sectors of a scatter-gather list processed by a single batch call
+	struct SectorRun
+	{
+		SectorRun () : Data (nullptr), SectorIndex (0), SectorCount (0) { }
+		SectorRun (uint8 *data, uint64 sectorIndex, uint64 sectorCount) : Data (data), SectorIndex (sectorIndex), SectorCount (sectorCount) { }
+
+		uint8 *Data;
+		uint64 SectorIndex;
+		uint64 SectorCount;
+	};
+
 	class EncryptionMode
 	{
 	public:
@@ -29,9 +41,11 @@ namespace VeraCrypt
 
 		virtual void Decrypt (uint8 *data, uint64 length) const = 0;
 		virtual void DecryptSectors (uint8 *data, uint64 sectorIndex, uint64 sectorCount, size_t sectorSize) const;
+		virtual void DecryptSectors (const SectorRun *runs, size_t runCount, size_t sectorSize) const;
 		virtual void DecryptSectorsCurrentThread (uint8 *data, uint64 sectorIndex, uint64 sectorCount, size_t sectorSize) const = 0;
 		virtual void Encrypt (uint8 *data, uint64 length) const = 0;
 		virtual void EncryptSectors (uint8 *data, uint64 sectorIndex, uint64 sectorCount, size_t sectorSize) const;
+		virtual void EncryptSectors (const SectorRun *runs, size_t runCount, size_t sectorSize) const;
 		virtual void EncryptSectorsCurrentThread (uint8 *data, uint64 sectorIndex, uint64 sectorCount, size_t sectorSize) const = 0;
 		static EncryptionModeList GetAvailableModes ();
 		virtual const SecureBuffer &GetKey () const { throw NotApplicable (SRC_POS); }
@@ -55,9 +69,12 @@ namespace VeraCrypt
 
 		CipherList Ciphers;
 		bool KeySet;
+		mutable std::atomic <size_t> MinFragmentSize;	// Measured by EncryptionThreadPool, zero until then
 		uint64 SectorOffset;
 
 	private:
+		friend class EncryptionThreadPool;
+
 		EncryptionMode (const EncryptionMode &);
 		EncryptionMode &operator= (const EncryptionMode &);
 	};
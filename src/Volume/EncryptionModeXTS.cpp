@@ -14,36 +14,36 @@
 #include "Crypto/misc.h"
 #include "EncryptionModeXTS.h"
 #include "Common/Crypto.h"
+#include "Crypto/XtsTweak.h"
 
-#if (CRYPTOPP_BOOL_SSE2_INTRINSICS_AVAILABLE && CRYPTOPP_BOOL_X64)
-
-#define XorBlocks(result,ptr,len,start,end) \
-	while (len >= 2) \
-	{ \
-		__m128i xmm1 = _mm_loadu_si128((const __m128i*) ptr); \
-		__m128i xmm2 = _mm_loadu_si128((__m128i*)result); \
-		__m128i xmm3 = _mm_loadu_si128((const __m128i*) (ptr + 2)); \
-		__m128i xmm4 = _mm_loadu_si128((__m128i*)(result + 2)); \
-		\
-		_mm_storeu_si128((__m128i*)result, _mm_xor_si128(xmm1, xmm2)); \
-		_mm_storeu_si128((__m128i*)(result + 2), _mm_xor_si128(xmm3, xmm4)); \
-		ptr+= 4; \
-		result+= 4; \
-		len -= 2; \
-	} \
-	\
-	if (len) \
-	{ \
-		__m128i xmm1 = _mm_loadu_si128((const __m128i*)ptr); \
-		__m128i xmm2 = _mm_loadu_si128((__m128i*)result); \
-		\
-		_mm_storeu_si128((__m128i*)result, _mm_xor_si128(xmm1, xmm2)); \
-		ptr+= 2; \
-		result+= 2; \
-	} \
-	len = end - start;
+// XORs one whitening value into every block (XTS pre- and post-whitening)
+static void XorWhiteningValues (uint8 *data, const uint8 *whiteningValues, size_t blockCount)
+{
+#if CRYPTOPP_BOOL_SSE2_INTRINSICS_AVAILABLE
+	for (; blockCount >= 2; blockCount -= 2)
+	{
+		__m128i b0 = _mm_xor_si128 (_mm_loadu_si128 ((const __m128i *) data), _mm_loadu_si128 ((const __m128i *) whiteningValues));
+		__m128i b1 = _mm_xor_si128 (_mm_loadu_si128 ((const __m128i *) (data + 16)), _mm_loadu_si128 ((const __m128i *) (whiteningValues + 16)));
+
+		_mm_storeu_si128 ((__m128i *) data, b0);
+		_mm_storeu_si128 ((__m128i *) (data + 16), b1);
+		data += 32;
+		whiteningValues += 32;
+	}
+
+	if (blockCount)
+		_mm_storeu_si128 ((__m128i *) data, _mm_xor_si128 (_mm_loadu_si128 ((const __m128i *) data), _mm_loadu_si128 ((const __m128i *) whiteningValues)));
+#else
+	uint64 *dataPtr64 = (uint64 *) data;
+	const uint64 *whiteningValuesPtr64 = (const uint64 *) whiteningValues;
 
+	while (blockCount-- > 0)
+	{
+		*dataPtr64++ ^= *whiteningValuesPtr64++;
+		*dataPtr64++ ^= *whiteningValuesPtr64++;
+	}
 #endif
+}
 
 namespace VeraCrypt
 {
@@ -56,50 +56,51 @@ namespace VeraCrypt
 	{
 		if_debug (ValidateState());
 
-		CipherList::const_iterator iSecondaryCipher = SecondaryCiphers.begin();
+		// A cascade is applied to one chunk of data units at a time so that the data stays in cache
+		// between the ciphers. Data units are independent, which keeps the ciphertext unchanged.
+		uint64 chunkSize = length;
+		if (Ciphers.size() > 1)
+			chunkSize = CascadeChunkSize;
 
-		for (CipherList::const_iterator iCipher = Ciphers.begin(); iCipher != Ciphers.end(); ++iCipher)
+		while (length > 0)
 		{
-			EncryptBufferXTS (**iCipher, **iSecondaryCipher, data, length, startDataUnitNo, 0);
-			++iSecondaryCipher;
-		}
+			uint64 size = length < chunkSize ? length : chunkSize;
+			CipherList::const_iterator iSecondaryCipher = SecondaryCiphers.begin();
 
-		assert (iSecondaryCipher == SecondaryCiphers.end());
+			for (CipherList::const_iterator iCipher = Ciphers.begin(); iCipher != Ciphers.end(); ++iCipher)
+			{
+				EncryptBufferXTS (**iCipher, **iSecondaryCipher, data, size, startDataUnitNo, 0);
+				++iSecondaryCipher;
+			}
+
+			assert (iSecondaryCipher == SecondaryCiphers.end());
+
+			data += size;
+			length -= size;
+			startDataUnitNo += size / ENCRYPTION_DATA_UNIT_SIZE;
+		}
 	}
 
 	void EncryptionModeXTS::EncryptBufferXTS (const Cipher &cipher, const Cipher &secondaryCipher, uint8 *buffer, uint64 length, uint64 startDataUnitNo, unsigned int startCipherBlockNo) const
 	{
-                uint8 finalCarry;
 		uint8 whiteningValues [ENCRYPTION_DATA_UNIT_SIZE];
 		uint8 whiteningValue [BYTES_PER_XTS_BLOCK];
-		uint8 byteBufUnitNo [BYTES_PER_XTS_BLOCK];
-		uint64 *whiteningValuesPtr64 = (uint64 *) whiteningValues;
-		uint64 *whiteningValuePtr64 = (uint64 *) whiteningValue;
-		uint64 *bufPtr = (uint64 *) buffer;
-		uint64 *dataUnitBufPtr;
-		unsigned int startBlock = startCipherBlockNo, endBlock, block, countBlock;
+		unsigned int startBlock = startCipherBlockNo, endBlock, countBlock;
 		uint64 remainingBlocks, dataUnitNo;
 
 		startDataUnitNo += SectorOffset;
 
-		/* The encrypted data unit number (i.e. the resultant ciphertext block) is to be multiplied in the
-		finite field GF(2^128) by j-th power of n, where j is the sequential plaintext/ciphertext block
-		number and n is 2, a primitive element of GF(2^128). This can be (and is) simplified and implemented
-		as a left shift of the preceding whitening value by one bit (with carry propagating). In addition, if
-		the shift of the highest byte results in a carry, 135 is XORed into the lowest byte. The value 135 is
-		derived from the modulus of the Galois Field (x^128+x^7+x^2+x+1). */
-
-		// Convert the 64-bit data unit number into a little-endian 16-byte array.
-		// Note that as we are converting a 64-bit number into a 16-byte array we can always zero the last 8 bytes.
-		dataUnitNo = startDataUnitNo;
-		*((uint64 *) byteBufUnitNo) = Endian::Little (dataUnitNo);
-		*((uint64 *) byteBufUnitNo + 1) = 0;
-
 		if (length % BYTES_PER_XTS_BLOCK)
 			TC_THROW_FATAL_EXCEPTION;
 
 		remainingBlocks = length / BYTES_PER_XTS_BLOCK;
 
+		// Ciphers with a dedicated XTS kernel (e.g. VAES) generate the whitening values themselves
+		if (cipher.EncryptDataUnitsXTS (secondaryCipher, buffer, remainingBlocks, startDataUnitNo, startBlock))
+			return;
+
+		dataUnitNo = startDataUnitNo;
+
 		// Process all blocks in the buffer
 		while (remainingBlocks > 0)
 		{
@@ -109,98 +110,25 @@ namespace VeraCrypt
 				endBlock = BLOCKS_PER_XTS_DATA_UNIT;
 			countBlock = endBlock - startBlock;
 
-			whiteningValuesPtr64 = (uint64 *) whiteningValues;
-			whiteningValuePtr64 = (uint64 *) whiteningValue;
-
 			// Encrypt the data unit number using the secondary key (in order to generate the first
-			// whitening value for this data unit)
-			*whiteningValuePtr64 = *((uint64 *) byteBufUnitNo);
-			*(whiteningValuePtr64 + 1) = 0;
+			// whitening value for this data unit). The 64-bit number is converted into a little-endian
+			// 16-byte array, the last 8 bytes of which are always zero.
+			*((uint64 *) whiteningValue) = Endian::Little (dataUnitNo);
+			*((uint64 *) whiteningValue + 1) = 0;
 			secondaryCipher.EncryptBlock (whiteningValue);
 
-			// Generate subsequent whitening values for blocks in this data unit. Note that all generated 128-bit
-			// whitening values are stored in memory as a sequence of 64-bit integers.
-			for (block = 0; block < endBlock; block++)
-			{
-				if (block >= startBlock)
-				{
-					*whiteningValuesPtr64++ = *whiteningValuePtr64++;
-					*whiteningValuesPtr64++ = *whiteningValuePtr64;
-				}
-				else
-					whiteningValuePtr64++;
-
-				// Derive the next whitening value
-
-#if BYTE_ORDER == LITTLE_ENDIAN
-
-				// Little-endian platforms
-
-				finalCarry =
-					(*whiteningValuePtr64 & 0x8000000000000000ULL) ?
-					135 : 0;
-
-				*whiteningValuePtr64-- <<= 1;
-
-				if (*whiteningValuePtr64 & 0x8000000000000000ULL)
-					*(whiteningValuePtr64 + 1) |= 1;
-
-				*whiteningValuePtr64 <<= 1;
-#else
-
-				// Big-endian platforms
-
-				finalCarry =
-					(*whiteningValuePtr64 & 0x80) ?
-					135 : 0;
-
-				*whiteningValuePtr64 = Endian::Little (Endian::Little (*whiteningValuePtr64) << 1);
-
-				whiteningValuePtr64--;
-
-				if (*whiteningValuePtr64 & 0x80)
-					*(whiteningValuePtr64 + 1) |= 0x0100000000000000ULL;
-
-				*whiteningValuePtr64 = Endian::Little (Endian::Little (*whiteningValuePtr64) << 1);
-#endif
-
-				whiteningValue[0] ^= finalCarry;
-			}
-
-			dataUnitBufPtr = bufPtr;
-			whiteningValuesPtr64 = (uint64 *) whiteningValues;
-
-			// Encrypt all blocks in this data unit
-#if (CRYPTOPP_BOOL_SSE2_INTRINSICS_AVAILABLE && CRYPTOPP_BOOL_X64)
-			XorBlocks (bufPtr, whiteningValuesPtr64, countBlock, startBlock, endBlock);
-#else
-			for (block = 0; block < countBlock; block++)
-			{
-				// Pre-whitening
-				*bufPtr++ ^= *whiteningValuesPtr64++;
-				*bufPtr++ ^= *whiteningValuesPtr64++;
-			}
-#endif
-			// Actual encryption
-			cipher.EncryptBlocks ((uint8 *) dataUnitBufPtr, countBlock);
+			// Generate the whitening values of all blocks to be processed in this data unit at once
+			xts_tweak_table (whiteningValues, whiteningValue, startBlock, countBlock);
 
-			bufPtr = dataUnitBufPtr;
-			whiteningValuesPtr64 = (uint64 *) whiteningValues;
+			// Pre-whitening, encryption and post-whitening
+			XorWhiteningValues (buffer, whiteningValues, countBlock);
+			cipher.EncryptBlocks (buffer, countBlock);
+			XorWhiteningValues (buffer, whiteningValues, countBlock);
 
-#if (CRYPTOPP_BOOL_SSE2_INTRINSICS_AVAILABLE && CRYPTOPP_BOOL_X64)
-			XorBlocks (bufPtr, whiteningValuesPtr64, countBlock, startBlock, endBlock);
-#else
-			for (block = 0; block < countBlock; block++)
-			{
-				// Post-whitening
-				*bufPtr++ ^= *whiteningValuesPtr64++;
-				*bufPtr++ ^= *whiteningValuesPtr64++;
-			}
-#endif
+			buffer += countBlock * BYTES_PER_XTS_BLOCK;
 			remainingBlocks -= countBlock;
 			startBlock = 0;
 			dataUnitNo++;
-			*((uint64 *) byteBufUnitNo) = Endian::Little (dataUnitNo);
 		}
 
 		FAST_ERASE64 (whiteningValue, sizeof (whiteningValue));
@@ -235,43 +163,48 @@ namespace VeraCrypt
 	{
 		if_debug (ValidateState());
 
-		CipherList::const_iterator iSecondaryCipher = SecondaryCiphers.end();
+		uint64 chunkSize = length;
+		if (Ciphers.size() > 1)
+			chunkSize = CascadeChunkSize;
 
-		for (CipherList::const_reverse_iterator iCipher = Ciphers.rbegin(); iCipher != Ciphers.rend(); ++iCipher)
+		while (length > 0)
 		{
-			--iSecondaryCipher;
-			DecryptBufferXTS (**iCipher, **iSecondaryCipher, data, length, startDataUnitNo, 0);
-		}
+			uint64 size = length < chunkSize ? length : chunkSize;
+			CipherList::const_iterator iSecondaryCipher = SecondaryCiphers.end();
+
+			for (CipherList::const_reverse_iterator iCipher = Ciphers.rbegin(); iCipher != Ciphers.rend(); ++iCipher)
+			{
+				--iSecondaryCipher;
+				DecryptBufferXTS (**iCipher, **iSecondaryCipher, data, size, startDataUnitNo, 0);
+			}
+
+			assert (iSecondaryCipher == SecondaryCiphers.begin());
 
-		assert (iSecondaryCipher == SecondaryCiphers.begin());
+			data += size;
+			length -= size;
+			startDataUnitNo += size / ENCRYPTION_DATA_UNIT_SIZE;
+		}
 	}
 
 	void EncryptionModeXTS::DecryptBufferXTS (const Cipher &cipher, const Cipher &secondaryCipher, uint8 *buffer, uint64 length, uint64 startDataUnitNo, unsigned int startCipherBlockNo) const
 	{
-		uint8 finalCarry;
 		uint8 whiteningValues [ENCRYPTION_DATA_UNIT_SIZE];
 		uint8 whiteningValue [BYTES_PER_XTS_BLOCK];
-		uint8 byteBufUnitNo [BYTES_PER_XTS_BLOCK];
-		uint64 *whiteningValuesPtr64 = (uint64 *) whiteningValues;
-		uint64 *whiteningValuePtr64 = (uint64 *) whiteningValue;
-		uint64 *bufPtr = (uint64 *) buffer;
-		uint64 *dataUnitBufPtr;
-		unsigned int startBlock = startCipherBlockNo, endBlock, block, countBlock;
+		unsigned int startBlock = startCipherBlockNo, endBlock, countBlock;
 		uint64 remainingBlocks, dataUnitNo;
 
 		startDataUnitNo += SectorOffset;
 
-		// Convert the 64-bit data unit number into a little-endian 16-byte array.
-		// Note that as we are converting a 64-bit number into a 16-byte array we can always zero the last 8 bytes.
-		dataUnitNo = startDataUnitNo;
-		*((uint64 *) byteBufUnitNo) = Endian::Little (dataUnitNo);
-		*((uint64 *) byteBufUnitNo + 1) = 0;
-
 		if (length % BYTES_PER_XTS_BLOCK)
 			TC_THROW_FATAL_EXCEPTION;
 
 		remainingBlocks = length / BYTES_PER_XTS_BLOCK;
 
+		if (cipher.DecryptDataUnitsXTS (secondaryCipher, buffer, remainingBlocks, startDataUnitNo, startBlock))
+			return;
+
+		dataUnitNo = startDataUnitNo;
+
 		// Process all blocks in the buffer
 		while (remainingBlocks > 0)
 		{
@@ -281,100 +214,30 @@ namespace VeraCrypt
 				endBlock = BLOCKS_PER_XTS_DATA_UNIT;
 			countBlock = endBlock - startBlock;
 
-			whiteningValuesPtr64 = (uint64 *) whiteningValues;
-			whiteningValuePtr64 = (uint64 *) whiteningValue;
-
 			// Encrypt the data unit number using the secondary key (in order to generate the first
-			// whitening value for this data unit)
-			*whiteningValuePtr64 = *((uint64 *) byteBufUnitNo);
-			*(whiteningValuePtr64 + 1) = 0;
+			// whitening value for this data unit). The 64-bit number is converted into a little-endian
+			// 16-byte array, the last 8 bytes of which are always zero.
+			*((uint64 *) whiteningValue) = Endian::Little (dataUnitNo);
+			*((uint64 *) whiteningValue + 1) = 0;
 			secondaryCipher.EncryptBlock (whiteningValue);
 
-			// Generate subsequent whitening values for blocks in this data unit. Note that all generated 128-bit
-			// whitening values are stored in memory as a sequence of 64-bit integers.
-			for (block = 0; block < endBlock; block++)
-			{
-				if (block >= startBlock)
-				{
-					*whiteningValuesPtr64++ = *whiteningValuePtr64++;
-					*whiteningValuesPtr64++ = *whiteningValuePtr64;
-				}
-				else
-					whiteningValuePtr64++;
-
-				// Derive the next whitening value
-
-#if BYTE_ORDER == LITTLE_ENDIAN
-
-				// Little-endian platforms
-
-				finalCarry =
-					(*whiteningValuePtr64 & 0x8000000000000000ULL) ?
-					135 : 0;
-
-				*whiteningValuePtr64-- <<= 1;
-
-				if (*whiteningValuePtr64 & 0x8000000000000000ULL)
-					*(whiteningValuePtr64 + 1) |= 1;
+			// Generate the whitening values of all blocks to be processed in this data unit at once
+			xts_tweak_table (whiteningValues, whiteningValue, startBlock, countBlock);
 
-				*whiteningValuePtr64 <<= 1;
+			// Pre-whitening, decryption and post-whitening
+			XorWhiteningValues (buffer, whiteningValues, countBlock);
+			cipher.DecryptBlocks (buffer, countBlock);
+			XorWhiteningValues (buffer, whiteningValues, countBlock);
 
-#else
-				// Big-endian platforms
-
-				finalCarry =
-					(*whiteningValuePtr64 & 0x80) ?
-					135 : 0;
-
-				*whiteningValuePtr64 = Endian::Little (Endian::Little (*whiteningValuePtr64) << 1);
-
-				whiteningValuePtr64--;
-
-				if (*whiteningValuePtr64 & 0x80)
-					*(whiteningValuePtr64 + 1) |= 0x0100000000000000ULL;
-
-				*whiteningValuePtr64 = Endian::Little (Endian::Little (*whiteningValuePtr64) << 1);
-#endif
-
-				whiteningValue[0] ^= finalCarry;
-			}
-
-			dataUnitBufPtr = bufPtr;
-			whiteningValuesPtr64 = (uint64 *) whiteningValues;
-
-			// Decrypt blocks in this data unit
-#if (CRYPTOPP_BOOL_SSE2_INTRINSICS_AVAILABLE && CRYPTOPP_BOOL_X64)
-			XorBlocks (bufPtr, whiteningValuesPtr64, countBlock, startBlock, endBlock);
-#else
-			for (block = 0; block < countBlock; block++)
-			{
-				*bufPtr++ ^= *whiteningValuesPtr64++;
-				*bufPtr++ ^= *whiteningValuesPtr64++;
-			}
-#endif
-			cipher.DecryptBlocks ((uint8 *) dataUnitBufPtr, countBlock);
-
-			bufPtr = dataUnitBufPtr;
-			whiteningValuesPtr64 = (uint64 *) whiteningValues;
-#if (CRYPTOPP_BOOL_SSE2_INTRINSICS_AVAILABLE && CRYPTOPP_BOOL_X64)
-			XorBlocks (bufPtr, whiteningValuesPtr64, countBlock, startBlock, endBlock);
-#else
-			for (block = 0; block < countBlock; block++)
-			{
-				*bufPtr++ ^= *whiteningValuesPtr64++;
-				*bufPtr++ ^= *whiteningValuesPtr64++;
-			}
-#endif
+			buffer += countBlock * BYTES_PER_XTS_BLOCK;
 			remainingBlocks -= countBlock;
 			startBlock = 0;
 			dataUnitNo++;
-
-			*((uint64 *) byteBufUnitNo) = Endian::Little (dataUnitNo);
 		}
 
 		FAST_ERASE64 (whiteningValue, sizeof (whiteningValue));
 		FAST_ERASE64 (whiteningValues, sizeof (whiteningValues));
-        }
+	}
 
 	void EncryptionModeXTS::DecryptSectorsCurrentThread (uint8 *data, uint64 sectorIndex, uint64 sectorCount, size_t sectorSize) const
 	{
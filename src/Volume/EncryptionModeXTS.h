@@ -42,6 +42,8 @@ namespace VeraCrypt
 		void EncryptBufferXTS (const Cipher &cipher, const Cipher &secondaryCipher, uint8 *buffer, uint64 length, uint64 startDataUnitNo, unsigned int startCipherBlockNo) const;
 		void SetSecondaryCipherKeys ();
 
+		static const size_t CascadeChunkSize = 16 * ENCRYPTION_DATA_UNIT_SIZE;
+
 		SecureBuffer SecondaryKey;
 		CipherList SecondaryCiphers;
 
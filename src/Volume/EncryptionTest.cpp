@@ -21,6 +21,7 @@
 #endif
 #include "EncryptionTest.h"
 #include "Pkcs5Kdf.h"
+#include "Common/Pkcs5.h"
 
 namespace VeraCrypt
 {
@@ -40,6 +41,7 @@ namespace VeraCrypt
 		TestCiphers();
 		TestXtsAES();
 		TestXts();
+		TestSectorRuns();
 		TestPkcs5();
 	}
 
@@ -1108,6 +1110,102 @@ namespace VeraCrypt
 			throw TestFailed (SRC_POS);
 	}
 
+#ifndef WOLFCRYPT_BACKEND
+	// Block-by-block PBKDF2 built on the plain HMAC functions
+	static void DeriveKeyWithHmac (void (*hmac) (unsigned char *, int, unsigned char *, int), size_t digestSize, const BufferPtr &key, const VolumePassword &password, const ConstBufferPtr &salt, int iterationCount)
+	{
+		SecureBuffer u (salt.Size() + 4 > digestSize ? salt.Size() + 4 : digestSize);
+		SecureBuffer t (digestSize);
+
+		for (uint32 block = 1, offset = 0; offset < key.Size(); ++block, offset += digestSize)
+		{
+			u.GetRange (0, salt.Size()).CopyFrom (salt);
+			*reinterpret_cast <uint32 *> (u.Ptr() + salt.Size()) = Endian::Big (block);
+
+			hmac (password.DataPtr(), (int) password.Size(), u.Ptr(), (int) salt.Size() + 4);
+			t.CopyFrom (u.GetRange (0, digestSize));
+
+			for (int i = 1; i < iterationCount; ++i)
+			{
+				hmac (password.DataPtr(), (int) password.Size(), u.Ptr(), (int) digestSize);
+
+				for (size_t j = 0; j < digestSize; ++j)
+					t.Ptr()[j] ^= u.Ptr()[j];
+			}
+
+			size_t size = key.Size() - offset < digestSize ? key.Size() - offset : digestSize;
+			key.GetRange (offset, size).CopyFrom (t.GetRange (0, size));
+		}
+	}
+#endif
+
+	void EncryptionTest::TestSectorRuns ()
+	{
+		// A batch of runs must give the same results as the runs processed separately. Runs are
+		// separated by a sector which must not be modified.
+		static const size_t runCount = 5;
+		static const uint64 runSectorCounts[runCount] = { 1, 0, 37, 3, 64 };
+		static const uint64 runSectorIndexes[runCount] = { 0xffffffffffULL, 7, 1000, 0, 123456789 };
+
+		size_t sectorCount = runCount;
+		for (size_t i = 0; i < runCount; i++)
+			sectorCount += (size_t) runSectorCounts[i];
+
+		SecureBuffer plaintext (sectorCount * ENCRYPTION_DATA_UNIT_SIZE);
+		SecureBuffer batchData (plaintext.Size());
+		SecureBuffer runData (plaintext.Size());
+
+		for (size_t i = 0; i < plaintext.Size(); i++)
+			plaintext[i] = (uint8) (i * 31 + (i >> 9));
+
+		foreach_ref (EncryptionAlgorithm &ea, EncryptionAlgorithm::GetAvailableAlgorithms())
+		{
+                    #ifdef WOLFCRYPT_BACKEND
+                        shared_ptr <EncryptionMode> mode (new EncryptionModeWolfCryptXTS);
+                    #else
+                        shared_ptr <EncryptionMode> mode (new EncryptionModeXTS);
+                    #endif
+
+			if (!ea.IsModeSupported (mode))
+				continue;
+
+			Buffer key (ea.GetKeySize());
+			for (size_t i = 0; i < key.Size(); i++)
+				key[i] = (uint8) (i * 7 + 1);
+
+			ea.SetKey (key);
+			mode->SetKey (key);
+			ea.SetMode (mode);
+                    #ifdef WOLFCRYPT_BACKEND
+			ea.SetKeyXTS (key);
+                    #endif
+
+			batchData.CopyFrom (plaintext);
+			runData.CopyFrom (plaintext);
+
+			SectorRun runs[runCount];
+			size_t offset = 0;
+
+			for (size_t i = 0; i < runCount; i++)
+			{
+				runs[i] = SectorRun (batchData.Ptr() + offset, runSectorIndexes[i], runSectorCounts[i]);
+				ea.EncryptSectors (runData.Ptr() + offset, runSectorIndexes[i], runSectorCounts[i], ENCRYPTION_DATA_UNIT_SIZE);
+
+				offset += (size_t) (runSectorCounts[i] + 1) * ENCRYPTION_DATA_UNIT_SIZE;
+			}
+
+			ea.EncryptSectors (runs, runCount, ENCRYPTION_DATA_UNIT_SIZE);
+
+			if (memcmp (batchData.Ptr(), runData.Ptr(), batchData.Size()) != 0)
+				throw TestFailed (SRC_POS);
+
+			ea.DecryptSectors (runs, runCount, ENCRYPTION_DATA_UNIT_SIZE);
+
+			if (memcmp (batchData.Ptr(), plaintext.Ptr(), batchData.Size()) != 0)
+				throw TestFailed (SRC_POS);
+		}
+	}
+
 	void EncryptionTest::TestPkcs5 ()
 	{
 		VolumePassword password ((uint8*) "password", 8);
@@ -1140,6 +1238,19 @@ namespace VeraCrypt
 		pkcs5HmacStreebog.DeriveKey (derivedKey, password, salt, 5);
 		if (memcmp (derivedKey.Ptr(), "\xd0\x53\xa2\x30", 4) != 0)
 			throw TestFailed (SRC_POS);
+
+		// Keys spanning several digests are derived in parallel SIMD lanes when the CPU supports it
+		Buffer longKey (300), referenceKey (300);
+
+		pkcs5HmacSha256.DeriveKey (longKey, password, salt, 5);
+		DeriveKeyWithHmac (hmac_sha256, SHA256_DIGESTSIZE, referenceKey, password, salt, 5);
+		if (memcmp (longKey.Ptr(), referenceKey.Ptr(), longKey.Size()) != 0)
+			throw TestFailed (SRC_POS);
+
+		pkcs5HmacSha512.DeriveKey (longKey, password, salt, 5);
+		DeriveKeyWithHmac (hmac_sha512, SHA512_DIGESTSIZE, referenceKey, password, salt, 5);
+		if (memcmp (longKey.Ptr(), referenceKey.Ptr(), longKey.Size()) != 0)
+			throw TestFailed (SRC_POS);
          #else
                Pkcs5HmacSha256 pkcs5HmacSha256;
 		pkcs5HmacSha256.DeriveKey (derivedKey, password, salt, 5);
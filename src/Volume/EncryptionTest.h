@@ -28,6 +28,7 @@ namespace VeraCrypt
 		static void TestCiphers ();
 		static void TestLegacyModes ();
 		static void TestPkcs5 ();
+		static void TestSectorRuns ();
 		static void TestXts ();
 		static void TestXtsAES ();
 
@@ -10,17 +10,18 @@
  code distribution packages.
 */
 
+#include <algorithm>
+#include <set>
+
 #ifdef TC_UNIX
 #	include <unistd.h>
 #endif
 
-#ifdef TC_MACOSX
-#	include <sys/types.h>
-#	include <sys/sysctl.h>
-#endif
-
 #include "Platform/SyncEvent.h"
+#include "Platform/SystemInfo.h"
 #include "Platform/SystemLog.h"
+#include "Platform/Time.h"
+#include "Platform/Trace.h"
 #include "Common/Crypto.h"
 #include "EncryptionThreadPool.h"
 
@@ -28,179 +29,564 @@ namespace VeraCrypt
 {
 	void EncryptionThreadPool::DoWork (WorkType::Enum type, const EncryptionMode *encryptionMode, uint8 *data, uint64 startUnitNo, uint64 unitCount, size_t sectorSize)
 	{
-		size_t fragmentCount;
-		size_t unitsPerFragment;
-		size_t remainder;
+		SectorRun run;
+		run.Data = data;
+		run.SectorIndex = startUnitNo;
+		run.SectorCount = unitCount;
 
-		uint8 *fragmentData;
-		uint64 fragmentStartUnitNo;
+		DoWork (type, encryptionMode, &run, 1, sectorSize);
+	}
 
-		WorkItem *workItem;
-		WorkItem *firstFragmentWorkItem;
+	void EncryptionThreadPool::DoWork (WorkType::Enum type, const EncryptionMode *encryptionMode, const SectorRun *runs, size_t runCount, size_t sectorSize)
+	{
+		if (type != WorkType::EncryptDataUnits && type != WorkType::DecryptDataUnits)
+			throw ParameterIncorrect (SRC_POS);
+
+		uint64 unitCount = 0;
+		for (size_t i = 0; i < runCount; ++i)
+			unitCount += runs[i].SectorCount;
 
 		if (unitCount == 0)
 			return;
 
-		if (!ThreadPoolRunning || unitCount == 1)
+		uint64 splitUnitCount = 1;
+		if (ThreadPoolRunning)
+		{
+			splitUnitCount = GetMinFragmentSize (encryptionMode) / sectorSize;
+			if (splitUnitCount < 1)
+				splitUnitCount = 1;
+		}
+
+		// Small requests stay on the submitting thread
+		if (!ThreadPoolRunning || unitCount < 2 * splitUnitCount)
+		{
+			for (size_t i = 0; i < runCount; ++i)
+				ProcessFragment (type, encryptionMode, runs[i].Data, runs[i].SectorIndex, runs[i].SectorCount, sectorSize);
+
+			return;
+		}
+
+		trace_event_scope ("EncryptionThreadPool::DoWork", unitCount);
+
+		WorkCompletion completion (0);
+
+		WorkFragment fragment;
+		fragment.Type = type;
+		fragment.Completion = &completion;
+		fragment.Mode = encryptionMode;
+		fragment.SectorSize = sectorSize;
+		fragment.SplitUnitCount = splitUnitCount;
+
+		// Each run is a fragment, which is split further by the thread which processes it. The first
+		// run is processed by this thread, while the others are offered to the pool.
+		size_t firstRun = runCount;
+		size_t queuedCount = 0;
+
+		for (size_t i = 0; i < runCount; ++i)
 		{
-			switch (type)
+			if (runs[i].SectorCount == 0)
+				continue;
+
+			completion.AddFragment();
+
+			if (firstRun == runCount)
 			{
-			case WorkType::DecryptDataUnits:
-				encryptionMode->DecryptSectorsCurrentThread (data, startUnitNo, unitCount, sectorSize);
-				break;
+				firstRun = i;
+				continue;
+			}
 
-			case WorkType::EncryptDataUnits:
-				encryptionMode->EncryptSectorsCurrentThread (data, startUnitNo, unitCount, sectorSize);
-				break;
+			fragment.Data = runs[i].Data;
+			fragment.StartUnitNo = runs[i].SectorIndex;
+			fragment.UnitCount = runs[i].SectorCount;
 
-			default:
-				throw ParameterIncorrect (SRC_POS);
+			if (FragmentQueue.TryPush (fragment))
+			{
+				++queuedCount;
 			}
+			else
+			{
+				// The queue is full, which leaves the fragment to this thread
+				NotifyWorkers (queuedCount);
+				queuedCount = 0;
+
+				ExecuteFragment (fragment, nullptr);
+			}
+		}
+
+		trace_event ("EncryptionThreadPool::Enqueue", queuedCount);
+		NotifyWorkers (queuedCount);
+
+		fragment.Data = runs[firstRun].Data;
+		fragment.StartUnitNo = runs[firstRun].SectorIndex;
+		fragment.UnitCount = runs[firstRun].SectorCount;
+
+		ExecuteFragment (fragment, nullptr);
+		WaitForCompletion (completion);
+
+		unique_ptr <Exception> fragmentException (completion.ItemException.exchange (nullptr));
 
+		if (fragmentException)
+			fragmentException->Throw();
+	}
+
+	void EncryptionThreadPool::BeginKeyDerivation (shared_ptr <KeyDerivationRequest> request)
+	{
+		if (!request)
+			throw ParameterIncorrect (SRC_POS);
+
+		if (!ThreadPoolRunning)
+		{
+			DeriveKey (*request);
 			return;
 		}
 
-		if (unitCount <= ThreadCount)
+		// The queue only fills up with far more concurrent derivations than there are threads
+		if (!KeyDerivationQueue.TryPush (request))
 		{
-			fragmentCount = (size_t) unitCount;
-			unitsPerFragment = 1;
-			remainder = 0;
+			DeriveKey (*request);
+			return;
 		}
-		else
+
+		NotifyWorkers (1);
+	}
+
+	void EncryptionThreadPool::BeginWork (shared_ptr <WorkRequest> request)
+	{
+		if (!request || (request->Type != WorkType::EncryptDataUnits && request->Type != WorkType::DecryptDataUnits))
+			throw ParameterIncorrect (SRC_POS);
+
+		// A request may be submitted again once it is completed. Only its completion unit may still be
+		// outstanding, while the thread which completed it is returning from FragmentCompleted().
+		WorkCompletion &completion = request->Completion;
+		if ((completion.OutstandingFragmentCount.load (std::memory_order_acquire) & ~WorkCompletion::WaiterFlag) > 1)
+			throw ParameterIncorrect (SRC_POS);
+
+		completion.Wait();
+
+		delete completion.ItemException.exchange (nullptr);
+
+		const vector <SectorRun> &runs = request->Runs;
+
+		uint64 unitCount = 0;
+		for (size_t i = 0; i < runs.size(); ++i)
+			unitCount += runs[i].SectorCount;
+
+		// Without worker threads, runs are processed by this thread and are not split
+		uint64 splitUnitCount = unitCount;
+		if (ThreadPoolRunning)
+			splitUnitCount = GetMinFragmentSize (request->Mode) / request->SectorSize;
+
+		if (splitUnitCount < 1)
+			splitUnitCount = 1;
+
+		trace_event_scope ("EncryptionThreadPool::BeginWork", unitCount);
+
+		// The completion unit is released by FragmentCompleted() once the request is completed. The additional
+		// fragment of the submission keeps the request from being completed while its runs are being queued.
+		completion.AddFragment();
+		completion.AddFragment();
+		request->SelfReference = request;
+
+		WorkFragment fragment;
+		fragment.Type = request->Type;
+		fragment.Completion = &completion;
+		fragment.Mode = request->Mode;
+		fragment.SectorSize = request->SectorSize;
+		fragment.SplitUnitCount = splitUnitCount;
+
+		size_t queuedCount = 0;
+
+		for (size_t i = 0; i < runs.size(); ++i)
 		{
-			fragmentCount = ThreadCount;
-			unitsPerFragment = (size_t) unitCount / ThreadCount;
-			remainder = (size_t) unitCount % ThreadCount;
+			if (runs[i].SectorCount == 0)
+				continue;
+
+			fragment.Data = runs[i].Data;
+			fragment.StartUnitNo = runs[i].SectorIndex;
+			fragment.UnitCount = runs[i].SectorCount;
 
-			if (remainder > 0)
-				++unitsPerFragment;
+			completion.AddFragment();
+
+			if (ThreadPoolRunning && FragmentQueue.TryPush (fragment))
+			{
+				++queuedCount;
+			}
+			else
+			{
+				NotifyWorkers (queuedCount);
+				queuedCount = 0;
+
+				ExecuteFragment (fragment, nullptr);
+			}
 		}
 
-		fragmentData = data;
-		fragmentStartUnitNo = startUnitNo;
+		NotifyWorkers (queuedCount);
 
-		{
-			ScopeLock lock (EnqueueMutex);
-			firstFragmentWorkItem = &WorkItemQueue[EnqueuePosition];
+		// Completes the request if all runs have already been processed
+		completion.FragmentCompleted (nullptr);
+	}
 
-			while (firstFragmentWorkItem->State != WorkItem::State::Free)
+	shared_ptr <EncryptionThreadPool::WorkRequest> EncryptionThreadPool::CompleteRequest (WorkRequest &request)
+	{
+		// The self-reference is returned to the caller, which keeps the request alive until it has released
+		// the completion unit, after which the request may be released by its submitter
+		shared_ptr <WorkRequest> self;
+		self.swap (request.SelfReference);
+
+		if (request.CompletionQueue)
+			request.CompletionQueue->Add (self);
+
+		if (request.CompletionEvent)
+			request.CompletionEvent->Signal();
+
+		return self;
+	}
+
+	void EncryptionThreadPool::DeriveKey (KeyDerivationRequest &request)
+	{
+		try
+		{
+			if (!request.Cancelled)
 			{
-				WorkItemCompletedEvent.Wait();
+				uint64 startTime = Time::GetMonotonic();
+				request.Kdf->DeriveKey (request.DerivedKey, *request.Password, request.Pim, request.Salt, &request.Cancelled);
+				request.ElapsedTime = Time::GetMonotonic() - startTime;
 			}
+		}
+		catch (Exception &e)
+		{
+			request.DerivationException.reset (e.CloneNew());
+		}
+		catch (exception &e)
+		{
+			request.DerivationException.reset (new ExternalException (SRC_POS, StringConverter::ToExceptionString (e)));
+		}
+		catch (...)
+		{
+			request.DerivationException.reset (new UnknownException (SRC_POS));
+		}
+
+		request.Completed.Set (true);
 
-			firstFragmentWorkItem->OutstandingFragmentCount.Set (fragmentCount);
-			firstFragmentWorkItem->ItemException.reset();
+		if (request.CompletionEvent)
+			request.CompletionEvent->Signal();
+	}
 
-			while (fragmentCount-- > 0)
+	void EncryptionThreadPool::ExecuteFragment (WorkFragment fragment, WorkerDeque *deque)
+	{
+		// The second half of a large fragment is offered to idle threads, which split it further, until the
+		// rest is small enough to be processed by this thread. Workers push the halves to their own deque,
+		// from which the smaller ones are popped first and the larger ones are stolen by other threads.
+		while (fragment.UnitCount >= 2 * fragment.SplitUnitCount)
+		{
+			uint64 firstUnitCount = fragment.UnitCount / 2;
+
+			WorkFragment secondHalf = fragment;
+			secondHalf.Data += firstUnitCount * fragment.SectorSize;
+			secondHalf.StartUnitNo += firstUnitCount;
+			secondHalf.UnitCount -= firstUnitCount;
+
+			fragment.Completion->AddFragment();
+
+			if (!(deque ? deque->Push (secondHalf) : FragmentQueue.TryPush (secondHalf)))
 			{
-				workItem = &WorkItemQueue[EnqueuePosition++];
+				// Undoes AddFragment(), which cannot complete the request as this fragment is outstanding
+				fragment.Completion->FragmentCompleted (nullptr);
+				break;
+			}
 
-				if (EnqueuePosition >= QueueSize)
-					EnqueuePosition = 0;
+			NotifyWorkers (1);
+			fragment.UnitCount = firstUnitCount;
+		}
 
-				while (workItem->State != WorkItem::State::Free)
-				{
-					WorkItemCompletedEvent.Wait();
-				}
+		trace_event_begin ("EncryptionThreadPool::Fragment", fragment.UnitCount);
+		Exception *fragmentException = nullptr;
 
-				workItem->Type = type;
-				workItem->FirstFragment = firstFragmentWorkItem;
+		try
+		{
+			ProcessFragment (fragment.Type, fragment.Mode, fragment.Data, fragment.StartUnitNo, fragment.UnitCount, fragment.SectorSize);
+		}
+		catch (Exception &e)
+		{
+			fragmentException = e.CloneNew();
+		}
+		catch (exception &e)
+		{
+			fragmentException = new ExternalException (SRC_POS, StringConverter::ToExceptionString (e));
+		}
+		catch (...)
+		{
+			fragmentException = new UnknownException (SRC_POS);
+		}
 
-				workItem->Encryption.Mode = encryptionMode;
-				workItem->Encryption.Data = fragmentData;
-				workItem->Encryption.UnitCount = unitsPerFragment;
-				workItem->Encryption.StartUnitNo = fragmentStartUnitNo;
-				workItem->Encryption.SectorSize = sectorSize;
+		fragment.Completion->FragmentCompleted (fragmentException);
+		trace_event_end ("EncryptionThreadPool::Fragment");
+	}
 
-				fragmentData += unitsPerFragment * sectorSize;
-				fragmentStartUnitNo += unitsPerFragment;
+	bool EncryptionThreadPool::FindFragment (WorkFragment &fragment, WorkerDeque *deque, size_t workerIndex)
+	{
+		if (deque && deque->Pop (fragment))
+			return true;
 
-				if (remainder > 0 && --remainder == 0)
-					--unitsPerFragment;
+		if (FragmentQueue.TryPop (fragment))
+			return true;
 
-				workItem->State.Set (WorkItem::State::Ready);
-				WorkItemReadyEvent.Signal();
+		// Victims are visited in a different order by each thread
+		size_t dequeCount = WorkerDeques.size();
+		for (size_t i = 1; i <= dequeCount; ++i)
+		{
+			if (WorkerDeques[(workerIndex + i) % dequeCount]->Steal (fragment))
+			{
+				trace_event ("EncryptionThreadPool::Steal", fragment.UnitCount);
+				return true;
 			}
 		}
 
-		firstFragmentWorkItem->ItemCompletedEvent.Wait();
+		return false;
+	}
+
+	void EncryptionThreadPool::Configuration::Deserialize (Serializer &sr)
+	{
+		sr.Deserialize ("ThreadPoolThreadCount", ThreadCount);
+		sr.Deserialize ("ThreadPoolAvailableCpuCount", AvailableCpuCount);
+		sr.Deserialize ("ThreadPoolCpuQuota", CpuQuota);
+		sr.Deserialize ("ThreadPoolNumaNodeCount", NumaNodeCount);
+		sr.Deserialize ("ThreadPoolThreadsPinned", ThreadsPinned);
+	}
+
+	void EncryptionThreadPool::Configuration::Serialize (Serializer &sr) const
+	{
+		sr.Serialize ("ThreadPoolThreadCount", ThreadCount);
+		sr.Serialize ("ThreadPoolAvailableCpuCount", AvailableCpuCount);
+		sr.Serialize ("ThreadPoolCpuQuota", CpuQuota);
+		sr.Serialize ("ThreadPoolNumaNodeCount", NumaNodeCount);
+		sr.Serialize ("ThreadPoolThreadsPinned", ThreadsPinned);
+	}
+
+	void EncryptionThreadPool::EndWork (WorkRequest &request)
+	{
+		WaitForCompletion (request.Completion);
+
+		// The exception is kept by the request, so that each call of EndWork() throws it
+		Exception *requestException = request.Completion.ItemException.load (std::memory_order_acquire);
+
+		if (requestException)
+			requestException->Throw();
+	}
+
+	EncryptionThreadPool::Configuration EncryptionThreadPool::GetConfiguration ()
+	{
+		return CurrentConfiguration;
+	}
+
+	uint64 EncryptionThreadPool::GetDispatchTime ()
+	{
+		// Median round trip of an empty fragment through a parked worker thread
+		const int roundCount = 5;
+		uint64 times[roundCount];
+
+		for (int i = 0; i < roundCount; ++i)
+		{
+			Thread::Sleep (1);
+
+			WorkCompletion completion (1);
+			WorkFragment fragment;
+			fragment.Type = WorkType::EncryptDataUnits;
+			fragment.Completion = &completion;
+			fragment.Mode = nullptr;
+			fragment.Data = nullptr;
+			fragment.StartUnitNo = 0;
+			fragment.UnitCount = 0;
+			fragment.SectorSize = ENCRYPTION_DATA_UNIT_SIZE;
+			fragment.SplitUnitCount = 1;
+
+			uint64 startTime = Time::GetMonotonic();
+
+			if (!FragmentQueue.TryPush (fragment))
+				throw ParameterIncorrect (SRC_POS);
+
+			NotifyWorkers (1);
+			completion.Wait();
+			times[i] = Time::GetMonotonic() - startTime;
+		}
+
+		std::sort (times, times + roundCount);
+		return times[roundCount / 2];
+	}
+
+	size_t EncryptionThreadPool::GetMinFragmentSize (const EncryptionMode *mode)
+	{
+		size_t minSize = mode->MinFragmentSize.load (std::memory_order_relaxed);
+		if (minSize != 0)
+			return minSize;
+
+		// A fragment should take at least twice as long to process as its dispatch to a worker thread.
+		// The processing speed depends on the ciphers of the mode and on the CPU, so it is measured
+		// on the first use of each mode.
+		const size_t benchmarkSize = 16 * 1024;
+		SecureBuffer buffer (benchmarkSize);
+		buffer.Zero();
+
+		uint64 bestTime = 0;
+		for (int i = 0; i < 3; ++i)
+		{
+			uint64 startTime = Time::GetMonotonic();
+			mode->EncryptSectorsCurrentThread (buffer.Ptr(), 0, benchmarkSize / ENCRYPTION_DATA_UNIT_SIZE, ENCRYPTION_DATA_UNIT_SIZE);
+			uint64 time = Time::GetMonotonic() - startTime;
+
+			if (i == 0 || time < bestTime)
+				bestTime = time;
+		}
+
+		if (bestTime == 0)
+			bestTime = 1;
+
+		uint64 size = DispatchTime * 2 * benchmarkSize / bestTime;
+
+		if (size < MinFragmentSizeLimit)
+			size = MinFragmentSizeLimit;
+
+		if (size > MaxFragmentSizeLimit)
+			size = MaxFragmentSizeLimit;
+
+		mode->MinFragmentSize.store ((size_t) size, std::memory_order_relaxed);
+		return (size_t) size;
+	}
+
+	void EncryptionThreadPool::NotifyWorkers (size_t count)
+	{
+		if (count == 0)
+			return;
+
+		// Orders the preceding push before the load of IdleWorkerCount; pairs with the fence in WorkThreadProc()
+		std::atomic_thread_fence (std::memory_order_seq_cst);
+
+		if (IdleWorkerCount.load (std::memory_order_relaxed) != 0)
+		{
+			WorkEpoch.fetch_add (1, std::memory_order_release);
+			Futex::Wake (WorkEpoch, (uint32) count);
+		}
+	}
+
+	void EncryptionThreadPool::ProcessFragment (WorkType::Enum type, const EncryptionMode *mode, uint8 *data, uint64 startUnitNo, uint64 unitCount, size_t sectorSize)
+	{
+		// Empty fragments are used to measure the dispatch time
+		if (unitCount == 0)
+			return;
 
-		unique_ptr <Exception> itemException;
-		if (firstFragmentWorkItem->ItemException.get())
-			itemException = move_ptr(firstFragmentWorkItem->ItemException);
+		switch (type)
+		{
+		case WorkType::DecryptDataUnits:
+			mode->DecryptSectorsCurrentThread (data, startUnitNo, unitCount, sectorSize);
+			break;
 
-		firstFragmentWorkItem->State.Set (WorkItem::State::Free);
-		WorkItemCompletedEvent.Signal();
+		case WorkType::EncryptDataUnits:
+			mode->EncryptSectorsCurrentThread (data, startUnitNo, unitCount, sectorSize);
+			break;
 
-		if (itemException.get())
-			itemException->Throw();
+		default:
+			throw ParameterIncorrect (SRC_POS);
+		}
 	}
 
-	void EncryptionThreadPool::Start ()
+	void EncryptionThreadPool::Start (bool pinThreads)
 	{
 		if (ThreadPoolRunning)
 			return;
 
-		size_t cpuCount;
+		vector <uint32> cpus;
+		uint32 cpuQuota = 0;
 
 #ifdef TC_WINDOWS
 
 		SYSTEM_INFO sysInfo;
 		GetSystemInfo (&sysInfo);
-		cpuCount = sysInfo.dwNumberOfProcessors;
 
-#elif defined (_SC_NPROCESSORS_ONLN)
+		for (DWORD cpu = 0; cpu < sysInfo.dwNumberOfProcessors; ++cpu)
+			cpus.push_back ((uint32) cpu);
 
-		cpuCount = (size_t) sysconf (_SC_NPROCESSORS_ONLN);
-		if (cpuCount == (size_t) -1)
-			cpuCount = 1;
+#else
 
-#elif defined (TC_MACOSX)
+		cpus = SystemInfo::GetAvailableCpus();
+		cpuQuota = SystemInfo::GetCpuQuota();
 
-		int cpuCountSys;
-		int mib[2] = { CTL_HW, HW_NCPU };
+#endif
 
-		size_t len = sizeof (cpuCountSys);
-		if (sysctl (mib, 2, &cpuCountSys, &len, nullptr, 0) == -1)
-			cpuCountSys = 1;
+		Configuration configuration;
+		configuration.AvailableCpuCount = (uint32) cpus.size();
+		configuration.CpuQuota = cpuQuota;
 
-		cpuCount = (size_t) cpuCountSys;
+		// A container may be allowed a few CPUs worth of time on a host with many more CPUs, where
+		// a thread for every CPU would only be throttled
+		size_t threadCount = cpus.size();
 
-#else
-#	error Cannot determine CPU count
-#endif
+		if (cpuQuota != 0 && (cpuQuota + 999) / 1000 < threadCount)
+			threadCount = (cpuQuota + 999) / 1000;
 
-		if (cpuCount < 2)
-			return;
+		if (threadCount > MaxThreadCount)
+			threadCount = MaxThreadCount;
 
-		if (cpuCount > MaxThreadCount)
-			cpuCount = MaxThreadCount;
+		// CPUs are ordered by NUMA node, so that a pool smaller than the CPU set stays on as few nodes as possible
+		vector < pair <int, uint32> > nodeCpus;
+		for (size_t i = 0; i < cpus.size(); ++i)
+			nodeCpus.push_back (make_pair (SystemInfo::GetCpuNumaNode (cpus[i]), cpus[i]));
 
-		StopPending = false;
-		DequeuePosition = 0;
-		EnqueuePosition = 0;
+		std::stable_sort (nodeCpus.begin(), nodeCpus.end(), [] (const pair <int, uint32> &a, const pair <int, uint32> &b) { return a.first < b.first; });
 
-		for (size_t i = 0; i < sizeof (WorkItemQueue) / sizeof (WorkItemQueue[0]); ++i)
+		WorkerCpus.clear();
+		set <int> nodes;
+
+		for (size_t i = 0; i < threadCount; ++i)
 		{
-			WorkItemQueue[i].State.Set (WorkItem::State::Free);
+			WorkerCpus.push_back (nodeCpus[i].second);
+
+			if (nodeCpus[i].first >= 0)
+				nodes.insert (nodeCpus[i].first);
 		}
 
+		// Systems without NUMA information are treated as a single node
+		configuration.NumaNodeCount = nodes.empty() ? 1 : (uint32) nodes.size();
+		CurrentConfiguration = configuration;
+
+		if (threadCount < 2)
+			return;
+
+		FragmentQueue.Reset();
+		KeyDerivationQueue.Reset();
+		StopRequested = false;
+		PinThreads = pinThreads;
+		PinnedWorkerCount = 0;
+		StartedWorkerCount = 0;
+
+		// Each worker allocates its own deque, while the vector is never resized while the threads run
+		WorkerDeques.clear();
+		WorkerDeques.resize (threadCount);
+
 		try
 		{
-			for (ThreadCount = 0; ThreadCount < cpuCount; ++ThreadCount)
+			for (ThreadCount = 0; ThreadCount < threadCount; ++ThreadCount)
 			{
 				struct ThreadFunctor : public Functor
 				{
+					ThreadFunctor (size_t workerIndex) : WorkerIndex (workerIndex) { }
+
 					virtual void operator() ()
 					{
-						WorkThreadProc();
+						WorkThreadProc (WorkerIndex);
 					}
+
+					size_t WorkerIndex;
 				};
 
 				make_shared_auto (Thread, thread);
-				thread->Start (new ThreadFunctor ());
+				thread->Start (new ThreadFunctor (ThreadCount));
 				RunningThreads.push_back (thread);
 			}
+
+			if (!WaitForWorkers())
+				throw ParameterIncorrect (SRC_POS);
+
+			DispatchTime = GetDispatchTime();
 		}
 		catch (...)
 		{
@@ -213,6 +599,8 @@ namespace VeraCrypt
 			throw;
 		}
 
+		CurrentConfiguration.ThreadCount = (uint32) ThreadCount;
+		CurrentConfiguration.ThreadsPinned = PinThreads && PinnedWorkerCount == ThreadCount;
 		ThreadPoolRunning = true;
 	}
 
@@ -221,82 +609,132 @@ namespace VeraCrypt
 		if (!ThreadPoolRunning)
 			return;
 
-		StopPending = true;
-		WorkItemReadyEvent.Signal();
+		// Workers exit once they find no more work
+		StopRequested = true;
+		WorkEpoch.fetch_add (1, std::memory_order_release);
+		Futex::WakeAll (WorkEpoch);
 
 		foreach_ref (const Thread &thread, RunningThreads)
 		{
 			thread.Join();
 		}
 
+		RunningThreads.clear();
+		WorkerDeques.clear();
 		ThreadCount = 0;
+		CurrentConfiguration = Configuration();
 		ThreadPoolRunning = false;
 	}
 
-	void EncryptionThreadPool::WorkThreadProc ()
+	void EncryptionThreadPool::WaitForCompletion (WorkCompletion &completion)
 	{
-		try
+		// The submitting thread helps with any queued work while its own fragments are outstanding
+		WorkFragment fragment;
+		size_t victim = (size_t) Time::GetMonotonic();
+
+		while (!completion.IsCompleted() && FindFragment (fragment, nullptr, victim))
+			ExecuteFragment (fragment, nullptr);
+
+		completion.Wait();
+	}
+
+	bool EncryptionThreadPool::WaitForWorkers ()
+	{
+		for (;;)
 		{
-			WorkItem *workItem;
+			uint32 epoch = WorkEpoch.load (std::memory_order_acquire);
 
-			while (!StopPending)
-			{
-				{
-					ScopeLock lock (DequeueMutex);
+			if (StartedWorkerCount.load (std::memory_order_acquire) == WorkerDeques.size())
+				return true;
 
-					workItem = &WorkItemQueue[DequeuePosition++];
+			if (StopRequested)
+				return false;
 
-					if (DequeuePosition >= QueueSize)
-						DequeuePosition = 0;
+			Futex::Wait (WorkEpoch, epoch);
+		}
+	}
 
-					while (!StopPending && workItem->State != WorkItem::State::Ready)
-					{
-						WorkItemReadyEvent.Wait();
-					}
+	void EncryptionThreadPool::WorkThreadProc (size_t workerIndex)
+	{
+		try
+		{
+			if (PinThreads && Thread::SetCurrentThreadAffinity (WorkerCpus[workerIndex]))
+				++PinnedWorkerCount;
 
-					workItem->State.Set (WorkItem::State::Busy);
-				}
+			// The deque is allocated after pinning, which places it on the NUMA node of the worker
+			WorkerDeques[workerIndex].reset (new WorkerDeque (DequeSize));
 
-				if (StopPending)
-					break;
+			StartedWorkerCount.fetch_add (1, std::memory_order_release);
+			WorkEpoch.fetch_add (1, std::memory_order_release);
+			Futex::WakeAll (WorkEpoch);
 
-				try
-				{
-					switch (workItem->Type)
-					{
-					case WorkType::DecryptDataUnits:
-						workItem->Encryption.Mode->DecryptSectorsCurrentThread (workItem->Encryption.Data, workItem->Encryption.StartUnitNo, workItem->Encryption.UnitCount, workItem->Encryption.SectorSize);
-						break;
+			// Other deques are stolen from only once all of them exist
+			if (!WaitForWorkers())
+				return;
 
-					case WorkType::EncryptDataUnits:
-						workItem->Encryption.Mode->EncryptSectorsCurrentThread (workItem->Encryption.Data, workItem->Encryption.StartUnitNo, workItem->Encryption.UnitCount, workItem->Encryption.SectorSize);
-						break;
+			WorkerDeque *deque = WorkerDeques[workerIndex].get();
+			WorkFragment fragment;
+			shared_ptr <KeyDerivationRequest> request;
 
-					default:
-						throw ParameterIncorrect (SRC_POS);
-					}
-				}
-				catch (Exception &e)
+			for (;;)
+			{
+				if (FindFragment (fragment, deque, workerIndex))
 				{
-					workItem->FirstFragment->ItemException.reset (e.CloneNew());
+					ExecuteFragment (fragment, deque);
+					continue;
 				}
-				catch (exception &e)
+
+				// Key derivations take much longer than fragments, which are therefore processed first
+				if (KeyDerivationQueue.TryPop (request))
 				{
-					workItem->FirstFragment->ItemException.reset (new ExternalException (SRC_POS, StringConverter::ToExceptionString (e)));
+					DeriveKey (*request);
+					request.reset();
+					continue;
 				}
-				catch (...)
+
+				bool found = false;
+
+				for (int spin = Futex::GetSpinCount(); spin > 0 && !found; --spin)
 				{
-					workItem->FirstFragment->ItemException.reset (new UnknownException (SRC_POS));
+					found = FindFragment (fragment, deque, workerIndex) || KeyDerivationQueue.TryPop (request);
+					TC_CPU_RELAX();
 				}
 
-				if (workItem != workItem->FirstFragment)
+				if (!found)
 				{
-					workItem->State.Set (WorkItem::State::Free);
-					WorkItemCompletedEvent.Signal();
+					IdleWorkerCount.fetch_add (1, std::memory_order_relaxed);
+					std::atomic_thread_fence (std::memory_order_seq_cst);
+					// A worker which reads the incremented epoch also sees the work pushed before it
+					uint32 epoch = WorkEpoch.load (std::memory_order_acquire);
+
+					found = FindFragment (fragment, deque, workerIndex) || KeyDerivationQueue.TryPop (request);
+
+					if (!found)
+					{
+						if (StopRequested)
+						{
+							IdleWorkerCount.fetch_sub (1, std::memory_order_relaxed);
+							break;
+						}
+
+						Futex::Wait (WorkEpoch, epoch);
+					}
+
+					IdleWorkerCount.fetch_sub (1, std::memory_order_relaxed);
 				}
 
-				if (workItem->FirstFragment->OutstandingFragmentCount.Decrement() == 0)
-					workItem->FirstFragment->ItemCompletedEvent.Signal();
+				if (found)
+				{
+					if (request)
+					{
+						DeriveKey (*request);
+						request.reset();
+					}
+					else
+					{
+						ExecuteFragment (fragment, deque);
+					}
+				}
 			}
 		}
 		catch (exception &e)
@@ -309,21 +747,126 @@ namespace VeraCrypt
 		}
 	}
 
-	volatile bool EncryptionThreadPool::ThreadPoolRunning = false;
-	volatile bool EncryptionThreadPool::StopPending = false;
+	void EncryptionThreadPool::WorkCompletion::FragmentCompleted (Exception *fragmentException)
+	{
+		if (fragmentException)
+		{
+			// The first exception is rethrown by DoWork() or EndWork()
+			Exception *noException = nullptr;
+			if (!ItemException.compare_exchange_strong (noException, fragmentException))
+				delete fragmentException;
+		}
 
-	size_t EncryptionThreadPool::ThreadCount;
+		// DoWork() may return and release this object as soon as the count reaches zero, so nothing but
+		// the address of the count is used after the decrement
+		WorkRequest *request = Request;
+		uint32 previous = OutstandingFragmentCount.fetch_sub (1, std::memory_order_acq_rel);
 
-	EncryptionThreadPool::WorkItem EncryptionThreadPool::WorkItemQueue[QueueSize];
+		// The count of a WorkRequest includes a completion unit, which is released only after the request
+		// has been completed, so that it is not seen as completed before its queue and event are signalled
+		shared_ptr <WorkRequest> completedRequest;
+		if (request && (previous & ~WaiterFlag) == 2)
+		{
+			completedRequest = CompleteRequest (*request);
+			previous = OutstandingFragmentCount.fetch_sub (1, std::memory_order_acq_rel);
+		}
 
-	volatile size_t EncryptionThreadPool::EnqueuePosition;
-	volatile size_t EncryptionThreadPool::DequeuePosition;
+		if (previous == (WaiterFlag | 1))
+			Futex::Wake (OutstandingFragmentCount);
+	}
 
-	Mutex EncryptionThreadPool::EnqueueMutex;
-	Mutex EncryptionThreadPool::DequeueMutex;
+	size_t EncryptionThreadPool::WorkCompletionQueue::Poll (list < shared_ptr <WorkRequest> > &completedRequests, size_t maxCount)
+	{
+		ScopeLock lock (QueueMutex);
+		size_t count = 0;
 
-	SyncEvent EncryptionThreadPool::WorkItemReadyEvent;
-	SyncEvent EncryptionThreadPool::WorkItemCompletedEvent;
+		while (count < maxCount && !CompletedRequests.empty())
+		{
+			completedRequests.push_back (CompletedRequests.front());
+			CompletedRequests.pop_front();
+			++count;
+		}
+
+		return count;
+	}
+
+	size_t EncryptionThreadPool::WorkCompletionQueue::Wait (list < shared_ptr <WorkRequest> > &completedRequests, size_t maxCount)
+	{
+		if (maxCount == 0)
+			throw ParameterIncorrect (SRC_POS);
+
+		// A request added after an empty poll leaves the event signalled
+		size_t count;
+		while ((count = Poll (completedRequests, maxCount)) == 0)
+			CompletionEvent.Wait();
+
+		return count;
+	}
+
+	void EncryptionThreadPool::WorkCompletionQueue::Add (const shared_ptr <WorkRequest> &request)
+	{
+		{
+			ScopeLock lock (QueueMutex);
+			CompletedRequests.push_back (request);
+		}
+
+		CompletionEvent.Signal();
+	}
+
+	void EncryptionThreadPool::WorkCompletion::Wait ()
+	{
+		for (int spin = Futex::GetSpinCount(); ; --spin)
+		{
+			uint32 count = OutstandingFragmentCount.load (std::memory_order_acquire);
+
+			if ((count & ~WaiterFlag) == 0)
+				return;
+
+			if (spin > 0)
+			{
+				TC_CPU_RELAX();
+				continue;
+			}
+
+			if ((count & WaiterFlag) == 0)
+			{
+				if (!OutstandingFragmentCount.compare_exchange_weak (count, count | WaiterFlag, std::memory_order_acquire))
+					continue;
+
+				count |= WaiterFlag;
+			}
+
+			Futex::Wait (OutstandingFragmentCount, count);
+		}
+	}
+
+	EncryptionThreadPool::Configuration EncryptionThreadPool::CurrentConfiguration;
+
+	uint64 EncryptionThreadPool::DispatchTime;
+
+	MpmcQueue <EncryptionThreadPool::WorkFragment> EncryptionThreadPool::FragmentQueue (QueueSize);
+
+	std::atomic <uint32> EncryptionThreadPool::IdleWorkerCount (0);
+
+	std::atomic <uint32> EncryptionThreadPool::PinnedWorkerCount (0);
+
+	bool EncryptionThreadPool::PinThreads = false;
+
+	MpmcQueue < shared_ptr <EncryptionThreadPool::KeyDerivationRequest> > EncryptionThreadPool::KeyDerivationQueue (QueueSize);
 
 	list < shared_ptr <Thread> > EncryptionThreadPool::RunningThreads;
+
+	std::atomic <uint32> EncryptionThreadPool::StartedWorkerCount (0);
+
+	std::atomic <bool> EncryptionThreadPool::StopRequested (false);
+
+	size_t EncryptionThreadPool::ThreadCount;
+
+	volatile bool EncryptionThreadPool::ThreadPoolRunning = false;
+
+	vector <uint32> EncryptionThreadPool::WorkerCpus;
+
+	vector < shared_ptr <EncryptionThreadPool::WorkerDeque> > EncryptionThreadPool::WorkerDeques;
+
+	std::atomic <uint32> EncryptionThreadPool::WorkEpoch (0);
 }
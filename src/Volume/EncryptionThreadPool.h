@@ -13,8 +13,15 @@
 #ifndef TC_HEADER_Volume_EncryptionThreadPool
 #define TC_HEADER_Volume_EncryptionThreadPool
 
+#include <atomic>
 #include "Platform/Platform.h"
+#include "Platform/MpmcQueue.h"
+#include "Platform/SyncEvent.h"
+#include "Platform/Serializer.h"
+#include "Platform/WorkStealingDeque.h"
 #include "EncryptionMode.h"
+#include "Pkcs5Kdf.h"
+#include "VolumePassword.h"
 
 namespace VeraCrypt
 {
@@ -31,60 +38,186 @@ namespace VeraCrypt
 			};
 		};
 
-		struct WorkItem
+		struct KeyDerivationRequest
 		{
-			struct State
-			{
-				enum Enum
-				{
-					Free,
-					Ready,
-					Busy
-				};
-			};
+			KeyDerivationRequest (shared_ptr <Pkcs5Kdf> kdf, shared_ptr <VolumePassword> password, int pim, const ConstBufferPtr &salt, size_t keySize, shared_ptr <SyncEvent> completionEvent)
+				: Kdf (kdf), Password (password), Pim (pim), Salt (salt), DerivedKey (keySize), Cancelled (0), Completed (false), ElapsedTime (0), CompletionEvent (completionEvent) { }
+
+			shared_ptr <Pkcs5Kdf> Kdf;
+			shared_ptr <VolumePassword> Password;
+			int Pim;
+			SecureBuffer Salt;
+			SecureBuffer DerivedKey;
+			long volatile Cancelled; // Polled by a running derivation, which stops early once it is set
+			SharedVal <bool> Completed;
+			uint64 ElapsedTime; // Nanoseconds spent deriving the key (zero if cancelled before start)
+			unique_ptr <Exception> DerivationException;
+			shared_ptr <SyncEvent> CompletionEvent;
+
+		private:
+			KeyDerivationRequest (const KeyDerivationRequest &);
+			KeyDerivationRequest &operator= (const KeyDerivationRequest &);
+		};
+
+		struct WorkRequest;
+
+		// Outstanding fragments of one DoWork() call or WorkRequest
+		struct WorkCompletion
+		{
+			// Set in OutstandingFragmentCount while the submitting thread is parked
+			static const uint32 WaiterFlag = 0x80000000;
+
+			WorkCompletion (uint32 fragmentCount, WorkRequest *request = nullptr) : OutstandingFragmentCount (fragmentCount), ItemException (nullptr), Request (request) { }
+
+			// Must be called by the thread which holds one of the outstanding fragments
+			void AddFragment () { OutstandingFragmentCount.fetch_add (1, std::memory_order_relaxed); }
+			bool IsCompleted () const { return (OutstandingFragmentCount.load (std::memory_order_acquire) & ~WaiterFlag) == 0; }
+			void FragmentCompleted (Exception *fragmentException);
+			void Wait ();
+
+			std::atomic <uint32> OutstandingFragmentCount;
+			std::atomic <Exception *> ItemException;
+			WorkRequest *Request;	// Null for DoWork()
+
+		private:
+			WorkCompletion (const WorkCompletion &);
+			WorkCompletion &operator= (const WorkCompletion &);
+		};
+
+		class WorkCompletionQueue;
+
+		// Encryption or decryption of sector runs submitted by BeginWork(), which returns before the work is
+		// done. The data of the runs must stay valid until the request is completed. Completion is signalled
+		// by CompletionEvent and by adding the request to CompletionQueue, if set, and its result is
+		// obtained by EndWork().
+		struct WorkRequest
+		{
+			WorkRequest (WorkType::Enum type, const EncryptionMode *mode, const SectorRun *runs, size_t runCount, size_t sectorSize,
+				shared_ptr <SyncEvent> completionEvent = shared_ptr <SyncEvent> (), shared_ptr <WorkCompletionQueue> completionQueue = shared_ptr <WorkCompletionQueue> ())
+				: Type (type), Mode (mode), Runs (runs, runs + runCount), SectorSize (sectorSize), Tag (0), CompletionEvent (completionEvent), CompletionQueue (completionQueue), Completion (0, this) { }
+
+			~WorkRequest () { delete Completion.ItemException.load(); }
+
+			bool IsCompleted () const { return Completion.IsCompleted(); }
 
-			struct WorkItem *FirstFragment;
-			unique_ptr <Exception> ItemException;
-			SyncEvent ItemCompletedEvent;
-			SharedVal <size_t> OutstandingFragmentCount;
-			SharedVal <State::Enum> State;
 			WorkType::Enum Type;
+			const EncryptionMode *Mode;
+			vector <SectorRun> Runs;
+			size_t SectorSize;
+			uint64 Tag;	// Identifies the request to its submitter
+			shared_ptr <SyncEvent> CompletionEvent;
+			shared_ptr <WorkCompletionQueue> CompletionQueue;
 
-			union
-			{
-				struct
-				{
-					const EncryptionMode *Mode;
-					uint8 *Data;
-					uint64 StartUnitNo;
-					uint64 UnitCount;
-					size_t SectorSize;
-				} Encryption;
-			};
+		protected:
+			friend class EncryptionThreadPool;
+
+			WorkCompletion Completion;
+			shared_ptr <WorkRequest> SelfReference;	// Keeps a submitted request alive until it is completed
+
+		private:
+			WorkRequest (const WorkRequest &);
+			WorkRequest &operator= (const WorkRequest &);
+		};
+
+		// Collects completed requests, which are retrieved in batches by the thread that submitted them
+		class WorkCompletionQueue
+		{
+		public:
+			WorkCompletionQueue () { }
+
+			size_t Poll (list < shared_ptr <WorkRequest> > &completedRequests, size_t maxCount);
+			size_t Wait (list < shared_ptr <WorkRequest> > &completedRequests, size_t maxCount);
+
+		protected:
+			friend class EncryptionThreadPool;
+
+			void Add (const shared_ptr <WorkRequest> &request);
+
+			list < shared_ptr <WorkRequest> > CompletedRequests;
+			SyncEvent CompletionEvent;
+			Mutex QueueMutex;
+
+		private:
+			WorkCompletionQueue (const WorkCompletionQueue &);
+			WorkCompletionQueue &operator= (const WorkCompletionQueue &);
+		};
+
+		// Contiguous range of data units of one request. Fragments are trivially copyable, as they may be
+		// stolen from the deque of a worker thread.
+		struct WorkFragment
+		{
+			WorkType::Enum Type;
+			WorkCompletion *Completion;
+			const EncryptionMode *Mode;
+			uint8 *Data;
+			uint64 StartUnitNo;
+			uint64 UnitCount;
+			size_t SectorSize;
+			uint64 SplitUnitCount;	// Fragments of at least twice this many units are split
+		};
+
+		typedef WorkStealingDeque <WorkFragment> WorkerDeque;
+
+		// Effective configuration of the running pool
+		struct Configuration
+		{
+			Configuration () : ThreadCount (0), AvailableCpuCount (0), CpuQuota (0), NumaNodeCount (0), ThreadsPinned (false) { }
+
+			void Deserialize (Serializer &sr);
+			void Serialize (Serializer &sr) const;
+
+			uint32 ThreadCount;			// Zero if requests are processed by their submitting threads
+			uint32 AvailableCpuCount;	// CPUs in the affinity mask of the process
+			uint32 CpuQuota;			// Thousandths of a CPU, zero if unlimited
+			uint32 NumaNodeCount;		// NUMA nodes of the CPUs used by the pool
+			bool ThreadsPinned;
 		};
 
+		static void BeginKeyDerivation (shared_ptr <KeyDerivationRequest> request);
+		static void BeginWork (shared_ptr <WorkRequest> request);
+
 		static void DoWork (WorkType::Enum type, const EncryptionMode *mode, uint8 *data, uint64 startUnitNo, uint64 unitCount, size_t sectorSize);
+		static void DoWork (WorkType::Enum type, const EncryptionMode *mode, const SectorRun *runs, size_t runCount, size_t sectorSize);
+		static void EndWork (WorkRequest &request);
+		static Configuration GetConfiguration ();
 		static bool IsRunning () { return ThreadPoolRunning; }
-		static void Start ();
+		static void Start (bool pinThreads = false);
 		static void Stop ();
 
 	protected:
-		static void WorkThreadProc ();
+		static shared_ptr <WorkRequest> CompleteRequest (WorkRequest &request);
+		static void DeriveKey (KeyDerivationRequest &request);
+		static void ExecuteFragment (WorkFragment fragment, WorkerDeque *deque);
+		static bool FindFragment (WorkFragment &fragment, WorkerDeque *deque, size_t workerIndex);
+		static uint64 GetDispatchTime ();
+		static size_t GetMinFragmentSize (const EncryptionMode *mode);
+		static void NotifyWorkers (size_t count);
+		static void ProcessFragment (WorkType::Enum type, const EncryptionMode *mode, uint8 *data, uint64 startUnitNo, uint64 unitCount, size_t sectorSize);
+		static void WaitForCompletion (WorkCompletion &completion);
+		static bool WaitForWorkers ();
+		static void WorkThreadProc (size_t workerIndex);
 
-		static const size_t MaxThreadCount = 32;
-		static const size_t QueueSize = MaxThreadCount * 2;
+		static const size_t MaxThreadCount = 1024;
+		static const size_t QueueSize = 2048;
+		static const size_t DequeSize = 256;
+		static const size_t MinFragmentSizeLimit = ENCRYPTION_DATA_UNIT_SIZE;
+		static const size_t MaxFragmentSizeLimit = 1024 * 1024;
 
-		static Mutex DequeueMutex;
-		static volatile size_t DequeuePosition;
-		static volatile size_t EnqueuePosition;
-		static Mutex EnqueueMutex;
+		static Configuration CurrentConfiguration;
+		static uint64 DispatchTime;	// Nanoseconds
+		static MpmcQueue <WorkFragment> FragmentQueue;	// Fragments submitted by threads outside the pool
+		static std::atomic <uint32> IdleWorkerCount;
+		static std::atomic <uint32> PinnedWorkerCount;
+		static bool PinThreads;
+		static MpmcQueue < shared_ptr <KeyDerivationRequest> > KeyDerivationQueue;
 		static list < shared_ptr <Thread> > RunningThreads;
-		static volatile bool StopPending;
+		static std::atomic <bool> StopRequested;
+		static std::atomic <uint32> StartedWorkerCount;
 		static size_t ThreadCount;
 		static volatile bool ThreadPoolRunning;
-		static SyncEvent WorkItemCompletedEvent;
-		static WorkItem WorkItemQueue[QueueSize];
-		static SyncEvent WorkItemReadyEvent;
+		static vector <uint32> WorkerCpus;
+		static vector < shared_ptr <WorkerDeque> > WorkerDeques;
+		static std::atomic <uint32> WorkEpoch;	// Idle workers wait for a change of the epoch
 	};
 }
 
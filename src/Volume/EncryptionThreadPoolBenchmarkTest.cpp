@@ -0,0 +1,328 @@
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <iomanip>
+#include <thread>
+
+#include "Testing.h"
+#include "Platform/MpmcQueue.h"
+#include "Platform/SyncEvent.h"
+#include "Platform/Time.h"
+#include "Crypto/cpu.h"
+#include "EncryptionAlgorithm.h"
+#include "EncryptionModeXTS.h"
+#include "EncryptionThreadPool.h"
+
+#define QUEUE_ITEMS_PER_PRODUCER 1000000
+#define QUEUE_CONSUMERS 4
+#define POOL_BUFFER_SIZE (4 * 1024 * 1024)
+#define POOL_SECTOR_SIZE 512
+
+// Common/Crypto.h declares a C struct EncryptionAlgorithm, hence no "using namespace VeraCrypt"
+namespace VeraCrypt {
+
+const size_t ProducerCounts[] = { 1, 2, 4, 8, 16 };
+
+void FillBuffer(uint8 *b, size_t size, uint8 seed) {
+    for (size_t i = 0; i < size; ++i) {
+        b[i] = (uint8) (i * 131 + seed);
+    }
+}
+
+double PerSecond(uint64 count, uint64 elapsedTime) {
+    return (double) count / ((double) elapsedTime / 1000000000);
+}
+
+// N producers push tagged values that QUEUE_CONSUMERS consumers pop until the queue is closed
+void MpmcQueueContention(shared_ptr<TestResult> r) {
+    for (size_t producerCount : ProducerCounts) {
+        MpmcQueue<uint64> queue(1024);
+        vector<std::thread> producers, consumers;
+        vector<uint64> consumedSums(QUEUE_CONSUMERS), consumedCounts(QUEUE_CONSUMERS);
+
+        uint64 start = Time::GetMonotonic();
+
+        for (size_t c = 0; c < QUEUE_CONSUMERS; ++c) {
+            consumers.push_back(std::thread([&queue, &consumedSums, &consumedCounts, c]() {
+                uint64 item, sum = 0, count = 0;
+                while (queue.Pop(item)) {
+                    sum += item;
+                    ++count;
+                }
+                consumedSums[c] = sum;
+                consumedCounts[c] = count;
+            }));
+        }
+
+        for (size_t p = 0; p < producerCount; ++p) {
+            producers.push_back(std::thread([&queue, p]() {
+                for (uint64 i = 0; i < QUEUE_ITEMS_PER_PRODUCER; ++i) {
+                    queue.Push(((uint64) p << 32) | i);
+                }
+            }));
+        }
+
+        for (auto &t : producers)
+            t.join();
+        queue.Close();
+        for (auto &t : consumers)
+            t.join();
+
+        uint64 elapsed = Time::GetMonotonic() - start;
+
+        uint64 sum = 0, count = 0, expectedSum = 0;
+        for (size_t c = 0; c < QUEUE_CONSUMERS; ++c) {
+            sum += consumedSums[c];
+            count += consumedCounts[c];
+        }
+        for (size_t p = 0; p < producerCount; ++p) {
+            expectedSum += ((uint64) p << 32) * QUEUE_ITEMS_PER_PRODUCER + (uint64) QUEUE_ITEMS_PER_PRODUCER * (QUEUE_ITEMS_PER_PRODUCER - 1) / 2;
+        }
+
+        if (count != producerCount * QUEUE_ITEMS_PER_PRODUCER || sum != expectedSum) {
+            r->Failed("items lost or duplicated");
+        }
+
+        stringstream s;
+        s << producerCount << " producers, " << QUEUE_CONSUMERS << " consumers: "
+            << fixed << setprecision(2) << PerSecond(count, elapsed) / 1000000 << " M items/s";
+        r->Info(s.str());
+    }
+}
+
+// N producer threads encrypt their own part of a buffer with requests of unitsPerRequest sectors,
+// the way concurrent FUSE reads reach EncryptionThreadPool::DoWork
+void ThreadPoolContention(shared_ptr<TestResult> r, size_t unitsPerRequest) {
+    AES aes;
+    SecureBuffer key(aes.GetKeySize());
+    SecureBuffer secondaryKey(aes.GetKeySize());
+    FillBuffer(key.Ptr(), key.Size(), 1);
+    FillBuffer(secondaryKey.Ptr(), secondaryKey.Size(), 2);
+
+    aes.SetKey(key);
+    shared_ptr<EncryptionMode> mode(new EncryptionModeXTS());
+    aes.SetMode(mode);
+    mode->SetKey(secondaryKey);
+
+    Buffer plaintext(POOL_BUFFER_SIZE);
+    Buffer reference(POOL_BUFFER_SIZE);
+    Buffer data(POOL_BUFFER_SIZE);
+    FillBuffer(plaintext.Ptr(), plaintext.Size(), 3);
+
+    reference.CopyFrom(plaintext);
+    mode->EncryptSectorsCurrentThread(reference.Ptr(), 0, POOL_BUFFER_SIZE / POOL_SECTOR_SIZE, POOL_SECTOR_SIZE);
+
+    const size_t requestSize = unitsPerRequest * POOL_SECTOR_SIZE;
+    const size_t requestCount = POOL_BUFFER_SIZE / requestSize;
+
+    for (size_t producerCount : ProducerCounts) {
+        data.CopyFrom(plaintext);
+        vector<std::thread> producers;
+
+        uint64 start = Time::GetMonotonic();
+
+        for (size_t p = 0; p < producerCount; ++p) {
+            producers.push_back(std::thread([&aes, &data, p, producerCount, requestSize, requestCount, unitsPerRequest]() {
+                for (size_t i = p; i < requestCount; i += producerCount) {
+                    aes.EncryptSectors(data.Ptr() + i * requestSize, i * unitsPerRequest, unitsPerRequest, POOL_SECTOR_SIZE);
+                }
+            }));
+        }
+
+        for (auto &t : producers)
+            t.join();
+
+        uint64 elapsed = Time::GetMonotonic() - start;
+
+        if (memcmp(data.Ptr(), reference.Ptr(), data.Size()) != 0) {
+            r->Failed("ciphertext differs from single-threaded encryption");
+        }
+
+        stringstream s;
+        s << producerCount << " producers, " << requestSize / 1024 << " KiB requests: "
+            << fixed << setprecision(0) << PerSecond(requestCount, elapsed) << " requests/s, "
+            << setprecision(1) << PerSecond(POOL_BUFFER_SIZE, elapsed) / (1024 * 1024) << " MiB/s";
+        r->Info(s.str());
+    }
+}
+
+void ThreadPoolSmallRequests(shared_ptr<TestResult> r) {
+    ThreadPoolContention(r, 8);
+}
+
+void ThreadPoolLargeRequests(shared_ptr<TestResult> r) {
+    ThreadPoolContention(r, 256);
+}
+
+// Latency of requests of a single caller, which are processed inline or split among the caller
+// and the pool depending on the size of the request and on the speed of the ciphers
+template <class AlgorithmType>
+void RequestLatency(shared_ptr<TestResult> r, const char *algorithmName) {
+    const size_t requestSizes[] = { 4 * 1024, 64 * 1024, 1024 * 1024 };
+    const size_t requestCount = 2000;
+
+    AlgorithmType algorithm;
+    SecureBuffer key(algorithm.GetKeySize());
+    SecureBuffer secondaryKey(algorithm.GetKeySize());
+    FillBuffer(key.Ptr(), key.Size(), 1);
+    FillBuffer(secondaryKey.Ptr(), secondaryKey.Size(), 2);
+
+    algorithm.SetKey(key);
+    shared_ptr<EncryptionMode> mode(new EncryptionModeXTS());
+    algorithm.SetMode(mode);
+    mode->SetKey(secondaryKey);
+
+    for (size_t requestSize : requestSizes) {
+        const size_t unitCount = requestSize / POOL_SECTOR_SIZE;
+
+        Buffer plaintext(requestSize);
+        Buffer reference(requestSize);
+        Buffer data(requestSize);
+        FillBuffer(plaintext.Ptr(), plaintext.Size(), 3);
+
+        reference.CopyFrom(plaintext);
+        mode->EncryptSectorsCurrentThread(reference.Ptr(), 0, unitCount, POOL_SECTOR_SIZE);
+
+        vector<uint64> times;
+        uint64 totalTime = 0;
+
+        for (size_t i = 0; i < requestCount; ++i) {
+            data.CopyFrom(plaintext);
+
+            uint64 start = Time::GetMonotonic();
+            algorithm.EncryptSectors(data.Ptr(), 0, unitCount, POOL_SECTOR_SIZE);
+            uint64 elapsed = Time::GetMonotonic() - start;
+
+            times.push_back(elapsed);
+            totalTime += elapsed;
+
+            if (i == 0 && memcmp(data.Ptr(), reference.Ptr(), data.Size()) != 0) {
+                r->Failed("ciphertext differs from single-threaded encryption");
+            }
+        }
+
+        std::sort(times.begin(), times.end());
+
+        stringstream s;
+        s << algorithmName << ", " << requestSize / 1024 << " KiB requests: mean "
+            << fixed << setprecision(1) << (double) totalTime / requestCount / 1000 << " us, 99% "
+            << (double) times[requestCount * 99 / 100] / 1000 << " us";
+        r->Info(s.str());
+    }
+}
+
+void ThreadPoolRequestLatency(shared_ptr<TestResult> r) {
+    RequestLatency<AES>(r, "AES");
+    RequestLatency<AESTwofishSerpent>(r, "AES-Twofish-Serpent");
+}
+
+
+// A single caller keeps up to queueDepth requests of 64 KiB in flight, the way an I/O thread submits
+// chunks for decryption, retrieves completed requests in batches and submits them again
+void ThreadPoolAsyncRequests(shared_ptr<TestResult> r) {
+    typedef EncryptionThreadPool::WorkRequest WorkRequest;
+
+    const size_t queueDepths[] = { 1, 4, 16 };
+    const size_t unitsPerRequest = 128;
+    const size_t requestSize = unitsPerRequest * POOL_SECTOR_SIZE;
+    const size_t requestCount = POOL_BUFFER_SIZE / requestSize;
+
+    AES aes;
+    SecureBuffer key(aes.GetKeySize());
+    SecureBuffer secondaryKey(aes.GetKeySize());
+    FillBuffer(key.Ptr(), key.Size(), 1);
+    FillBuffer(secondaryKey.Ptr(), secondaryKey.Size(), 2);
+
+    aes.SetKey(key);
+    shared_ptr<EncryptionMode> mode(new EncryptionModeXTS());
+    aes.SetMode(mode);
+    mode->SetKey(secondaryKey);
+
+    Buffer plaintext(POOL_BUFFER_SIZE);
+    Buffer reference(POOL_BUFFER_SIZE);
+    Buffer data(POOL_BUFFER_SIZE);
+    FillBuffer(plaintext.Ptr(), plaintext.Size(), 3);
+
+    reference.CopyFrom(plaintext);
+    mode->EncryptSectorsCurrentThread(reference.Ptr(), 0, POOL_BUFFER_SIZE / POOL_SECTOR_SIZE, POOL_SECTOR_SIZE);
+
+    for (size_t queueDepth : queueDepths) {
+        data.CopyFrom(plaintext);
+        shared_ptr<EncryptionThreadPool::WorkCompletionQueue> completionQueue(new EncryptionThreadPool::WorkCompletionQueue());
+        list<shared_ptr<WorkRequest>> completed, freeRequests;
+        size_t submitted = 0, inFlight = 0, batchCount = 0;
+
+        uint64 start = Time::GetMonotonic();
+
+        while (submitted < requestCount || inFlight > 0) {
+            while (submitted < requestCount && inFlight < queueDepth) {
+                SectorRun run;
+                run.Data = data.Ptr() + submitted * requestSize;
+                run.SectorIndex = submitted * unitsPerRequest;
+                run.SectorCount = unitsPerRequest;
+
+                shared_ptr<WorkRequest> request;
+                if (freeRequests.empty()) {
+                    request.reset(new WorkRequest(EncryptionThreadPool::WorkType::EncryptDataUnits, mode.get(), &run, 1, POOL_SECTOR_SIZE,
+                        shared_ptr<SyncEvent>(), completionQueue));
+                } else {
+                    request = freeRequests.front();
+                    freeRequests.pop_front();
+                    request->Runs[0] = run;
+                }
+                request->Tag = submitted;
+
+                EncryptionThreadPool::BeginWork(request);
+                ++submitted;
+                ++inFlight;
+            }
+
+            completed.clear();
+            inFlight -= completionQueue->Wait(completed, queueDepth);
+            ++batchCount;
+
+            for (auto &request : completed) {
+                EncryptionThreadPool::EndWork(*request);
+                if (request->Tag >= requestCount) {
+                    r->Failed("unknown request completed");
+                }
+                freeRequests.push_back(request);
+            }
+        }
+
+        uint64 elapsed = Time::GetMonotonic() - start;
+
+        if (memcmp(data.Ptr(), reference.Ptr(), data.Size()) != 0) {
+            r->Failed("ciphertext differs from single-threaded encryption");
+        }
+
+        stringstream s;
+        s << "queue depth " << queueDepth << ", " << requestSize / 1024 << " KiB requests: "
+            << fixed << setprecision(0) << PerSecond(requestCount, elapsed) << " requests/s, "
+            << setprecision(1) << PerSecond(POOL_BUFFER_SIZE, elapsed) / (1024 * 1024) << " MiB/s, "
+            << (double) requestCount / batchCount << " completions per poll";
+        r->Info(s.str());
+    }
+}
+
+}
+
+int main() {
+    using namespace VeraCrypt;
+    Testing t;
+
+#ifdef CRYPTOPP_CPUID_AVAILABLE
+    DetectX86Features();
+#endif
+    EncryptionThreadPool::Start();
+
+    t.AddTest("MpmcQueueContention", &MpmcQueueContention);
+    t.AddTest("ThreadPoolSmallRequests", &ThreadPoolSmallRequests);
+    t.AddTest("ThreadPoolLargeRequests", &ThreadPoolLargeRequests);
+    t.AddTest("ThreadPoolRequestLatency", &ThreadPoolRequestLatency);
+    t.AddTest("ThreadPoolAsyncRequests", &ThreadPoolAsyncRequests);
+
+    t.Main();
+
+    EncryptionThreadPool::Stop();
+}
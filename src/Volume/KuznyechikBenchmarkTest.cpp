@@ -0,0 +1,121 @@
+#include <cstring>
+#include <sstream>
+#include <iomanip>
+
+#include "Testing.h"
+#include "Platform/Time.h"
+#include "Crypto/cpu.h"
+#include "Crypto/kuznyechik.h"
+
+#define BENCHMARK_BUFFER_SIZE (1024 * 1024)
+#define BENCHMARK_ROUNDS 8
+
+// Blocks per kernel call: EncryptionModeXTS passes one 512-byte data unit at a time
+#define BENCHMARK_CALL_BLOCKS 32
+
+namespace VeraCrypt {
+
+typedef void (*KuznyechikBlocksFunction)(uint8 *out, const uint8 *in, size_t blocks, const kuznyechik_kds *kds);
+
+struct KuznyechikKernel {
+    const char *Name;
+    KuznyechikBlocksFunction Encrypt;
+    KuznyechikBlocksFunction Decrypt;
+};
+
+void EncryptBlocksSimd(uint8 *out, const uint8 *in, size_t blocks, const kuznyechik_kds *kds) {
+    kuznyechik_encrypt_blocks(out, in, blocks, const_cast<kuznyechik_kds *>(kds));
+}
+
+void DecryptBlocksSimd(uint8 *out, const uint8 *in, size_t blocks, const kuznyechik_kds *kds) {
+    kuznyechik_decrypt_blocks(out, in, blocks, const_cast<kuznyechik_kds *>(kds));
+}
+
+KuznyechikKernel SimdKernel = { "sse2", &EncryptBlocksSimd, &DecryptBlocksSimd };
+KuznyechikKernel GfniKernel = { "gfni-avx512", &kuznyechik_encrypt_blocks_gfni, &kuznyechik_decrypt_blocks_gfni };
+
+void FillBuffer(uint8 *b, size_t size, uint8 seed) {
+    for (size_t i = 0; i < size; ++i) {
+        b[i] = (uint8) (i * 131 + seed);
+    }
+}
+
+double MiBPerSecond(uint64 elapsedTime) {
+    return (double) BENCHMARK_BUFFER_SIZE / (1024 * 1024) / ((double) elapsedTime / 1000000000);
+}
+
+// Processes the buffer in place, one data unit per call, and returns the elapsed time
+uint64 RunKernel(KuznyechikBlocksFunction function, uint8 *data, const kuznyechik_kds *kds) {
+    uint64 start = Time::GetMonotonic();
+    for (size_t offset = 0; offset < BENCHMARK_BUFFER_SIZE; offset += BENCHMARK_CALL_BLOCKS * 16) {
+        function(data + offset, data + offset, BENCHMARK_CALL_BLOCKS, kds);
+    }
+    return Time::GetMonotonic() - start;
+}
+
+void KuznyechikBenchmark(shared_ptr<TestResult> r, KuznyechikKernel *kernel) {
+    kuznyechik_kds kds;
+    uint8 key[32];
+    FillBuffer(key, sizeof(key), 1);
+    kuznyechik_set_key(key, &kds);
+
+    vector<uint8> plaintext(BENCHMARK_BUFFER_SIZE);
+    vector<uint8> reference(BENCHMARK_BUFFER_SIZE);
+    vector<uint8> data(BENCHMARK_BUFFER_SIZE);
+    FillBuffer(plaintext.data(), plaintext.size(), 3);
+
+    // Single-block reference
+    for (size_t offset = 0; offset < BENCHMARK_BUFFER_SIZE; offset += 16) {
+        kuznyechik_encrypt_block(&reference[offset], &plaintext[offset], &kds);
+    }
+
+    uint64 encryptTime = 0, decryptTime = 0;
+
+    for (int round = 0; round < BENCHMARK_ROUNDS; ++round) {
+        data = plaintext;
+        uint64 elapsed = RunKernel(kernel->Encrypt, data.data(), &kds);
+        if (round == 0 || elapsed < encryptTime)
+            encryptTime = elapsed;
+
+        if (memcmp(data.data(), reference.data(), data.size()) != 0) {
+            r->Failed("ciphertext differs from single-block encryption");
+        }
+
+        elapsed = RunKernel(kernel->Decrypt, data.data(), &kds);
+        if (round == 0 || elapsed < decryptTime)
+            decryptTime = elapsed;
+
+        if (memcmp(data.data(), plaintext.data(), data.size()) != 0) {
+            r->Failed("decryption does not restore the plaintext");
+        }
+    }
+
+    burn(&kds, sizeof(kds));
+
+    stringstream s;
+    s << fixed << setprecision(1)
+        << "encryption " << MiBPerSecond(encryptTime) << " MiB/s, "
+        << "decryption " << MiBPerSecond(decryptTime) << " MiB/s";
+    r->Info(s.str());
+}
+
+}
+
+int main() {
+    using namespace VeraCrypt;
+    Testing t;
+
+#ifdef CRYPTOPP_CPUID_AVAILABLE
+    DetectX86Features();
+#endif
+
+    if (HasSSE2()) {
+        t.AddTest(TestSuite::param<KuznyechikKernel>(SimdKernel.Name, &KuznyechikBenchmark, &SimdKernel));
+    }
+
+    if (kuznyechik_has_gfni() && HasGFNI() && HasSAVX512BW() && HasSAVX512VL() && HasSAVX512VBMI()) {
+        t.AddTest(TestSuite::param<KuznyechikKernel>(GfniKernel.Name, &KuznyechikBenchmark, &GfniKernel));
+    }
+
+    t.Main();
+}
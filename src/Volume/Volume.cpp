@@ -13,7 +13,10 @@
 #ifndef TC_WINDOWS
 #include <errno.h>
 #endif
+#include "Platform/Finally.h"
+#include "Platform/SecureBufferPool.h"
 #include "EncryptionModeXTS.h"
+#include "EncryptionThreadPool.h"
 #include "Volume.h"
 #include "VolumeHeader.h"
 #include "VolumeLayout.h"
@@ -21,8 +24,16 @@
 
 namespace VeraCrypt
 {
+	// Returns a range of the given size which starts at an address aligned as required by direct I/O
+	static BufferPtr GetAlignedRange (const PooledSecureBuffer &buffer, size_t size, size_t alignment)
+	{
+		size_t misalignment = (size_t) ((uintptr_t) buffer.Ptr() % alignment);
+		return buffer.GetRange (misalignment == 0 ? 0 : alignment - misalignment, size);
+	}
+
 	Volume::Volume ()
-		: HiddenVolumeProtectionTriggered (false),
+		: DiscardEnabled (false),
+		HiddenVolumeProtectionTriggered (false),
 		SystemEncryption (false),
 		VolumeDataOffset (0),
 		VolumeDataSize (0),
@@ -55,7 +66,166 @@ namespace VeraCrypt
 		if (VolumeFile.get() == nullptr)
 			throw NotInitialized (SRC_POS);
 
-		VolumeFile.reset();
+		finally_do_arg (Volume *, this,
+		{
+			finally_arg->WriteBuffer.reset();
+			finally_arg->WriteBufferWriter.reset();
+			finally_arg->ReadAhead.reset();
+			finally_arg->AsyncIo.reset();
+			finally_arg->VolumeFile.reset();
+			finally_arg->SectorCache.reset();
+		});
+
+		// Buffered writes are completed before the volume file is released
+		FlushWriteBuffer();
+	}
+
+	void Volume::DecryptHostSectors (const BufferPtr &buffer, uint64 hostOffset) const
+	{
+		ScopedLatency latency (Statistics, VolumeLatency::ReadCrypto);
+
+		// Discarded sectors are read from holes of the host file as zeros, which are returned unchanged
+		if (DiscardEnabled)
+			EA->DecryptSparseSectors (buffer, hostOffset / SectorSize, buffer.Size() / SectorSize, SectorSize);
+		else
+			EA->DecryptSectors (buffer, hostOffset / SectorSize, buffer.Size() / SectorSize, SectorSize);
+	}
+
+	void Volume::DiscardSectors (uint64 byteOffset, uint64 length)
+	{
+		if_debug (ValidateState ());
+
+		uint64 hostOffset = VolumeDataOffset + byteOffset;
+		uint64 hostEndOffset = hostOffset + length;
+
+		if (length % SectorSize != 0
+			|| byteOffset % SectorSize != 0
+			|| byteOffset + length > VolumeDataSize)
+			throw ParameterIncorrect (SRC_POS);
+
+		if (!DiscardEnabled)
+			throw NotApplicable (SRC_POS);
+
+		if (Protection == VolumeProtection::ReadOnly)
+			throw VolumeReadOnly (SRC_POS);
+
+		if (HiddenVolumeProtectionTriggered)
+			throw VolumeProtected (SRC_POS);
+
+		// Pending writes to the range are older than the discard
+		FlushWriteBuffer();
+
+		Mutex *directIoWriteMutex = VolumeFile->GetDirectIoAlignment() > SectorSize ? &DirectIoWriteMutex : nullptr;
+
+		if (directIoWriteMutex)
+			directIoWriteMutex->Lock();
+
+		finally_do_arg (Mutex *, directIoWriteMutex, { if (finally_arg) finally_arg->Unlock(); });
+
+		// The protected hidden volume is not deallocated, as the outer volume treats its area as free space
+		if (Protection == VolumeProtection::HiddenVolumeReadOnly
+			&& hostOffset < ProtectedRangeEnd && hostEndOffset > ProtectedRangeStart)
+		{
+			if (hostOffset < ProtectedRangeStart)
+				VolumeFile->PunchHole (hostOffset, ProtectedRangeStart - hostOffset);
+
+			if (hostEndOffset > ProtectedRangeEnd)
+				VolumeFile->PunchHole (ProtectedRangeEnd, hostEndOffset - ProtectedRangeEnd);
+		}
+		else if (length > 0)
+			VolumeFile->PunchHole (hostOffset, length);
+
+		InvalidateCachedSectors (byteOffset, length);
+	}
+
+	void Volume::EnableAsyncIo (size_t queueDepth)
+	{
+		if_debug (ValidateState ());
+
+		AsyncIo.reset();
+
+		// Transfers are performed synchronously where asynchronous I/O is not available
+		if (queueDepth > 0 && AsyncFile::IsSupported())
+			AsyncIo.reset (new AsyncFile (VolumeFile, queueDepth));
+	}
+
+	void Volume::EnableDirectIo ()
+	{
+		if_debug (ValidateState ());
+
+		// Unaligned transfers are handled by ReadHostData() and WriteHostData()
+		VolumeFile->EnableDirectIo();
+	}
+
+	void Volume::EnableDiscard ()
+	{
+		if_debug (ValidateState ());
+
+		// Discarded sectors of volumes whose data is not entirely encrypted could not be told apart from plaintext.
+		// Enabled before the read-ahead, which decrypts sectors independently.
+		if (!SystemEncryption && !EncryptionNotCompleted)
+			DiscardEnabled = true;
+	}
+
+	void Volume::EnableReadAhead (size_t readAheadSize)
+	{
+		if_debug (ValidateState ());
+
+		ReadAhead.reset();
+
+		// Volumes whose data is not entirely encrypted are read only through ReadSectors()
+		if (readAheadSize > 0 && !SystemEncryption && !EncryptionNotCompleted)
+			ReadAhead.reset (new VolumeReadAhead (VolumeFile, EA, VolumeDataOffset, VolumeDataSize, SectorSize, readAheadSize, DiscardEnabled));
+	}
+
+	void Volume::EnableSectorCache (size_t cacheSize)
+	{
+		if_debug (ValidateState ());
+
+		SectorCache.reset();
+
+		if (cacheSize > 0)
+			SectorCache.reset (new VolumeSectorCache (cacheSize));
+	}
+
+	void Volume::EnableWriteBuffer (size_t bufferSize)
+	{
+		if_debug (ValidateState ());
+
+		FlushWriteBuffer();
+		WriteBuffer.reset();
+
+		if (bufferSize > 0)
+		{
+			struct WriteUnbuffered : public VolumeWriteBuffer::SectorHandler
+			{
+				WriteUnbuffered (Volume *volume) : VolumeObj (volume) { }
+
+				virtual void operator() (const BufferPtr &buffer, uint64 byteOffset)
+				{
+					VolumeObj->WriteUnbufferedSectors (buffer, byteOffset);
+				}
+
+				Volume *VolumeObj;
+			};
+
+			WriteBufferWriter.reset (new WriteUnbuffered (this));
+			WriteBuffer.reset (new VolumeWriteBuffer (bufferSize, *WriteBufferWriter));
+		}
+	}
+
+	void Volume::Flush ()
+	{
+		if_debug (ValidateState ());
+
+		FlushWriteBuffer();
+		VolumeFile->Flush();
+	}
+
+	void Volume::FlushWriteBuffer ()
+	{
+		if (WriteBuffer)
+			WriteBuffer->Flush();
 	}
 
 	shared_ptr <EncryptionAlgorithm> Volume::GetEncryptionAlgorithm () const
@@ -70,6 +240,21 @@ namespace VeraCrypt
 		return EA->GetMode();
 	}
 
+	void Volume::InvalidateCachedSectors (uint64 byteOffset, uint64 length)
+	{
+		if (ReadAhead)
+			ReadAhead->Invalidate (byteOffset, length);
+
+		if (SectorCache)
+			SectorCache->Invalidate (byteOffset, length);
+	}
+
+	bool Volume::IsDirectIoAligned (const void *memory, uint64 hostOffset, uint64 length) const
+	{
+		size_t alignment = VolumeFile->GetDirectIoAlignment();
+		return alignment <= 1 || (((uint64) (uintptr_t) memory | hostOffset | length) % alignment) == 0;
+	}
+
 	void Volume::Open (const VolumePath &volumePath, bool preserveTimestamps, shared_ptr <VolumePassword> password, int pim, shared_ptr <Pkcs5Kdf> kdf, shared_ptr <KeyfileList> keyfiles, wstring securityTokenSchemeSpec, bool emvSupportEnabled, VolumeProtection::Enum protection, shared_ptr <VolumePassword> protectionPassword, int protectionPim, shared_ptr <Pkcs5Kdf> protectionKdf, shared_ptr <KeyfileList> protectionKeyfiles, wstring protectionSecurityTokenSchemeSpec, bool sharedAccessAllowed, VolumeType::Enum volumeType, bool useBackupHeaders, bool partitionInSystemEncryptionScope)
 	{
 		make_shared_auto (File, file);
@@ -119,8 +304,9 @@ namespace VeraCrypt
 			shared_ptr <VolumePassword> passwordKey = Keyfile::ApplyListToPassword (keyfiles, password, securityTokenSchemeSpec, emvSupportEnabled);
 
 			bool skipLayoutV1Normal = false;
+			vector <HeaderProbeCandidate> candidates;
 
-			// Test volume layouts
+			// Read headers of all volume layouts
 			foreach (shared_ptr <VolumeLayout> layout, VolumeLayout::GetAvailableLayouts (volumeType))
 			{
 				if (skipLayoutV1Normal && typeid (*layout) == typeid (VolumeLayoutV1Normal))
@@ -132,7 +318,7 @@ namespace VeraCrypt
 				if (useBackupHeaders && !layout->HasBackupHeader())
 					continue;
 
-				SecureBuffer headerBuffer (layout->GetHeaderSize());
+				shared_ptr <SecureBuffer> headerBuffer (new SecureBuffer (layout->GetHeaderSize()));
 
 				if (layout->HasDriveHeader())
 				{
@@ -152,7 +338,7 @@ namespace VeraCrypt
 					else
 						driveDevice.SeekEnd (headerOffset);
 
-					if (driveDevice.Read (headerBuffer) != layout->GetHeaderSize())
+					if (driveDevice.Read (*headerBuffer) != layout->GetHeaderSize())
 						continue;
 				}
 				else
@@ -167,104 +353,110 @@ namespace VeraCrypt
 					else
 						VolumeFile->SeekEnd (headerOffset);
 
-					if (VolumeFile->Read (headerBuffer) != layout->GetHeaderSize())
+					if (VolumeFile->Read (*headerBuffer) != layout->GetHeaderSize())
 						continue;
 				}
 
-				EncryptionAlgorithmList layoutEncryptionAlgorithms = layout->GetSupportedEncryptionAlgorithms();
-				EncryptionModeList layoutEncryptionModes = layout->GetSupportedEncryptionModes();
+				HeaderProbeCandidate candidate;
+				candidate.Layout = layout;
+				candidate.HeaderBuffer = headerBuffer;
+				candidate.EncryptionAlgorithms = layout->GetSupportedEncryptionAlgorithms();
+				candidate.EncryptionModes = layout->GetSupportedEncryptionModes();
 
 				if (typeid (*layout) == typeid (VolumeLayoutV2Normal))
 				{
 					skipLayoutV1Normal = true;
 
 					// Test all algorithms and modes of VolumeLayoutV1Normal as it shares header location with VolumeLayoutV2Normal
-					layoutEncryptionAlgorithms = EncryptionAlgorithm::GetAvailableAlgorithms();
-					layoutEncryptionModes = EncryptionMode::GetAvailableModes();
+					candidate.EncryptionAlgorithms = EncryptionAlgorithm::GetAvailableAlgorithms();
+					candidate.EncryptionModes = EncryptionMode::GetAvailableModes();
 				}
 
-				shared_ptr <VolumeHeader> header = layout->GetHeader();
+				candidates.push_back (candidate);
+			}
+
+			shared_ptr <VolumeLayout> layout;
+			shared_ptr <VolumeHeader> header;
+
+			if (ProbeHeaders (candidates, passwordKey, pim, kdf, layout, header))
+			{
+				// Header decrypted
 
-				if (header->Decrypt (headerBuffer, *passwordKey, pim, kdf, layout->GetSupportedKeyDerivationFunctions(), layoutEncryptionAlgorithms, layoutEncryptionModes))
+				if (typeid (*layout) == typeid (VolumeLayoutV2Normal) && header->GetRequiredMinProgramVersion() < 0x10b)
 				{
-					// Header decrypted
+					// VolumeLayoutV1Normal has been opened as VolumeLayoutV2Normal
+					layout.reset (new VolumeLayoutV1Normal);
+					header->SetSize (layout->GetHeaderSize());
+					layout->SetHeader (header);
+				}
+
+				Pim = pim;
+				Type = layout->GetType();
+				SectorSize = header->GetSectorSize();
+
+				VolumeDataOffset = layout->GetDataOffset (VolumeHostSize);
+				VolumeDataSize = layout->GetDataSize (VolumeHostSize);
+				EncryptedDataSize = header->GetEncryptedAreaLength();
+
+				Header = header;
+				Layout = layout;
+				EA = header->GetEncryptionAlgorithm();
+				EncryptionMode &mode = *EA->GetMode();
 
-					if (typeid (*layout) == typeid (VolumeLayoutV2Normal) && header->GetRequiredMinProgramVersion() < 0x10b)
+				if (layout->HasDriveHeader())
+				{
+					if (header->GetEncryptedAreaLength() != header->GetVolumeDataSize())
 					{
-						// VolumeLayoutV1Normal has been opened as VolumeLayoutV2Normal
-						layout.reset (new VolumeLayoutV1Normal);
-						header->SetSize (layout->GetHeaderSize());
-						layout->SetHeader (header);
+						EncryptionNotCompleted = true;
+						// we avoid writing data to the partition since it is only partially encrypted
+						Protection = VolumeProtection::ReadOnly;
 					}
 
-					Pim = pim;
-					Type = layout->GetType();
-					SectorSize = header->GetSectorSize();
+					uint64 partitionStartOffset = VolumeFile->GetPartitionDeviceStartOffset();
 
-					VolumeDataOffset = layout->GetDataOffset (VolumeHostSize);
-					VolumeDataSize = layout->GetDataSize (VolumeHostSize);
-					EncryptedDataSize = header->GetEncryptedAreaLength();
+					if (partitionStartOffset < header->GetEncryptedAreaStart()
+						|| partitionStartOffset >= header->GetEncryptedAreaStart() + header->GetEncryptedAreaLength())
+						throw PasswordIncorrect (SRC_POS);
 
-					Header = header;
-					Layout = layout;
-					EA = header->GetEncryptionAlgorithm();
-					EncryptionMode &mode = *EA->GetMode();
+					EncryptedDataSize -= partitionStartOffset - header->GetEncryptedAreaStart();
 
-					if (layout->HasDriveHeader())
+					mode.SetSectorOffset (partitionStartOffset / ENCRYPTION_DATA_UNIT_SIZE);
+				}
+
+				// Volume protection
+				if (Protection == VolumeProtection::HiddenVolumeReadOnly)
+				{
+					if (Type == VolumeType::Hidden)
+						throw PasswordIncorrect (SRC_POS);
+					else
 					{
-						if (header->GetEncryptedAreaLength() != header->GetVolumeDataSize())
+						try
 						{
-							EncryptionNotCompleted = true;
-							// we avoid writing data to the partition since it is only partially encrypted
-							Protection = VolumeProtection::ReadOnly;
-						}
-
-						uint64 partitionStartOffset = VolumeFile->GetPartitionDeviceStartOffset();
+							Volume protectedVolume;
 
-						if (partitionStartOffset < header->GetEncryptedAreaStart()
-							|| partitionStartOffset >= header->GetEncryptedAreaStart() + header->GetEncryptedAreaLength())
-							throw PasswordIncorrect (SRC_POS);
+							protectedVolume.Open (VolumeFile,
+								protectionPassword, protectionPim, protectionKdf, protectionKeyfiles, protectionSecurityTokenSchemeSpec,
+								emvSupportEnabled,
+								VolumeProtection::ReadOnly,
+								shared_ptr <VolumePassword> (), 0, shared_ptr <Pkcs5Kdf> (),shared_ptr <KeyfileList> (), wstring(),
+								VolumeType::Hidden,
+								useBackupHeaders, false);
 
-						EncryptedDataSize -= partitionStartOffset - header->GetEncryptedAreaStart();
-
-						mode.SetSectorOffset (partitionStartOffset / ENCRYPTION_DATA_UNIT_SIZE);
-					}
+							if (protectedVolume.GetType() != VolumeType::Hidden)
+								ParameterIncorrect (SRC_POS);
 
-					// Volume protection
-					if (Protection == VolumeProtection::HiddenVolumeReadOnly)
-					{
-						if (Type == VolumeType::Hidden)
-							throw PasswordIncorrect (SRC_POS);
-						else
+							ProtectedRangeStart = protectedVolume.VolumeDataOffset;
+							ProtectedRangeEnd = protectedVolume.VolumeDataOffset + protectedVolume.VolumeDataSize;
+						}
+						catch (PasswordException&)
 						{
-							try
-							{
-								Volume protectedVolume;
-
-								protectedVolume.Open (VolumeFile,
-									protectionPassword, protectionPim, protectionKdf, protectionKeyfiles, protectionSecurityTokenSchemeSpec,
-									emvSupportEnabled,
-									VolumeProtection::ReadOnly,
-									shared_ptr <VolumePassword> (), 0, shared_ptr <Pkcs5Kdf> (),shared_ptr <KeyfileList> (), wstring(),
-									VolumeType::Hidden,
-									useBackupHeaders, false);
-
-								if (protectedVolume.GetType() != VolumeType::Hidden)
-									ParameterIncorrect (SRC_POS);
-
-								ProtectedRangeStart = protectedVolume.VolumeDataOffset;
-								ProtectedRangeEnd = protectedVolume.VolumeDataOffset + protectedVolume.VolumeDataSize;
-							}
-							catch (PasswordException&)
-							{
-								if (protectionKeyfiles && !protectionKeyfiles->empty())
-									throw ProtectionPasswordKeyfilesIncorrect (SRC_POS);
-								throw ProtectionPasswordIncorrect (SRC_POS);
-							}
+							if (protectionKeyfiles && !protectionKeyfiles->empty())
+								throw ProtectionPasswordKeyfilesIncorrect (SRC_POS);
+							throw ProtectionPasswordIncorrect (SRC_POS);
 						}
 					}
-					return;
 				}
+				return;
 			}
 
 			if (partitionInSystemEncryptionScope)
@@ -305,18 +497,223 @@ namespace VeraCrypt
 		}
 	}
 
+	bool Volume::ProbeHeaders (const vector <HeaderProbeCandidate> &candidates, shared_ptr <VolumePassword> passwordKey, int pim, shared_ptr <Pkcs5Kdf> kdf, shared_ptr <VolumeLayout> &layout, shared_ptr <VolumeHeader> &header)
+	{
+		typedef EncryptionThreadPool::KeyDerivationRequest KeyDerivationRequest;
+
+		struct Probe
+		{
+			size_t Candidate;
+			shared_ptr <KeyDerivationRequest> Request;
+			bool Processed;
+		};
+
+		// Header keys of all (layout, KDF) candidates are derived concurrently on the encryption thread pool.
+		// Results are accepted in layout order: a header decrypted for a layout is used only after all
+		// candidates of preceding layouts have failed, so the outcome matches a sequential search.
+
+		if (!candidates.empty() && passwordKey->Size() < 1)
+			throw PasswordEmpty (SRC_POS);
+
+		shared_ptr <SyncEvent> completionEvent (new SyncEvent);
+		vector <Probe> probes;
+
+		for (size_t i = 0; i < candidates.size(); ++i)
+		{
+			foreach (shared_ptr <Pkcs5Kdf> pkcs5, candidates[i].Layout->GetSupportedKeyDerivationFunctions())
+			{
+				if (kdf && (kdf->GetName() != pkcs5->GetName()))
+					continue;
+
+				Probe probe;
+				probe.Candidate = i;
+				probe.Request.reset (new KeyDerivationRequest (pkcs5, passwordKey, pim, VolumeHeader::GetSalt (*candidates[i].HeaderBuffer),
+					VolumeHeader::GetLargestSerializedKeySize(), completionEvent));
+				probe.Processed = false;
+
+				probes.push_back (probe);
+			}
+		}
+
+		finally_do_arg (vector <Probe> *, &probes,
+		{
+			for (size_t i = 0; i < finally_arg->size(); ++i)
+				(*finally_arg)[i].Request->Cancelled = 1;
+		});
+
+		// Without a thread pool, keys are derived one at a time so that the search can stop at the first match
+		bool parallel = EncryptionThreadPool::IsRunning();
+		size_t submitted = 0;
+
+		if (parallel)
+		{
+			for (; submitted < probes.size(); ++submitted)
+				EncryptionThreadPool::BeginKeyDerivation (probes[submitted].Request);
+		}
+
+		vector < shared_ptr <VolumeHeader> > headers (candidates.size());
+		HeaderProbeResults.clear();
+
+		size_t foundCandidate = candidates.size();
+		bool finished = probes.empty();
+
+		while (!finished)
+		{
+			if (!parallel && submitted < probes.size())
+				EncryptionThreadPool::BeginKeyDerivation (probes[submitted++].Request);
+
+			for (size_t i = 0; i < probes.size(); ++i)
+			{
+				Probe &probe = probes[i];
+				KeyDerivationRequest &request = *probe.Request;
+
+				if (probe.Processed || !request.Completed || headers[probe.Candidate])
+					continue;
+
+				probe.Processed = true;
+
+				if (request.DerivationException.get())
+					request.DerivationException->Throw();
+
+				const HeaderProbeCandidate &candidate = candidates[probe.Candidate];
+				shared_ptr <VolumeHeader> candidateHeader = candidate.Layout->GetHeader();
+
+				trace_msgw ("Derived key using " << request.Kdf->GetName() << " in " << request.ElapsedTime / 1000 / 1000 << " ms");
+
+				bool decrypted = candidateHeader->Decrypt (*candidate.HeaderBuffer, request.DerivedKey, request.Kdf, candidate.EncryptionAlgorithms, candidate.EncryptionModes);
+				if (decrypted)
+					headers[probe.Candidate] = candidateHeader;
+
+				VolumeHeaderProbeResult result;
+				result.LayoutType = candidate.Layout->GetType();
+				result.KdfName = request.Kdf->GetName();
+				result.ElapsedTime = request.ElapsedTime;
+				result.Completed = true;
+				result.HeaderDecrypted = decrypted;
+				HeaderProbeResults.push_back (result);
+			}
+
+			// Find the first layout which either succeeded or still has outstanding candidates
+			finished = true;
+			for (size_t i = 0; i < probes.size(); ++i)
+			{
+				const Probe &probe = probes[i];
+
+				if (headers[probe.Candidate])
+				{
+					foundCandidate = probe.Candidate;
+					break;
+				}
+
+				if (!probe.Processed)
+				{
+					finished = false;
+					break;
+				}
+			}
+
+			if (!finished && parallel)
+				completionEvent->Wait();
+		}
+
+		for (size_t i = 0; i < probes.size(); ++i)
+		{
+			const Probe &probe = probes[i];
+
+			if (probe.Processed)
+				continue;
+
+			VolumeHeaderProbeResult result;
+			result.LayoutType = candidates[probe.Candidate].Layout->GetType();
+			result.KdfName = probe.Request->Kdf->GetName();
+			result.ElapsedTime = 0;
+			result.Completed = false;
+			result.HeaderDecrypted = false;
+			HeaderProbeResults.push_back (result);
+		}
+
+		if (foundCandidate == candidates.size())
+			return false;
+
+		layout = candidates[foundCandidate].Layout;
+		header = headers[foundCandidate];
+		return true;
+	}
+
 	void Volume::ReadSectors (const BufferPtr &buffer, uint64 byteOffset)
 	{
 		if_debug (ValidateState ());
 
+		if (buffer.Size() % SectorSize != 0 || byteOffset % SectorSize != 0)
+			throw ParameterIncorrect (SRC_POS);
+
+		uint64 startTime = Time::GetMonotonic();
+
+		if (WriteBuffer)
+		{
+			// Data of pending writes replaces the data read
+			struct ReadUnbuffered : public VolumeWriteBuffer::SectorHandler
+			{
+				ReadUnbuffered (Volume *volume) : VolumeObj (volume) { }
+
+				virtual void operator() (const BufferPtr &buffer, uint64 byteOffset)
+				{
+					VolumeObj->ReadUnbufferedSectors (buffer, byteOffset);
+				}
+
+				Volume *VolumeObj;
+			};
+
+			ReadUnbuffered readUnbuffered (this);
+			WriteBuffer->Read (buffer, byteOffset, readUnbuffered);
+		}
+		else
+			ReadUnbufferedSectors (buffer, byteOffset);
+
+		Statistics.AddRead (buffer.Size(), Time::GetMonotonic() - startTime);
+	}
+
+	void Volume::ReadUnbufferedSectors (const BufferPtr &buffer, uint64 byteOffset)
+	{
 		uint64 length = buffer.Size();
 		uint64 hostOffset = VolumeDataOffset + byteOffset;
 		size_t bufferOffset = 0;
 
-		if (length % SectorSize != 0 || byteOffset % SectorSize != 0)
-			throw ParameterIncorrect (SRC_POS);
+		if (ReadAhead && ReadAhead->Read (buffer, byteOffset))
+		{
+			TotalDataRead += length;
+			return;
+		}
+
+		// Small requests are typically filesystem metadata, which is read repeatedly
+		if (SectorCache
+			&& length <= VolumeSectorCache::MaxRequestSize
+			&& !SystemEncryption
+			&& !EncryptionNotCompleted)
+		{
+			uint64 unitsEndOffset = byteOffset + length;
+			if (unitsEndOffset % VolumeSectorCache::UnitSize != 0)
+				unitsEndOffset += VolumeSectorCache::UnitSize - unitsEndOffset % VolumeSectorCache::UnitSize;
+
+			if (unitsEndOffset <= VolumeDataSize)
+			{
+				ReadCachedSectors (buffer, byteOffset);
+				return;
+			}
+		}
+
+		if (AsyncIo
+			&& length > AsyncIoChunkSize
+			&& !SystemEncryption
+			&& !EncryptionNotCompleted
+			&& IsDirectIoAligned (buffer.Get(), hostOffset, length))
+		{
+			ReadSectorsAsync (buffer, hostOffset);
+			TotalDataRead += length;
+			return;
+		}
 
-		if (VolumeFile->ReadAt (buffer, hostOffset) != length)
+		if (ReadHostData (buffer, hostOffset) != length)
 			throw MissingVolumeData (SRC_POS);
 
 		// first sector can be unencrypted in some cases (e.g. windows repair)
@@ -341,12 +738,165 @@ namespace VeraCrypt
 				}
 			}
 			else
-				EA->DecryptSectors (buffer.GetRange (bufferOffset, length), hostOffset / SectorSize, length / SectorSize, SectorSize);
+				DecryptHostSectors (buffer.GetRange (bufferOffset, length), hostOffset);
 		}
 
 		TotalDataRead += length;
 	}
 
+	void Volume::ReadCachedSectors (const BufferPtr &buffer, uint64 byteOffset)
+	{
+		uint64 length = buffer.Size();
+
+		if (!SectorCache->Read (buffer, byteOffset))
+		{
+			uint64 unitsOffset = byteOffset - byteOffset % VolumeSectorCache::UnitSize;
+			uint64 unitsLength = byteOffset + length - unitsOffset;
+			if (unitsLength % VolumeSectorCache::UnitSize != 0)
+				unitsLength += VolumeSectorCache::UnitSize - unitsLength % VolumeSectorCache::UnitSize;
+
+			uint64 hostOffset = VolumeDataOffset + unitsOffset;
+			uint64 generation = SectorCache->GetGeneration();
+
+			PooledSecureBuffer units ((size_t) unitsLength);
+
+			if (ReadHostData (units, hostOffset) != unitsLength)
+				throw MissingVolumeData (SRC_POS);
+
+			DecryptHostSectors (units, hostOffset);
+
+			SectorCache->Insert (units, unitsOffset, generation);
+			buffer.CopyFrom (units.GetRange ((size_t) (byteOffset - unitsOffset), (size_t) length));
+		}
+
+		TotalDataRead += length;
+	}
+
+	uint64 Volume::ReadHostData (const BufferPtr &buffer, uint64 hostOffset)
+	{
+		ScopedLatency latency (Statistics, VolumeLatency::ReadHost);
+
+		if (IsDirectIoAligned (buffer.Get(), hostOffset, buffer.Size()))
+			return VolumeFile->ReadAt (buffer, hostOffset);
+
+		size_t alignment = VolumeFile->GetDirectIoAlignment();
+		uint64 alignedOffset = hostOffset - hostOffset % alignment;
+		size_t leadSize = (size_t) (hostOffset - alignedOffset);
+
+		size_t alignedSize = leadSize + buffer.Size();
+		if (alignedSize % alignment != 0)
+			alignedSize += alignment - alignedSize % alignment;
+
+		PooledSecureBuffer bounceBuffer (alignedSize + (alignment > SecureBufferPool::Alignment ? alignment : 0));
+		BufferPtr alignedBuffer = GetAlignedRange (bounceBuffer, alignedSize, alignment);
+
+		uint64 bytesRead = VolumeFile->ReadAt (alignedBuffer, alignedOffset);
+		if (bytesRead <= leadSize)
+			return 0;
+
+		size_t copySize = buffer.Size();
+		if (bytesRead - leadSize < copySize)
+			copySize = (size_t) (bytesRead - leadSize);
+
+		Memory::Copy (buffer.Get(), alignedBuffer.Get() + leadSize, copySize);
+		return copySize;
+	}
+
+	void Volume::ReadSectorsAsync (const BufferPtr &buffer, uint64 hostOffset)
+	{
+		typedef EncryptionThreadPool::WorkRequest WorkRequest;
+
+		// Each chunk is submitted for decryption as soon as it has been read, so that this thread keeps the ring
+		// filled with reads while the pool decrypts. Chunks of volumes with discard enabled are checked for
+		// sparse sectors and therefore decrypted by this thread.
+		struct DecryptChunk : public AsyncFile::ChunkHandler
+		{
+			DecryptChunk (const Volume &volume) : VolumeObj (volume), DecryptionTime (0) { }
+
+			virtual void operator() (const BufferPtr &chunk, uint64 position)
+			{
+				uint64 startTime = Time::GetMonotonic();
+
+				if (VolumeObj.DiscardEnabled)
+				{
+					VolumeObj.DecryptHostSectors (chunk, position);
+				}
+				else
+				{
+					SectorRun run;
+					run.Data = chunk.Get();
+					run.SectorIndex = position / VolumeObj.SectorSize;
+					run.SectorCount = chunk.Size() / VolumeObj.SectorSize;
+
+					shared_ptr <WorkRequest> request (new WorkRequest (EncryptionThreadPool::WorkType::DecryptDataUnits, VolumeObj.EA->GetMode().get(), &run, 1, VolumeObj.SectorSize));
+					EncryptionThreadPool::BeginWork (request);
+					Requests.push_back (request);
+				}
+
+				DecryptionTime += Time::GetMonotonic() - startTime;
+			}
+
+			// Waits for all requests, as the buffer must not be released while any of them is outstanding
+			void EndRequests ()
+			{
+				unique_ptr <Exception> requestException;
+
+				foreach (shared_ptr <WorkRequest> request, Requests)
+				{
+					try
+					{
+						EncryptionThreadPool::EndWork (*request);
+					}
+					catch (Exception &e)
+					{
+						if (!requestException)
+							requestException.reset (e.CloneNew());
+					}
+				}
+
+				Requests.clear();
+
+				if (requestException)
+					requestException->Throw();
+			}
+
+			const Volume &VolumeObj;
+			uint64 DecryptionTime;
+			list < shared_ptr <WorkRequest> > Requests;
+		};
+
+		DecryptChunk decryptChunk (*this);
+		uint64 startTime = Time::GetMonotonic();
+		uint64 bytesRead;
+
+		try
+		{
+			bytesRead = AsyncIo->ReadAt (buffer, hostOffset, AsyncIoChunkSize, decryptChunk);
+		}
+		catch (...)
+		{
+			try
+			{
+				decryptChunk.EndRequests();
+			}
+			catch (...) { }
+
+			throw;
+		}
+
+		// Chunks are decrypted while the others are being read, so the host time is the remainder
+		Statistics.AddLatency (VolumeLatency::ReadHost, Time::GetMonotonic() - startTime - decryptChunk.DecryptionTime);
+
+		{
+			// Only the decryption of the last chunks is not overlapped by reads
+			ScopedLatency latency (Statistics, VolumeLatency::ReadCrypto);
+			decryptChunk.EndRequests();
+		}
+
+		if (bytesRead != buffer.Size())
+			throw MissingVolumeData (SRC_POS);
+	}
+
 	void Volume::ReEncryptHeader (bool backupHeader, const ConstBufferPtr &newSalt, const ConstBufferPtr &newHeaderKey, shared_ptr <Pkcs5Kdf> newPkcs5Kdf)
 	{
 		if_debug (ValidateState ());
@@ -395,16 +945,143 @@ namespace VeraCrypt
 		if (Protection == VolumeProtection::HiddenVolumeReadOnly)
 			CheckProtectedRange (hostOffset, length);
 
-		SecureBuffer encBuf (buffer.Size());
-		encBuf.CopyFrom (buffer);
+		uint64 startTime = Time::GetMonotonic();
 
-		EA->EncryptSectors (encBuf, hostOffset / SectorSize, length / SectorSize, SectorSize);
-		VolumeFile->WriteAt (encBuf, hostOffset);
+		if (WriteBuffer && WriteBuffer->Write (buffer, byteOffset))
+		{
+			// Reads are served from the write buffer until the data is written, which invalidates cached data again
+			InvalidateCachedSectors (byteOffset, length);
+		}
+		else
+			WriteUnbufferedSectors (buffer, byteOffset);
 
 		TotalDataWritten += length;
+		Statistics.AddWrite (length, Time::GetMonotonic() - startTime);
 
 		uint64 writeEndOffset = byteOffset + buffer.Size();
 		if (writeEndOffset > TopWriteOffset)
 			TopWriteOffset = writeEndOffset;
 	}
+
+	void Volume::WriteUnbufferedSectors (const ConstBufferPtr &buffer, uint64 byteOffset)
+	{
+		uint64 length = buffer.Size();
+		uint64 hostOffset = VolumeDataOffset + byteOffset;
+
+		if (SectorCache || ReadAhead)
+		{
+			// Cached data is invalidated after the write so that concurrent reads cannot cache stale data
+			try
+			{
+				WriteEncryptedSectors (buffer, hostOffset);
+			}
+			catch (...)
+			{
+				InvalidateCachedSectors (byteOffset, length);
+				throw;
+			}
+
+			InvalidateCachedSectors (byteOffset, length);
+		}
+		else
+			WriteEncryptedSectors (buffer, hostOffset);
+	}
+
+	void Volume::WriteEncryptedSectors (const ConstBufferPtr &buffer, uint64 hostOffset)
+	{
+		// Partial blocks are rewritten together with adjacent sectors, which must not be written meanwhile
+		Mutex *directIoWriteMutex = VolumeFile->GetDirectIoAlignment() > SectorSize ? &DirectIoWriteMutex : nullptr;
+
+		if (directIoWriteMutex)
+			directIoWriteMutex->Lock();
+
+		finally_do_arg (Mutex *, directIoWriteMutex, { if (finally_arg) finally_arg->Unlock(); });
+
+		if (AsyncIo
+			&& buffer.Size() > AsyncIoChunkSize
+			&& IsDirectIoAligned (nullptr, hostOffset, buffer.Size()))
+		{
+			// Each chunk is encrypted while the previous ones are being written
+			struct EncryptChunk : public AsyncFile::ChunkHandler
+			{
+				EncryptChunk (const ConstBufferPtr &buffer, uint64 hostOffset, EncryptionAlgorithm &ea, size_t sectorSize, VolumeStatisticsCounters &statistics)
+					: Plaintext (buffer), HostOffset (hostOffset), EA (ea), SectorSize (sectorSize), Statistics (statistics), EncryptionTime (0) { }
+
+				virtual void operator() (const BufferPtr &chunk, uint64 position)
+				{
+					uint64 startTime = Time::GetMonotonic();
+					chunk.CopyFrom (Plaintext.GetRange ((size_t) (position - HostOffset), chunk.Size()));
+					EA.EncryptSectors (chunk, position / SectorSize, chunk.Size() / SectorSize, SectorSize);
+
+					uint64 time = Time::GetMonotonic() - startTime;
+					Statistics.AddLatency (VolumeLatency::WriteCrypto, time);
+					EncryptionTime += time;
+				}
+
+				const ConstBufferPtr &Plaintext;
+				uint64 HostOffset;
+				EncryptionAlgorithm &EA;
+				size_t SectorSize;
+				VolumeStatisticsCounters &Statistics;
+				uint64 EncryptionTime;
+			};
+
+			EncryptChunk encryptChunk (buffer, hostOffset, *EA, SectorSize, Statistics);
+			uint64 startTime = Time::GetMonotonic();
+
+			AsyncIo->WriteAt (buffer.Size(), hostOffset, AsyncIoChunkSize, encryptChunk);
+
+			// Chunks are encrypted while the others are being written, so the host time is the remainder
+			Statistics.AddLatency (VolumeLatency::WriteHost, Time::GetMonotonic() - startTime - encryptChunk.EncryptionTime);
+			return;
+		}
+
+		PooledSecureBuffer encBuf (buffer.Size());
+		encBuf.CopyFrom (buffer);
+
+		{
+			ScopedLatency latency (Statistics, VolumeLatency::WriteCrypto);
+			EA->EncryptSectors (encBuf, hostOffset / SectorSize, buffer.Size() / SectorSize, SectorSize);
+		}
+
+		WriteHostData (encBuf, hostOffset);
+	}
+
+	void Volume::WriteHostData (const ConstBufferPtr &buffer, uint64 hostOffset)
+	{
+		ScopedLatency latency (Statistics, VolumeLatency::WriteHost);
+
+		if (IsDirectIoAligned (buffer.Get(), hostOffset, buffer.Size()))
+		{
+			VolumeFile->WriteAt (buffer, hostOffset);
+			return;
+		}
+
+		size_t alignment = VolumeFile->GetDirectIoAlignment();
+		uint64 alignedOffset = hostOffset - hostOffset % alignment;
+		size_t leadSize = (size_t) (hostOffset - alignedOffset);
+
+		size_t alignedSize = leadSize + buffer.Size();
+		if (alignedSize % alignment != 0)
+			alignedSize += alignment - alignedSize % alignment;
+
+		PooledSecureBuffer bounceBuffer (alignedSize + (alignment > SecureBufferPool::Alignment ? alignment : 0));
+		BufferPtr alignedBuffer = GetAlignedRange (bounceBuffer, alignedSize, alignment);
+
+		// The first and the last block may hold data which is not overwritten
+		if (leadSize != 0)
+		{
+			if (VolumeFile->ReadAt (alignedBuffer.GetRange (0, alignment), alignedOffset) != alignment)
+				throw MissingVolumeData (SRC_POS);
+		}
+
+		if ((leadSize + buffer.Size()) % alignment != 0 && (leadSize == 0 || alignedSize > alignment))
+		{
+			if (VolumeFile->ReadAt (alignedBuffer.GetRange (alignedSize - alignment, alignment), alignedOffset + alignedSize - alignment) != alignment)
+				throw MissingVolumeData (SRC_POS);
+		}
+
+		Memory::Copy (alignedBuffer.Get() + leadSize, buffer.Get(), buffer.Size());
+		VolumeFile->WriteAt (alignedBuffer, alignedOffset);
+	}
 }
@@ -14,6 +14,7 @@
 #define TC_HEADER_Volume_Volume
 
 #include "Platform/Platform.h"
+#include "Platform/AsyncFile.h"
 #include "Platform/StringConverter.h"
 #include "EncryptionAlgorithm.h"
 #include "EncryptionMode.h"
@@ -21,6 +22,10 @@
 #include "VolumePassword.h"
 #include "VolumeException.h"
 #include "VolumeLayout.h"
+#include "VolumeReadAhead.h"
+#include "VolumeSectorCache.h"
+#include "VolumeStatistics.h"
+#include "VolumeWriteBuffer.h"
 
 namespace VeraCrypt
 {
@@ -79,6 +84,17 @@ namespace VeraCrypt
 		};
 	};
 
+	struct VolumeHeaderProbeResult
+	{
+		VolumeType::Enum LayoutType;
+		wstring KdfName;
+		uint64 ElapsedTime; // Nanoseconds spent deriving the header key
+		bool Completed;		// False if the derivation was cancelled or still running when the header was found
+		bool HeaderDecrypted;
+	};
+
+	typedef list <VolumeHeaderProbeResult> VolumeHeaderProbeResultList;
+
 	class Volume
 	{
 	public:
@@ -86,10 +102,20 @@ namespace VeraCrypt
 		virtual ~Volume ();
 
 		void Close ();
+		void DiscardSectors (uint64 byteOffset, uint64 length);
+		void EnableAsyncIo (size_t queueDepth);
+		void EnableDirectIo ();
+		void EnableDiscard ();
+		void EnableReadAhead (size_t readAheadSize);
+		void EnableSectorCache (size_t cacheSize);
+		void EnableWriteBuffer (size_t bufferSize);
+		void Flush ();
+		void FlushWriteBuffer ();
 		shared_ptr <EncryptionAlgorithm> GetEncryptionAlgorithm () const;
 		shared_ptr <EncryptionMode> GetEncryptionMode () const;
 		shared_ptr <File> GetFile () const { return VolumeFile; }
 		shared_ptr <VolumeHeader> GetHeader () const { return Header; }
+		const VolumeHeaderProbeResultList &GetHeaderProbeResults () const { return HeaderProbeResults; }
 		uint64 GetHeaderCreationTime () const { return Header->GetHeaderCreationTime(); }
 		uint64 GetHostSize () const { return VolumeHostSize; }
 		shared_ptr <VolumeLayout> GetLayout () const { return Layout; }
@@ -100,12 +126,16 @@ namespace VeraCrypt
 		size_t GetSectorSize () const { return SectorSize; }
 		uint64 GetSize () const { return VolumeDataSize; }
 		uint64 GetEncryptedSize () const { return EncryptedDataSize; }
+		uint64 GetSectorCacheHits () const { return SectorCache ? SectorCache->GetHits() : 0; }
+		uint64 GetSectorCacheMisses () const { return SectorCache ? SectorCache->GetMisses() : 0; }
+		VolumeStatistics GetStatistics () const { return Statistics.GetStatistics(); }
 		uint64 GetTopWriteOffset () const { return TopWriteOffset; }
 		uint64 GetTotalDataRead () const { return TotalDataRead; }
 		uint64 GetTotalDataWritten () const { return TotalDataWritten; }
 		VolumeType::Enum GetType () const { return Type; }
 		int GetPim() const { return Pim;}
 		uint64 GetVolumeCreationTime () const { return Header->GetVolumeCreationTime(); }
+		bool IsDiscardEnabled () const { return DiscardEnabled; }
 		bool IsHiddenVolumeProtectionTriggered () const { return HiddenVolumeProtectionTriggered; }
 		bool IsInSystemEncryptionScope () const { return SystemEncryption; }
 		void Open (const VolumePath &volumePath, bool preserveTimestamps, shared_ptr <VolumePassword> password, int pim, shared_ptr <Pkcs5Kdf> kdf, shared_ptr <KeyfileList> keyfiles, wstring securityTokenKeySpec, bool emvSupportEnabled, VolumeProtection::Enum protection = VolumeProtection::None, shared_ptr <VolumePassword> protectionPassword = shared_ptr <VolumePassword> (), int protectionPim = 0, shared_ptr <Pkcs5Kdf> protectionKdf = shared_ptr <Pkcs5Kdf> (),shared_ptr <KeyfileList> protectionKeyfiles = shared_ptr <KeyfileList> (), wstring protectionSecurityTokenKeySpec = wstring(), bool sharedAccessAllowed = false, VolumeType::Enum volumeType = VolumeType::Unknown, bool useBackupHeaders = false, bool partitionInSystemEncryptionScope = false);
@@ -117,17 +147,46 @@ namespace VeraCrypt
 		bool IsMasterKeyVulnerable() const { return Header && Header->IsMasterKeyVulnerable(); }
 
 	protected:
+		struct HeaderProbeCandidate
+		{
+			shared_ptr <VolumeLayout> Layout;
+			shared_ptr <SecureBuffer> HeaderBuffer;
+			EncryptionAlgorithmList EncryptionAlgorithms;
+			EncryptionModeList EncryptionModes;
+		};
+
 		void CheckProtectedRange (uint64 writeHostOffset, uint64 writeLength);
+		void DecryptHostSectors (const BufferPtr &buffer, uint64 hostOffset) const;
+		void InvalidateCachedSectors (uint64 byteOffset, uint64 length);
+		bool IsDirectIoAligned (const void *memory, uint64 hostOffset, uint64 length) const;
+		void ReadCachedSectors (const BufferPtr &buffer, uint64 byteOffset);
+		uint64 ReadHostData (const BufferPtr &buffer, uint64 hostOffset);
+		void ReadSectorsAsync (const BufferPtr &buffer, uint64 hostOffset);
+		void ReadUnbufferedSectors (const BufferPtr &buffer, uint64 byteOffset);
+		bool ProbeHeaders (const vector <HeaderProbeCandidate> &candidates, shared_ptr <VolumePassword> passwordKey, int pim, shared_ptr <Pkcs5Kdf> kdf, shared_ptr <VolumeLayout> &layout, shared_ptr <VolumeHeader> &header);
 		void ValidateState () const;
+		void WriteEncryptedSectors (const ConstBufferPtr &buffer, uint64 hostOffset);
+		void WriteHostData (const ConstBufferPtr &buffer, uint64 hostOffset);
+		void WriteUnbufferedSectors (const ConstBufferPtr &buffer, uint64 byteOffset);
 
+		// Requests larger than a chunk are transferred in chunks, each of which is processed as soon as it has been read
+		static const size_t AsyncIoChunkSize = 64 * 1024;
+
+		unique_ptr <AsyncFile> AsyncIo;
+		Mutex DirectIoWriteMutex;
+		bool DiscardEnabled;
 		shared_ptr <EncryptionAlgorithm> EA;
 		shared_ptr <VolumeHeader> Header;
+		VolumeHeaderProbeResultList HeaderProbeResults;
 		bool HiddenVolumeProtectionTriggered;
 		shared_ptr <VolumeLayout> Layout;
 		uint64 ProtectedRangeStart;
 		uint64 ProtectedRangeEnd;
 		VolumeProtection::Enum Protection;
+		unique_ptr <VolumeReadAhead> ReadAhead;
+		unique_ptr <VolumeSectorCache> SectorCache;
 		size_t SectorSize;
+		mutable VolumeStatisticsCounters Statistics;
 		bool SystemEncryption;
 		VolumeType::Enum Type;
 		shared_ptr <File> VolumeFile;
@@ -141,6 +200,10 @@ namespace VeraCrypt
 		int Pim;
 		bool EncryptionNotCompleted;
 
+		// Destroyed first, as its flush thread writes to the volume
+		unique_ptr <VolumeWriteBuffer::SectorHandler> WriteBufferWriter;
+		unique_ptr <VolumeWriteBuffer> WriteBuffer;
+
 	private:
 		Volume (const Volume &);
 		Volume &operator= (const Volume &);
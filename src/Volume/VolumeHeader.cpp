@@ -98,9 +98,7 @@ namespace VeraCrypt
 		if (password.Size() < 1)
 			throw PasswordEmpty (SRC_POS);
 
-		ConstBufferPtr salt (encryptedData.GetRange (SaltOffset, SaltSize));
-		SecureBuffer header (EncryptedHeaderDataSize);
-
+		ConstBufferPtr salt (GetSalt (encryptedData));
 		SecureBuffer headerKey (GetLargestSerializedKeySize());
 
 		foreach (shared_ptr <Pkcs5Kdf> pkcs5, keyDerivationFunctions)
@@ -111,50 +109,60 @@ namespace VeraCrypt
 			trace_msgw("Trying kdf " << pkcs5->GetName());
 			pkcs5->DeriveKey (headerKey, password, pim, salt);
 
-			foreach (shared_ptr <EncryptionMode> mode, encryptionModes)
+			if (Decrypt (encryptedData, headerKey, pkcs5, encryptionAlgorithms, encryptionModes))
+				return true;
+		}
+
+		return false;
+	}
+
+	bool VolumeHeader::Decrypt (const ConstBufferPtr &encryptedData, const ConstBufferPtr &headerKey, shared_ptr <Pkcs5Kdf> pkcs5, const EncryptionAlgorithmList &encryptionAlgorithms, const EncryptionModeList &encryptionModes)
+	{
+		SecureBuffer header (EncryptedHeaderDataSize);
+
+		foreach (shared_ptr <EncryptionMode> mode, encryptionModes)
+		{
+                    #ifdef WOLFCRYPT_BACKEND
+                        if (typeid (*mode) != typeid (EncryptionModeWolfCryptXTS))
+                    #else
+                        if (typeid (*mode) != typeid (EncryptionModeXTS))
+                    #endif
+                            mode->SetKey (headerKey.GetRange (0, mode->GetKeySize()));
+
+			foreach (shared_ptr <EncryptionAlgorithm> ea, encryptionAlgorithms)
 			{
-                            #ifdef WOLFCRYPT_BACKEND
-                                if (typeid (*mode) != typeid (EncryptionModeWolfCryptXTS))
+				if (!ea->IsModeSupported (mode))
+					continue;
+
+                            #ifndef WOLFCRYPT_BACKEND
+				if (typeid (*mode) == typeid (EncryptionModeXTS))
+				{
+                                   ea->SetKey (headerKey.GetRange (0, ea->GetKeySize()));
                             #else
-                                if (typeid (*mode) != typeid (EncryptionModeXTS))
+				if (typeid (*mode) == typeid (EncryptionModeWolfCryptXTS))
+				{
+                                      ea->SetKey (headerKey.GetRange (0, ea->GetKeySize()));
+					ea->SetKeyXTS (headerKey.GetRange (ea->GetKeySize(), ea->GetKeySize()));
                             #endif
-                                    mode->SetKey (headerKey.GetRange (0, mode->GetKeySize()));
 
-				foreach (shared_ptr <EncryptionAlgorithm> ea, encryptionAlgorithms)
+					mode = mode->GetNew();
+					mode->SetKey (headerKey.GetRange (ea->GetKeySize(), ea->GetKeySize()));
+				}
+				else
+				{
+					ea->SetKey (headerKey.GetRange (LegacyEncryptionModeKeyAreaSize, ea->GetKeySize()));
+				}
+
+				ea->SetMode (mode);
+
+				header.CopyFrom (encryptedData.GetRange (EncryptedHeaderDataOffset, EncryptedHeaderDataSize));
+				ea->Decrypt (header);
+
+				if (Deserialize (header, ea, mode))
 				{
-					if (!ea->IsModeSupported (mode))
-						continue;
-
-                                    #ifndef WOLFCRYPT_BACKEND
-					if (typeid (*mode) == typeid (EncryptionModeXTS))
-					{
-                                           ea->SetKey (headerKey.GetRange (0, ea->GetKeySize()));
-                                    #else
-					if (typeid (*mode) == typeid (EncryptionModeWolfCryptXTS))
-					{
-                                              ea->SetKey (headerKey.GetRange (0, ea->GetKeySize()));
-						ea->SetKeyXTS (headerKey.GetRange (ea->GetKeySize(), ea->GetKeySize()));
-                                    #endif
-
-						mode = mode->GetNew();
-						mode->SetKey (headerKey.GetRange (ea->GetKeySize(), ea->GetKeySize()));
-					}
-					else
-					{
-						ea->SetKey (headerKey.GetRange (LegacyEncryptionModeKeyAreaSize, ea->GetKeySize()));
-					}
-
-					ea->SetMode (mode);
-
-					header.CopyFrom (encryptedData.GetRange (EncryptedHeaderDataOffset, EncryptedHeaderDataSize));
-					ea->Decrypt (header);
-
-					if (Deserialize (header, ea, mode))
-					{
-						EA = ea;
-						Pkcs5 = pkcs5;
-						return true;
-					}
+					EA = ea;
+					Pkcs5 = pkcs5;
+					return true;
 				}
 			}
 		}
@@ -56,6 +56,60 @@ namespace VeraCrypt
 		sr.Deserialize ("VolumeCreationTime", VolumeCreationTime);
 		sr.Deserialize ("Pim", Pim);
 		sr.Deserialize ("MasterKeyVulnerable", MasterKeyVulnerable);
+
+		try
+		{
+			sr.Deserialize ("SectorCacheHits", SectorCacheHits);
+			sr.Deserialize ("SectorCacheMisses", SectorCacheMisses);
+		}
+		catch (...)
+		{
+			SectorCacheHits = 0;
+			SectorCacheMisses = 0;
+		}
+
+		try
+		{
+			Statistics.Deserialize (sr);
+		}
+		catch (...)
+		{
+			Statistics = VolumeStatistics();
+		}
+
+		try
+		{
+			ThreadPoolConfiguration.Deserialize (sr);
+		}
+		catch (...)
+		{
+			ThreadPoolConfiguration = EncryptionThreadPool::Configuration();
+		}
+
+		HeaderProbeResults.clear();
+		try
+		{
+			uint32 resultCount;
+			sr.Deserialize ("HeaderProbeResultCount", resultCount);
+
+			for (uint32 i = 0; i < resultCount; ++i)
+			{
+				string name = "HeaderProbeResult" + StringConverter::ToSingle (i);
+				VolumeHeaderProbeResult result;
+
+				result.LayoutType = static_cast <VolumeType::Enum> (sr.DeserializeInt32 (name + "LayoutType"));
+				result.KdfName = sr.DeserializeWString (name + "KdfName");
+				sr.Deserialize (name + "ElapsedTime", result.ElapsedTime);
+				sr.Deserialize (name + "Completed", result.Completed);
+				sr.Deserialize (name + "HeaderDecrypted", result.HeaderDecrypted);
+
+				HeaderProbeResults.push_back (result);
+			}
+		}
+		catch (...)
+		{
+			HeaderProbeResults.clear();
+		}
 	}
 
 	bool VolumeInfo::FirstVolumeMountedAfterSecond (shared_ptr <VolumeInfo> first, shared_ptr <VolumeInfo> second)
@@ -97,6 +151,24 @@ namespace VeraCrypt
 		sr.Serialize ("VolumeCreationTime", VolumeCreationTime);
 		sr.Serialize ("Pim", Pim);
 		sr.Serialize ("MasterKeyVulnerable", MasterKeyVulnerable);
+		sr.Serialize ("SectorCacheHits", SectorCacheHits);
+		sr.Serialize ("SectorCacheMisses", SectorCacheMisses);
+		Statistics.Serialize (sr);
+		ThreadPoolConfiguration.Serialize (sr);
+
+		sr.Serialize ("HeaderProbeResultCount", (uint32) HeaderProbeResults.size());
+
+		uint32 i = 0;
+		foreach (const VolumeHeaderProbeResult &result, HeaderProbeResults)
+		{
+			string name = "HeaderProbeResult" + StringConverter::ToSingle (i++);
+
+			sr.Serialize (name + "LayoutType", static_cast <uint32> (result.LayoutType));
+			sr.Serialize (name + "KdfName", result.KdfName);
+			sr.Serialize (name + "ElapsedTime", result.ElapsedTime);
+			sr.Serialize (name + "Completed", result.Completed);
+			sr.Serialize (name + "HeaderDecrypted", result.HeaderDecrypted);
+		}
 	}
 
 	void VolumeInfo::Set (const Volume &volume)
@@ -107,6 +179,7 @@ namespace VeraCrypt
 		EncryptionAlgorithmName = volume.GetEncryptionAlgorithm()->GetName();
 		EncryptionModeName = volume.GetEncryptionMode()->GetName();
 		HeaderCreationTime = volume.GetHeaderCreationTime();
+		HeaderProbeResults = volume.GetHeaderProbeResults();
 		VolumeCreationTime = volume.GetVolumeCreationTime();
 		HiddenVolumeProtectionTriggered = volume.IsHiddenVolumeProtectionTriggered();
 		MinRequiredProgramVersion = volume.GetHeader()->GetRequiredMinProgramVersion();
@@ -122,6 +195,10 @@ namespace VeraCrypt
 		TotalDataWritten = volume.GetTotalDataWritten();
 		Pim = volume.GetPim ();
 		MasterKeyVulnerable = volume.IsMasterKeyVulnerable();
+		SectorCacheHits = volume.GetSectorCacheHits();
+		SectorCacheMisses = volume.GetSectorCacheMisses();
+		Statistics = volume.GetStatistics();
+		ThreadPoolConfiguration = EncryptionThreadPool::GetConfiguration();
 	}
 
 	TC_SERIALIZER_FACTORY_ADD_CLASS (VolumeInfo);
@@ -15,6 +15,7 @@
 
 #include "Platform/Platform.h"
 #include "Platform/Serializable.h"
+#include "Volume/EncryptionThreadPool.h"
 #include "Volume/Volume.h"
 #include "Volume/VolumeSlot.h"
 
@@ -41,6 +42,7 @@ namespace VeraCrypt
 		wstring EncryptionAlgorithmName;
 		wstring EncryptionModeName;
 		VolumeTime HeaderCreationTime;
+		VolumeHeaderProbeResultList HeaderProbeResults;
 		bool HiddenVolumeProtectionTriggered;
 		DevicePath LoopDevice;
 		uint32 MinRequiredProgramVersion;
@@ -62,6 +64,10 @@ namespace VeraCrypt
 		VolumeTime VolumeCreationTime;
 		int Pim;
 		bool MasterKeyVulnerable;
+		uint64 SectorCacheHits;
+		uint64 SectorCacheMisses;
+		VolumeStatistics Statistics;
+		EncryptionThreadPool::Configuration ThreadPoolConfiguration;
 	private:
 		VolumeInfo (const VolumeInfo &);
 		VolumeInfo &operator= (const VolumeInfo &);
@@ -0,0 +1,324 @@
+/*
+ Derived from source code of TrueCrypt 7.1a, which is
+ Copyright (c) 2008-2012 TrueCrypt Developers Association and which is governed
+ by the TrueCrypt License 3.0.
+
+ Modifications and additions to the original source code (contained in this file)
+ and all other portions of this file are Copyright (c) 2013-2025 IDRIX
+ and are governed by the Apache License 2.0 the full text of which is
+ contained in the file License.txt included in VeraCrypt binary and source
+ code distribution packages.
+*/
+
+#include "Common/Tcdefs.h"
+#include "Platform/Finally.h"
+#include "Platform/ForEach.h"
+#include "VolumeException.h"
+#include "VolumeReadAhead.h"
+
+namespace VeraCrypt
+{
+	static size_t GetExtentCount (size_t size)
+	{
+		if (size > VolumeReadAhead::MaxSize)
+			size = VolumeReadAhead::MaxSize;
+
+		size_t extentCount = size / VolumeReadAhead::ExtentSize;
+		return extentCount < 2 ? 2 : extentCount;
+	}
+
+	static size_t GetQueueCapacity (size_t extentCount)
+	{
+		size_t capacity = 2;
+		while (capacity < extentCount)
+			capacity <<= 1;
+
+		return capacity;
+	}
+
+	VolumeReadAhead::VolumeReadAhead (shared_ptr <File> volumeFile, shared_ptr <EncryptionAlgorithm> ea, uint64 dataOffset, uint64 dataSize, size_t sectorSize, size_t size, bool sparseData)
+		: VolumeFile (volumeFile),
+		EA (ea),
+		DataOffset (dataOffset),
+		DataSize (dataSize),
+		SectorSize (sectorSize),
+		SparseData (sparseData),
+		Extents (nullptr),
+		ExtentCount (GetExtentCount (size)),
+		CompletionEpoch (0),
+		PendingExtents (GetQueueCapacity (ExtentCount)),
+		Stopping (false),
+		NextSequentialOffset ((uint64) -1),
+		SequentialCount (0),
+		Hits (0)
+	{
+		if (ExtentSize % sectorSize != 0)
+			throw ParameterIncorrect (SRC_POS);
+
+		Extents = new Extent[ExtentCount];
+
+		try
+		{
+			// Page-aligned buffers can also be read if the volume file bypasses the system cache
+			for (size_t i = 0; i < ExtentCount; ++i)
+				Extents[i].Data.Allocate (ExtentSize, 4096);
+
+			for (size_t i = 0; i < WorkThreadCount; ++i)
+			{
+				struct WorkThreadFunctor : public Functor
+				{
+					WorkThreadFunctor (VolumeReadAhead *readAhead) : ReadAhead (readAhead) { }
+
+					virtual void operator() ()
+					{
+						ReadAhead->WorkThreadProc();
+					}
+
+					VolumeReadAhead *ReadAhead;
+				};
+
+				make_shared_auto (Thread, thread);
+				thread->Start (new WorkThreadFunctor (this));
+				WorkThreads.push_back (thread);
+			}
+		}
+		catch (...)
+		{
+			Stop();
+			throw;
+		}
+	}
+
+	VolumeReadAhead::~VolumeReadAhead ()
+	{
+		Stop();
+	}
+
+	VolumeReadAhead::Extent *VolumeReadAhead::FindExtent (uint64 byteOffset)
+	{
+		for (size_t i = 0; i < ExtentCount; ++i)
+		{
+			Extent &extent = Extents[i];
+
+			if (extent.State != ExtentState::Free && !extent.Stale
+				&& byteOffset >= extent.Offset && byteOffset < extent.Offset + extent.Size)
+			{
+				return &extent;
+			}
+		}
+
+		return nullptr;
+	}
+
+	void VolumeReadAhead::FreeExtent (Extent &extent)
+	{
+		if (extent.Size > 0)
+			FAST_ERASE64 (extent.Data.Ptr(), extent.Size);
+
+		extent.State = ExtentState::Free;
+		extent.Stale = false;
+		extent.Size = 0;
+	}
+
+	void VolumeReadAhead::Invalidate (uint64 byteOffset, uint64 length)
+	{
+		ScopeLock lock (ExtentMutex);
+
+		for (size_t i = 0; i < ExtentCount; ++i)
+		{
+			Extent &extent = Extents[i];
+
+			if (extent.State == ExtentState::Free
+				|| byteOffset >= extent.Offset + extent.Size
+				|| byteOffset + length <= extent.Offset)
+			{
+				continue;
+			}
+
+			// The data of a pending extent may predate the write, so it is discarded when the read completes
+			if (extent.State == ExtentState::Pending)
+				extent.Stale = true;
+			else
+				FreeExtent (extent);
+		}
+	}
+
+	bool VolumeReadAhead::Read (const BufferPtr &buffer, uint64 byteOffset)
+	{
+		uint64 endOffset = byteOffset + buffer.Size();
+
+		ExtentMutex.Lock();
+		finally_do_arg (Mutex *, &ExtentMutex, { finally_arg->Unlock(); });
+
+		// Requests of a stream may be submitted concurrently and arrive slightly out of order
+		uint64 distance = byteOffset > NextSequentialOffset ? byteOffset - NextSequentialOffset : NextSequentialOffset - byteOffset;
+
+		if (distance <= ExtentSize)
+		{
+			if (SequentialCount < SequentialThreshold)
+				++SequentialCount;
+
+			if (endOffset > NextSequentialOffset)
+				NextSequentialOffset = endOffset;
+		}
+		else
+		{
+			SequentialCount = 0;
+			NextSequentialOffset = endOffset;
+		}
+
+		if (SequentialCount < SequentialThreshold)
+			return false;
+
+		Schedule (byteOffset, endOffset - endOffset % ExtentSize);
+
+		uint64 offset = byteOffset;
+		while (offset < endOffset)
+		{
+			Extent *extent = FindExtent (offset);
+			if (!extent)
+				return false;
+
+			if (extent->State == ExtentState::Pending)
+			{
+				// Workers update extents under the mutex before incrementing the epoch
+				uint32 epoch = CompletionEpoch.load (std::memory_order_acquire);
+
+				ExtentMutex.Unlock();
+				Futex::Wait (CompletionEpoch, epoch);
+				ExtentMutex.Lock();
+				continue;
+			}
+
+			size_t extentOffset = (size_t) (offset - extent->Offset);
+			size_t copySize = extent->Size - extentOffset;
+			if (copySize > endOffset - offset)
+				copySize = (size_t) (endOffset - offset);
+
+			Memory::Copy (buffer.Get() + (offset - byteOffset), extent->Data.Ptr() + extentOffset, copySize);
+			offset += copySize;
+		}
+
+		++Hits;
+		return true;
+	}
+
+	void VolumeReadAhead::ReadExtent (Extent &extent)
+	{
+		BufferPtr data = extent.Data.GetRange (0, extent.Size);
+		uint64 hostOffset = DataOffset + extent.Offset;
+
+		if (VolumeFile->ReadAt (data, hostOffset) != extent.Size)
+			throw MissingVolumeData (SRC_POS);
+
+		if (SparseData)
+			EA->DecryptSparseSectors (data, hostOffset / SectorSize, extent.Size / SectorSize, SectorSize);
+		else
+			EA->DecryptSectors (data, hostOffset / SectorSize, extent.Size / SectorSize, SectorSize);
+	}
+
+	void VolumeReadAhead::Schedule (uint64 requestOffset, uint64 windowOffset)
+	{
+		uint64 windowEndOffset = windowOffset + ExtentCount * ExtentSize;
+		if (windowEndOffset > DataSize)
+			windowEndOffset = DataSize;
+
+		for (uint64 offset = windowOffset; offset < windowEndOffset; offset += ExtentSize)
+		{
+			if (FindExtent (offset))
+				continue;
+
+			// Extents the stream has passed or which lie beyond the window are recycled
+			Extent *slot = nullptr;
+
+			for (size_t i = 0; i < ExtentCount && !slot; ++i)
+			{
+				if (Extents[i].State == ExtentState::Free)
+					slot = &Extents[i];
+			}
+
+			for (size_t i = 0; i < ExtentCount && !slot; ++i)
+			{
+				Extent &extent = Extents[i];
+
+				if (extent.State == ExtentState::Ready
+					&& (extent.Offset + extent.Size <= requestOffset || extent.Offset >= windowEndOffset))
+				{
+					slot = &extent;
+				}
+			}
+
+			if (!slot)
+				break;
+
+			FreeExtent (*slot);
+
+			slot->Offset = offset;
+			slot->Size = windowEndOffset - offset < ExtentSize ? (size_t) (windowEndOffset - offset) : ExtentSize;
+			slot->State = ExtentState::Pending;
+
+			// Never blocks, as the queue can hold every extent
+			PendingExtents.Push ((size_t) (slot - Extents));
+		}
+	}
+
+	void VolumeReadAhead::Stop ()
+	{
+		{
+			ScopeLock lock (ExtentMutex);
+			Stopping = true;
+		}
+
+		PendingExtents.Close();
+
+		foreach_ref (const Thread &thread, WorkThreads)
+		{
+			thread.Join();
+		}
+
+		WorkThreads.clear();
+
+		delete[] Extents;
+		Extents = nullptr;
+	}
+
+	void VolumeReadAhead::WorkThreadProc ()
+	{
+		size_t index;
+
+		while (PendingExtents.Pop (index))
+		{
+			Extent &extent = Extents[index];
+			bool completed = false;
+			bool stopping;
+
+			{
+				ScopeLock lock (ExtentMutex);
+				stopping = Stopping;
+			}
+
+			if (!stopping)
+			{
+				// Errors are reported when the reader falls back to a regular read of the data
+				try
+				{
+					ReadExtent (extent);
+					completed = true;
+				}
+				catch (...) { }
+			}
+
+			{
+				ScopeLock lock (ExtentMutex);
+
+				if (completed && !extent.Stale)
+					extent.State = ExtentState::Ready;
+				else
+					FreeExtent (extent);
+			}
+
+			CompletionEpoch.fetch_add (1, std::memory_order_release);
+			Futex::WakeAll (CompletionEpoch);
+		}
+	}
+}
@@ -0,0 +1,97 @@
+/*
+ Derived from source code of TrueCrypt 7.1a, which is
+ Copyright (c) 2008-2012 TrueCrypt Developers Association and which is governed
+ by the TrueCrypt License 3.0.
+
+ Modifications and additions to the original source code (contained in this file)
+ and all other portions of this file are Copyright (c) 2013-2025 IDRIX
+ and are governed by the Apache License 2.0 the full text of which is
+ contained in the file License.txt included in VeraCrypt binary and source
+ code distribution packages.
+*/
+
+#ifndef TC_HEADER_Volume_VolumeReadAhead
+#define TC_HEADER_Volume_VolumeReadAhead
+
+#include <atomic>
+#include "Platform/Platform.h"
+#include "Platform/MpmcQueue.h"
+#include "EncryptionAlgorithm.h"
+
+namespace VeraCrypt
+{
+	// Detects sequential reads of volume data and prefetches the extents that follow them. Extents are
+	// read and decrypted by background threads (decryption itself is spread over EncryptionThreadPool),
+	// so that the disk and the CPU are busy while the reader is processing the data returned to it.
+	class VolumeReadAhead
+	{
+	public:
+		VolumeReadAhead (shared_ptr <File> volumeFile, shared_ptr <EncryptionAlgorithm> ea, uint64 dataOffset, uint64 dataSize, size_t sectorSize, size_t size, bool sparseData);
+		virtual ~VolumeReadAhead ();
+
+		uint64 GetHits () const { return Hits; }
+		void Invalidate (uint64 byteOffset, uint64 length);
+		bool Read (const BufferPtr &buffer, uint64 byteOffset);
+
+		static const size_t ExtentSize = 256 * 1024;
+		static const size_t MaxSize = 64 * 1024 * 1024;
+		static const size_t WorkThreadCount = 2;
+
+		// Number of consecutive sequential requests that start a prefetch
+		static const int SequentialThreshold = 2;
+
+	protected:
+		struct ExtentState
+		{
+			enum Enum
+			{
+				Free,
+				Pending,
+				Ready
+			};
+		};
+
+		struct Extent
+		{
+			Extent () : Offset (0), Size (0), State (ExtentState::Free), Stale (false) { }
+
+			uint64 Offset;
+			size_t Size;
+			ExtentState::Enum State;
+			bool Stale;
+			SecureBuffer Data;
+		};
+
+		Extent *FindExtent (uint64 byteOffset);
+		void FreeExtent (Extent &extent);
+		void ReadExtent (Extent &extent);
+		void Schedule (uint64 requestOffset, uint64 windowOffset);
+		void Stop ();
+		void WorkThreadProc ();
+
+		shared_ptr <File> VolumeFile;
+		shared_ptr <EncryptionAlgorithm> EA;
+		uint64 DataOffset;
+		uint64 DataSize;
+		size_t SectorSize;
+		bool SparseData; // Zero sectors read from holes of the host file are not decrypted
+
+		Mutex ExtentMutex;
+		Extent *Extents;
+		size_t ExtentCount;
+		std::atomic <uint32> CompletionEpoch;
+		MpmcQueue <size_t> PendingExtents;
+		list < shared_ptr <Thread> > WorkThreads;
+		bool Stopping;
+
+		uint64 NextSequentialOffset;
+		int SequentialCount;
+		uint64 Hits;
+
+	private:
+		VolumeReadAhead (const VolumeReadAhead &);
+		VolumeReadAhead &operator= (const VolumeReadAhead &);
+	};
+}
+
+#endif // TC_HEADER_Volume_VolumeReadAhead
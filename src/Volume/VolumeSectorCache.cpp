@@ -0,0 +1,214 @@
+/*
+ Derived from source code of TrueCrypt 7.1a, which is
+ Copyright (c) 2008-2012 TrueCrypt Developers Association and which is governed
+ by the TrueCrypt License 3.0.
+
+ Modifications and additions to the original source code (contained in this file)
+ and all other portions of this file are Copyright (c) 2013-2025 IDRIX
+ and are governed by the Apache License 2.0 the full text of which is
+ contained in the file License.txt included in VeraCrypt binary and source
+ code distribution packages.
+*/
+
+#ifdef TC_UNIX
+#	include <sys/mman.h>
+#endif
+
+#include "Common/Tcdefs.h"
+#include "VolumeSectorCache.h"
+
+namespace VeraCrypt
+{
+	VolumeSectorCache::VolumeSectorCache (size_t size)
+		: Data (nullptr), ClockHand (0), Generation (0), Hits (0), Misses (0)
+	{
+		if (size > MaxSize)
+			size = MaxSize;
+
+		UnitCount = size / UnitSize;
+		if (UnitCount < 1)
+			throw ParameterIncorrect (SRC_POS);
+
+		Entry emptyEntry;
+		emptyEntry.UnitNo = 0;
+		emptyEntry.Valid = false;
+		emptyEntry.Referenced = false;
+
+		Entries.assign (UnitCount, emptyEntry);
+		EntryIndex.reserve (UnitCount);
+
+		Data = static_cast <uint8 *> (Memory::AllocateAligned (UnitCount * UnitSize, UnitSize));
+
+#ifdef TC_UNIX
+		// Failure to lock the cache (e.g. due to RLIMIT_MEMLOCK) is not fatal
+		mlock (Data, UnitCount * UnitSize);
+#endif
+	}
+
+	VolumeSectorCache::~VolumeSectorCache ()
+	{
+		for (size_t i = 0; i < UnitCount; ++i)
+			FAST_ERASE64 (Data + i * UnitSize, UnitSize);
+
+#ifdef TC_UNIX
+		munlock (Data, UnitCount * UnitSize);
+#endif
+		Memory::FreeAligned (Data);
+	}
+
+	size_t VolumeSectorCache::EvictEntry ()
+	{
+		for (;;)
+		{
+			size_t i = ClockHand;
+			Entry &entry = Entries[i];
+
+			if (++ClockHand == UnitCount)
+				ClockHand = 0;
+
+			if (!entry.Valid)
+				return i;
+
+			if (entry.Referenced)
+			{
+				entry.Referenced = false;
+				continue;
+			}
+
+			EntryIndex.erase (entry.UnitNo);
+			entry.Valid = false;
+			return i;
+		}
+	}
+
+	uint64 VolumeSectorCache::GetGeneration ()
+	{
+		ScopeLock lock (CacheMutex);
+		return Generation;
+	}
+
+	void VolumeSectorCache::Insert (const ConstBufferPtr &units, uint64 byteOffset, uint64 generation)
+	{
+		if (byteOffset % UnitSize != 0 || units.Size() % UnitSize != 0)
+			throw ParameterIncorrect (SRC_POS);
+
+		ScopeLock lock (CacheMutex);
+
+		// Data read before a write invalidated the cache may be stale
+		if (generation != Generation)
+			return;
+
+		uint64 unitNo = byteOffset / UnitSize;
+
+		for (size_t offset = 0; offset < units.Size(); offset += UnitSize, ++unitNo)
+		{
+			size_t i;
+			std::unordered_map <uint64, size_t>::const_iterator existing = EntryIndex.find (unitNo);
+
+			if (existing != EntryIndex.end())
+			{
+				i = existing->second;
+			}
+			else
+			{
+				i = EvictEntry();
+				Entries[i].UnitNo = unitNo;
+				Entries[i].Valid = true;
+				EntryIndex[unitNo] = i;
+			}
+
+			Entries[i].Referenced = true;
+			Memory::Copy (Data + i * UnitSize, units.Get() + offset, UnitSize);
+		}
+	}
+
+	void VolumeSectorCache::Invalidate (uint64 byteOffset, uint64 length)
+	{
+		if (length == 0)
+			return;
+
+		uint64 firstUnitNo = byteOffset / UnitSize;
+		uint64 lastUnitNo = (byteOffset + length - 1) / UnitSize;
+
+		ScopeLock lock (CacheMutex);
+		++Generation;
+
+		if (EntryIndex.empty())
+			return;
+
+		if (lastUnitNo - firstUnitNo >= UnitCount)
+		{
+			// Scanning the entries is cheaper than probing every unit of a large range
+			for (size_t i = 0; i < UnitCount; ++i)
+			{
+				Entry &entry = Entries[i];
+				if (entry.Valid && entry.UnitNo >= firstUnitNo && entry.UnitNo <= lastUnitNo)
+				{
+					EntryIndex.erase (entry.UnitNo);
+					entry.Valid = false;
+					FAST_ERASE64 (Data + i * UnitSize, UnitSize);
+				}
+			}
+			return;
+		}
+
+		for (uint64 unitNo = firstUnitNo; unitNo <= lastUnitNo; ++unitNo)
+		{
+			std::unordered_map <uint64, size_t>::iterator existing = EntryIndex.find (unitNo);
+
+			if (existing != EntryIndex.end())
+			{
+				size_t i = existing->second;
+				EntryIndex.erase (existing);
+				Entries[i].Valid = false;
+				FAST_ERASE64 (Data + i * UnitSize, UnitSize);
+			}
+		}
+	}
+
+	bool VolumeSectorCache::Read (const BufferPtr &buffer, uint64 byteOffset)
+	{
+		if (buffer.Size() == 0)
+			return true;
+
+		uint64 firstUnitNo = byteOffset / UnitSize;
+		uint64 lastUnitNo = (byteOffset + buffer.Size() - 1) / UnitSize;
+		size_t entryIndexes[MaxRequestSize / UnitSize + 1];
+
+		if (lastUnitNo - firstUnitNo >= array_capacity (entryIndexes))
+			throw ParameterIncorrect (SRC_POS);
+
+		ScopeLock lock (CacheMutex);
+
+		for (uint64 unitNo = firstUnitNo; unitNo <= lastUnitNo; ++unitNo)
+		{
+			std::unordered_map <uint64, size_t>::const_iterator existing = EntryIndex.find (unitNo);
+
+			if (existing == EntryIndex.end())
+			{
+				++Misses;
+				return false;
+			}
+
+			entryIndexes[unitNo - firstUnitNo] = existing->second;
+		}
+
+		size_t bufferOffset = 0;
+		size_t unitOffset = (size_t) (byteOffset % UnitSize);
+
+		for (uint64 unitNo = firstUnitNo; unitNo <= lastUnitNo; ++unitNo)
+		{
+			size_t i = entryIndexes[unitNo - firstUnitNo];
+			size_t copySize = VC_MIN (UnitSize - unitOffset, buffer.Size() - bufferOffset);
+
+			Memory::Copy (buffer.Get() + bufferOffset, Data + i * UnitSize + unitOffset, copySize);
+			Entries[i].Referenced = true;
+
+			bufferOffset += copySize;
+			unitOffset = 0;
+		}
+
+		++Hits;
+		return true;
+	}
+}
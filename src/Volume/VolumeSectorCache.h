@@ -0,0 +1,68 @@
+/*
+ Derived from source code of TrueCrypt 7.1a, which is
+ Copyright (c) 2008-2012 TrueCrypt Developers Association and which is governed
+ by the TrueCrypt License 3.0.
+
+ Modifications and additions to the original source code (contained in this file)
+ and all other portions of this file are Copyright (c) 2013-2025 IDRIX
+ and are governed by the Apache License 2.0 the full text of which is
+ contained in the file License.txt included in VeraCrypt binary and source
+ code distribution packages.
+*/
+
+#ifndef TC_HEADER_Volume_VolumeSectorCache
+#define TC_HEADER_Volume_VolumeSectorCache
+
+#include <unordered_map>
+#include "Platform/Platform.h"
+
+namespace VeraCrypt
+{
+	// Size-bounded cache of decrypted volume data in units of UnitSize bytes, evicted by the CLOCK
+	// algorithm. The cache memory is locked where the system permits it and is wiped when units are
+	// invalidated and when the cache is destroyed.
+	class VolumeSectorCache
+	{
+	public:
+		VolumeSectorCache (size_t size);
+		virtual ~VolumeSectorCache ();
+
+		uint64 GetGeneration ();
+		uint64 GetHits () const { return Hits; }
+		uint64 GetMisses () const { return Misses; }
+		size_t GetSize () const { return UnitCount * UnitSize; }
+		void Insert (const ConstBufferPtr &units, uint64 byteOffset, uint64 generation);
+		void Invalidate (uint64 byteOffset, uint64 length);
+		bool Read (const BufferPtr &buffer, uint64 byteOffset);
+
+		static const size_t UnitSize = 4096;
+		static const size_t MaxSize = 1024 * 1024 * 1024;
+		static const size_t MaxRequestSize = 64 * 1024;
+
+	protected:
+		struct Entry
+		{
+			uint64 UnitNo;
+			bool Valid;
+			bool Referenced;
+		};
+
+		size_t EvictEntry ();
+
+		Mutex CacheMutex;
+		uint8 *Data;
+		vector <Entry> Entries;
+		std::unordered_map <uint64, size_t> EntryIndex;
+		size_t ClockHand;
+		uint64 Generation;
+		uint64 Hits;
+		uint64 Misses;
+		size_t UnitCount;
+
+	private:
+		VolumeSectorCache (const VolumeSectorCache &);
+		VolumeSectorCache &operator= (const VolumeSectorCache &);
+	};
+}
+
+#endif // TC_HEADER_Volume_VolumeSectorCache
@@ -0,0 +1,164 @@
+/*
+ Derived from source code of TrueCrypt 7.1a, which is
+ Copyright (c) 2008-2012 TrueCrypt Developers Association and which is governed
+ by the TrueCrypt License 3.0.
+
+ Modifications and additions to the original source code (contained in this file)
+ and all other portions of this file are Copyright (c) 2013-2025 IDRIX
+ and are governed by the Apache License 2.0 the full text of which is
+ contained in the file License.txt included in VeraCrypt binary and source
+ code distribution packages.
+*/
+
+#include "Platform/StringConverter.h"
+#include "VolumeStatistics.h"
+
+namespace VeraCrypt
+{
+	static const char *const LatencyNames[VolumeLatency::Count] =
+	{
+		"ReadLatency",
+		"ReadHostLatency",
+		"ReadCryptoLatency",
+		"WriteLatency",
+		"WriteHostLatency",
+		"WriteCryptoLatency"
+	};
+
+	size_t LatencyHistogram::GetBucket (uint64 time)
+	{
+		uint64 microseconds = time / 1000;
+		size_t bucket = 0;
+
+		while (microseconds != 0 && bucket < BucketCount - 1)
+		{
+			microseconds >>= 1;
+			++bucket;
+		}
+
+		return bucket;
+	}
+
+	uint64 LatencyHistogram::GetCount () const
+	{
+		uint64 count = 0;
+		for (size_t i = 0; i < BucketCount; ++i)
+			count += Buckets[i];
+
+		return count;
+	}
+
+	uint64 LatencyHistogram::GetMeanTime () const
+	{
+		uint64 count = GetCount();
+		return count != 0 ? TotalTime / count : 0;
+	}
+
+	uint64 LatencyHistogram::GetPercentileLimit (int percent) const
+	{
+		uint64 count = GetCount();
+		if (count == 0)
+			return 0;
+
+		// Smallest bucket limit which is not exceeded by the given percentage of samples
+		uint64 threshold = (count * percent + 99) / 100;
+		uint64 sum = 0;
+
+		for (size_t i = 0; i < BucketCount; ++i)
+		{
+			sum += Buckets[i];
+			if (sum >= threshold)
+				return GetBucketLimit (i);
+		}
+
+		return GetBucketLimit (BucketCount - 1);
+	}
+
+	void VolumeStatistics::Deserialize (Serializer &sr)
+	{
+		sr.Deserialize ("ReadOperations", ReadOperations);
+		sr.Deserialize ("ReadBytes", ReadBytes);
+		sr.Deserialize ("WriteOperations", WriteOperations);
+		sr.Deserialize ("WriteBytes", WriteBytes);
+
+		for (size_t type = 0; type < VolumeLatency::Count; ++type)
+		{
+			string name = LatencyNames[type];
+
+			for (size_t i = 0; i < LatencyHistogram::BucketCount; ++i)
+				sr.Deserialize (name + StringConverter::ToSingle ((uint32) i), Latency[type].Buckets[i]);
+
+			sr.Deserialize (name + "TotalTime", Latency[type].TotalTime);
+		}
+	}
+
+	void VolumeStatistics::Serialize (Serializer &sr) const
+	{
+		sr.Serialize ("ReadOperations", ReadOperations);
+		sr.Serialize ("ReadBytes", ReadBytes);
+		sr.Serialize ("WriteOperations", WriteOperations);
+		sr.Serialize ("WriteBytes", WriteBytes);
+
+		for (size_t type = 0; type < VolumeLatency::Count; ++type)
+		{
+			string name = LatencyNames[type];
+
+			for (size_t i = 0; i < LatencyHistogram::BucketCount; ++i)
+				sr.Serialize (name + StringConverter::ToSingle ((uint32) i), Latency[type].Buckets[i]);
+
+			sr.Serialize (name + "TotalTime", Latency[type].TotalTime);
+		}
+	}
+
+	VolumeStatisticsCounters::VolumeStatisticsCounters ()
+		: ReadOperations (0), ReadBytes (0), WriteOperations (0), WriteBytes (0)
+	{
+		for (size_t type = 0; type < VolumeLatency::Count; ++type)
+		{
+			for (size_t i = 0; i < LatencyHistogram::BucketCount; ++i)
+				Latency[type].Buckets[i] = 0;
+
+			Latency[type].TotalTime = 0;
+		}
+	}
+
+	void VolumeStatisticsCounters::AddLatency (VolumeLatency::Enum type, uint64 time)
+	{
+		Latency[type].Buckets[LatencyHistogram::GetBucket (time)].fetch_add (1, std::memory_order_relaxed);
+		Latency[type].TotalTime.fetch_add (time, std::memory_order_relaxed);
+	}
+
+	void VolumeStatisticsCounters::AddRead (uint64 length, uint64 time)
+	{
+		ReadOperations.fetch_add (1, std::memory_order_relaxed);
+		ReadBytes.fetch_add (length, std::memory_order_relaxed);
+		AddLatency (VolumeLatency::Read, time);
+	}
+
+	void VolumeStatisticsCounters::AddWrite (uint64 length, uint64 time)
+	{
+		WriteOperations.fetch_add (1, std::memory_order_relaxed);
+		WriteBytes.fetch_add (length, std::memory_order_relaxed);
+		AddLatency (VolumeLatency::Write, time);
+	}
+
+	VolumeStatistics VolumeStatisticsCounters::GetStatistics () const
+	{
+		// Counters are read individually, which may make a snapshot taken during I/O slightly inconsistent
+		VolumeStatistics statistics;
+		statistics.ReadOperations = ReadOperations.load (std::memory_order_relaxed);
+		statistics.ReadBytes = ReadBytes.load (std::memory_order_relaxed);
+		statistics.WriteOperations = WriteOperations.load (std::memory_order_relaxed);
+		statistics.WriteBytes = WriteBytes.load (std::memory_order_relaxed);
+
+		for (size_t type = 0; type < VolumeLatency::Count; ++type)
+		{
+			for (size_t i = 0; i < LatencyHistogram::BucketCount; ++i)
+				statistics.Latency[type].Buckets[i] = Latency[type].Buckets[i].load (std::memory_order_relaxed);
+
+			statistics.Latency[type].TotalTime = Latency[type].TotalTime.load (std::memory_order_relaxed);
+		}
+
+		return statistics;
+	}
+}
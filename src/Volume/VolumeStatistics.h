@@ -0,0 +1,120 @@
+/*
+ Derived from source code of TrueCrypt 7.1a, which is
+ Copyright (c) 2008-2012 TrueCrypt Developers Association and which is governed
+ by the TrueCrypt License 3.0.
+
+ Modifications and additions to the original source code (contained in this file)
+ and all other portions of this file are Copyright (c) 2013-2025 IDRIX
+ and are governed by the Apache License 2.0 the full text of which is
+ contained in the file License.txt included in VeraCrypt binary and source
+ code distribution packages.
+*/
+
+#ifndef TC_HEADER_Volume_VolumeStatistics
+#define TC_HEADER_Volume_VolumeStatistics
+
+#include <atomic>
+#include "Platform/Platform.h"
+#include "Platform/Serializer.h"
+#include "Platform/Time.h"
+
+namespace VeraCrypt
+{
+	struct VolumeLatency
+	{
+		enum Enum
+		{
+			Read,			// Complete read request
+			ReadHost,		// Reading of the host file or device
+			ReadCrypto,		// Decryption
+			Write,			// Complete write request
+			WriteHost,		// Writing of the host file or device
+			WriteCrypto,	// Encryption
+			Count
+		};
+	};
+
+	// Histogram of latencies on a log2 scale: bucket 0 counts samples shorter than 1 us and bucket i
+	// counts samples of 2^(i-1) us to 2^i us. The last bucket also counts all longer samples.
+	struct LatencyHistogram
+	{
+		LatencyHistogram () : TotalTime (0) { Memory::Zero (Buckets, sizeof (Buckets)); }
+
+		static size_t GetBucket (uint64 time);
+		static uint64 GetBucketLimit (size_t bucket) { return 1ULL << bucket; }	// Microseconds
+		uint64 GetCount () const;
+		uint64 GetMeanTime () const;	// Nanoseconds
+		uint64 GetPercentileLimit (int percent) const;	// Microseconds
+
+		static const size_t BucketCount = 28;
+
+		uint64 Buckets[BucketCount];
+		uint64 TotalTime;	// Nanoseconds
+	};
+
+	// Snapshot of the I/O statistics of a volume
+	struct VolumeStatistics
+	{
+		VolumeStatistics () : ReadOperations (0), ReadBytes (0), WriteOperations (0), WriteBytes (0) { }
+
+		void Deserialize (Serializer &sr);
+		void Serialize (Serializer &sr) const;
+
+		uint64 ReadOperations;
+		uint64 ReadBytes;
+		uint64 WriteOperations;
+		uint64 WriteBytes;
+		LatencyHistogram Latency[VolumeLatency::Count];
+	};
+
+	// Lock-free I/O counters of a volume, which may be updated by any number of threads
+	class VolumeStatisticsCounters
+	{
+	public:
+		VolumeStatisticsCounters ();
+		virtual ~VolumeStatisticsCounters () { }
+
+		void AddLatency (VolumeLatency::Enum type, uint64 time);
+		void AddRead (uint64 length, uint64 time);
+		void AddWrite (uint64 length, uint64 time);
+		VolumeStatistics GetStatistics () const;
+
+	protected:
+		struct Histogram
+		{
+			std::atomic <uint64> Buckets[LatencyHistogram::BucketCount];
+			std::atomic <uint64> TotalTime;
+		};
+
+		std::atomic <uint64> ReadOperations;
+		std::atomic <uint64> ReadBytes;
+		std::atomic <uint64> WriteOperations;
+		std::atomic <uint64> WriteBytes;
+		Histogram Latency[VolumeLatency::Count];
+
+	private:
+		VolumeStatisticsCounters (const VolumeStatisticsCounters &);
+		VolumeStatisticsCounters &operator= (const VolumeStatisticsCounters &);
+	};
+
+	// Adds the time elapsed between construction and destruction to a latency histogram
+	class ScopedLatency
+	{
+	public:
+		ScopedLatency (VolumeStatisticsCounters &counters, VolumeLatency::Enum type)
+			: Counters (counters), StartTime (Time::GetMonotonic()), Type (type) { }
+
+		~ScopedLatency () { Counters.AddLatency (Type, Time::GetMonotonic() - StartTime); }
+
+	protected:
+		VolumeStatisticsCounters &Counters;
+		uint64 StartTime;
+		VolumeLatency::Enum Type;
+
+	private:
+		ScopedLatency (const ScopedLatency &);
+		ScopedLatency &operator= (const ScopedLatency &);
+	};
+}
+
+#endif // TC_HEADER_Volume_VolumeStatistics
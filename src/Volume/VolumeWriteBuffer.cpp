@@ -0,0 +1,341 @@
+/*
+ Derived from source code of TrueCrypt 7.1a, which is
+ Copyright (c) 2008-2012 TrueCrypt Developers Association and which is governed
+ by the TrueCrypt License 3.0.
+
+ Modifications and additions to the original source code (contained in this file)
+ and all other portions of this file are Copyright (c) 2013-2025 IDRIX
+ and are governed by the Apache License 2.0 the full text of which is
+ contained in the file License.txt included in VeraCrypt binary and source
+ code distribution packages.
+*/
+
+#include "Common/Tcdefs.h"
+#include "Platform/Finally.h"
+#include "Platform/Futex.h"
+#include "Platform/Time.h"
+#include "VolumeWriteBuffer.h"
+
+namespace VeraCrypt
+{
+	static size_t GetBatchCount (size_t size)
+	{
+		if (size > VolumeWriteBuffer::MaxSize)
+			size = VolumeWriteBuffer::MaxSize;
+
+		size_t batchCount = size / VolumeWriteBuffer::BatchCapacity;
+		return batchCount < 1 ? 1 : batchCount;
+	}
+
+	VolumeWriteBuffer::VolumeWriteBuffer (size_t size, SectorHandler &batchWriter)
+		: BatchWriter (batchWriter),
+		Batches (nullptr),
+		BatchCount (GetBatchCount (size)),
+		BatchesWritten (0),
+		FlushThreadEpoch (0),
+		Stopping (false)
+	{
+		Batches = new Batch[BatchCount];
+
+		try
+		{
+			// Page-aligned buffers can also be written if the volume file bypasses the system cache
+			for (size_t i = 0; i < BatchCount; ++i)
+				Batches[i].Data.Allocate (BatchCapacity, 4096);
+
+			struct FlushThreadFunctor : public Functor
+			{
+				FlushThreadFunctor (VolumeWriteBuffer *writeBuffer) : WriteBuffer (writeBuffer) { }
+
+				virtual void operator() ()
+				{
+					WriteBuffer->FlushThreadProc();
+				}
+
+				VolumeWriteBuffer *WriteBuffer;
+			};
+
+			FlushThread.reset (new Thread);
+			FlushThread->Start (new FlushThreadFunctor (this));
+		}
+		catch (...)
+		{
+			delete[] Batches;
+			throw;
+		}
+	}
+
+	VolumeWriteBuffer::~VolumeWriteBuffer ()
+	{
+		{
+			ScopeLock lock (BatchMutex);
+			Stopping = true;
+			FlushThreadEpoch.fetch_add (1, std::memory_order_release);
+		}
+
+		Futex::WakeAll (FlushThreadEpoch);
+		FlushThread->Join();
+
+		// Data which has not been flushed is discarded
+		for (size_t i = 0; i < BatchCount; ++i)
+			FreeBatch (Batches[i]);
+
+		delete[] Batches;
+	}
+
+	void VolumeWriteBuffer::Flush ()
+	{
+		ScopeLock lock (BatchMutex);
+
+		// All batches are written even if some of them fail, which records the error
+		for (size_t i = 0; i < BatchCount; ++i)
+		{
+			if (Batches[i].Size == 0)
+				continue;
+
+			try
+			{
+				WriteBatch (Batches[i]);
+			}
+			catch (...) { }
+		}
+
+		ThrowWriteError();
+	}
+
+	void VolumeWriteBuffer::FlushOverlapping (uint64 byteOffset, uint64 length, const Batch *excludedBatch)
+	{
+		for (size_t i = 0; i < BatchCount; ++i)
+		{
+			Batch &batch = Batches[i];
+
+			if (&batch != excludedBatch && batch.Size != 0
+				&& byteOffset < batch.Offset + batch.Size && batch.Offset < byteOffset + length)
+			{
+				WriteBatch (batch);
+			}
+		}
+	}
+
+	void VolumeWriteBuffer::FlushThreadProc ()
+	{
+		const uint64 maxBatchAge = (uint64) MaxBatchAge * 1000 * 1000;
+
+		BatchMutex.Lock();
+		finally_do_arg (Mutex *, &BatchMutex, { finally_arg->Unlock(); });
+
+		while (!Stopping)
+		{
+			uint64 time = Time::GetMonotonic();
+			bool batchesPending = false;
+
+			for (size_t i = 0; i < BatchCount; ++i)
+			{
+				Batch &batch = Batches[i];
+
+				if (batch.Size == 0)
+					continue;
+
+				if (time - batch.CreationTime < maxBatchAge)
+				{
+					batchesPending = true;
+					continue;
+				}
+
+				// A failed batch is retried once it is old again, while the error is reported by writes and flushes
+				try
+				{
+					WriteBatch (batch);
+				}
+				catch (...)
+				{
+					batchesPending = true;
+				}
+			}
+
+			if (batchesPending)
+			{
+				BatchMutex.Unlock();
+				Thread::Sleep (MaxBatchAge / 2);
+				BatchMutex.Lock();
+			}
+			else
+			{
+				// Writers increment the epoch under the mutex when they start a batch
+				uint32 epoch = FlushThreadEpoch.load (std::memory_order_acquire);
+
+				BatchMutex.Unlock();
+				Futex::Wait (FlushThreadEpoch, epoch);
+				BatchMutex.Lock();
+			}
+		}
+	}
+
+	void VolumeWriteBuffer::FreeBatch (Batch &batch)
+	{
+		if (batch.Size > 0)
+			FAST_ERASE64 (batch.Data.Ptr(), batch.Size);
+
+		batch.Size = 0;
+	}
+
+	void VolumeWriteBuffer::Read (const BufferPtr &buffer, uint64 byteOffset, SectorHandler &sectorReader)
+	{
+		uint64 endOffset = byteOffset + buffer.Size();
+
+		{
+			ScopeLock lock (BatchMutex);
+
+			bool overlapping = false;
+			for (size_t i = 0; i < BatchCount && !overlapping; ++i)
+			{
+				const Batch &batch = Batches[i];
+				overlapping = batch.Size != 0 && byteOffset < batch.Offset + batch.Size && batch.Offset < endOffset;
+			}
+
+			if (overlapping)
+			{
+				// Batches cannot be written while the data read is being combined with them
+				sectorReader (buffer, byteOffset);
+
+				for (size_t i = 0; i < BatchCount; ++i)
+				{
+					const Batch &batch = Batches[i];
+
+					if (batch.Size == 0 || byteOffset >= batch.Offset + batch.Size || batch.Offset >= endOffset)
+						continue;
+
+					uint64 copyOffset = batch.Offset > byteOffset ? batch.Offset : byteOffset;
+					uint64 copyEndOffset = batch.Offset + batch.Size < endOffset ? batch.Offset + batch.Size : endOffset;
+
+					Memory::Copy (buffer.Get() + (copyOffset - byteOffset), batch.Data.Ptr() + (copyOffset - batch.Offset), (size_t) (copyEndOffset - copyOffset));
+				}
+
+				return;
+			}
+		}
+
+		// Reads of data without pending writes do not block writers
+		sectorReader (buffer, byteOffset);
+	}
+
+	void VolumeWriteBuffer::ThrowWriteError ()
+	{
+		// Acknowledged writes may have been lost, which is reported until the volume is closed
+		if (WriteError)
+			WriteError->Throw();
+	}
+
+	bool VolumeWriteBuffer::Write (const ConstBufferPtr &buffer, uint64 byteOffset)
+	{
+		uint64 length = buffer.Size();
+		uint64 endOffset = byteOffset + length;
+
+		ScopeLock lock (BatchMutex);
+		ThrowWriteError();
+
+		// Large writes are not buffered, but must not be overwritten later by older buffered data
+		if (length >= BatchCapacity)
+		{
+			FlushOverlapping (byteOffset, length, nullptr);
+			return false;
+		}
+
+		// A batch is extended by writes which start within or immediately after its range
+		Batch *batch = nullptr;
+		for (size_t i = 0; i < BatchCount && !batch; ++i)
+		{
+			Batch &b = Batches[i];
+			uint64 batchEndOffset = b.Offset + b.Size;
+
+			if (b.Size != 0 && byteOffset >= b.Offset && byteOffset <= batchEndOffset
+				&& (endOffset > batchEndOffset ? endOffset : batchEndOffset) - b.Offset <= BatchCapacity)
+			{
+				batch = &b;
+			}
+		}
+
+		// Data of other batches which the write overlaps is older and is therefore written first
+		FlushOverlapping (byteOffset, length, batch);
+
+		if (!batch)
+		{
+			Batch *oldestBatch = nullptr;
+
+			for (size_t i = 0; i < BatchCount && !batch; ++i)
+			{
+				Batch &b = Batches[i];
+
+				if (b.Size == 0)
+					batch = &b;
+				else if (!oldestBatch || b.CreationTime < oldestBatch->CreationTime)
+					oldestBatch = &b;
+			}
+
+			if (!batch)
+			{
+				batch = oldestBatch;
+				WriteBatch (*batch);
+			}
+
+			batch->Offset = byteOffset;
+			batch->CreationTime = Time::GetMonotonic();
+
+			FlushThreadEpoch.fetch_add (1, std::memory_order_release);
+			Futex::WakeAll (FlushThreadEpoch);
+		}
+
+		Memory::Copy (batch->Data.Ptr() + (byteOffset - batch->Offset), buffer.Get(), (size_t) length);
+
+		if (endOffset - batch->Offset > batch->Size)
+			batch->Size = (size_t) (endOffset - batch->Offset);
+
+		// The write is buffered even if the full batch cannot be written yet, which is reported later
+		if (batch->Size == BatchCapacity)
+		{
+			try
+			{
+				WriteBatch (*batch);
+			}
+			catch (...) { }
+		}
+
+		return true;
+	}
+
+	void VolumeWriteBuffer::WriteBatch (Batch &batch)
+	{
+		// A batch is released only once it has been written, as its writes have already been acknowledged
+		try
+		{
+			BatchWriter (batch.Data.GetRange (0, batch.Size), batch.Offset);
+		}
+		catch (Exception &e)
+		{
+			if (!WriteError)
+				WriteError.reset (e.CloneNew());
+
+			batch.CreationTime = Time::GetMonotonic();
+			throw;
+		}
+		catch (exception &e)
+		{
+			if (!WriteError)
+				WriteError.reset (new ExternalException (SRC_POS, StringConverter::ToExceptionString (e)));
+
+			batch.CreationTime = Time::GetMonotonic();
+			throw;
+		}
+		catch (...)
+		{
+			if (!WriteError)
+				WriteError.reset (new UnknownException (SRC_POS));
+
+			batch.CreationTime = Time::GetMonotonic();
+			throw;
+		}
+
+		FreeBatch (batch);
+		++BatchesWritten;
+	}
+}
@@ -0,0 +1,82 @@
+/*
+ Derived from source code of TrueCrypt 7.1a, which is
+ Copyright (c) 2008-2012 TrueCrypt Developers Association and which is governed
+ by the TrueCrypt License 3.0.
+
+ Modifications and additions to the original source code (contained in this file)
+ and all other portions of this file are Copyright (c) 2013-2025 IDRIX
+ and are governed by the Apache License 2.0 the full text of which is
+ contained in the file License.txt included in VeraCrypt binary and source
+ code distribution packages.
+*/
+
+#ifndef TC_HEADER_Volume_VolumeWriteBuffer
+#define TC_HEADER_Volume_VolumeWriteBuffer
+
+#include <atomic>
+#include "Platform/Platform.h"
+
+namespace VeraCrypt
+{
+	// Gathers small writes of volume data into batches of up to BatchCapacity bytes, each covering a
+	// contiguous range, so that adjacent writes are encrypted and written to the host by a single
+	// transfer. A batch is written when it is full, when its slot is needed for a write elsewhere, when
+	// it is older than MaxBatchAge and when the buffer is flushed. Batches never overlap each other.
+	// A batch which fails to be written is kept and written again later, as its writes have already been
+	// acknowledged. The first such failure is reported by every later call to Write() and Flush().
+	class VolumeWriteBuffer
+	{
+	public:
+		struct SectorHandler
+		{
+			virtual ~SectorHandler () { }
+			virtual void operator() (const BufferPtr &buffer, uint64 byteOffset) = 0;
+		};
+
+		VolumeWriteBuffer (size_t size, SectorHandler &batchWriter);
+		virtual ~VolumeWriteBuffer ();
+
+		void Flush ();
+		uint64 GetBatchesWritten () const { return BatchesWritten; }
+		void Read (const BufferPtr &buffer, uint64 byteOffset, SectorHandler &sectorReader);
+		bool Write (const ConstBufferPtr &buffer, uint64 byteOffset);
+
+		static const size_t BatchCapacity = 256 * 1024;
+		static const size_t MaxSize = 64 * 1024 * 1024;
+		static const uint32 MaxBatchAge = 50; // ms
+
+	protected:
+		struct Batch
+		{
+			Batch () : Offset (0), Size (0), CreationTime (0) { }
+
+			uint64 Offset;
+			size_t Size;
+			uint64 CreationTime;
+			SecureBuffer Data;
+		};
+
+		void FlushOverlapping (uint64 byteOffset, uint64 length, const Batch *excludedBatch);
+		void FlushThreadProc ();
+		static void FreeBatch (Batch &batch);
+		void ThrowWriteError ();
+		void WriteBatch (Batch &batch);
+
+		SectorHandler &BatchWriter;
+		Mutex BatchMutex;
+		Batch *Batches;
+		size_t BatchCount;
+		uint64 BatchesWritten;
+		unique_ptr <Exception> WriteError;
+
+		shared_ptr <Thread> FlushThread;
+		std::atomic <uint32> FlushThreadEpoch;
+		bool Stopping;
+
+	private:
+		VolumeWriteBuffer (const VolumeWriteBuffer &);
+		VolumeWriteBuffer &operator= (const VolumeWriteBuffer &);
+	};
+}
+
+#endif // TC_HEADER_Volume_VolumeWriteBuffer